@@ -0,0 +1,852 @@
+/**
+ * @file jxs_bench.c
+ * @brief Throughput benchmark of the conversion functions over the example
+ * struct shapes. One row is printed for every shape and operation, as csv or
+ * json, so the results of two library versions can be compared by a script.
+ *
+ * usage: jxs_bench [-f csv|json] [-s scale] [-t ms] [-d jsondir] [-o outdir] [shape...]
+ *
+ *   -f  output format, csv by default.
+ *   -s  records per call. With a scale above 1 the struct is an array of
+ *       'scale' copies of the shape, written as {"records":[...]}.
+ *   -t  minimum measuring time of every operation in milliseconds.
+ *   -d  directory of the example json files, '<bindir>/../example/json' by default.
+ *   -o  directory of the temporary files of 'to_file' and 'from_file'.
+ *
+ * The 'dense_array' shape is not an example: it is the multi_dimen_array
+ * matrix with every element set, plus a small nested struct array, so that
+ * '-s 50000 dense_array' gives a json text of about 230MB.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include "jsonXstruct.h"
+
+#ifndef JXS_BENCH_VERSION
+#define JXS_BENCH_VERSION    "unknown"
+#endif
+
+/*
+ * Allocations are counted by replacing malloc() in the executable, the
+ * library and json-c call it through the dynamic linker. Only glibc exports
+ * the '__libc_*' entries the counting functions forward to, elsewhere the
+ * column is -1.
+ */
+#if defined(__GLIBC__) && !defined(JXS_BENCH_NO_MALLOC_COUNT)
+#define BENCH_COUNT_MALLOC    1
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static uint64_t malloc_count = 0;
+
+void *malloc(size_t size)
+{
+	malloc_count++;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	malloc_count++;
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	malloc_count++;
+	return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+	__libc_free(ptr);
+}
+#endif
+
+/* basic.c */
+struct thumbs {
+	char icon[1024];
+	char url1[1024];
+	char url2[1024];
+	char url3[1024];
+};
+
+struct basic {
+	int           vari;
+	int64_t       vari64;
+	bool          varb;
+	double        vard;
+	char          path[1024];
+	int           matrix[2][2][3];
+	struct thumbs ta;
+	struct thumbs tb[2];
+};
+
+static jxs_mapper *basic_descriptor(void *context)
+{
+	jxs_mapper *mapper     = NULL;
+	jxs_mapper *map_thumbs = NULL;
+	jxs_map_new(context, struct basic, mapper, 8);
+	jxs_map_new(context, struct thumbs, map_thumbs, 4);
+	jxs_item_add(mapper, int, vari, NULL);
+	jxs_item_add(mapper, int, vari64, NULL);
+	jxs_item_add(mapper, boolean, varb, NULL);
+	jxs_item_add(mapper, double, vard, NULL);
+	jxs_item_add(mapper, string, path, NULL);
+	jxs_item_add(mapper, int, matrix, NULL, 2, 2, 3);
+	jxs_item_add(mapper, struct, ta, map_thumbs);
+	jxs_item_add(mapper, struct, tb, map_thumbs, 2);
+
+	jxs_item_add(map_thumbs, string, icon, NULL);
+	jxs_item_add(map_thumbs, string, url1, NULL);
+	jxs_item_add(map_thumbs, string, url2, NULL);
+	jxs_item_add(map_thumbs, string, url3, NULL);
+	return mapper;
+}
+
+/* struct_reuse.c */
+struct task {
+	int           category;
+	int64_t       fs_id;
+	bool          isdir;
+	char          md5[64];
+	char          path[1024];
+	int64_t       server_ctime;
+	char          server_filename[1024];
+	int64_t       server_mtime;
+	int64_t       size;
+	struct thumbs tb[2];
+	char          cube[2][2][2][2][1024];
+};
+
+typedef struct task_all_t {
+	struct task up;
+	struct task down;
+	struct task bt;
+	struct task cdn;
+} task_all_t;
+
+static jxs_mapper *struct_reuse_descriptor(void *context)
+{
+	jxs_mapper *mapper     = NULL;
+	jxs_mapper *map_task   = NULL;
+	jxs_mapper *map_thumbs = NULL;
+	jxs_map_new(context, task_all_t, mapper, 4);
+	jxs_map_new(context, struct task, map_task, 11);
+	jxs_map_new(context, struct thumbs, map_thumbs, 4);
+	jxs_item_add(mapper, struct, up, map_task);
+	jxs_item_add(mapper, struct, down, map_task);
+	jxs_item_add(mapper, struct, bt, map_task);
+	jxs_item_add(mapper, struct, cdn, map_task);
+
+	jxs_item_add(map_task, int, category, NULL);
+	jxs_item_add(map_task, int, fs_id, NULL);
+	jxs_item_add(map_task, boolean, isdir, NULL);
+	jxs_item_add(map_task, string, md5, NULL);
+	jxs_item_add(map_task, string, path, NULL);
+	jxs_item_add(map_task, int, server_ctime, NULL);
+	jxs_item_add(map_task, string, server_filename, NULL);
+	jxs_item_add(map_task, int, server_mtime, NULL);
+	jxs_item_add(map_task, int, size, NULL);
+	jxs_item_add(map_task, struct, tb, map_thumbs, JXS_NELEM(((struct task *)0)->tb));
+	jxs_item_add(map_task, string, cube, NULL, 2, 2, 2, 2);
+
+	jxs_item_add(map_thumbs, string, icon, NULL);
+	jxs_item_add(map_thumbs, string, url1, NULL);
+	jxs_item_add(map_thumbs, string, url2, NULL);
+	jxs_item_add(map_thumbs, string, url3, NULL);
+	return mapper;
+}
+
+/* anonymous_struct.c */
+typedef struct anon_cfg_t {
+	struct {
+		char     cdn_dir[1024];
+		char     dev_sn[512];
+		uint32_t cdn_size;
+		uint32_t remain_size;
+		uint64_t speed_limit;
+		char     download_dir[1024];
+		char     token_path[1024];
+		int      matrix[5][4][3];
+	}    tdcfg;
+	char tdcfg_path[1024];
+	struct {
+		int  onflag;
+		char data_dir[1024];
+		char all_path[20][1024];
+		struct {
+			char    name[1024];
+			double  pi;
+			bool    is_new;
+			int64_t size;
+			int32_t limit;
+		}    dev_info[2][2][2];
+		struct {
+			int64_t code;
+			char    err[10];
+		}    errmsg[4];
+	}    modcfg;
+	char modcfg_path[1024];
+} anon_cfg_t;
+
+static jxs_mapper *anonymous_struct_descriptor(void *context)
+{
+	anon_cfg_t *cfg       = NULL;
+	jxs_mapper *mapper    = NULL;
+	jxs_mapper *jm_tdcfg  = NULL;
+	jxs_mapper *jm_modcfg = NULL;
+	jxs_mapper *jm_dinfo  = NULL;
+	jxs_mapper *jm_errmsg = NULL;
+	jxs_anon_map_new(context, mapper, 4);
+	jxs_anon_map_new(context, jm_modcfg, 5);
+	jxs_anon_map_new(context, jm_errmsg, 2);
+	jxs_anon_map_new(context, jm_tdcfg, 8);
+	jxs_anon_map_new(context, jm_dinfo, 5);
+
+	jxs_anon_item_add(mapper, cfg, struct, tdcfg, jm_tdcfg);
+	jxs_anon_item_add(mapper, cfg, string, tdcfg_path, NULL);
+	jxs_anon_item_add(mapper, cfg, struct, modcfg, jm_modcfg);
+	jxs_anon_item_add(mapper, cfg, string, modcfg_path, NULL);
+
+	jxs_anon_item_add(jm_tdcfg, &cfg->tdcfg, string, cdn_dir, NULL);
+	jxs_anon_item_add(jm_tdcfg, &cfg->tdcfg, string, dev_sn, NULL);
+	jxs_anon_item_add(jm_tdcfg, &cfg->tdcfg, int, cdn_size, NULL);
+	jxs_anon_item_add(jm_tdcfg, &cfg->tdcfg, int, remain_size, NULL);
+	jxs_anon_item_add(jm_tdcfg, &cfg->tdcfg, int, speed_limit, NULL);
+	jxs_anon_item_add(jm_tdcfg, &cfg->tdcfg, string, download_dir, NULL);
+	jxs_anon_item_add(jm_tdcfg, &cfg->tdcfg, string, token_path, NULL);
+	jxs_anon_item_add(jm_tdcfg, &cfg->tdcfg, int, matrix, NULL, 5, 4, 3);
+
+	jxs_anon_item_add(jm_modcfg, &cfg->modcfg, int, onflag, NULL);
+	jxs_anon_item_add(jm_modcfg, &cfg->modcfg, string, data_dir, NULL);
+	jxs_anon_item_add(jm_modcfg, &cfg->modcfg, string, all_path, NULL, JXS_NELEM(cfg->modcfg.all_path));
+	jxs_anon_item_add(jm_modcfg, &cfg->modcfg, struct, dev_info, jm_dinfo, 2, 2, 2);
+	jxs_anon_item_add(jm_modcfg, &cfg->modcfg, struct, errmsg, jm_errmsg, JXS_NELEM(cfg->modcfg.errmsg));
+
+	jxs_anon_item_add(jm_dinfo, cfg->modcfg.dev_info[0][0], string, name, NULL);
+	jxs_anon_item_add(jm_dinfo, cfg->modcfg.dev_info[0][0], double, pi, NULL);
+	jxs_anon_item_add(jm_dinfo, cfg->modcfg.dev_info[0][0], boolean, is_new, NULL);
+	jxs_anon_item_add(jm_dinfo, cfg->modcfg.dev_info[0][0], int, size, NULL);
+	jxs_anon_item_add(jm_dinfo, cfg->modcfg.dev_info[0][0], int, limit, NULL);
+
+	jxs_anon_item_add(jm_errmsg, cfg->modcfg.errmsg, int, code, NULL);
+	jxs_anon_item_add(jm_errmsg, cfg->modcfg.errmsg, string, err, NULL);
+	return mapper;
+}
+
+/* set_attributes.c, the 'input' key is used both ways */
+typedef struct attr_cfg_t {
+	struct {
+		char     cdn_dir[1024];
+		char     dev_sn[512];
+		uint32_t cdn_size;
+		uint32_t remain_size;
+		uint64_t speed_limit;
+		char     download_dir[1024];
+		char     token_path[1024];
+		int      matrix[5][4][3];
+	}    tdcfg;
+	char tdcfg_path[1024];
+	struct {
+		int  onflag;
+		char data_dir[1024];
+		char all_path[20][1024];
+		struct {
+			char    name[1024];
+			float   pi;
+			bool    is_new;
+			int64_t size;
+			int32_t limit;
+		}    dev_info;
+		struct {
+			int64_t code;
+			char    err[10];
+		}    errmsg[4];
+	}    modcfg;
+	char modcfg_path[1024];
+} attr_cfg_t;
+
+static jxs_mapper *set_attributes_descriptor(void *context)
+{
+	attr_cfg_t *cfg       = NULL;
+	jxs_item   *item      = NULL;
+	jxs_mapper *mapper    = NULL;
+	jxs_mapper *jm_tdcfg  = NULL;
+	jxs_mapper *jm_modcfg = NULL;
+	jxs_mapper *jm_dinfo  = NULL;
+	jxs_mapper *jm_errmsg = NULL;
+	jxs_map_new(context, attr_cfg_t, mapper, 4);
+	jxs_anon_map_new(context, jm_tdcfg, 8);
+	jxs_anon_map_new(context, jm_modcfg, 5);
+	jxs_anon_map_new(context, jm_dinfo, 5);
+	jxs_anon_map_new(context, jm_errmsg, 2);
+
+	jxs_item_add(mapper, struct, tdcfg, jm_tdcfg);
+	jxs_item_add(mapper, string, tdcfg_path, NULL);
+	jxs_item_add(mapper, struct, modcfg, jm_modcfg);
+	jxs_item_add(mapper, string, modcfg_path, NULL);
+
+	jxs_anon_item_add(jm_tdcfg, &cfg->tdcfg, string, cdn_dir, NULL);
+	jxs_anon_item_add(jm_tdcfg, &cfg->tdcfg, string, dev_sn, NULL);
+	jxs_anon_item_add(jm_tdcfg, &cfg->tdcfg, int, cdn_size, NULL);
+	jxs_anon_item_add(jm_tdcfg, &cfg->tdcfg, int, remain_size, NULL);
+	jxs_anon_item_add(jm_tdcfg, &cfg->tdcfg, int, speed_limit, NULL);
+	jxs_anon_item_add(jm_tdcfg, &cfg->tdcfg, string, download_dir, NULL);
+	item = jxs_anon_item_add(jm_tdcfg, &cfg->tdcfg, string, token_path, NULL);
+	jxs_item_set_rule(item, JXS_RULE_SET_NULL);
+	jxs_anon_item_add(jm_tdcfg, &cfg->tdcfg, int, matrix, NULL, 5, 4, 3);
+
+	jxs_anon_item_add(jm_modcfg, &cfg->modcfg, int, onflag, NULL);
+	jxs_anon_item_add(jm_modcfg, &cfg->modcfg, string, data_dir, NULL);
+	item = jxs_anon_item_add(jm_modcfg, &cfg->modcfg, string, all_path, NULL, JXS_NELEM(cfg->modcfg.all_path));
+	jxs_item_set_rule(item, JXS_RULE_DROP_SELF);
+	jxs_item_set_constkey(item, "input");
+	jxs_anon_item_add(jm_modcfg, &cfg->modcfg, struct, dev_info, jm_dinfo);
+	jxs_anon_item_add(jm_modcfg, &cfg->modcfg, struct, errmsg, jm_errmsg, JXS_NELEM(cfg->modcfg.errmsg));
+
+	jxs_anon_item_add(jm_dinfo, &cfg->modcfg.dev_info, string, name, NULL);
+	jxs_anon_item_add(jm_dinfo, &cfg->modcfg.dev_info, double, pi, NULL);
+	jxs_anon_item_add(jm_dinfo, &cfg->modcfg.dev_info, boolean, is_new, NULL);
+	jxs_anon_item_add(jm_dinfo, &cfg->modcfg.dev_info, int, size, NULL);
+	jxs_anon_item_add(jm_dinfo, &cfg->modcfg.dev_info, int, limit, NULL);
+
+	jxs_anon_item_add(jm_errmsg, cfg->modcfg.errmsg, int, code, NULL);
+	jxs_anon_item_add(jm_errmsg, cfg->modcfg.errmsg, string, err, NULL);
+	return mapper;
+}
+
+/* multi_dimen_array.c */
+struct url_set {
+	char url1[1024];
+	char url2[1024];
+	char url3[1024];
+};
+
+struct info_set {
+	char           name[512];
+	int            age;
+	char           address[512];
+	uint64_t       id;
+	struct url_set url[2][3][2][3];
+};
+
+struct mdarray_set {
+	int             matrix[2][2][3][4][2][3];
+	struct info_set info[2][3][2];
+};
+
+typedef struct array_t {
+	struct mdarray_set a;
+	struct mdarray_set b[2];
+	struct mdarray_set c[2][2];
+	struct mdarray_set d[2][2][2];
+} array_t;
+
+static jxs_mapper *multi_dimen_array_descriptor(void *context)
+{
+	jxs_mapper *mapper      = NULL;
+	jxs_mapper *map_mdarray = NULL;
+	jxs_mapper *map_info    = NULL;
+	jxs_mapper *map_url     = NULL;
+	jxs_map_new(context, array_t, mapper, 4);
+	jxs_map_new(context, struct mdarray_set, map_mdarray, 2);
+	jxs_map_new(context, struct info_set, map_info, 5);
+	jxs_map_new(context, struct url_set, map_url, 3);
+	jxs_item_add(mapper, struct, a, map_mdarray);
+	jxs_item_add(mapper, struct, b, map_mdarray, 2);
+	jxs_item_add(mapper, struct, c, map_mdarray, 2, 2);
+	jxs_item_add(mapper, struct, d, map_mdarray, 2, 2, 2);
+
+	jxs_item_add(map_mdarray, int, matrix, NULL, 2, 2, 3, 4, 2, 3);
+	jxs_item_add(map_mdarray, struct, info, map_info, 2, 3, 2);
+
+	jxs_item_add(map_info, string, name, NULL);
+	jxs_item_add(map_info, int, age, NULL);
+	jxs_item_add(map_info, string, address, NULL);
+	jxs_item_add(map_info, int, id, NULL);
+	jxs_item_add(map_info, struct, url, map_url, 2, 3, 2, 3);
+
+	jxs_item_add(map_url, string, url1, NULL);
+	jxs_item_add(map_url, string, url2, NULL);
+	jxs_item_add(map_url, string, url3, NULL);
+	return mapper;
+}
+
+/* dynamic_modify.c, without the prints of the convert callback */
+typedef struct bd_listall_t {
+	int  cursor;
+	char errmsg[128];
+	int  _errno;
+	int  has_more;
+	struct {
+		int     category;
+		int64_t fs_id;
+		bool    isdir;
+		char    md5[64];
+		char    path[1024];
+		int64_t server_ctime;
+		char    server_filename[1024];
+		int64_t server_mtime;
+		int64_t size;
+		struct {
+			char icon[1024];
+			char url1[1024];
+			char url2[1024];
+			char url3[1024];
+		}       thumbs[2];
+	}    list[10];
+	char request_id[128];
+} bd_listall_t;
+
+static void dynamic_modify_callback(void *context)
+{
+	void *vptr = NULL;
+	if ((vptr = jxs_cvt_get_item_fuzzy(context, "list[x].thumbs[x].url1")) != NULL) {
+		const char *url1 = (const char *)vptr;
+		if (url1[0] == '\0') {
+			jxs_cvt_set_item_rule(context, JXS_RULE_KEEP_RAW);
+		}
+	}
+	if ((vptr = jxs_cvt_get_item(context, "list[1].thumbs[1].url3")) != NULL) {
+		strncpy((char *)vptr, "https://translate.google.cn/", 1024 - 1);
+	}
+}
+
+static jxs_mapper *dynamic_modify_descriptor(void *context)
+{
+	bd_listall_t *listall    = NULL;
+	jxs_item     *item       = NULL;
+	jxs_mapper   *mapper     = NULL;
+	jxs_mapper   *jmp_list   = NULL;
+	jxs_mapper   *jmp_thumbs = NULL;
+	jxs_anon_map_new(context, mapper, 6);
+	jxs_anon_map_new(context, jmp_list, 10);
+	jxs_anon_map_new(context, jmp_thumbs, 4);
+	jxs_set_convert_callback(context, dynamic_modify_callback);
+
+	jxs_anon_item_add(mapper, listall, int, cursor, NULL);
+	jxs_anon_item_add(mapper, listall, string, errmsg, NULL);
+	item = jxs_anon_item_add(mapper, listall, int, _errno, NULL);
+	jxs_item_set_constkey(item, "errno");
+	jxs_anon_item_add(mapper, listall, int, has_more, NULL);
+	jxs_anon_item_add(mapper, listall, struct, list, jmp_list, JXS_NELEM(listall->list));
+	jxs_anon_item_add(mapper, listall, string, request_id, NULL);
+
+	jxs_anon_item_add(jmp_list, listall->list, int, category, NULL);
+	jxs_anon_item_add(jmp_list, listall->list, int, fs_id, NULL);
+	jxs_anon_item_add(jmp_list, listall->list, int, isdir, NULL);
+	jxs_anon_item_add(jmp_list, listall->list, string, md5, NULL);
+	jxs_anon_item_add(jmp_list, listall->list, string, path, NULL);
+	jxs_anon_item_add(jmp_list, listall->list, int, server_ctime, NULL);
+	jxs_anon_item_add(jmp_list, listall->list, string, server_filename, NULL);
+	jxs_anon_item_add(jmp_list, listall->list, int, server_mtime, NULL);
+	jxs_anon_item_add(jmp_list, listall->list, int, size, NULL);
+	jxs_anon_item_add(jmp_list, listall->list, struct, thumbs, jmp_thumbs, JXS_NELEM(listall->list->thumbs));
+	item = jxs_anon_item_add(jmp_thumbs, listall->list->thumbs, string, icon, NULL);
+	jxs_item_set_rule(item, JXS_RULE_SET_NULL);
+	item = jxs_anon_item_add(jmp_thumbs, listall->list->thumbs, string, url1, NULL);
+	jxs_item_set_rule(item, JXS_RULE_SET_NULL);
+	item = jxs_anon_item_add(jmp_thumbs, listall->list->thumbs, string, url2, NULL);
+	jxs_item_set_rule(item, JXS_RULE_SET_NULL);
+	item = jxs_anon_item_add(jmp_thumbs, listall->list->thumbs, string, url3, NULL);
+	jxs_item_set_rule(item, JXS_RULE_SET_NULL);
+	return mapper;
+}
+
+/* synthetic, multi_dimen_array's matrix with every element set */
+struct dense_info {
+	char    name[32];
+	int64_t id;
+	double  score[4][4];
+};
+
+typedef struct dense_array_t {
+	int               matrix[2][2][3][4][2][3];
+	struct dense_info info[2][3];
+} dense_array_t;
+
+static jxs_mapper *dense_array_descriptor(void *context)
+{
+	jxs_mapper *mapper   = NULL;
+	jxs_mapper *map_info = NULL;
+	jxs_map_new(context, dense_array_t, mapper, 2);
+	jxs_map_new(context, struct dense_info, map_info, 3);
+	jxs_item_add(mapper, int, matrix, NULL, 2, 2, 3, 4, 2, 3);
+	jxs_item_add(mapper, struct, info, map_info, 2, 3);
+
+	jxs_item_add(map_info, string, name, NULL);
+	jxs_item_add(map_info, int, id, NULL);
+	jxs_item_add(map_info, double, score, NULL, 4, 4);
+	return mapper;
+}
+
+static uint32_t dense_random(uint32_t *seed)
+{
+	/* xorshift32, the same data on every run */
+	*seed ^= *seed << 13;
+	*seed ^= *seed >> 17;
+	*seed ^= *seed << 5;
+	return *seed;
+}
+
+static void dense_array_fill(void *stptr)
+{
+	dense_array_t *st   = (dense_array_t *)stptr;
+	int           *mtx  = &st->matrix[0][0][0][0][0][0];
+	uint32_t       seed = 2463534242u;
+	size_t         i    = 0;
+	size_t         j    = 0;
+	for (i = 0; i < sizeof(st->matrix) / sizeof(int); i++) {
+		mtx[i] = (int)(dense_random(&seed) % 2000001u) - 1000000;
+	}
+	for (i = 0; i < sizeof(st->info) / sizeof(st->info[0][0]); i++) {
+		struct dense_info *info  = &st->info[i / 3][i % 3];
+		double            *score = &info->score[0][0];
+		snprintf(info->name, sizeof(info->name), "sensor-%08x", dense_random(&seed));
+		info->id = (int64_t)dense_random(&seed) << 16;
+		for (j = 0; j < sizeof(info->score) / sizeof(double); j++) {
+			score[j] = (double)dense_random(&seed) / 4096.0;
+		}
+	}
+}
+
+typedef struct bench_shape {
+	const char     *name;
+	jxs_descriptor  descriptor;
+	size_t          size;
+	void          (*fill)(void *stptr); /* NULL, read '<name>.json' */
+} bench_shape;
+
+static const bench_shape bench_shapes[] = {
+	{ "basic",             basic_descriptor,             sizeof(struct basic), NULL             },
+	{ "struct_reuse",      struct_reuse_descriptor,      sizeof(task_all_t),   NULL             },
+	{ "anonymous_struct",  anonymous_struct_descriptor,  sizeof(anon_cfg_t),   NULL             },
+	{ "set_attributes",    set_attributes_descriptor,    sizeof(attr_cfg_t),   NULL             },
+	{ "multi_dimen_array", multi_dimen_array_descriptor, sizeof(array_t),      NULL             },
+	{ "dynamic_modify",    dynamic_modify_descriptor,    sizeof(bd_listall_t), NULL             },
+	{ "dense_array",       dense_array_descriptor,       sizeof(dense_array_t), dense_array_fill },
+};
+
+/* The struct of a run with a scale above 1: 'scale' records of the shape */
+typedef struct bench_records {
+	const bench_shape *shape;
+	int                scale;
+} bench_records;
+
+static jxs_mapper *records_descriptor(void *context)
+{
+	const bench_records *rec    = (const bench_records *)jxs_get_userdata(context);
+	jxs_mapper          *mapper = NULL;
+	jxs_anon_map_new(context, mapper, 1);
+	jxs_item_basic_add(mapper, jxs_type_struct, "records", 0,
+	                   rec->shape->size * (size_t)rec->scale,
+	                   rec->shape->descriptor(context), rec->scale, 0);
+	return mapper;
+}
+
+typedef struct bench_result {
+	const char *shape;
+	const char *op;
+	int         scale;
+	size_t      bytes;     /* json text of one call */
+	size_t      fields;    /* json values other than objects and arrays */
+	uint64_t    iters;
+	double      ns;        /* per call */
+	int64_t     allocs;    /* per call, -1 if not counted */
+} bench_result;
+
+enum {
+	OP_TO_STRING = 0,
+	OP_FROM_STRING,
+	OP_TO_FILE,
+	OP_FROM_FILE,
+	OP_NUM,
+};
+static const char *bench_ops[OP_NUM] = { "to_string", "from_string", "to_file", "from_file" };
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static size_t count_fields(json_object *jso)
+{
+	size_t count = 0;
+	size_t i     = 0;
+	switch (json_object_get_type(jso)) {
+	case json_type_object: {
+		struct json_object_iterator it  = json_object_iter_begin(jso);
+		struct json_object_iterator end = json_object_iter_end(jso);
+		for (; !json_object_iter_equal(&it, &end); json_object_iter_next(&it)) {
+			count += count_fields(json_object_iter_peek_value(&it));
+		}
+		break;
+	}
+	case json_type_array:
+		for (i = 0; i < json_object_array_length(jso); i++) {
+			count += count_fields(json_object_array_get_idx(jso, i));
+		}
+		break;
+	default:
+		count = 1;
+		break;
+	}
+	return count;
+}
+
+/* one call of the operation, 0 for success */
+static int bench_call(int op, const jxs_schema *schema, void *stptr, void *opaque,
+                      const char *jstring, const char *filename)
+{
+	const char *out = NULL;
+	switch (op) {
+	case OP_TO_STRING:
+		if ((out = jxs_struct_to_json_string_with_schema(schema, stptr, opaque)) == NULL) {
+			return -1;
+		}
+		jxs_free_json_string((char *)(uintptr_t)out);
+		return 0;
+	case OP_FROM_STRING:
+		return jxs_struct_from_json_string_with_schema(schema, stptr, opaque, jstring);
+	case OP_TO_FILE:
+		return jxs_struct_to_file_with_schema(schema, stptr, opaque, filename);
+	case OP_FROM_FILE:
+		return jxs_struct_from_file_with_schema(schema, stptr, opaque, filename);
+	default:
+		return -1;
+	}
+}
+
+/* run the operation for 'min_ns' at least, after one call to warm up */
+static int bench_op(int op, const jxs_schema *schema, void *stptr, void *opaque,
+                    const char *jstring, const char *filename, double min_ns,
+                    bench_result *res)
+{
+	uint64_t iters  = 0;
+	double   start  = 0;
+	double   spent  = 0;
+#ifdef BENCH_COUNT_MALLOC
+	uint64_t allocs = 0;
+#endif
+	if (bench_call(op, schema, stptr, opaque, jstring, filename) != 0) {
+		return -1;
+	}
+#ifdef BENCH_COUNT_MALLOC
+	allocs = malloc_count;
+#endif
+	start = now_ns();
+	do {
+		if (bench_call(op, schema, stptr, opaque, jstring, filename) != 0) {
+			return -1;
+		}
+		iters++;
+		spent = now_ns() - start;
+	} while (spent < min_ns);
+	res->op    = bench_ops[op];
+	res->iters = iters;
+	res->ns    = spent / (double)iters;
+#ifdef BENCH_COUNT_MALLOC
+	res->allocs = (int64_t)((malloc_count - allocs) / iters);
+#else
+	res->allocs = -1;
+#endif
+	return 0;
+}
+
+static void print_result(const bench_result *res, bool json, bool first)
+{
+	double mbps = (double)res->bytes / res->ns * 1e9 / (1024.0 * 1024.0);
+	double rps  = (double)res->scale / res->ns * 1e9;
+	double nspf = res->fields ? res->ns / (double)res->fields : 0;
+	if (json) {
+		printf("%s{\"version\":\"%s\",\"shape\":\"%s\",\"op\":\"%s\",\"scale\":%d,"
+		       "\"bytes\":%zu,\"fields\":%zu,\"iters\":%llu,\"ns_per_call\":%.0f,"
+		       "\"mb_per_s\":%.2f,\"records_per_s\":%.1f,\"ns_per_field\":%.2f,"
+		       "\"allocs_per_call\":%lld}",
+		       first ? "\n\t" : ",\n\t", JXS_BENCH_VERSION, res->shape, res->op, res->scale,
+		       res->bytes, res->fields, (unsigned long long)res->iters, res->ns,
+		       mbps, rps, nspf, (long long)res->allocs);
+	} else {
+		printf("%s,%s,%s,%d,%zu,%zu,%llu,%.0f,%.2f,%.1f,%.2f,%lld\n",
+		       JXS_BENCH_VERSION, res->shape, res->op, res->scale,
+		       res->bytes, res->fields, (unsigned long long)res->iters, res->ns,
+		       mbps, rps, nspf, (long long)res->allocs);
+	}
+	fflush(stdout);
+}
+
+/* all operations of one shape, the number of rows printed or -1 */
+static int bench_shape_run(const bench_shape *shape, int scale, const char *jsondir,
+                           const char *outdir, double min_ns, bool json, bool first)
+{
+	bench_records  rec      = { shape, scale };
+	jxs_schema    *single   = NULL;
+	jxs_schema    *schema   = NULL;
+	void          *opaque   = scale > 1 ? (void *)&rec : NULL;
+	char          *stptr    = NULL;
+	const char    *jstring  = NULL;
+	json_object   *jso      = NULL;
+	bench_result   res;
+	char           filename[1024] = { 0 };
+	int            rows     = -1;
+	int            op       = 0;
+	int            i        = 0;
+	memset(&res, 0, sizeof(res));
+	res.shape = shape->name;
+	res.scale = scale;
+	if ((single = jxs_schema_compile(shape->descriptor, NULL)) == NULL) {
+		goto end;
+	}
+	if ((schema = (scale > 1) ? jxs_schema_compile(records_descriptor, &rec) : single) == NULL) {
+		goto end;
+	}
+	if ((stptr = (char *)calloc((size_t)scale, shape->size)) == NULL) {
+		fprintf(stderr, "%s: no memory for %d records of %zu bytes\n",
+		        shape->name, scale, shape->size);
+		goto end;
+	}
+	/* one record from the example json(or the fill function), then copies of it */
+	if (shape->fill) {
+		shape->fill(stptr);
+	} else {
+		snprintf(filename, sizeof(filename), "%s/%s.json", jsondir, shape->name);
+		if (jxs_struct_from_file_with_schema(single, stptr, NULL, filename) != 0) {
+			fprintf(stderr, "%s: can not read '%s'\n", shape->name, filename);
+			goto end;
+		}
+	}
+	for (i = 1; i < scale; i++) {
+		memcpy(stptr + (size_t)i * shape->size, stptr, shape->size);
+	}
+	if ((jstring = jxs_struct_to_json_string_with_schema(schema, stptr, opaque)) == NULL) {
+		goto end;
+	}
+	if ((jso = json_tokener_parse(jstring)) == NULL) {
+		goto end;
+	}
+	res.bytes  = strlen(jstring);
+	res.fields = count_fields(jso);
+	json_object_put(jso);
+	snprintf(filename, sizeof(filename), "%s/jxs_bench_%s.json", outdir, shape->name);
+	rows = 0;
+	for (op = 0; op < OP_NUM; op++) {
+		if (bench_op(op, schema, stptr, opaque, jstring, filename, min_ns, &res) != 0) {
+			fprintf(stderr, "%s: %s failed\n", shape->name, bench_ops[op]);
+			continue;
+		}
+		print_result(&res, json, first && rows == 0);
+		rows++;
+	}
+	unlink(filename);
+end:
+	if (jstring) {
+		jxs_free_json_string((char *)(uintptr_t)jstring);
+	}
+	free(stptr);
+	if (schema && schema != single) {
+		jxs_schema_free(schema);
+	}
+	if (single) {
+		jxs_schema_free(single);
+	}
+	return rows;
+}
+
+static void usage(const char *name)
+{
+	size_t i = 0;
+	fprintf(stderr, "usage: %s [-f csv|json] [-s scale] [-t ms] [-d jsondir] [-o outdir] [shape...]\n"
+	        "shapes:", name);
+	for (i = 0; i < JXS_NELEM(bench_shapes); i++) {
+		fprintf(stderr, " %s", bench_shapes[i].name);
+	}
+	fprintf(stderr, "\n");
+}
+
+int main(int argc, char *argv[])
+{
+	char        jsondir[1024] = { 0 };
+	char        bindir[512]   = { 0 };
+	const char *outdir        = "/tmp";
+	bool        json          = false;
+	int         scale         = 1;
+	long        min_ms        = 200;
+	int         rows          = 0;
+	int         ret           = 0;
+	int         opt           = 0;
+	int         i             = 0;
+	size_t      k             = 0;
+	char       *s             = NULL;
+	strncpy(bindir, argv[0], sizeof(bindir) - 1);
+	if ((s = strrchr(bindir, '/')) != NULL) {
+		s[0] = '\0';
+	} else {
+		strcpy(bindir, ".");
+	}
+	snprintf(jsondir, sizeof(jsondir), "%s/../example/json", bindir);
+	while ((opt = getopt(argc, argv, "f:s:t:d:o:h")) != -1) {
+		switch (opt) {
+		case 'f':
+			json = (strcmp(optarg, "json") == 0);
+			break;
+		case 's':
+			scale = atoi(optarg);
+			break;
+		case 't':
+			min_ms = atol(optarg);
+			break;
+		case 'd':
+			snprintf(jsondir, sizeof(jsondir), "%s", optarg);
+			break;
+		case 'o':
+			outdir = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (scale < 1) {
+		usage(argv[0]);
+		return 1;
+	}
+	jxs_set_loglevel(JXS_LOG_QUIET);
+	if (json) {
+		printf("[");
+	} else {
+		printf("version,shape,op,scale,bytes,fields,iters,ns_per_call,"
+		       "mb_per_s,records_per_s,ns_per_field,allocs_per_call\n");
+	}
+	for (k = 0; k < JXS_NELEM(bench_shapes); k++) {
+		if (optind < argc) {
+			for (i = optind; i < argc; i++) {
+				if (strcmp(argv[i], bench_shapes[k].name) == 0) {
+					break;
+				}
+			}
+			if (i == argc) {
+				continue;
+			}
+		}
+		int n = bench_shape_run(&bench_shapes[k], scale, jsondir, outdir,
+		                        (double)min_ms * 1e6, json, rows == 0);
+		if (n < 0 || n < OP_NUM) {
+			ret = 1;
+		}
+		rows += n > 0 ? n : 0;
+	}
+	if (json) {
+		printf("\n]\n");
+	}
+	return ret;
+}
@@ -0,0 +1,81 @@
+/**
+ * @file jxs_codegen.c
+ * @brief Build-time code generator: runs a struct descriptor once and writes a
+ * C file of json text converters specialized for that struct, see
+ * jxs_schema_codegen(). The descriptor is loaded from a shared object, built
+ * from the same source the program uses.
+ *
+ * usage: jxs-codegen -l library -d descriptor [-n name] [-f flags] -o output.c
+ *
+ *   -l  shared object that defines the descriptor, e.g. ./libtypes.so.
+ *   -d  symbol of the jxs_descriptor function.
+ *   -n  prefix of the generated functions, the descriptor symbol by default.
+ *   -f  json-c formatting flags of the generated writer, 0 by default.
+ *   -o  output file.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include "jsonXstruct.h"
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s -l library -d descriptor [-n name] [-f flags] -o output.c\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+	int            c          = 0;
+	int            ret        = EXIT_FAILURE;
+	int            flags      = 0;
+	const char    *library    = NULL;
+	const char    *descriptor = NULL;
+	const char    *name       = NULL;
+	const char    *output     = NULL;
+	void          *handle     = NULL;
+	jxs_descriptor func       = NULL;
+	jxs_schema    *schema     = NULL;
+	while ((c = getopt(argc, argv, "l:d:n:f:o:")) != -1) {
+		switch (c) {
+		case 'l': library = optarg; break;
+		case 'd': descriptor = optarg; break;
+		case 'n': name = optarg; break;
+		case 'f': flags = (int)strtol(optarg, NULL, 0); break;
+		case 'o': output = optarg; break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if ((library == NULL) || (descriptor == NULL) || (output == NULL)) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	/* the descriptor calls back into the library this program is linked with */
+	handle = dlopen(library, RTLD_NOW | RTLD_GLOBAL);
+	if (handle == NULL) {
+		fprintf(stderr, "load %s failed: %s\n", library, dlerror());
+		return EXIT_FAILURE;
+	}
+	*(void **)(&func) = dlsym(handle, descriptor);
+	if (func == NULL) {
+		fprintf(stderr, "descriptor %s not found in %s\n", descriptor, library);
+		goto end;
+	}
+	schema = jxs_schema_compile(func, NULL);
+	if (schema == NULL) {
+		fprintf(stderr, "descriptor %s failed\n", descriptor);
+		goto end;
+	}
+	if (jxs_schema_codegen(schema, name ? name : descriptor, flags, output) != 0) {
+		fprintf(stderr, "generate %s failed\n", output);
+		goto end;
+	}
+	ret = EXIT_SUCCESS;
+end:
+	jxs_schema_free(schema);
+	dlclose(handle);
+	return ret;
+}
@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <string.h>
+#include "jsonXstruct.h"
+
+#define RECORD_COUNT 1000
+
+// independent records of a batch
+struct record {
+	int    id;
+	char   name[32];
+	double score;
+	int    tags[3];
+};
+
+static jxs_mapper *struct_descriptor(void *context)
+{
+	jxs_mapper *mapper = NULL;
+	jxs_map_new(context, struct record, mapper, 4);
+	jxs_item_add(mapper, int, id, NULL);
+	jxs_item_add(mapper, string, name, NULL);
+	jxs_item_add(mapper, double, score, NULL);
+	jxs_item_add(mapper, int, tags, NULL, 3);
+	return mapper;
+}
+
+int main(void)
+{
+	static struct record records[RECORD_COUNT];
+	static struct record parsed[RECORD_COUNT];
+	static char         *jstrings[RECORD_COUNT];
+	int                  ret    = 1;
+	int                  i      = 0;
+	jxs_schema          *schema = NULL;
+	jxs_pool            *pool   = NULL;
+	for (i = 0; i < RECORD_COUNT; i++) {
+		records[i].id      = i;
+		records[i].score   = i * 0.25;
+		records[i].tags[0] = i;
+		records[i].tags[1] = i * 2;
+		records[i].tags[2] = i * 3;
+		snprintf(records[i].name, sizeof(records[i].name), "record-%d", i);
+	}
+	schema = jxs_schema_compile(struct_descriptor, NULL);
+	// 0 threads: one per online CPU
+	pool = jxs_pool_new(0);
+	if ((schema == NULL) || (pool == NULL)) {
+		goto end;
+	}
+	// the records to json strings and back, spread across the threads
+	if ((jxs_batch_to_json(pool, schema, records, sizeof(records[0]), RECORD_COUNT, NULL,
+	                       JSON_C_TO_STRING_PLAIN, jstrings) != 0) ||
+	    (jxs_batch_from_json(pool, schema, parsed, sizeof(parsed[0]), RECORD_COUNT, NULL,
+	                         (const char *const *)jstrings) != 0)) {
+		printf("batch conversion failed\n");
+		goto end;
+	}
+	if (memcmp(records, parsed, sizeof(records)) != 0) {
+		printf("batch round trip changed the records\n");
+		goto end;
+	}
+	printf("batch of %d records ok: %s\n", RECORD_COUNT, jstrings[RECORD_COUNT - 1]);
+	ret = 0;
+end:
+	for (i = 0; i < RECORD_COUNT; i++) {
+		jxs_free_json_string(jstrings[i]);
+	}
+	jxs_pool_free(pool);
+	jxs_schema_free(schema);
+	return ret;
+}
@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "jsonXstruct.h"
+
+// sub struct
+struct thumbs {
+	char icon[1024];
+	char url1[1024];
+	char url2[1024];
+	char url3[1024];
+};
+
+// top struct
+struct basic {
+	int           vari;
+	int64_t       vari64;
+	bool          varb;
+	double        vard;
+	char          path[1024];
+	int           matrix[2][2][3];
+	struct thumbs ta;
+	struct thumbs tb[2];
+};
+
+static jxs_mapper *struct_descriptor(void *context)
+{
+	jxs_mapper *mapper     = NULL;
+	jxs_mapper *map_thumbs = NULL;
+	jxs_map_new(context, struct basic, mapper, 8);
+	jxs_map_new(context, struct thumbs, map_thumbs, 4);
+	jxs_item_add(mapper, int, vari, NULL);
+	jxs_item_add(mapper, int, vari64, NULL);
+	jxs_item_add(mapper, boolean, varb, NULL);
+	jxs_item_add(mapper, double, vard, NULL);
+	jxs_item_add(mapper, string, path, NULL);
+	jxs_item_add(mapper, int, matrix, NULL, 2, 2, 3);
+	jxs_item_add(mapper, struct, ta, map_thumbs);
+	jxs_item_add(mapper, struct, tb, map_thumbs, 2);
+
+	jxs_item_add(map_thumbs, string, icon, NULL);
+	jxs_item_add(map_thumbs, string, url1, NULL);
+	jxs_item_add(map_thumbs, string, url2, NULL);
+	jxs_item_add(map_thumbs, string, url3, NULL);
+	return mapper;
+}
+
+int main(int argc, char *argv[])
+{
+	static struct basic bst;
+	static struct basic bst_cbor;
+	int                 ret    = 1;
+	jxs_schema         *schema = NULL;
+	uint8_t            *data   = NULL;
+	size_t              len    = 0;
+	char                input[1024]  = { 0 };
+	char                output[1024] = { 0 };
+	if (argc) {
+		char testdir[512] = { 0 };
+		strncpy(testdir, argv[0], sizeof(testdir) - 1);
+		char *s = strrchr(testdir, '/');
+		if (s) {
+			s[0] = '\0';
+		}
+		snprintf(input, sizeof(input), "%s/json/basic.json", testdir);
+		snprintf(output, sizeof(output), "%s/cbor_out.json", testdir);
+	}
+	schema = jxs_schema_compile(struct_descriptor, NULL);
+	if ((schema == NULL) || (jxs_struct_from_file_with_schema(schema, &bst, NULL, input) != 0)) {
+		goto end;
+	}
+	// struct to CBOR, then CBOR back to another struct
+	data = jxs_struct_to_cbor(schema, &bst, NULL, &len);
+	if ((data == NULL) || (jxs_struct_from_cbor(schema, &bst_cbor, NULL, data, len) != 0)) {
+		printf("cbor conversion failed\n");
+		goto end;
+	}
+	if (memcmp(&bst, &bst_cbor, sizeof(bst)) != 0) {
+		printf("cbor round trip changed the struct\n");
+		goto end;
+	}
+	jxs_struct_to_file_ext_with_schema(schema, &bst_cbor, NULL, output, JSON_C_TO_STRING_PRETTY);
+	printf("cbor %zu bytes ok\n", len);
+	ret = 0;
+end:
+	jxs_free_cbor(data);
+	jxs_schema_free(schema);
+	return ret;
+}
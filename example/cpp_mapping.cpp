@@ -0,0 +1,57 @@
+#include <cstdio>
+#include <cstring>
+#include "jsonXstruct.hpp"
+
+// sub struct
+struct thumbs {
+	char icon[1024];
+	char url1[1024];
+	char url2[1024];
+	char url3[1024];
+};
+
+// top struct
+struct basic {
+	int           vari;
+	int64_t       vari64;
+	bool          varb;
+	double        vard;
+	char          path[1024];
+	int           matrix[2][2][3];
+	struct thumbs ta;
+	struct thumbs tb[2];
+};
+
+// Member tables, the type and array dimensions of every member are deduced.
+JXS_MAPPING(thumbs, JXS_ITEM(icon), JXS_ITEM(url1), JXS_ITEM(url2), JXS_ITEM(url3));
+JXS_MAPPING(basic, JXS_ITEM(vari), JXS_ITEM(vari64), JXS_ITEM(varb), JXS_ITEM(vard),
+            JXS_ITEM(path), JXS_ITEM(matrix), JXS_ITEM(ta), JXS_ITEM(tb));
+
+int main(void)
+{
+	static struct basic bst;
+	jxs_context        *jctx = jxs_context_new();
+	const char         *text = NULL;
+	FILE               *fp   = NULL;
+	// the table is a plain descriptor for the C functions too
+	jxs_struct_from_file(jxs::descriptor<basic>, &bst, NULL, "./example/json/basic.json");
+	// Change the value of some variables in the structure
+	bst.vari = 100;
+	// the converters instantiated for 'struct basic'
+	text = jxs::to_json_string<JSON_C_TO_STRING_PRETTY | JSON_C_TO_STRING_PRETTY_TAB |
+	                           JSON_C_TO_STRING_NOSLASHESCAPE>(jctx, bst);
+	if ((text == NULL) || (jxs::from_json_string(jctx, bst, text) != 0)) {
+		jxs_context_free(jctx);
+		return 1;
+	}
+	// save the json text, it is owned by the context
+	text = jxs::to_json_string<JSON_C_TO_STRING_PRETTY | JSON_C_TO_STRING_PRETTY_TAB |
+	                           JSON_C_TO_STRING_NOSLASHESCAPE>(jctx, bst);
+	fp = fopen("./cpp_mapping_out.json", "wb");
+	if (fp != NULL) {
+		fputs(text, fp);
+		fclose(fp);
+	}
+	jxs_context_free(jctx);
+	return 0;
+}
@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <string.h>
+#include "jsonXstruct.h"
+
+// struct with a json_object member
+struct holder {
+	int          id;
+	json_object *obj;
+};
+
+static jxs_mapper *struct_descriptor(void *context)
+{
+	jxs_mapper *mapper = NULL;
+	jxs_map_new(context, struct holder, mapper, 2);
+	jxs_item_add(mapper, int, id, NULL);
+	jxs_item_add(mapper, object, obj, NULL);
+	return mapper;
+}
+
+static const uint8_t cbor_repeat[] = {
+	0xa3, 0x62, 'i', 'd', 0x01,
+	0x63, 'o', 'b', 'j', 0xa1, 0x61, 'a', 0x01,
+	0x63, 'o', 'b', 'j', 0xa1, 0x61, 'b', 0x02,
+};
+static const uint8_t cbor_null[] = {
+	0xa2, 0x63, 'o', 'b', 'j', 0x82, 0x01, 0x02,
+	0x63, 'o', 'b', 'j', 0xf6,
+};
+
+int main(void)
+{
+	struct holder hd     = { 0, NULL };
+	int           ret    = 1;
+	jxs_schema   *schema = NULL;
+	json_object  *jso    = NULL;
+	schema = jxs_schema_compile(struct_descriptor, NULL);
+	if (schema == NULL) {
+		goto end;
+	}
+	// the last value of a repeated key wins, the first one is released
+	if ((jxs_struct_from_json_string_with_schema(schema, &hd, NULL,
+	                                             "{\"id\":1,\"obj\":{\"a\":1},\"obj\":{\"b\":2}}") != 0) ||
+	    (hd.obj == NULL) || json_object_object_get_ex(hd.obj, "a", NULL) ||
+	    !json_object_object_get_ex(hd.obj, "b", &jso) || (json_object_get_int(jso) != 2)) {
+		printf("repeated object key failed\n");
+		goto end;
+	}
+	json_object_put(hd.obj);
+	hd.obj = NULL;
+	// a repeated null clears the member
+	if ((jxs_struct_from_json_string_with_schema(schema, &hd, NULL,
+	                                             "{\"obj\":[1,2],\"id\":2,\"obj\":null}") != 0) ||
+	    (hd.obj != NULL) || (hd.id != 2)) {
+		printf("repeated null key failed\n");
+		goto end;
+	}
+	// the same from CBOR maps: {"id":1,"obj":{"a":1},"obj":{"b":2}} and {"obj":[1,2],"obj":null}
+	json_object_put(hd.obj);
+	hd.obj = NULL;
+	if ((jxs_struct_from_cbor(schema, &hd, NULL, cbor_repeat, sizeof(cbor_repeat)) != 0) ||
+	    (hd.obj == NULL) || json_object_object_get_ex(hd.obj, "a", NULL) ||
+	    !json_object_object_get_ex(hd.obj, "b", &jso) || (json_object_get_int(jso) != 2)) {
+		printf("repeated cbor key failed\n");
+		goto end;
+	}
+	json_object_put(hd.obj);
+	hd.obj = NULL;
+	if ((jxs_struct_from_cbor(schema, &hd, NULL, cbor_null, sizeof(cbor_null)) != 0) || (hd.obj != NULL)) {
+		printf("repeated cbor null key failed\n");
+		goto end;
+	}
+	printf("duplicate keys ok\n");
+	ret = 0;
+end:
+	json_object_put(hd.obj);
+	jxs_schema_free(schema);
+	return ret;
+}
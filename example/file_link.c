@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "jsonXstruct.h"
+
+// saved record
+struct record {
+	int  id;
+	char name[32];
+};
+
+static jxs_mapper *struct_descriptor(void *context)
+{
+	jxs_mapper *mapper = NULL;
+	jxs_map_new(context, struct record, mapper, 2);
+	jxs_item_add(mapper, int, id, NULL);
+	jxs_item_add(mapper, string, name, NULL);
+	return mapper;
+}
+
+int main(int argc, char *argv[])
+{
+	struct record rec    = { 1, "linked" };
+	struct record back   = { 0, "" };
+	int           ret    = 1;
+	jxs_schema   *schema = NULL;
+	struct stat   st;
+	char          target[1024] = { 0 };
+	char          link[1024]   = { 0 };
+	if (argc) {
+		char testdir[512] = { 0 };
+		strncpy(testdir, argv[0], sizeof(testdir) - 1);
+		char *s = strrchr(testdir, '/');
+		if (s) {
+			s[0] = '\0';
+		}
+		snprintf(target, sizeof(target), "%s/file_link_out.json", testdir);
+		snprintf(link, sizeof(link), "%s/file_link.link", testdir);
+	}
+	schema = jxs_schema_compile(struct_descriptor, NULL);
+	unlink(link);
+	if ((schema == NULL) || (jxs_struct_to_file_with_schema(schema, &rec, NULL, target) != 0) ||
+	    (symlink("file_link_out.json", link) != 0)) {
+		goto end;
+	}
+	// saving through the link replaces its target, the link stays
+	rec.id = 2;
+	if ((jxs_struct_to_file_with_schema(schema, &rec, NULL, link) != 0) ||
+	    (lstat(link, &st) != 0) || !S_ISLNK(st.st_mode) ||
+	    (jxs_struct_from_file_with_schema(schema, &back, NULL, target) != 0) ||
+	    (back.id != 2) || strcmp(back.name, "linked")) {
+		printf("file through a link failed\n");
+		goto end;
+	}
+	printf("file link ok\n");
+	ret = 0;
+end:
+	unlink(link);
+	jxs_schema_free(schema);
+	return ret;
+}
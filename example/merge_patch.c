@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "jsonXstruct.h"
+
+// sub struct
+struct thumbs {
+	char icon[1024];
+	char url1[1024];
+	char url2[1024];
+	char url3[1024];
+};
+
+// top struct
+struct basic {
+	int           vari;
+	int64_t       vari64;
+	bool          varb;
+	double        vard;
+	char          path[1024];
+	int           matrix[2][2][3];
+	struct thumbs ta;
+	struct thumbs tb[2];
+};
+
+static jxs_mapper *struct_descriptor(void *context)
+{
+	jxs_mapper *mapper     = NULL;
+	jxs_mapper *map_thumbs = NULL;
+	jxs_map_new(context, struct basic, mapper, 8);
+	jxs_map_new(context, struct thumbs, map_thumbs, 4);
+	jxs_item_add(mapper, int, vari, NULL);
+	jxs_item_add(mapper, int, vari64, NULL);
+	jxs_item_add(mapper, boolean, varb, NULL);
+	jxs_item_add(mapper, double, vard, NULL);
+	jxs_item_add(mapper, string, path, NULL);
+	jxs_item_add(mapper, int, matrix, NULL, 2, 2, 3);
+	jxs_item_add(mapper, struct, ta, map_thumbs);
+	jxs_item_add(mapper, struct, tb, map_thumbs, 2);
+
+	jxs_item_add(map_thumbs, string, icon, NULL);
+	jxs_item_add(map_thumbs, string, url1, NULL);
+	jxs_item_add(map_thumbs, string, url2, NULL);
+	jxs_item_add(map_thumbs, string, url3, NULL);
+	return mapper;
+}
+
+static bool all_zero(const void *ptr, size_t size)
+{
+	const uint8_t *p = (const uint8_t *)ptr;
+	size_t         i = 0;
+	for (i = 0; i < size; i++) {
+		if (p[i] != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	static struct basic bst;
+	int                 ret    = 1;
+	jxs_schema         *schema = NULL;
+	char                input[1024]  = { 0 };
+	char                output[1024] = { 0 };
+	if (argc) {
+		char testdir[512] = { 0 };
+		strncpy(testdir, argv[0], sizeof(testdir) - 1);
+		char *s = strrchr(testdir, '/');
+		if (s) {
+			s[0] = '\0';
+		}
+		snprintf(input, sizeof(input), "%s/json/basic.json", testdir);
+		snprintf(output, sizeof(output), "%s/merge_patch_out.json", testdir);
+	}
+	schema = jxs_schema_compile(struct_descriptor, NULL);
+	if ((schema == NULL) || (jxs_struct_from_file_with_schema(schema, &bst, NULL, input) != 0)) {
+		goto end;
+	}
+	// members absent from the patch are kept, a sub-struct is merged member by member
+	jxs_struct_patch_from_json_string(schema, &bst, NULL, "{\"vari\":100,\"ta\":{\"icon\":\"x\"}}");
+	if ((bst.vari != 100) || (bst.vari64 != 123456789198) || strcmp(bst.ta.icon, "x") ||
+	    strcmp(bst.ta.url1, "wwwww")) {
+		printf("merge patch of members failed\n");
+		goto end;
+	}
+	// an array is replaced whole: a shorter array clears the tail,
+	// an element object clears the members it leaves out
+	jxs_struct_patch_from_json_string(schema, &bst, NULL, "{\"tb\":[{\"icon\":\"X\"}],\"matrix\":[[[9]]]}");
+	if (strcmp(bst.tb[0].icon, "X") || !all_zero(bst.tb[0].url1, sizeof(bst.tb[0].url1)) ||
+	    !all_zero(&bst.tb[1], sizeof(bst.tb[1])) || (bst.matrix[0][0][0] != 9) ||
+	    !all_zero(&bst.matrix[0][0][1], sizeof(bst.matrix) - sizeof(int)) ||
+	    strcmp(bst.ta.url1, "wwwww")) {
+		printf("merge patch of arrays failed\n");
+		goto end;
+	}
+	// the same from a parsed json object
+	json_object *jso = json_tokener_parse("{\"tb\":[{\"url1\":\"y\"}]}");
+	jxs_struct_patch_from_json_object(schema, &bst, NULL, jso);
+	json_object_put(jso);
+	if (strcmp(bst.tb[0].url1, "y") || !all_zero(bst.tb[0].icon, sizeof(bst.tb[0].icon))) {
+		printf("merge patch from json object failed\n");
+		goto end;
+	}
+	// null clears the member
+	jxs_struct_patch_from_json_string(schema, &bst, NULL, "{\"ta\":null}");
+	if (!all_zero(&bst.ta, sizeof(bst.ta)) || (bst.vari != 100)) {
+		printf("merge patch of null failed\n");
+		goto end;
+	}
+	jxs_struct_to_file_ext_with_schema(schema, &bst, NULL, output, JSON_C_TO_STRING_PRETTY);
+	printf("merge patch ok\n");
+	ret = 0;
+end:
+	jxs_schema_free(schema);
+	return ret;
+}
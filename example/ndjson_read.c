@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <string.h>
+#include "jsonXstruct.h"
+
+// one record per line
+struct record {
+	int    id;
+	char   name[32];
+	double score;
+	int    tags[3];
+};
+
+// records compared with the input lines
+struct check {
+	FILE  *fp;
+	size_t count;
+	int    failed;
+};
+
+static jxs_mapper *struct_descriptor(void *context)
+{
+	jxs_mapper *mapper = NULL;
+	jxs_map_new(context, struct record, mapper, 4);
+	jxs_item_add(mapper, int, id, NULL);
+	jxs_item_add(mapper, string, name, NULL);
+	jxs_item_add(mapper, double, score, NULL);
+	jxs_item_add(mapper, int, tags, NULL, 3);
+	return mapper;
+}
+
+static jxs_schema *schema = NULL;
+
+static int record_callback(void *stptr, size_t lineno, void *userdata)
+{
+	struct check  *chk  = (struct check *)userdata;
+	struct record *rec  = (struct record *)stptr;
+	const char    *text = NULL;
+	char           line[256] = { 0 };
+	chk->count++;
+	// the struct back to json text is the same line
+	text = jxs_struct_to_json_string_ext_with_schema(schema, rec, NULL, JSON_C_TO_STRING_PLAIN);
+	if ((text == NULL) || (fgets(line, sizeof(line), chk->fp) == NULL) ||
+	    (strncmp(text, line, strlen(text)) != 0) || (line[strlen(text)] != '\n') ||
+	    (rec->id != (int)lineno)) {
+		printf("line %zu differs: %s", lineno, line);
+		chk->failed = 1;
+	}
+	jxs_free_json_string((char *)(uintptr_t)text);
+	return chk->failed;
+}
+
+int main(int argc, char *argv[])
+{
+	static struct record rec;
+	struct check         chk   = { NULL, 0, 0 };
+	char                 input[1024] = { 0 };
+	if (argc) {
+		char testdir[512] = { 0 };
+		strncpy(testdir, argv[0], sizeof(testdir) - 1);
+		char *s = strrchr(testdir, '/');
+		if (s) {
+			s[0] = '\0';
+		}
+		snprintf(input, sizeof(input), "%s/json/ndjson_read.ndjson", testdir);
+	}
+	schema = jxs_schema_compile(struct_descriptor, NULL);
+	chk.fp = fopen(input, "rb");
+	if ((schema == NULL) || (chk.fp == NULL) ||
+	    (jxs_ndjson_foreach(schema, input, &rec, NULL, record_callback, &chk) != 0) ||
+	    chk.failed || (chk.count != 3)) {
+		printf("ndjson read failed\n");
+		chk.failed = 1;
+	} else {
+		printf("ndjson read %zu records ok\n", chk.count);
+	}
+	if (chk.fp) {
+		fclose(chk.fp);
+	}
+	jxs_schema_free(schema);
+	return chk.failed;
+}
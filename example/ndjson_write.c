@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "jsonXstruct.h"
+
+// one record per line
+struct record {
+	int    id;
+	char   name[32];
+	double score;
+	int    tags[3];
+};
+
+static const struct record records[] = {
+	{ 1, "alpha", 1.5, { 1, 2, 3 } },
+	{ 2, "beta", -2.25, { 4, 5, 6 } },
+	{ 3, "gamma", 0.5, { 7, 8, 9 } },
+};
+#define RECORD_COUNT (sizeof(records) / sizeof(records[0]))
+
+static jxs_mapper *struct_descriptor(void *context)
+{
+	jxs_mapper *mapper = NULL;
+	jxs_map_new(context, struct record, mapper, 4);
+	jxs_item_add(mapper, int, id, NULL);
+	jxs_item_add(mapper, string, name, NULL);
+	jxs_item_add(mapper, double, score, NULL);
+	jxs_item_add(mapper, int, tags, NULL, 3);
+	return mapper;
+}
+
+// every line read back must be the record that was written
+static int record_callback(void *stptr, size_t lineno, void *userdata)
+{
+	size_t *count = (size_t *)userdata;
+	if ((lineno > RECORD_COUNT) || (memcmp(stptr, &records[lineno - 1], sizeof(struct record)) != 0)) {
+		printf("line %zu differs\n", lineno);
+		return 1;
+	}
+	(*count)++;
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	static struct record rec;
+	int                  ret    = 1;
+	int                  fd     = -1;
+	size_t               i      = 0;
+	size_t               count  = 0;
+	jxs_schema          *schema = NULL;
+	jxs_writer          *writer = NULL;
+	char                 output[1024] = { 0 };
+	if (argc) {
+		char testdir[512] = { 0 };
+		strncpy(testdir, argv[0], sizeof(testdir) - 1);
+		char *s = strrchr(testdir, '/');
+		if (s) {
+			s[0] = '\0';
+		}
+		snprintf(output, sizeof(output), "%s/ndjson_write_out.json", testdir);
+	}
+	schema = jxs_schema_compile(struct_descriptor, NULL);
+	fd     = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if ((schema == NULL) || (fd < 0) || ((writer = jxs_writer_new(fd, 0, JXS_SYNC_NONE)) == NULL)) {
+		goto end;
+	}
+	// append the records as json lines, they are written out by flush and free
+	for (i = 0; i < RECORD_COUNT; i++) {
+		memcpy(&rec, &records[i], sizeof(rec));
+		if (jxs_writer_append(writer, schema, &rec, NULL, JSON_C_TO_STRING_PLAIN) != 0) {
+			printf("ndjson append failed\n");
+			goto end;
+		}
+	}
+	if ((jxs_writer_flush(writer) != 0) || (jxs_writer_free(writer) != 0)) {
+		writer = NULL;
+		printf("ndjson write failed\n");
+		goto end;
+	}
+	writer = NULL;
+	// read the file back
+	if ((jxs_ndjson_foreach(schema, output, &rec, NULL, record_callback, &count) != 0) ||
+	    (count != RECORD_COUNT)) {
+		printf("ndjson read back failed\n");
+		goto end;
+	}
+	// a write error keeps the record buffered, append succeeds and flush fails
+	close(fd);
+	fd = open(output, O_RDONLY);
+	if ((fd < 0) || ((writer = jxs_writer_new(fd, 1, JXS_SYNC_NONE)) == NULL) ||
+	    (jxs_writer_append(writer, schema, &rec, NULL, JSON_C_TO_STRING_PLAIN) != 0) ||
+	    (jxs_writer_flush(writer) == 0)) {
+		printf("ndjson write error not kept for flush\n");
+		goto end;
+	}
+	jxs_writer_free(writer);
+	writer = NULL;
+	printf("ndjson write %zu records ok\n", count);
+	ret = 0;
+end:
+	if (writer) {
+		jxs_writer_free(writer);
+	}
+	if (fd >= 0) {
+		close(fd);
+	}
+	jxs_schema_free(schema);
+	return ret;
+}
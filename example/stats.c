@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <string.h>
+#include "jsonXstruct.h"
+
+// counted record
+struct record {
+	int    id;
+	char   name[8];
+	double score;
+	int    tags[3];
+};
+
+static jxs_mapper *struct_descriptor(void *context)
+{
+	jxs_mapper *mapper = NULL;
+	jxs_map_new(context, struct record, mapper, 4);
+	jxs_item_add(mapper, int, id, NULL);
+	jxs_item_add(mapper, string, name, NULL);
+	jxs_item_add(mapper, double, score, NULL);
+	jxs_item_add(mapper, int, tags, NULL, 3);
+	return mapper;
+}
+
+int main(void)
+{
+	static struct record rec    = { 7, "seven", 7.5, { 1, 2, 3 } };
+	static struct record parsed;
+	int                  ret    = 1;
+	jxs_context         *jctx   = NULL;
+	const jxs_schema    *schema = NULL;
+	const char          *text   = NULL;
+	const char          *report = NULL;
+	size_t               len    = 0;
+	char                 copy[256] = { 0 };
+	jxs_stats            last;
+	jxs_stats            total;
+	jxs_stats            all;
+	jxs_stats_enable(1);
+	jxs_stats_reset();
+	jctx   = jxs_context_new();
+	schema = jxs_context_schema(jctx, struct_descriptor, NULL);
+	if ((jctx == NULL) || (schema == NULL)) {
+		goto end;
+	}
+	// struct to json: 4 members, 3 array elements, the text length
+	text = jxs_context_to_json_string_ext(jctx, schema, &rec, NULL, JSON_C_TO_STRING_PLAIN);
+	if (text == NULL) {
+		goto end;
+	}
+	strncpy(copy, text, sizeof(copy) - 1);
+	len = strlen(copy);
+	jxs_context_stats(jctx, &last, NULL);
+	if ((last.calls != 1) || (last.items != 4) || (last.elements != 3) || (last.bytes_out != len)) {
+		printf("stats of struct to json are wrong\n");
+		goto end;
+	}
+	// and back
+	if ((jxs_context_from_json_string(jctx, schema, &parsed, NULL, copy) != 0) ||
+	    (memcmp(&parsed, &rec, sizeof(rec)) != 0)) {
+		printf("json to struct failed\n");
+		goto end;
+	}
+	jxs_context_stats(jctx, &last, NULL);
+	if ((last.calls != 1) || (last.items != 4) || (last.elements != 3) || (last.bytes_in != len)) {
+		printf("stats of json to struct are wrong\n");
+		goto end;
+	}
+	// a string longer than its member is truncated
+	jxs_context_from_json_string(jctx, schema, &parsed, NULL, "{\"name\":\"much too long\"}");
+	jxs_context_stats(jctx, &last, &total);
+	jxs_stats_get(&all);
+	if ((last.truncated != 1) || (total.calls != 3) || (all.calls != 3) || (all.errors != 0)) {
+		printf("total stats are wrong\n");
+		goto end;
+	}
+	report = jxs_stats_to_json_string(NULL);
+	printf("%s\n", report);
+	// off, nothing is counted
+	jxs_stats_enable(0);
+	jxs_context_to_json_string(jctx, schema, &rec, NULL);
+	jxs_stats_get(&all);
+	if (all.calls != 3) {
+		printf("stats counted while off\n");
+		goto end;
+	}
+	ret = 0;
+end:
+	jxs_free_json_string((char *)(uintptr_t)report);
+	jxs_context_free(jctx);
+	jxs_stats_enable(0);
+	return ret;
+}
@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "jsonXstruct.h"
+
+// sub struct
+struct thumbs {
+	char icon[1024];
+	char url1[1024];
+	char url2[1024];
+	char url3[1024];
+};
+
+// top struct
+struct basic {
+	int           vari;
+	int64_t       vari64;
+	bool          varb;
+	double        vard;
+	char          path[1024];
+	int           matrix[2][2][3];
+	struct thumbs ta;
+	struct thumbs tb[2];
+};
+
+static jxs_mapper *struct_descriptor(void *context)
+{
+	jxs_mapper *mapper     = NULL;
+	jxs_mapper *map_thumbs = NULL;
+	jxs_map_new(context, struct basic, mapper, 8);
+	jxs_map_new(context, struct thumbs, map_thumbs, 4);
+	jxs_item_add(mapper, int, vari, NULL);
+	jxs_item_add(mapper, int, vari64, NULL);
+	jxs_item_add(mapper, boolean, varb, NULL);
+	jxs_item_add(mapper, double, vard, NULL);
+	jxs_item_add(mapper, string, path, NULL);
+	jxs_item_add(mapper, int, matrix, NULL, 2, 2, 3);
+	jxs_item_add(mapper, struct, ta, map_thumbs);
+	jxs_item_add(mapper, struct, tb, map_thumbs, 2);
+
+	jxs_item_add(map_thumbs, string, icon, NULL);
+	jxs_item_add(map_thumbs, string, url1, NULL);
+	jxs_item_add(map_thumbs, string, url2, NULL);
+	jxs_item_add(map_thumbs, string, url3, NULL);
+	return mapper;
+}
+
+int main(int argc, char *argv[])
+{
+	static struct basic bst_old;
+	static struct basic bst_new;
+	static struct basic bst_patched;
+	int                 ret    = 1;
+	jxs_schema         *schema = NULL;
+	const char         *merge  = NULL;
+	const char         *jpatch = NULL;
+	char                input[1024]  = { 0 };
+	char                output[1024] = { 0 };
+	if (argc) {
+		char testdir[512] = { 0 };
+		strncpy(testdir, argv[0], sizeof(testdir) - 1);
+		char *s = strrchr(testdir, '/');
+		if (s) {
+			s[0] = '\0';
+		}
+		snprintf(input, sizeof(input), "%s/json/basic.json", testdir);
+		snprintf(output, sizeof(output), "%s/struct_diff_out.json", testdir);
+	}
+	schema = jxs_schema_compile(struct_descriptor, NULL);
+	if ((schema == NULL) || (jxs_struct_from_file_with_schema(schema, &bst_old, NULL, input) != 0)) {
+		goto end;
+	}
+	// change some members of a copy
+	memcpy(&bst_new, &bst_old, sizeof(bst_new));
+	bst_new.vari = 100;
+	strcpy(bst_new.ta.url2, "changed");
+	bst_new.matrix[1][1][2] = 0;
+	// the changes as a merge patch and as a json patch
+	merge  = jxs_struct_diff_to_json(schema, &bst_old, &bst_new, NULL, JXS_PATCH_MERGE, 0);
+	jpatch = jxs_struct_diff_to_json(schema, &bst_old, &bst_new, NULL, JXS_PATCH_JSON, 0);
+	if ((merge == NULL) || (jpatch == NULL)) {
+		printf("struct diff failed\n");
+		goto end;
+	}
+	printf("merge patch: %s\n", merge);
+	printf("json patch: %s\n", jpatch);
+	if (strcmp(jpatch, "[{\"op\":\"replace\",\"path\":\"/vari\",\"value\":100},"
+	                   "{\"op\":\"replace\",\"path\":\"/matrix/1/1/2\",\"value\":0},"
+	                   "{\"op\":\"replace\",\"path\":\"/ta/url2\",\"value\":\"changed\"}]") != 0) {
+		printf("unexpected json patch\n");
+		goto end;
+	}
+	// applying the merge patch to the old struct gives the new one
+	memcpy(&bst_patched, &bst_old, sizeof(bst_patched));
+	if ((jxs_struct_patch_from_json_string(schema, &bst_patched, NULL, merge) != 0) ||
+	    (memcmp(&bst_patched, &bst_new, sizeof(bst_new)) != 0)) {
+		printf("merge patch round trip failed\n");
+		goto end;
+	}
+	jxs_struct_to_file_ext_with_schema(schema, &bst_patched, NULL, output, JSON_C_TO_STRING_PRETTY);
+	ret = 0;
+end:
+	jxs_free_json_string((char *)(uintptr_t)merge);
+	jxs_free_json_string((char *)(uintptr_t)jpatch);
+	jxs_schema_free(schema);
+	return ret;
+}
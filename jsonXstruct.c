@@ -7,11 +7,64 @@
  *
  */
 
+#include <errno.h>
 #include <string.h>
+#include <math.h>
+#include <float.h>
+#include <locale.h>
 #include "jsonXstruct_priv.h"
 
 static int  jxs_log_level = JXS_LOG_ERROR;
 static void (*jxs_log_callback)(int, const char *, va_list) = jxs_log_default_callback;
+static bool jxs_stats_on = false;
+static jxs_stats jxs_stats_all;
+
+static void *jxs_libc_alloc(void *userdata, size_t size)
+{
+	(void)userdata;
+	return malloc(size);
+}
+static void *jxs_libc_resize(void *userdata, void *ptr, size_t size)
+{
+	(void)userdata;
+	return realloc(ptr, size);
+}
+static void jxs_libc_release(void *userdata, void *ptr)
+{
+	(void)userdata;
+	free(ptr);
+}
+
+static jxs_allocator jxs_heap = {
+	jxs_libc_alloc, jxs_libc_resize, jxs_libc_release, NULL
+};
+
+/* Every allocation of the library goes through these, see jxs_set_allocator() */
+static inline void *jxs_malloc(size_t size)
+{
+	return jxs_heap.alloc(jxs_heap.userdata, size);
+}
+static inline void *jxs_realloc(void *ptr, size_t size)
+{
+	return jxs_heap.resize(jxs_heap.userdata, ptr, size);
+}
+static inline void jxs_free(void *ptr)
+{
+	if (ptr) {
+		jxs_heap.release(jxs_heap.userdata, ptr);
+	}
+}
+static void *jxs_calloc(size_t n, size_t size)
+{
+	void *ptr = NULL;
+	if ((size != 0) && (n > SIZE_MAX / size)) {
+		return NULL;
+	}
+	if ((ptr = jxs_malloc(n * size)) != NULL) {
+		memset(ptr, 0, n * size);
+	}
+	return ptr;
+}
 
 static void jxs_log_default_callback(int level, const char *fmt, va_list vl)
 {
@@ -60,6 +113,211 @@ static inline jmap_list_t *get_jmlist(jxs_mapper *mapper)
 	return &mapper[1].jmlist;
 }
 
+/**
+ * @brief Key hash of the mapper key index, 64-bit FNV-1a. The low bits pick
+ * the bucket, the high bits the slot.
+ */
+static inline uint64_t jmap_key_hash(const char *key, size_t len)
+{
+	size_t   i    = 0;
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (i = 0; i < len; i++) {
+		hash ^= (uint8_t)key[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+/**
+ * @brief Slot of a key hash with the displacement of its bucket.
+ */
+static inline size_t jmap_key_slot(uint64_t hash, uint32_t disp, size_t nslot)
+{
+	uint32_t x = (uint32_t)(hash >> 32) ^ (disp * 0x9e3779b1U);
+	x ^= x >> 16;
+	x *= 0x85ebca6bU;
+	x ^= x >> 13;
+	x *= 0xc2b2ae35U;
+	x ^= x >> 16;
+	return (size_t)x & (nslot - 1);
+}
+
+static inline uint16_t *jmap_index_table(jxs_mapper *mapper)
+{
+	return (uint16_t *)(void *)&mapper[get_jmhead(mapper)->limit + 1];
+}
+
+/**
+ * @brief Size the key index of a mapper with 'num' items.
+ * @return number of mapper units to allocate behind the items for it.
+ */
+static size_t jmap_index_units(size_t num, size_t *nslot, size_t *nbucket)
+{
+	*nslot   = 0;
+	*nbucket = 0;
+	if (num > JXS_INDEX_MAX_ITEMS) {
+		return 0;
+	}
+	/* load factor below 0.8, about two keys per bucket */
+	for (*nslot = 2; *nslot < (num + num / 4 + 1); *nslot *= 2) {
+	}
+	for (*nbucket = 1; *nbucket < (num / 2 + 1); *nbucket *= 2) {
+	}
+	return ((2 * *nbucket + *nslot) * sizeof(uint16_t) + sizeof(jxs_mapper) - 1) / sizeof(jxs_mapper);
+}
+
+/**
+ * @brief Try the displacements of one bucket until all its keys land in free
+ * slots, and take the slots.
+ * @return 0 for success, -1 if no displacement fits.
+ */
+static int jmap_index_place(jmap_list_t *jmlist, uint16_t *disp, uint16_t *slot,
+                            size_t nslot, size_t bucket, size_t first)
+{
+	uint32_t d    = 0;
+	size_t   i    = 0;
+	size_t   k    = 0;
+	size_t   sidx = 0;
+	for (d = 0; d <= JXS_INDEX_MAX_DISP; d++) {
+		for (i = first; i != 0; i = jmlist[i - 1].link) {
+			sidx = jmap_key_slot(jmlist[i - 1].khash, d, nslot);
+			if (slot[sidx] != 0) {
+				break;
+			}
+			slot[sidx] = (uint16_t)i;
+		}
+		if (i == 0) {
+			disp[bucket] = (uint16_t)d;
+			return 0;
+		}
+		/* give back the slots taken with this displacement */
+		for (k = first; k != i; k = jmlist[k - 1].link) {
+			slot[jmap_key_slot(jmlist[k - 1].khash, d, nslot)] = 0;
+		}
+	}
+	return -1;
+}
+
+/**
+ * @brief Build the key index of the mapper and of all its sub-mappers, after the
+ * descriptor has returned, so the keys set by jxs_item_set_constkey() count.
+ * Every distinct key gets its own slot(a perfect hash, found by trying a
+ * displacement per bucket, the largest buckets first), the items mapped to an
+ * existing key are chained behind it in order.
+ */
+static void jmap_index_build(jxs_mapper *mapper)
+{
+	size_t       i      = 0;
+	size_t       j      = 0;
+	size_t       b      = 0;
+	size_t       len    = 0;
+	size_t       maxlen = 0;
+	uint16_t    *disp   = NULL;
+	uint16_t    *head   = NULL;
+	uint16_t    *slot   = NULL;
+	jmap_head_t *jmhead = get_jmhead(mapper);
+	jmap_list_t *jmlist = get_jmlist(mapper);
+	if (jmhead->indexed) {
+		return;
+	}
+	jmhead->indexed = true;
+	for (i = 0; i < jmhead->idx; i++) {
+		jmap_item_t *jmitem = &jmlist[i];
+		jmitem->klen  = strlen(jmitem->key);
+		jmitem->khash = jmap_key_hash(jmitem->key, jmitem->klen);
+		jmitem->same  = 0;
+		jmitem->link  = 0;
+		if (jmitem->subjm) {
+			jmap_index_build(jmitem->subjm);
+		}
+	}
+	if (jmhead->nslot == 0) {
+		return;
+	}
+	disp = jmap_index_table(mapper);
+	head = disp + jmhead->nbucket;
+	slot = head + jmhead->nbucket;
+	memset(disp, 0, (2 * jmhead->nbucket + jmhead->nslot) * sizeof(uint16_t));
+	/* bucket lists of the distinct keys, in reverse order */
+	for (i = 0; i < jmhead->idx; i++) {
+		jmap_item_t *jmitem = &jmlist[i];
+		b = (size_t)(jmitem->khash & (jmhead->nbucket - 1));
+		for (j = head[b]; j != 0; j = jmlist[j - 1].link) {
+			jmap_item_t *other = &jmlist[j - 1];
+			if ((other->khash == jmitem->khash) && (other->klen == jmitem->klen) &&
+			    (memcmp(other->key, jmitem->key, jmitem->klen) == 0)) {
+				break;
+			}
+		}
+		if (j != 0) {
+			/* chain it behind the last item with the same key */
+			for (; jmlist[j - 1].same != 0; j = jmlist[j - 1].same) {
+			}
+			jmlist[j - 1].same = i + 1;
+			continue;
+		}
+		jmitem->link = head[b];
+		head[b]      = (uint16_t)(i + 1);
+	}
+	for (b = 0; b < jmhead->nbucket; b++) {
+		for (len = 0, j = head[b]; j != 0; j = jmlist[j - 1].link) {
+			len++;
+		}
+		maxlen = (len > maxlen) ? len : maxlen;
+	}
+	for (; maxlen > 0; maxlen--) {
+		for (b = 0; b < jmhead->nbucket; b++) {
+			for (len = 0, j = head[b]; j != 0; j = jmlist[j - 1].link) {
+				len++;
+			}
+			if (len != maxlen) {
+				continue;
+			}
+			if (jmap_index_place(jmlist, disp, slot, jmhead->nslot, b, head[b]) != 0) {
+				jxs_log(JXS_LOG_INFO, "JMAP INDEX[%p] no perfect hash, scan the keys.\n", mapper);
+				jmhead->nslot = 0;
+				return;
+			}
+		}
+	}
+}
+
+/**
+ * @brief Find the first item mapped to the key, the others follow by 'same'.
+ * @return item, or NULL if no item is mapped to the key.
+ */
+static jmap_item_t *jmap_index_find(jxs_mapper *mapper, const char *key, size_t klen)
+{
+	size_t       i      = 0;
+	uint64_t     hash   = 0;
+	uint16_t    *disp   = NULL;
+	jmap_item_t *jmitem = NULL;
+	jmap_head_t *jmhead = get_jmhead(mapper);
+	jmap_list_t *jmlist = get_jmlist(mapper);
+	if (jmhead->nslot == 0) {
+		for (i = 0; i < jmhead->idx; i++) {
+			jmitem = &jmlist[i];
+			if ((jmitem->klen == klen) && (memcmp(jmitem->key, key, klen) == 0)) {
+				return jmitem;
+			}
+		}
+		return NULL;
+	}
+	hash = jmap_key_hash(key, klen);
+	disp = jmap_index_table(mapper);
+	i    = disp[2 * jmhead->nbucket +
+	            jmap_key_slot(hash, disp[hash & (jmhead->nbucket - 1)], jmhead->nslot)];
+	if (i == 0) {
+		return NULL;
+	}
+	jmitem = &jmlist[i - 1];
+	if ((jmitem->khash != hash) || (jmitem->klen != klen) ||
+	    (memcmp(jmitem->key, key, klen) != 0)) {
+		return NULL;
+	}
+	return jmitem;
+}
+
 /**
  * @brief Return a string describing the type of the element type.
  * e.g. "int", or "object", etc...
@@ -73,6 +331,7 @@ static const char *type_to_name(jxs_type type)
 		[jxs_type_boolean] = "boolean",
 		[jxs_type_double]  = "double",
 		[jxs_type_int]     = "int",
+		[jxs_type_uint]    = "uint",
 		[jxs_type_string]  = "string",
 		[jxs_type_struct]  = "struct",
 		[jxs_type_object]  = "object",
@@ -85,1172 +344,7997 @@ static const char *type_to_name(jxs_type type)
 	return jxs_type_name[type];
 }
 
+/* SWAR helpers, one byte lane per 8 bits of a uint64_t */
+#define SWAR_ONES               0x0101010101010101ULL
+#define SWAR_HIGHS              0x8080808080808080ULL
+/* some byte of 'x' is zero */
+#define SWAR_HAS_ZERO(x)        (((x) - SWAR_ONES) & ~(x) & SWAR_HIGHS)
+/* some byte of 'x' is less than 'n'(n <= 128) */
+#define SWAR_HAS_LESS(x, n)     (((x) - SWAR_ONES * (n)) & ~(x) & SWAR_HIGHS)
+
 /**
- * @brief [Multidimensional Arrays] Set the jmap of the next dimension of the
- * array, Until the last dimension of the array is traversed.
- * @param  new_jmitem new jmap item for the next dimension of array.
- * @param  jmitem     parent jmap item.
- * @param  idx        index of the array.
+ * @brief Length of the plain run at the start of the string, the bytes json
+ * text can carry as they are: no control character, '"' or '\', and no '/'
+ * if 'slash' is set.
  */
-static void jmap_array_move_next_dimen(jmap_item_t *new_jmitem,
-                                       jmap_item_t *jmitem, size_t idx)
+static inline size_t str_escape_span(const char *s, size_t len, bool slash)
 {
-	memset(new_jmitem, 0, sizeof(jmap_item_t));
-	if ((jmitem->arr.cur_depth >= jmitem->arr.depth) ||
-	    (jmitem->arr.deptab[0] == 0)) {
-		jxs_log(JXS_LOG_FATAL, "array depth error.\n");
-		return;
+	size_t i = 0;
+#ifdef JXS_SIMD_AVX2
+	{
+		const __m256i vquote = _mm256_set1_epi8('"');
+		const __m256i vback  = _mm256_set1_epi8('\\');
+		const __m256i vslash = _mm256_set1_epi8(slash ? '/' : '"');
+		const __m256i vctrl  = _mm256_set1_epi8(0x1f);
+		for (; i + 32 <= len; i += 32) {
+			__m256i  x = _mm256_loadu_si256((const __m256i *)(const void *)(s + i));
+			__m256i  m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(x, vquote),
+			                                             _mm256_cmpeq_epi8(x, vback)),
+			                             _mm256_or_si256(_mm256_cmpeq_epi8(x, vslash),
+			                                             _mm256_cmpeq_epi8(_mm256_max_epu8(x, vctrl), vctrl)));
+			uint32_t mask = (uint32_t)_mm256_movemask_epi8(m);
+			if (mask) {
+				return i + (size_t)__builtin_ctz(mask);
+			}
+		}
 	}
-	new_jmitem->key      = jmitem->key;
-	new_jmitem->subjm    = jmitem->subjm;
-	new_jmitem->basetype = jmitem->basetype;
-	/* calculate the starting address of the current array */
-	new_jmitem->offset = jmitem->offset + (ptrdiff_t)(jmitem->size * idx);
-	/* If it is the last dimension, set the current arr_depth type
-	 * as the base type, otherwise it is array type */
-	new_jmitem->type = ((jmitem->arr.depth - jmitem->arr.cur_depth) == 1) ?
-	                   jmitem->basetype : jxs_type_array;
-	new_jmitem->size          = jmitem->size / jmitem->arr.deptab[0];
-	new_jmitem->arr.length    = jmitem->arr.deptab[0];
-	new_jmitem->arr.depth     = jmitem->arr.depth;
-	new_jmitem->arr.cur_depth = jmitem->arr.cur_depth + 1;
-	/* Shift 'array record table' to the left */
-	memcpy(new_jmitem->arr.deptab, &(jmitem->arr.deptab[1]),
-	       sizeof(jmitem->arr.deptab) - sizeof(jmitem->arr.deptab[0]));
-	new_jmitem->rule = jmitem->rule;
+#endif
+#ifdef JXS_SIMD_SSE2
+	{
+		const __m128i vquote = _mm_set1_epi8('"');
+		const __m128i vback  = _mm_set1_epi8('\\');
+		const __m128i vslash = _mm_set1_epi8(slash ? '/' : '"');
+		const __m128i vctrl  = _mm_set1_epi8(0x1f);
+		for (; i + 16 <= len; i += 16) {
+			__m128i  x = _mm_loadu_si128((const __m128i *)(const void *)(s + i));
+			__m128i  m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, vquote),
+			                                       _mm_cmpeq_epi8(x, vback)),
+			                          _mm_or_si128(_mm_cmpeq_epi8(x, vslash),
+			                                       _mm_cmpeq_epi8(_mm_max_epu8(x, vctrl), vctrl)));
+			uint32_t mask = (uint32_t)_mm_movemask_epi8(m);
+			if (mask) {
+				return i + (size_t)__builtin_ctz(mask);
+			}
+		}
+	}
+#else
+	{
+		const uint64_t quote = SWAR_ONES * '"';
+		const uint64_t back  = SWAR_ONES * '\\';
+		const uint64_t sl    = SWAR_ONES * (slash ? '/' : '"');
+		for (; i + 8 <= len; i += 8) {
+			uint64_t x = 0;
+			memcpy(&x, s + i, sizeof(x));
+			if (SWAR_HAS_LESS(x, 0x20) | SWAR_HAS_ZERO(x ^ quote) |
+			    SWAR_HAS_ZERO(x ^ back) | SWAR_HAS_ZERO(x ^ sl)) {
+				break;
+			}
+		}
+	}
+#endif
+	for (; i < len; i++) {
+		unsigned char c = (unsigned char)s[i];
+		if ((c < 0x20) || (c == '"') || (c == '\\') || (slash && (c == '/'))) {
+			break;
+		}
+	}
+	return i;
 }
 
 /**
- * @brief [struct array] Modify mapper to point to the next struct of the array.
- * @param mapper  mapper object
- * @param stsize  size of a single struct of the array.
- * @param idx     array index
+ * @brief Length of the run at the start of a json string body, up to the
+ * closing quote or the first escape.
  */
-static void jmap_struct_move_forward(jxs_mapper *mapper, size_t stsize, size_t idx)
+static inline size_t str_plain_span(const char *s, size_t len, char quote)
 {
 	size_t i = 0;
-	if (mapper) {
-		jmap_head_t *jmhead = get_jmhead(mapper);
-		jmap_list_t *jmlist = get_jmlist(mapper);
-		for (i = 0; i < jmhead->idx; i++) {
-			jmap_item_t *jmitem = &jmlist[i];
-			jmitem->offset = jmitem->offset + (ptrdiff_t)(stsize * idx);
+#ifdef JXS_SIMD_AVX2
+	{
+		const __m256i vquote = _mm256_set1_epi8(quote);
+		const __m256i vback  = _mm256_set1_epi8('\\');
+		for (; i + 32 <= len; i += 32) {
+			__m256i  x    = _mm256_loadu_si256((const __m256i *)(const void *)(s + i));
+			uint32_t mask = (uint32_t)_mm256_movemask_epi8(
+				_mm256_or_si256(_mm256_cmpeq_epi8(x, vquote), _mm256_cmpeq_epi8(x, vback)));
+			if (mask) {
+				return i + (size_t)__builtin_ctz(mask);
+			}
+		}
+	}
+#endif
+#ifdef JXS_SIMD_SSE2
+	{
+		const __m128i vquote = _mm_set1_epi8(quote);
+		const __m128i vback  = _mm_set1_epi8('\\');
+		for (; i + 16 <= len; i += 16) {
+			__m128i  x    = _mm_loadu_si128((const __m128i *)(const void *)(s + i));
+			uint32_t mask = (uint32_t)_mm_movemask_epi8(
+				_mm_or_si128(_mm_cmpeq_epi8(x, vquote), _mm_cmpeq_epi8(x, vback)));
+			if (mask) {
+				return i + (size_t)__builtin_ctz(mask);
+			}
+		}
+	}
+#else
+	{
+		const uint64_t vq = SWAR_ONES * (uint8_t)quote;
+		const uint64_t vb = SWAR_ONES * '\\';
+		for (; i + 8 <= len; i += 8) {
+			uint64_t x = 0;
+			memcpy(&x, s + i, sizeof(x));
+			if (SWAR_HAS_ZERO(x ^ vq) | SWAR_HAS_ZERO(x ^ vb)) {
+				break;
+			}
 		}
 	}
+#endif
+	for (; (i < len) && (s[i] != quote) && (s[i] != '\\'); i++) {
+	}
+	return i;
 }
 
 /**
- * @brief [struct array] mapper should be reset before the next struct use it.
- * @param mapper  mapper object.
- * @param stsize  size of a single struct of the array.
- * @param idx     array index.
- * @note  Must be used in pairs with 'jmap_struct_move_forward()'
+ * @brief How much of the string fits 'cap' bytes without splitting a UTF-8
+ * character. Only the bytes at the cut are looked at, invalid UTF-8 is cut
+ * as it is.
  */
-static void jmap_struct_move_backward(jxs_mapper *mapper, size_t stsize, size_t idx)
+static inline size_t utf8_fit(const char *s, size_t len, size_t cap)
 {
-	size_t i = 0;
-	if (mapper) {
-		jmap_head_t *jmhead = get_jmhead(mapper);
-		jmap_list_t *jmlist = get_jmlist(mapper);
-		for (i = 0; i < jmhead->idx; i++) {
-			jmap_item_t *jmitem = &jmlist[i];
-			jmitem->offset = jmitem->offset - (ptrdiff_t)(stsize * idx);
-		}
+	size_t k = cap;
+	if (len <= cap) {
+		return len;
+	}
+	/* s[cap] is the first byte left out, walk back over continuation bytes */
+	while ((k > 0) && ((cap - k) < 3) && (((unsigned char)s[k] & 0xc0) == 0x80)) {
+		k--;
+	}
+	if ((k != cap) && ((unsigned char)s[k] >= 0xc0)) {
+		unsigned char lead = (unsigned char)s[k];
+		size_t        need = (lead >= 0xf0) ? 4 : ((lead >= 0xe0) ? 3 : 2);
+		/* a stray continuation byte may follow a complete character */
+		return ((k + need) <= cap) ? cap : k;
 	}
+	return cap;
 }
 
 /**
- * @brief mapper print warpper
- *
- * @param  jmhead    mapper head.
- * @param  jmitem    jmap item.
- * @param  idx       array index.
- * @param  locator   current locator.
+ * @brief Copy the string into a char[size] member, truncated on a UTF-8
+ * character boundary, always terminated.
+ * @return true if the string was truncated.
  */
-static void jmap_print_warpper(jmap_context_t *ctx, jmap_head_t *jmhead,
-                               jmap_item_t *jmitem, size_t idx, const char *locator)
+static bool str_copy_fit(char *dst, size_t size, const char *src, size_t len)
 {
-	void     *vptr   = (uint8_t *)jmhead->start_addr + jmitem->offset;
-	jxs_type  type   = jmitem->type;
-	size_t    size   = jmitem->size;
-	ptrdiff_t offset = 0;
-	if (vptr == NULL) {
-		jxs_log(JXS_LOG_ERROR, "%s: jmap struct addr is null.\n", locator);
-		return;
+	size_t fit = 0;
+	if (size == 0) {
+		return len > 0;
 	}
-	vptr   = (uint8_t *)vptr + size * idx;
-	offset = (ptrdiff_t)vptr - (ptrdiff_t)ctx->start_addr;
-	switch (type) {
-	case jxs_type_null:
-		/* nothing to do */
-		PRINT_JMITEM(jmitem, "NULL");
-		break;
-
-	case jxs_type_boolean:
-		if (TYPEOF(size, int)) {
-			PRINT_JMITEM(jmitem, "%d", *((int *)vptr));
-		} else if (TYPEOF(size, bool)) {
-			PRINT_JMITEM(jmitem, "%d", *((bool *)vptr));
-		}
-		break;
-
-	case jxs_type_double:
-		if (TYPEOF(size, double)) {
-			PRINT_JMITEM(jmitem, "%lf", *((double *)vptr));
-		} else if (TYPEOF(size, float)) {
-			PRINT_JMITEM(jmitem, "%f", *((float *)vptr));
-		}
-		break;
+	fit = utf8_fit(src, len, size - 1);
+	memmove(dst, src, fit);
+	dst[fit] = '\0';
+	return fit < len;
+}
 
-	case jxs_type_int:
-		if (TYPEOF(size, int64_t)) {
-			PRINT_JMITEM(jmitem, "%" PRId64 "", *((int64_t *)vptr));
-		} else if (TYPEOF(size, int32_t)) {
-			PRINT_JMITEM(jmitem, "%" PRId32 "", *((int32_t *)vptr));
-		} else if (TYPEOF(size, int16_t)) {
-			PRINT_JMITEM(jmitem, "%" PRId16 "", *((int16_t *)vptr));
-		} else if (TYPEOF(size, int8_t)) {
-			PRINT_JMITEM(jmitem, "%" PRId8 "", *((int8_t *)vptr));
-		}
-		break;
+/**
+ * @brief Buffer size for one formatted number, '-', 17 digits, the point and
+ * the exponent, or the longest of the fixed forms('-0.000' + 17 digits).
+ */
+#define NUM_BUFSIZE             32
 
-	case jxs_type_string:
-		PRINT_JMITEM(jmitem, "%s", *((char(*)[])vptr));
-		break;
+static const char num_digit_pairs[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
 
-	case jxs_type_object: {
-		json_object *jso = NULL;
-		jso = *(json_object **)vptr;
-		if (jso) {
-			PRINT_JMITEM(jmitem, "%s", json_object_to_json_string(jso));
-		} else {
-			PRINT_JMITEM(jmitem, "NULL");
-		}
-		break;
+/**
+ * @brief Format an unsigned integer, two digits per step from the pair table.
+ * @return the number of chars written(not terminated).
+ */
+static size_t num_format_u64(char *buf, uint64_t value)
+{
+	char   tmp[20];
+	char  *p = tmp + sizeof(tmp);
+	size_t len = 0;
+	while (value >= 100) {
+		const char *pair = &num_digit_pairs[(value % 100) * 2];
+		value /= 100;
+		*--p = pair[1];
+		*--p = pair[0];
 	}
-
-	case jxs_type_struct: {
-		jmap_head_t *sub_jmhead = get_jmhead(jmitem->subjm);
-		sub_jmhead->start_addr = (uint8_t *)jmhead->start_addr + jmitem->offset;
-		jmap_struct_move_forward(jmitem->subjm, size, idx);
-		PRINT_JMITEM(jmitem, "[JMAP:%p][OFFSET:%8" FMT_PTRDIFF_T "]", jmitem->subjm,
-		             (ptrdiff_t)sub_jmhead->start_addr - (ptrdiff_t)ctx->start_addr);
-		jmap_struct_print(ctx, jmitem->subjm, locator);
-		jmap_struct_move_backward(jmitem->subjm, size, idx);
-		break;
+	if (value >= 10) {
+		const char *pair = &num_digit_pairs[value * 2];
+		*--p = pair[1];
+		*--p = pair[0];
+	} else {
+		*--p = (char)('0' + value);
 	}
+	len = (size_t)(tmp + sizeof(tmp) - p);
+	memcpy(buf, p, len);
+	return len;
+}
 
-	case jxs_type_array: {
-		jmap_item_t new_jmitem;
-		jmap_array_move_next_dimen(&new_jmitem, jmitem, idx);
-		PRINT_JMITEM(&new_jmitem, "[depth(%" FMT_SIZE_T "), type(%s), "
-		             "form(%" FMT_SIZE_T "x%" FMT_SIZE_T ")]",
-		             new_jmitem.arr.depth - new_jmitem.arr.cur_depth + 1,
-		             type_to_name(new_jmitem.type),
-		             new_jmitem.arr.length, new_jmitem.size);
-		jmap_array_print(ctx, jmhead, &new_jmitem, locator);
-		break;
+static size_t num_format_i64(char *buf, int64_t value)
+{
+	if (value < 0) {
+		buf[0] = '-';
+		return num_format_u64(buf + 1, 0 - (uint64_t)value) + 1;
 	}
+	return num_format_u64(buf, (uint64_t)value);
+}
 
-	default:
-		jxs_log(JXS_LOG_ERROR, "%s<error type>\n", jmitem->key);
-		break;
-	}
+/**
+ * Shortest round-trip doubles, Grisu2(Florian Loitsch, "Printing Floating-Point
+ * Numbers Quickly and Accurately with Integers"). The digits always read back
+ * to the same value, and are the shortest such digits for nearly all inputs.
+ * Floats get their own rounding boundaries, so they print with float precision.
+ */
+typedef struct {
+	uint64_t f;
+	int      e;
+} num_diyfp;
+
+/* normalized 10^k, k from -300 to 324 in steps of 8 */
+static const struct {
+	uint64_t f;
+	int16_t  e;
+	int16_t  k;
+} num_cached_powers[] = {
+	{ 0xAB70FE17C79AC6CAULL, -1060, -300 },
+	{ 0xFF77B1FCBEBCDC4FULL, -1034, -292 },
+	{ 0xBE5691EF416BD60CULL, -1007, -284 },
+	{ 0x8DD01FAD907FFC3CULL,  -980, -276 },
+	{ 0xD3515C2831559A83ULL,  -954, -268 },
+	{ 0x9D71AC8FADA6C9B5ULL,  -927, -260 },
+	{ 0xEA9C227723EE8BCBULL,  -901, -252 },
+	{ 0xAECC49914078536DULL,  -874, -244 },
+	{ 0x823C12795DB6CE57ULL,  -847, -236 },
+	{ 0xC21094364DFB5637ULL,  -821, -228 },
+	{ 0x9096EA6F3848984FULL,  -794, -220 },
+	{ 0xD77485CB25823AC7ULL,  -768, -212 },
+	{ 0xA086CFCD97BF97F4ULL,  -741, -204 },
+	{ 0xEF340A98172AACE5ULL,  -715, -196 },
+	{ 0xB23867FB2A35B28EULL,  -688, -188 },
+	{ 0x84C8D4DFD2C63F3BULL,  -661, -180 },
+	{ 0xC5DD44271AD3CDBAULL,  -635, -172 },
+	{ 0x936B9FCEBB25C996ULL,  -608, -164 },
+	{ 0xDBAC6C247D62A584ULL,  -582, -156 },
+	{ 0xA3AB66580D5FDAF6ULL,  -555, -148 },
+	{ 0xF3E2F893DEC3F126ULL,  -529, -140 },
+	{ 0xB5B5ADA8AAFF80B8ULL,  -502, -132 },
+	{ 0x87625F056C7C4A8BULL,  -475, -124 },
+	{ 0xC9BCFF6034C13053ULL,  -449, -116 },
+	{ 0x964E858C91BA2655ULL,  -422, -108 },
+	{ 0xDFF9772470297EBDULL,  -396, -100 },
+	{ 0xA6DFBD9FB8E5B88FULL,  -369,  -92 },
+	{ 0xF8A95FCF88747D94ULL,  -343,  -84 },
+	{ 0xB94470938FA89BCFULL,  -316,  -76 },
+	{ 0x8A08F0F8BF0F156BULL,  -289,  -68 },
+	{ 0xCDB02555653131B6ULL,  -263,  -60 },
+	{ 0x993FE2C6D07B7FACULL,  -236,  -52 },
+	{ 0xE45C10C42A2B3B06ULL,  -210,  -44 },
+	{ 0xAA242499697392D3ULL,  -183,  -36 },
+	{ 0xFD87B5F28300CA0EULL,  -157,  -28 },
+	{ 0xBCE5086492111AEBULL,  -130,  -20 },
+	{ 0x8CBCCC096F5088CCULL,  -103,  -12 },
+	{ 0xD1B71758E219652CULL,   -77,   -4 },
+	{ 0x9C40000000000000ULL,   -50,    4 },
+	{ 0xE8D4A51000000000ULL,   -24,   12 },
+	{ 0xAD78EBC5AC620000ULL,     3,   20 },
+	{ 0x813F3978F8940984ULL,    30,   28 },
+	{ 0xC097CE7BC90715B3ULL,    56,   36 },
+	{ 0x8F7E32CE7BEA5C70ULL,    83,   44 },
+	{ 0xD5D238A4ABE98068ULL,   109,   52 },
+	{ 0x9F4F2726179A2245ULL,   136,   60 },
+	{ 0xED63A231D4C4FB27ULL,   162,   68 },
+	{ 0xB0DE65388CC8ADA8ULL,   189,   76 },
+	{ 0x83C7088E1AAB65DBULL,   216,   84 },
+	{ 0xC45D1DF942711D9AULL,   242,   92 },
+	{ 0x924D692CA61BE758ULL,   269,  100 },
+	{ 0xDA01EE641A708DEAULL,   295,  108 },
+	{ 0xA26DA3999AEF774AULL,   322,  116 },
+	{ 0xF209787BB47D6B85ULL,   348,  124 },
+	{ 0xB454E4A179DD1877ULL,   375,  132 },
+	{ 0x865B86925B9BC5C2ULL,   402,  140 },
+	{ 0xC83553C5C8965D3DULL,   428,  148 },
+	{ 0x952AB45CFA97A0B3ULL,   455,  156 },
+	{ 0xDE469FBD99A05FE3ULL,   481,  164 },
+	{ 0xA59BC234DB398C25ULL,   508,  172 },
+	{ 0xF6C69A72A3989F5CULL,   534,  180 },
+	{ 0xB7DCBF5354E9BECEULL,   561,  188 },
+	{ 0x88FCF317F22241E2ULL,   588,  196 },
+	{ 0xCC20CE9BD35C78A5ULL,   614,  204 },
+	{ 0x98165AF37B2153DFULL,   641,  212 },
+	{ 0xE2A0B5DC971F303AULL,   667,  220 },
+	{ 0xA8D9D1535CE3B396ULL,   694,  228 },
+	{ 0xFB9B7CD9A4A7443CULL,   720,  236 },
+	{ 0xBB764C4CA7A44410ULL,   747,  244 },
+	{ 0x8BAB8EEFB6409C1AULL,   774,  252 },
+	{ 0xD01FEF10A657842CULL,   800,  260 },
+	{ 0x9B10A4E5E9913129ULL,   827,  268 },
+	{ 0xE7109BFBA19C0C9DULL,   853,  276 },
+	{ 0xAC2820D9623BF429ULL,   880,  284 },
+	{ 0x80444B5E7AA7CF85ULL,   907,  292 },
+	{ 0xBF21E44003ACDD2DULL,   933,  300 },
+	{ 0x8E679C2F5E44FF8FULL,   960,  308 },
+	{ 0xD433179D9C8CB841ULL,   986,  316 },
+	{ 0x9E19DB92B4E31BA9ULL,  1013,  324 },
+};
+
+#define NUM_CACHED_MIN_K        (-300)
+#define NUM_CACHED_STEP_K       8
+#define NUM_ALPHA               (-60)
+#define NUM_GAMMA               (-32)
+
+static inline num_diyfp num_diyfp_make(uint64_t f, int e)
+{
+	num_diyfp x;
+	x.f = f;
+	x.e = e;
+	return x;
 }
 
 /**
- * @brief array type print
- *
- * @param  jmhead    mapper head.
- * @param  jmitem    jmap item.
- * @param  locator   current locator.
+ * @brief x * y, the upper 64 bits of the product, rounded.
  */
-static void jmap_array_print(jmap_context_t *ctx, jmap_head_t *jmhead,
-                             jmap_item_t *jmitem, const char *locator)
+static num_diyfp num_diyfp_mul(num_diyfp x, num_diyfp y)
 {
-	size_t i = 0;
-	for (i = 0; i < jmitem->arr.length; i++) {
-		char *new_locator = NULL;
-		SET_NEW_LOCATOR(new_locator, locator, jmitem->key, 1, i);
-		jmap_print_warpper(ctx, jmhead, jmitem, i, new_locator);
+	uint64_t x_lo = x.f & 0xffffffffU;
+	uint64_t x_hi = x.f >> 32;
+	uint64_t y_lo = y.f & 0xffffffffU;
+	uint64_t y_hi = y.f >> 32;
+	uint64_t p0   = x_lo * y_lo;
+	uint64_t p1   = x_lo * y_hi;
+	uint64_t p2   = x_hi * y_lo;
+	uint64_t p3   = x_hi * y_hi;
+	uint64_t mid  = (p0 >> 32) + (p1 & 0xffffffffU) + (p2 & 0xffffffffU) + (1U << 31);
+	return num_diyfp_make(p3 + (p1 >> 32) + (p2 >> 32) + (mid >> 32), x.e + y.e + 64);
+}
+
+static num_diyfp num_diyfp_normalize(num_diyfp x)
+{
+	while ((x.f >> 63) == 0) {
+		x.f <<= 1;
+		x.e--;
 	}
+	return x;
 }
 
 /**
- * @brief struct type print
- *
- * @param  mapper    mapper object.
- * @param  locator   current locator.
+ * @brief Digits of the interval(m_minus, m_plus) around w, Grisu2 digit
+ * generation. The last digit is moved toward w as far as the interval allows.
  */
-static void jmap_struct_print(jmap_context_t *ctx, jxs_mapper *mapper, const char *locator)
+static void num_grisu2_digits(char *digits, int *len, int *exp10,
+                              num_diyfp m_minus, num_diyfp w, num_diyfp m_plus)
 {
-	size_t       i      = 0;
-	jmap_head_t *jmhead = NULL;
-	jmap_list_t *jmlist = NULL;
-	if (mapper == NULL) {
-		jxs_log(JXS_LOG_ERROR, "mapper null.\n");
-		return;
+	int      shift = -m_plus.e;
+	uint64_t one   = (uint64_t)1 << shift;
+	uint64_t delta = m_plus.f - m_minus.f;
+	uint64_t dist  = m_plus.f - w.f;
+	uint32_t p1    = (uint32_t)(m_plus.f >> shift);
+	uint64_t p2    = m_plus.f & (one - 1);
+	uint64_t rest  = 0;
+	uint64_t ten_k = 0;
+	uint32_t pow10 = 1;
+	int      n     = 1;
+	/* p1 has at most 10 digits */
+	while ((n < 10) && (p1 / pow10 >= 10)) {
+		pow10 *= 10;
+		n++;
 	}
-	jmhead = get_jmhead(mapper);
-	jmlist = get_jmlist(mapper);
-	for (i = 0; i < jmhead->idx; i++) {
-		jmap_item_t *jmitem      = &jmlist[i];
-		char        *new_locator = NULL;
-		SET_NEW_LOCATOR(new_locator, locator, jmitem->key, 0, 0);
-		jmap_print_warpper(ctx, jmhead, jmitem, 0, new_locator);
+	*len = 0;
+	for (;;) {
+		digits[(*len)++] = (char)('0' + p1 / pow10);
+		p1 %= pow10;
+		n--;
+		rest = ((uint64_t)p1 << shift) + p2;
+		if (rest <= delta) {
+			*exp10 += n;
+			ten_k   = (uint64_t)pow10 << shift;
+			goto round;
+		}
+		if (n == 0) {
+			break;
+		}
+		pow10 /= 10;
+	}
+	/* the fraction part, one digit at a time */
+	for (;;) {
+		p2    *= 10;
+		delta *= 10;
+		dist  *= 10;
+		digits[(*len)++] = (char)('0' + (p2 >> shift));
+		p2 &= one - 1;
+		(*exp10)--;
+		if (p2 <= delta) {
+			break;
+		}
+	}
+	rest  = p2;
+	ten_k = one;
+round:
+	while ((rest < dist) && (delta - rest >= ten_k) &&
+	       ((rest + ten_k < dist) || (dist - rest > rest + ten_k - dist))) {
+		digits[*len - 1]--;
+		rest += ten_k;
 	}
 }
 
-static item_action jmap_convert_handler(jmap_context_t *ctx, jmap_item_t *jmitem, void *vptr,
-                                        json_object **jso, const char *locator)
+/**
+ * @brief Shortest digits of a positive finite binary float with 'mant' and
+ * biased exponent 'bexp', 'prec' significand bits(hidden bit included) and
+ * exponent bias 'bias'. The value is digits * 10^exp10.
+ */
+static void num_grisu2(char *digits, int *len, int *exp10,
+                       uint64_t mant, int bexp, int prec, int bias)
 {
-	jxs_type type     = jmitem->type;
-	size_t   size     = jmitem->size;
-	uint8_t  rule     = jmitem->rule;
-	bool     is_force = false;
-	if (rule == 0) {
-		jxs_log(JXS_LOG_ERROR, "rule flag set error.\n");
-		return RULE_ITEM_ERROR;
+	uint64_t  hidden = (uint64_t)1 << (prec - 1);
+	int       ebias  = bias + prec - 1;
+	num_diyfp v, w, m_plus, m_minus, c;
+	int       f = 0, k = 0, idx = 0;
+	bool      closer = false;
+	if (bexp == 0) {
+		v = num_diyfp_make(mant, 1 - ebias);
+	} else {
+		v = num_diyfp_make(mant + hidden, bexp - ebias);
 	}
-	ctx->now.vptr = vptr;
-	if (ctx->convert.callback) {
-		ctx->convert.callback(ctx);
-		if (ctx->convert.rule != 0) {
-			/* if complex rule is set, overriding basic rules and force to check rules */
-			rule     = ctx->convert.rule;
-			is_force = true;
-			jxs_log(JXS_LOG_TRACE, "%s: set complex rule: 0x%08x.\n", locator, rule);
+	/* the boundaries are halfway to the neighbours, the lower one is closer
+	 * at a power of 2 */
+	closer  = (mant == 0) && (bexp > 1);
+	m_plus  = num_diyfp_normalize(num_diyfp_make(2 * v.f + 1, v.e - 1));
+	m_minus = closer ? num_diyfp_make(4 * v.f - 1, v.e - 2) : num_diyfp_make(2 * v.f - 1, v.e - 1);
+	m_minus.f <<= m_minus.e - m_plus.e;
+	m_minus.e   = m_plus.e;
+	w = num_diyfp_normalize(v);
+	/* a cached power that brings the exponent of m_plus into [alpha, gamma] */
+	f   = NUM_ALPHA - m_plus.e - 1;
+	k   = (f * 78913) / (1 << 18) + (f > 0);
+	idx = (-NUM_CACHED_MIN_K + k + (NUM_CACHED_STEP_K - 1)) / NUM_CACHED_STEP_K;
+	c   = num_diyfp_make(num_cached_powers[idx].f, num_cached_powers[idx].e);
+	w       = num_diyfp_mul(w, c);
+	m_minus = num_diyfp_mul(m_minus, c);
+	m_plus  = num_diyfp_mul(m_plus, c);
+	/* stay inside the interval whatever the rounding of the products */
+	m_minus.f++;
+	m_plus.f--;
+	*exp10 = -num_cached_powers[idx].k;
+	num_grisu2_digits(digits, len, exp10, m_minus, w, m_plus);
+}
+
+/**
+ * @brief Lay the digits out the way json-c's '%.17g' does: fixed notation for
+ * decimal exponents in [-4, 17), scientific otherwise, and always looks like
+ * a float. There are never trailing zeros to strip, so JSON_C_TO_STRING_NOZERO
+ * has nothing left to do.
+ */
+static size_t num_format_digits(char *buf, bool neg, const char *digits, int len, int exp10)
+{
+	char *p = buf;
+	int   n = len + exp10; /* position of the decimal point */
+	if (neg) {
+		*p++ = '-';
+	}
+	if ((n > 17) || (n < -3)) {
+		int e = n - 1;
+		*p++ = digits[0];
+		if (len > 1) {
+			*p++ = '.';
+			memcpy(p, digits + 1, (size_t)(len - 1));
+			p += len - 1;
 		}
-		/* reset rule flag */
-		ctx->convert.rule = 0;
+		*p++ = 'e';
+		*p++ = (e < 0) ? '-' : '+';
+		e    = (e < 0) ? -e : e;
+		if (e < 10) {
+			*p++ = '0';
+		}
+		p += num_format_u64(p, (uint64_t)e);
+	} else if (n >= len) {
+		memcpy(p, digits, (size_t)len);
+		p += len;
+		memset(p, '0', (size_t)(n - len));
+		p += n - len;
+		memcpy(p, ".0", 2);
+		p += 2;
+	} else if (n > 0) {
+		memcpy(p, digits, (size_t)n);
+		p += n;
+		*p++ = '.';
+		memcpy(p, digits + n, (size_t)(len - n));
+		p += len - n;
+	} else {
+		memcpy(p, "0.", 2);
+		p += 2;
+		memset(p, '0', (size_t)-n);
+		p += -n;
+		memcpy(p, digits, (size_t)len);
+		p += len;
 	}
-	if (rule == JXS_RULE_KEEP_RAW) {
-		// jxs_log(JXS_LOG_TRACE, "%s: keep raw.\n", locator);
-		return RULE_ITEM_KEEP;
+	return (size_t)(p - buf);
+}
+
+static size_t num_format_special(char *buf, double value)
+{
+	const char *str = NULL;
+	if (isnan(value)) {
+		str = "NaN";
+	} else if (isinf(value)) {
+		str = (value > 0) ? "Infinity" : "-Infinity";
+	} else {
+		str = signbit(value) ? "-0.0" : "0.0";
 	}
-	/* if complex rule not set, the rule action can only take effect when the data is empty */
-	if (!is_force) {
-		bool is_empty = false;
-		switch (type) {
-		case jxs_type_null:
-			/* nothing to do */
-			break;
+	memcpy(buf, str, strlen(str));
+	return strlen(str);
+}
 
-		case jxs_type_boolean: {
-			int tmpbool = 0;
-			if (TYPEOF(size, int)) {
-				tmpbool = *((int *)vptr);
-			} else if (TYPEOF(size, bool)) {
-				tmpbool = *((bool *)vptr);
-			}
-			if (tmpbool == false) {
-				is_empty = true;
-			}
-			break;
+/**
+ * @brief Format a double with the shortest digits that read back to it,
+ * 'NaN' and 'Infinity' as json-c does.
+ * @return the number of chars written(not terminated), at most NUM_BUFSIZE - 1.
+ */
+static size_t num_format_double(char *buf, double value)
+{
+	char     digits[20];
+	int      len   = 0;
+	int      exp10 = 0;
+	uint64_t bits  = 0;
+	if (!isfinite(value) || (value == 0)) {
+		return num_format_special(buf, value);
+	}
+	memcpy(&bits, &value, sizeof(bits));
+	num_grisu2(digits, &len, &exp10, bits & (((uint64_t)1 << 52) - 1),
+	           (int)((bits >> 52) & 0x7ff), 53, 1023);
+	return num_format_digits(buf, bits >> 63, digits, len, exp10);
+}
+
+/**
+ * @brief Same as num_format_double(), with the digits of a float.
+ */
+static size_t num_format_float(char *buf, float value)
+{
+	char     digits[20];
+	int      len   = 0;
+	int      exp10 = 0;
+	uint32_t bits  = 0;
+	if (!isfinite(value) || (value == 0)) {
+		return num_format_special(buf, value);
+	}
+	memcpy(&bits, &value, sizeof(bits));
+	num_grisu2(digits, &len, &exp10, bits & ((1U << 23) - 1),
+	           (int)((bits >> 23) & 0xff), 24, 127);
+	return num_format_digits(buf, bits >> 31, digits, len, exp10);
+}
+
+/**
+ * @brief Add one digit to the significand of a number being parsed, 'frac'
+ * for the digits after the decimal point. Past 19 significant digits only the
+ * exponent moves, and the value is no longer exact if a dropped digit is not 0.
+ */
+static inline void num_sig_digit(jxs_rvalue *val, unsigned d, bool frac)
+{
+	if (val->sig < 1000000000000000000ULL) {
+		val->sig    = val->sig * 10 + d;
+		val->exp10 -= frac;
+	} else {
+		val->exp10 += !frac;
+		val->exact &= (d == 0);
+	}
+}
+
+/**
+ * @brief sig * 10^exp10 with one rounding when both factors are exact in a
+ * double(Clinger's fast path), so the result is correctly rounded. Exponents
+ * past 22 still work as long as the extra powers fit in the significand.
+ * @return true for done, false if the slow path is needed.
+ */
+static bool num_fast_double(uint64_t sig, int exp10, double *out)
+{
+#if defined(FLT_EVAL_METHOD) && (FLT_EVAL_METHOD == 0)
+	static const double pow10[] = {
+		1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+	};
+	const uint64_t max = (uint64_t)1 << 53;
+	if (sig == 0) {
+		*out = 0;
+		return true;
+	}
+	if (sig > max) {
+		return false;
+	}
+	if (exp10 < 0) {
+		if (exp10 < -22) {
+			return false;
+		}
+		*out = (double)sig / pow10[-exp10];
+		return true;
+	}
+	for (; exp10 > 22; exp10--) {
+		if (sig > max / 10) {
+			return false;
 		}
+		sig *= 10;
+	}
+	*out = (double)sig * pow10[exp10];
+	return true;
+#else
+	/* the fast path needs the operations rounded to double */
+	(void)sig;
+	(void)exp10;
+	(void)out;
+	return false;
+#endif
+}
 
-		case jxs_type_double: {
-			double tmpdouble = 0;
-			if (TYPEOF(size, double)) {
-				tmpdouble = *((double *)vptr);
-			} else if (TYPEOF(size, float)) {
-				tmpdouble = *((float *)vptr);
+/**
+ * @brief Same as num_fast_double() with float precision.
+ */
+static bool num_fast_float(uint64_t sig, int exp10, float *out)
+{
+#if defined(FLT_EVAL_METHOD) && (FLT_EVAL_METHOD == 0)
+	static const float pow10[] = {
+		1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f,
+	};
+	if ((sig > ((uint64_t)1 << 24)) || (exp10 < -10) || (exp10 > 10)) {
+		return false;
+	}
+	*out = (exp10 < 0) ? ((float)sig / pow10[-exp10]) : ((float)sig * pow10[exp10]);
+	return true;
+#else
+	(void)sig;
+	(void)exp10;
+	(void)out;
+	return false;
+#endif
+}
+
+/**
+ * @brief Slow path of the number parsing, strtod()/strtof() on a copy of the
+ * text with the decimal point of the current locale. The whole text is parsed,
+ * a copy that doesn't fit the stack buffer is made on the heap.
+ * @return 0 for success, -1 for out of memory.
+ */
+static int num_parse_slow(const char *text, size_t len, bool single, double *out)
+{
+	char  buf[JXS_NUMBER_MAXLEN];
+	char *tmp   = buf;
+	char *dot   = NULL;
+	char  point = localeconv()->decimal_point[0];
+	if ((len >= sizeof(buf)) && ((tmp = (char *)jxs_malloc(len + 1)) == NULL)) {
+		jxs_log(JXS_LOG_ERROR, "number out of memory.\n");
+		return -1;
+	}
+	memcpy(tmp, text, len);
+	tmp[len] = '\0';
+	if ((point != '.') && (point != '\0') && ((dot = (char *)memchr(tmp, '.', len)) != NULL)) {
+		*dot = point;
+	}
+	*out = single ? strtof(tmp, NULL) : strtod(tmp, NULL);
+	if (tmp != buf) {
+		jxs_free(tmp);
+	}
+	return 0;
+}
+
+/**
+ * @brief Make sure the write buffer has room for 'n' more bytes(plus the
+ * terminating '\0'). On failure the buffer is marked as broken, so the callers
+ * can keep writing and check 'err' only once at the end.
+ * @return 0 for success, -1 for error.
+ */
+static int wbuf_reserve(jxs_wbuf *wbuf, size_t n)
+{
+	size_t cap  = 0;
+	char  *data = NULL;
+	if (wbuf->err) {
+		return -1;
+	}
+	if ((wbuf->cap - wbuf->len) > n) {
+		return 0;
+	}
+	cap = wbuf->cap ? wbuf->cap : WBUF_DEFAULT_SIZE;
+	while ((cap - wbuf->len) <= n) {
+		cap *= 2;
+	}
+	data = (char *)jxs_realloc(wbuf->data, cap);
+	if (data == NULL) {
+		jxs_log(JXS_LOG_ERROR, "write buffer grow to %" FMT_SIZE_T " failed.\n", cap);
+		wbuf->err = true;
+		return -1;
+	}
+	wbuf->data = data;
+	wbuf->cap  = cap;
+	wbuf->allocs++;
+	return 0;
+}
+
+static inline void wbuf_append(jxs_wbuf *wbuf, const char *data, size_t n)
+{
+	if (wbuf_reserve(wbuf, n) == 0) {
+		memcpy(wbuf->data + wbuf->len, data, n);
+		wbuf->len += n;
+	}
+}
+
+static inline void wbuf_putc(jxs_wbuf *wbuf, char c)
+{
+	if (wbuf_reserve(wbuf, 1) == 0) {
+		wbuf->data[wbuf->len++] = c;
+	}
+}
+
+static inline void wbuf_fill(jxs_wbuf *wbuf, char c, size_t n)
+{
+	if (wbuf_reserve(wbuf, n) == 0) {
+		memset(wbuf->data + wbuf->len, c, n);
+		wbuf->len += n;
+	}
+}
+
+#define wbuf_puts(wbuf, str)    wbuf_append(wbuf, str, sizeof(str) - 1)
+
+/* terminate the buffer, it can be used as a C string after that */
+static inline void wbuf_finish(jxs_wbuf *wbuf)
+{
+	if (wbuf_reserve(wbuf, 0) == 0) {
+		wbuf->data[wbuf->len] = '\0';
+	}
+}
+
+static void wbuf_release(jxs_wbuf *wbuf)
+{
+	jxs_free(wbuf->data);
+	memset(wbuf, 0, sizeof(jxs_wbuf));
+}
+
+static inline void rd_init(jxs_reader *rd, const char *text, size_t len)
+{
+	rd->start = text;
+	rd->cur   = text;
+	rd->end   = text + len;
+	rd->depth = 0;
+	rd->err   = false;
+}
+
+static void rd_error(jxs_reader *rd, const char *what)
+{
+	if (!rd->err) {
+		jxs_log(JXS_LOG_ERROR, "json parse error at offset %" FMT_SIZE_T ": %s.\n",
+		        (size_t)(rd->cur - rd->start), what);
+	}
+	rd->err = true;
+}
+
+/* skip white space, and comments like json-c does */
+static inline void rd_skip_ws(jxs_reader *rd)
+{
+	while (rd->cur < rd->end) {
+		char c = *rd->cur;
+		if ((c == ' ') || (c == '\n') || (c == '\r') || (c == '\t')) {
+			rd->cur++;
+		} else if ((c == '/') && (rd->end - rd->cur >= 2) && (rd->cur[1] == '/')) {
+			while ((rd->cur < rd->end) && (*rd->cur != '\n')) {
+				rd->cur++;
 			}
-			if (tmpdouble == 0) {
-				is_empty = true;
+		} else if ((c == '/') && (rd->end - rd->cur >= 2) && (rd->cur[1] == '*')) {
+			const char *p = rd->cur + 2;
+			while ((p + 1 < rd->end) && !((p[0] == '*') && (p[1] == '/'))) {
+				p++;
 			}
+			rd->cur = (p + 1 < rd->end) ? p + 2 : rd->end;
+		} else {
 			break;
 		}
+	}
+}
 
-		case jxs_type_int: {
-			int64_t tmpint = 0;
-			if (TYPEOF(size, int64_t)) {
-				tmpint = *((int64_t *)vptr);
-			} else if (TYPEOF(size, int32_t)) {
-				tmpint = *((int32_t *)vptr);
-			} else if (TYPEOF(size, int16_t)) {
-				tmpint = *((int16_t *)vptr);
-			} else if (TYPEOF(size, int8_t)) {
-				tmpint = *((int8_t *)vptr);
-			}
-			if (tmpint == 0) {
-				is_empty = true;
-			}
-			break;
+/* return next non-blank character without consuming it, or -1 at the end */
+static inline int rd_peek(jxs_reader *rd)
+{
+	rd_skip_ws(rd);
+	return (rd->cur < rd->end) ? (unsigned char)*rd->cur : -1;
+}
+
+/* consume the character 'c' if it is the next one */
+static inline bool rd_accept(jxs_reader *rd, char c)
+{
+	if (rd_peek(rd) == (unsigned char)c) {
+		rd->cur++;
+		return true;
+	}
+	return false;
+}
+
+/* consume the literal 'word' if it is the next one */
+static bool rd_literal(jxs_reader *rd, const char *word, size_t len)
+{
+	if (((size_t)(rd->end - rd->cur) >= len) && (memcmp(rd->cur, word, len) == 0)) {
+		rd->cur += len;
+		return true;
+	}
+	return false;
+}
+
+/* consume 'null' if it is the next value */
+static inline bool rd_null(jxs_reader *rd)
+{
+	return (rd_peek(rd) == 'n') && rd_literal(rd, "null", 4);
+}
+
+static int rd_hex4(const char *p, uint32_t *code)
+{
+	int i = 0;
+	*code = 0;
+	for (i = 0; i < 4; i++) {
+		char c = p[i];
+		*code <<= 4;
+		if ((c >= '0') && (c <= '9')) {
+			*code |= (uint32_t)(c - '0');
+		} else if ((c >= 'a') && (c <= 'f')) {
+			*code |= (uint32_t)(c - 'a' + 10);
+		} else if ((c >= 'A') && (c <= 'F')) {
+			*code |= (uint32_t)(c - 'A' + 10);
+		} else {
+			return -1;
 		}
+	}
+	return 0;
+}
 
-		case jxs_type_string: {
-			char *tmpstr = *((char(*)[])vptr);
-			if ((tmpstr == NULL) || (tmpstr[0] == '\0')) {
-				is_empty = true;
+/**
+ * @brief Decode one escape sequence at 'rd->cur'(just after the backslash).
+ * @param  out  decoded bytes, at most 4(UTF-8).
+ * @return number of decoded bytes, or -1 for error.
+ */
+static int rd_escape(jxs_reader *rd, char out[4])
+{
+	uint32_t code = 0;
+	if (rd->cur >= rd->end) {
+		return -1;
+	}
+	switch (*rd->cur++) {
+	case '"':  out[0] = '"'; return 1;
+	case '\\': out[0] = '\\'; return 1;
+	case '/':  out[0] = '/'; return 1;
+	case 'b':  out[0] = '\b'; return 1;
+	case 'f':  out[0] = '\f'; return 1;
+	case 'n':  out[0] = '\n'; return 1;
+	case 'r':  out[0] = '\r'; return 1;
+	case 't':  out[0] = '\t'; return 1;
+	case 'u':
+		if ((rd->end - rd->cur < 4) || (rd_hex4(rd->cur, &code) != 0)) {
+			return -1;
+		}
+		rd->cur += 4;
+		if ((code >= 0xd800) && (code <= 0xdbff)) {
+			uint32_t low = 0;
+			/* high surrogate, it needs the low surrogate as the next escape */
+			if ((rd->end - rd->cur >= 6) && (rd->cur[0] == '\\') && (rd->cur[1] == 'u') &&
+			    (rd_hex4(rd->cur + 2, &low) == 0) && (low >= 0xdc00) && (low <= 0xdfff)) {
+				rd->cur += 6;
+				code     = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+			} else {
+				code = 0xfffd;
 			}
-			break;
+		} else if ((code >= 0xdc00) && (code <= 0xdfff)) {
+			code = 0xfffd;
 		}
+		if (code < 0x80) {
+			out[0] = (char)code;
+			return 1;
+		} else if (code < 0x800) {
+			out[0] = (char)(0xc0 | (code >> 6));
+			out[1] = (char)(0x80 | (code & 0x3f));
+			return 2;
+		} else if (code < 0x10000) {
+			out[0] = (char)(0xe0 | (code >> 12));
+			out[1] = (char)(0x80 | ((code >> 6) & 0x3f));
+			out[2] = (char)(0x80 | (code & 0x3f));
+			return 3;
+		}
+		out[0] = (char)(0xf0 | (code >> 18));
+		out[1] = (char)(0x80 | ((code >> 12) & 0x3f));
+		out[2] = (char)(0x80 | ((code >> 6) & 0x3f));
+		out[3] = (char)(0x80 | (code & 0x3f));
+		return 4;
+	default:
+		return -1;
+	}
+}
 
-		case jxs_type_object: {
-			json_object *tmpjso = NULL;
-			tmpjso = *((json_object **)vptr);
-			if (tmpjso == NULL) {
-				is_empty = true;
+/**
+ * @brief Parse the json string at the current position and decode it into
+ * 'dst' directly. Like snprintf(), at most 'size - 1' bytes are written and
+ * 'dst' is always terminated.
+ * @param  dst   output buffer, NULL to skip the string.
+ * @param  size  size of 'dst'.
+ * @return 0 for success, -1 for error.
+ */
+static int rd_string(jxs_reader *rd, char *dst, size_t size)
+{
+	size_t n     = 0;
+	size_t cap   = ((dst != NULL) && (size > 0)) ? size - 1 : 0;
+	int    quote = rd_peek(rd);
+	rd->cut = false;
+	/* json-c accepts single quoted strings too */
+	if ((quote != '"') && (quote != '\'')) {
+		rd_error(rd, "string expected");
+		return -1;
+	}
+	rd->cur++;
+	while (rd->cur < rd->end) {
+		const char *p = rd->cur;
+		/* copy the plain characters in one go */
+		p += str_plain_span(p, (size_t)(rd->end - p), (char)quote);
+		if ((n < cap) && (p > rd->cur)) {
+			size_t run = (size_t)(p - rd->cur);
+			size_t fit = utf8_fit(rd->cur, run, cap - n);
+			memcpy(dst + n, rd->cur, fit);
+			n += fit;
+			if (fit < run) {
+				/* truncated, nothing after the cut fits any more */
+				cap     = n;
+				rd->cut = true;
 			}
-			break;
+		} else if ((dst != NULL) && (p > rd->cur)) {
+			rd->cut = true;
 		}
-
-		case jxs_type_struct:
-		case jxs_type_array:
-		default:
+		rd->cur = p;
+		if (p >= rd->end) {
 			break;
 		}
-		/* If the data is not empty, don't modify anything */
-		if (!is_empty) {
-			// jxs_log(JXS_LOG_TRACE, "%s: keep raw.\n", locator);
-			return RULE_ITEM_KEEP;
+		rd->cur++;
+		if (*p == quote) {
+			if (dst && (size > 0)) {
+				dst[n] = '\0';
+			}
+			return 0;
+		} else {
+			char esc[4];
+			int  len = rd_escape(rd, esc);
+			if (len < 0) {
+				rd_error(rd, "invalid escape in string");
+				return -1;
+			}
+			if ((len == 1) && (esc[0] == '\0')) {
+				/* the C string ends at '\u0000' */
+				cap = n;
+			} else if (n + (size_t)len <= cap) {
+				memcpy(dst + n, esc, (size_t)len);
+				n += (size_t)len;
+			} else {
+				/* drop the rest of the string */
+				cap     = n;
+				rd->cut = (dst != NULL);
+			}
 		}
 	}
-	if (rule == JXS_RULE_DROP_SELF) {
-		// jxs_log(JXS_LOG_TRACE, "%s: delete it.\n", locator);
-		return RULE_ITEM_DELETE;
-	} else if (rule == JXS_RULE_SET_NULL) {
-		*jso = NULL;
-		// jxs_log(JXS_LOG_TRACE, "%s: set null.\n", locator);
-		return RULE_ITEM_SET;
-	}
-	// jxs_log(JXS_LOG_TRACE, "%s: keep raw.\n", locator);
-	return RULE_ITEM_KEEP;
+	rd_error(rd, "unterminated string");
+	return -1;
 }
 
-static int jmap_to_json_warpper(jmap_context_t *ctx, jmap_head_t *jmhead,
-                                jmap_item_t *jmitem, size_t idx,
-                                json_object **jso, const char *locator)
-{
+/**
+ * @brief Parse an object key and the following ':'. A key without escapes
+ * points into the input directly, otherwise it is decoded into 'rd->keybuf'.
+ * @return 0 for success, -1 for error.
+ */
+static int rd_key(jxs_reader *rd, const char **key, size_t *len)
+{
+	const char *p     = NULL;
+	int         quote = rd_peek(rd);
+	if ((quote != '"') && (quote != '\'')) {
+		rd_error(rd, "object key expected");
+		return -1;
+	}
+	p = rd->cur + 1;
+	p += str_plain_span(p, (size_t)(rd->end - p), (char)quote);
+	if ((p < rd->end) && (*p == quote)) {
+		*key    = rd->cur + 1;
+		*len    = (size_t)(p - rd->cur - 1);
+		rd->cur = p + 1;
+	} else {
+		if (rd_string(rd, rd->keybuf, sizeof(rd->keybuf)) != 0) {
+			return -1;
+		}
+		*key = rd->keybuf;
+		*len = strlen(rd->keybuf);
+	}
+	if (!rd_accept(rd, ':')) {
+		rd_error(rd, "':' expected after object key");
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Parse a json number(or the NaN/Infinity json-c accepts).
+ * Integers saturate at the int64/uint64 range like json-c does. The digits are
+ * kept in 'sig' and 'exp10', so the value can also be rounded to a float.
+ * @param  convert  false to only scan the number text, when it is skipped.
+ * @return 0 for success, -1 for error.
+ */
+static int rd_number(jxs_reader *rd, jxs_rvalue *val, bool convert)
+{
+	const char *p      = rd->cur;
+	bool        neg    = false;
+	bool        isint  = true;
+	uint64_t    mag    = 0;
+	bool        over   = false;
+	const char *digits = NULL;
+	val->sig   = 0;
+	val->exp10 = 0;
+	val->exact = true;
+	if ((p < rd->end) && (*p == '-')) {
+		neg = true;
+		p++;
+	}
+	if ((p < rd->end) && ((*p == 'I') || (*p == 'N'))) {
+		rd->cur = p;
+		if (rd_literal(rd, "Infinity", 8)) {
+			val->d = neg ? -HUGE_VAL : HUGE_VAL;
+		} else if (!neg && rd_literal(rd, "NaN", 3)) {
+			val->d = NAN;
+		} else {
+			rd_error(rd, "invalid number");
+			return -1;
+		}
+		val->type   = json_type_double;
+		val->raw    = p - (neg ? 1 : 0);
+		val->rawlen = (size_t)(rd->cur - val->raw);
+		val->exact  = false;
+		return 0;
+	}
+	digits = p;
+	while ((p < rd->end) && (*p >= '0') && (*p <= '9')) {
+		unsigned d = (unsigned)(*p - '0');
+		if (mag > (UINT64_MAX - d) / 10) {
+			over = true;
+		} else {
+			mag = mag * 10 + d;
+		}
+		num_sig_digit(val, d, false);
+		p++;
+	}
+	if (p == digits) {
+		rd_error(rd, "invalid number");
+		return -1;
+	}
+	if ((p < rd->end) && (*p == '.')) {
+		isint = false;
+		for (p++; (p < rd->end) && (*p >= '0') && (*p <= '9'); p++) {
+			num_sig_digit(val, (unsigned)(*p - '0'), true);
+		}
+	}
+	if ((p < rd->end) && ((*p == 'e') || (*p == 'E'))) {
+		bool eneg = false;
+		int  e    = 0;
+		isint = false;
+		p++;
+		if ((p < rd->end) && ((*p == '+') || (*p == '-'))) {
+			eneg = (*p == '-');
+			p++;
+		}
+		for (; (p < rd->end) && (*p >= '0') && (*p <= '9'); p++) {
+			/* far out of the double range already */
+			if (e < 100000) {
+				e = e * 10 + (*p - '0');
+			}
+		}
+		val->exp10 += eneg ? -e : e;
+	}
+	val->raw    = rd->cur;
+	val->rawlen = (size_t)(p - rd->cur);
+	if (isint) {
+		val->type = json_type_int;
+		if (neg) {
+			val->i = (over || (mag > (uint64_t)INT64_MAX + 1)) ? INT64_MIN : (int64_t)(0 - mag);
+			val->u = 0;
+		} else {
+			val->i = (over || (mag > (uint64_t)INT64_MAX)) ? INT64_MAX : (int64_t)mag;
+			val->u = over ? UINT64_MAX : mag;
+		}
+	} else {
+		val->type = json_type_double;
+	}
+	if (!convert) {
+		val->d = 0;
+	} else if (isint && !over) {
+		val->d = (double)mag;
+	} else if ((!val->exact || !num_fast_double(val->sig, val->exp10, &val->d)) &&
+	           (num_parse_slow(val->raw + neg, val->rawlen - neg, false, &val->d) != 0)) {
+		rd_error(rd, "number out of memory");
+		return -1;
+	}
+	if (neg) {
+		val->d = -val->d;
+	}
+	rd->cur = p;
+	return 0;
+}
+
+/**
+ * @brief Skip the next json value without building anything, the value is
+ * still checked for syntax errors.
+ * @return 0 for success, -1 for error.
+ */
+static int rd_skip_value(jxs_reader *rd)
+{
+	jxs_rvalue val;
+	int        c = rd_peek(rd);
+	switch (c) {
+	case '{':
+	case '[': {
+		char close = (c == '{') ? '}' : ']';
+		if (++rd->depth > JXS_JSON_MAX_DEPTH) {
+			rd_error(rd, "nesting too deep");
+			return -1;
+		}
+		rd->cur++;
+		if (!rd_accept(rd, close)) {
+			do {
+				/* json-c accepts a trailing comma */
+				if (rd_peek(rd) == (unsigned char)close) {
+					break;
+				}
+				if (c == '{') {
+					const char *key = NULL;
+					size_t      len = 0;
+					if (rd_key(rd, &key, &len) != 0) {
+						return -1;
+					}
+				}
+				if (rd_skip_value(rd) != 0) {
+					return -1;
+				}
+			} while (rd_accept(rd, ','));
+			if (!rd_accept(rd, close)) {
+				rd_error(rd, (c == '{') ? "'}' expected" : "']' expected");
+				return -1;
+			}
+		}
+		rd->depth--;
+		return 0;
+	}
+
+	case '"':
+	case '\'':
+		return rd_string(rd, NULL, 0);
+
+	case 't':
+		if (rd_literal(rd, "true", 4)) {
+			return 0;
+		}
+		break;
+
+	case 'f':
+		if (rd_literal(rd, "false", 5)) {
+			return 0;
+		}
+		break;
+
+	case 'n':
+		if (rd_literal(rd, "null", 4)) {
+			return 0;
+		}
+		return rd_number(rd, &val, false);
+
+	default:
+		if ((c == '-') || (c == 'I') || (c == 'N') || ((c >= '0') && (c <= '9'))) {
+			return rd_number(rd, &val, false);
+		}
+		break;
+	}
+	rd_error(rd, "unexpected character");
+	return -1;
+}
+
+/**
+ * @brief Read the next value as a scalar, objects and arrays are skipped and
+ * only their type is recorded. A string is decoded into 'val->sbuf'.
+ * @return 0 for success, -1 for error.
+ */
+static int rd_scalar(jxs_reader *rd, jxs_rvalue *val)
+{
+	int c = rd_peek(rd);
+	val->type = json_type_null;
+	switch (c) {
+	case '{':
+	case '[':
+		val->type = (c == '{') ? json_type_object : json_type_array;
+		return rd_skip_value(rd);
+
+	case '"':
+	case '\'':
+		val->type = json_type_string;
+		return rd_string(rd, val->sbuf, sizeof(val->sbuf));
+
+	case 't':
+	case 'f':
+		val->type = json_type_boolean;
+		val->b    = (c == 't');
+		if (rd_literal(rd, val->b ? "true" : "false", val->b ? 4 : 5)) {
+			return 0;
+		}
+		break;
+
+	case 'n':
+		if (rd_literal(rd, "null", 4)) {
+			return 0;
+		}
+		return rd_number(rd, val, true);
+
+	default:
+		if ((c == '-') || (c == 'I') || (c == 'N') || ((c >= '0') && (c <= '9'))) {
+			return rd_number(rd, val, true);
+		}
+		break;
+	}
+	rd_error(rd, "unexpected character");
+	return -1;
+}
+
+/* The getters below follow json_object_get_xxx() of json-c */
+static bool rval_get_boolean(const jxs_rvalue *val)
+{
+	switch (val->type) {
+	case json_type_boolean: return val->b;
+	case json_type_int:     return val->d != 0;
+	case json_type_double:  return val->d != 0;
+	case json_type_string:  return val->sbuf[0] != '\0';
+	default:                return false;
+	}
+}
+
+static int64_t rval_get_int64(const jxs_rvalue *val)
+{
+	switch (val->type) {
+	case json_type_boolean:
+		return val->b;
+	case json_type_int:
+		return val->i;
+	case json_type_double:
+		if (val->d >= (double)INT64_MAX) {
+			return INT64_MAX;
+		} else if (val->d <= (double)INT64_MIN) {
+			return INT64_MIN;
+		}
+		return (int64_t)val->d;
+	case json_type_string: {
+		char   *end = NULL;
+		int64_t num = 0;
+		errno = 0;
+		num   = strtoll(val->sbuf, &end, 10);
+		if ((end == val->sbuf) || ((num == 0) && (errno != 0))) {
+			return 0;
+		}
+		return num;
+	}
+	default:
+		return 0;
+	}
+}
+
+/**
+ * @brief The value for an unsigned member, 'neg' is set for a negative value.
+ */
+static uint64_t rval_get_uint64(const jxs_rvalue *val, bool *neg)
+{
+	*neg = false;
+	switch (val->type) {
+	case json_type_int:
+		*neg = (val->i < 0);
+		return val->u;
+	case json_type_double:
+		if (isnan(val->d)) {
+			return 0;
+		} else if (val->d < 0) {
+			*neg = (val->d <= -1);
+			return 0;
+		} else if (val->d >= 18446744073709551616.0) {
+			return UINT64_MAX;
+		}
+		return (uint64_t)val->d;
+	default: {
+		int64_t num = rval_get_int64(val);
+		*neg = (num < 0);
+		return (num < 0) ? 0 : (uint64_t)num;
+	}
+	}
+}
+
+static double rval_get_double(const jxs_rvalue *val)
+{
+	switch (val->type) {
+	case json_type_boolean:
+		return val->b;
+	case json_type_int:
+	case json_type_double:
+		return val->d;
+	case json_type_string: {
+		char  *end = NULL;
+		double num = 0;
+		errno = 0;
+		num   = strtod(val->sbuf, &end);
+		if ((end == val->sbuf) || (*end != '\0')) {
+			return 0;
+		}
+		if (((num == HUGE_VAL) || (num == -HUGE_VAL)) && (errno == ERANGE)) {
+			return 0;
+		}
+		return num;
+	}
+	default:
+		return 0;
+	}
+}
+
+/**
+ * @brief The value for a float member, rounded once from the digits.
+ */
+static float rval_get_float(const jxs_rvalue *val)
+{
+	float  num  = 0;
+	double slow = 0;
+	if ((val->type != json_type_int) && (val->type != json_type_double)) {
+		return (float)rval_get_double(val);
+	}
+	if (!isfinite(val->d)) {
+		return (float)val->d;
+	}
+	if (val->exact && num_fast_float(val->sig, val->exp10, &num)) {
+		return signbit(val->d) ? -num : num;
+	}
+	/* out of memory, round the double instead */
+	if (num_parse_slow(val->raw, val->rawlen, true, &slow) != 0) {
+		return (float)val->d;
+	}
+	return (float)slow;
+}
+
+/**
+ * @brief Build a json_object from the next value, for the members that keep
+ * json-c objects. The value text is copied, as json-c needs a C string.
+ * @return 0 for success, -1 for error.
+ */
+static int rd_value_to_jso(jxs_reader *rd, json_object **jso)
+{
+	const char *start = NULL;
+	char       *text  = NULL;
+	size_t      len   = 0;
+	rd_skip_ws(rd);
+	start = rd->cur;
+	if (rd_skip_value(rd) != 0) {
+		return -1;
+	}
+	len  = (size_t)(rd->cur - start);
+	text = (char *)jxs_malloc(len + 1);
+	if (text == NULL) {
+		jxs_log(JXS_LOG_ERROR, "malloc %" FMT_SIZE_T " bytes failed.\n", len + 1);
+		return -1;
+	}
+	memcpy(text, start, len);
+	text[len] = '\0';
+	*jso      = json_tokener_parse(text);
+	jxs_free(text);
+	return 0;
+}
+
+/**
+ * @brief Read the next non-string value as the text json-c gives by
+ * json_object_get_string().
+ * @return 0 for success, -1 for error.
+ */
+static int rd_value_to_string(jxs_reader *rd, char *dst, size_t size)
+{
+	jxs_rvalue val;
+	int        len = 0;
+	int        c   = rd_peek(rd);
+	if ((c == '{') || (c == '[')) {
+		json_object *jso = NULL;
+		if (rd_value_to_jso(rd, &jso) != 0) {
+			return -1;
+		}
+		if (jso) {
+			const char *str = json_object_get_string(jso);
+			rd->cut = str_copy_fit(dst, size, str, strlen(str));
+		} else if (size > 0) {
+			dst[0] = '\0';
+		}
+		json_object_put(jso);
+		return 0;
+	}
+	if (rd_scalar(rd, &val) != 0) {
+		return -1;
+	}
+	if (val.type == json_type_boolean) {
+		len = snprintf(dst, size, "%s", val.b ? "true" : "false");
+	} else if ((val.type == json_type_int) && (val.i < 0)) {
+		len = snprintf(dst, size, "%" PRId64, val.i);
+	} else if (val.type == json_type_int) {
+		len = snprintf(dst, size, "%" PRIu64, val.u);
+	} else {
+		/* json-c keeps the original text of a double */
+		len = snprintf(dst, size, "%.*s", (int)val.rawlen, val.raw);
+	}
+	rd->cut = (len > 0) && ((size_t)len >= size);
+	return 0;
+}
+
+/**
+ * @brief Read the whole stream into the buffer, for the files that can't be
+ * mapped(pipes, devices, or no mmap on the platform).
+ * @return 0 for success, -1 for error.
+ */
+static int jxs_file_load(FILE *fp, const char *filename, jxs_wbuf *wbuf)
+{
+	int ret = 0;
+	while (wbuf_reserve(wbuf, RBUF_CHUNK_SIZE) == 0) {
+		size_t n = fread(wbuf->data + wbuf->len, 1, RBUF_CHUNK_SIZE, fp);
+		wbuf->len += n;
+		if (n < RBUF_CHUNK_SIZE) {
+			break;
+		}
+	}
+	if (wbuf->err || ferror(fp)) {
+		jxs_log(JXS_LOG_ERROR, "read file [%s] error.\n", filename);
+		ret = -1;
+	}
+	wbuf_finish(wbuf);
+	return ret;
+}
+
+#ifdef JXS_HAVE_POSIX
+/**
+ * @brief Map a regular file read-only, so it is parsed in place.
+ * @return the mapping, NULL if it's not a regular file or can't be mapped.
+ */
+static void *jxs_file_map(int fd, size_t *len)
+{
+	struct stat st;
+	void       *base = NULL;
+	if ((fstat(fd, &st) != 0) || !S_ISREG(st.st_mode) || (st.st_size <= 0) ||
+	    ((uintmax_t)st.st_size > SIZE_MAX)) {
+		return NULL;
+	}
+	base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (base == MAP_FAILED) {
+		return NULL;
+	}
+	madvise(base, (size_t)st.st_size, MADV_SEQUENTIAL);
+	*len = (size_t)st.st_size;
+	return base;
+}
+#endif
+
+/**
+ * @brief Enter the level 'depth' of the locator, the object member 'key' or the
+ * array element 'idx'(key is NULL). Only the level is recorded, the locator
+ * text is formatted later if someone asks for it.
+ */
+static inline void jmap_path_enter(jmap_context_t *ctx, size_t depth,
+                                   const char *key, size_t idx)
+{
+	if (depth < JXS_PATH_DEPTH) {
+		ctx->path.frame[depth].key = key;
+		ctx->path.frame[depth].idx = idx;
+	}
+	if (ctx->path.built > depth) {
+		ctx->path.built = depth;
+	}
+	ctx->path.depth = depth + 1;
+}
+
+/* go back to the level 'depth' of the locator */
+static inline void jmap_path_leave(jmap_context_t *ctx, size_t depth)
+{
+	if (ctx->path.built > depth) {
+		ctx->path.built = depth;
+	}
+	ctx->path.depth = depth;
+}
+
+static void jmap_path_append(char *buf, size_t *end, const char *str, size_t len)
+{
+	size_t room = JXS_KEY_MAXLEN - 1 - *end;
+	len = (len < room) ? len : room;
+	memcpy(buf + *end, str, len);
+	*end += len;
+}
+
+/* format 'idx' in decimal, return the start of the digits in 'buf' */
+static char *jmap_path_utoa(char buf[24], size_t idx)
+{
+	char *p = buf + 23;
+	*p = '\0';
+	do {
+		*--p = (char)('0' + idx % 10);
+		idx /= 10;
+	} while (idx != 0);
+	return p;
+}
+
+/**
+ * @brief Format the locator and the fuzzy locator. The levels formatted before
+ * are kept, only the changed levels are appended.
+ */
+static void jmap_path_build(jmap_context_t *ctx)
+{
+	size_t i     = ctx->path.built;
+	size_t depth = (ctx->path.depth < JXS_PATH_DEPTH) ? ctx->path.depth : JXS_PATH_DEPTH;
+	size_t end   = (i > 0) ? ctx->path.frame[i - 1].end : 0;
+	size_t fzend = (i > 0) ? ctx->path.frame[i - 1].fzend : 0;
+	for (; i < depth; i++) {
+		jmap_frame *frame = &ctx->path.frame[i];
+		if (frame->key) {
+			size_t len = strlen(frame->key);
+			if (i > 0) {
+				jmap_path_append(ctx->path.locator, &end, ".", 1);
+				jmap_path_append(ctx->path.fzlocator, &fzend, ".", 1);
+			}
+			jmap_path_append(ctx->path.locator, &end, frame->key, len);
+			jmap_path_append(ctx->path.fzlocator, &fzend, frame->key, len);
+		} else {
+			char  num[24];
+			char *digits = jmap_path_utoa(num, frame->idx);
+			jmap_path_append(ctx->path.locator, &end, "[", 1);
+			jmap_path_append(ctx->path.locator, &end, digits, (size_t)(num + 23 - digits));
+			jmap_path_append(ctx->path.locator, &end, "]", 1);
+			jmap_path_append(ctx->path.fzlocator, &fzend, "[x]", 3);
+		}
+		frame->end   = end;
+		frame->fzend = fzend;
+	}
+	ctx->path.built            = depth;
+	ctx->path.locator[end]     = '\0';
+	ctx->path.fzlocator[fzend] = '\0';
+}
+
+/* locator of the current item, like "tb[1].icon" */
+static const char *jmap_locator(jmap_context_t *ctx)
+{
+	jmap_path_build(ctx);
+	return ctx->path.locator;
+}
+
+/* fuzzy locator of the current item, like "tb[x].icon" */
+static const char *jmap_fzlocator(jmap_context_t *ctx)
+{
+	jmap_path_build(ctx);
+	return ctx->path.fzlocator;
+}
+
+/**
+ * @brief Compare the current locator(or fuzzy locator) with 'str' level by
+ * level, without formatting it.
+ */
+static bool jmap_path_match(jmap_context_t *ctx, const char *str, bool fuzzy)
+{
+	size_t i = 0;
+	if (ctx->path.depth > JXS_PATH_DEPTH) {
+		return strcmp(fuzzy ? jmap_fzlocator(ctx) : jmap_locator(ctx), str) == 0;
+	}
+	for (i = 0; i < ctx->path.depth; i++) {
+		jmap_frame *frame = &ctx->path.frame[i];
+		if (frame->key) {
+			size_t len = strlen(frame->key);
+			if ((i > 0) && (*str++ != '.')) {
+				return false;
+			}
+			if (strncmp(str, frame->key, len) != 0) {
+				return false;
+			}
+			str += len;
+		} else if (fuzzy) {
+			if (strncmp(str, "[x]", 3) != 0) {
+				return false;
+			}
+			str += 3;
+		} else {
+			char   num[24];
+			char  *digits = jmap_path_utoa(num, frame->idx);
+			size_t len    = (size_t)(num + 23 - digits);
+			if ((str[0] != '[') || (strncmp(str + 1, digits, len) != 0) || (str[len + 1] != ']')) {
+				return false;
+			}
+			str += len + 2;
+		}
+	}
+	return *str == '\0';
+}
+
+/**
+ * @brief [Multidimensional Arrays] Set the jmap of the next dimension of the
+ * array, Until the last dimension of the array is traversed.
+ * @param  new_jmitem new jmap item for the next dimension of array.
+ * @param  jmitem     parent jmap item.
+ * @param  idx        index of the array.
+ */
+static void jmap_array_move_next_dimen(jmap_item_t *new_jmitem,
+                                       jmap_item_t *jmitem, size_t idx)
+{
+	memset(new_jmitem, 0, sizeof(jmap_item_t));
+	if ((jmitem->arr.cur_depth >= jmitem->arr.depth) ||
+	    (jmitem->arr.deptab[0] == 0)) {
+		jxs_log(JXS_LOG_FATAL, "array depth error.\n");
+		return;
+	}
+	new_jmitem->key      = jmitem->key;
+	new_jmitem->subjm    = jmitem->subjm;
+	new_jmitem->basetype = jmitem->basetype;
+	/* calculate the starting address of the current array */
+	new_jmitem->offset = jmitem->offset + (ptrdiff_t)(jmitem->size * idx);
+	/* If it is the last dimension, set the current arr_depth type
+	 * as the base type, otherwise it is array type */
+	new_jmitem->type = ((jmitem->arr.depth - jmitem->arr.cur_depth) == 1) ?
+	                   jmitem->basetype : jxs_type_array;
+	new_jmitem->size          = jmitem->size / jmitem->arr.deptab[0];
+	new_jmitem->arr.length    = jmitem->arr.deptab[0];
+	new_jmitem->arr.depth     = jmitem->arr.depth;
+	new_jmitem->arr.cur_depth = jmitem->arr.cur_depth + 1;
+	/* Shift 'array record table' to the left */
+	memcpy(new_jmitem->arr.deptab, &(jmitem->arr.deptab[1]),
+	       sizeof(jmitem->arr.deptab) - sizeof(jmitem->arr.deptab[0]));
+	new_jmitem->rule = jmitem->rule;
+}
+
+/**
+ * @brief Dimensions of an array, from the dimension being walked to the last.
+ * @param  jmitem  jmap of the array, as set by jmap_array_move_next_dimen().
+ * @param  dims    dimensions output.
+ * @param  width   element size output.
+ * @return number of dimensions.
+ */
+static size_t jmap_array_dims(jmap_item_t *jmitem, size_t dims[JXS_ARRAY_DEPTH], size_t *width)
+{
+	size_t i     = 0;
+	size_t ndims = 1 + (jmitem->arr.depth - jmitem->arr.cur_depth);
+	*width  = jmitem->size;
+	dims[0] = jmitem->arr.length;
+	for (i = 1; i < ndims; i++) {
+		dims[i]  = jmitem->arr.deptab[i - 1];
+		*width  /= dims[i];
+	}
+	return ndims;
+}
+
+/**
+ * @brief Check if the array is a rectangular block of numbers(or booleans) of a
+ * known width, it is walked flat then: one call per dimension with precomputed
+ * strides, no jmap per element. The rules and the convert callback are checked
+ * per element, so an array written with any is walked per element.
+ * @param  write   the array is written.
+ * @param  dims    dimensions output, see @ref jmap_array_dims().
+ * @param  stride  output, bytes of one element of every dimension.
+ * @return number of dimensions, 0 if the array must be walked per element.
+ */
+static size_t jmap_array_flat(jmap_context_t *ctx, jmap_item_t *jmitem, bool write,
+                              size_t dims[JXS_ARRAY_DEPTH], size_t stride[JXS_ARRAY_DEPTH])
+{
+	size_t i     = 0;
+	size_t width = 0;
+	size_t ndims = jmap_array_dims(jmitem, dims, &width);
+	bool   known = false;
+	switch (jmitem->basetype) {
+	case jxs_type_boolean:
+		known = TYPEOF(width, int) || TYPEOF(width, bool);
+		break;
+	case jxs_type_double:
+		known = TYPEOF(width, double) || TYPEOF(width, float);
+		break;
+	case jxs_type_int:
+	case jxs_type_uint:
+		known = (width == 1) || (width == 2) || (width == 4) || (width == 8);
+		break;
+	default:
+		break;
+	}
+	if (!known || (write && ((ctx->convert.callback != NULL) || (jmitem->rule != JXS_RULE_KEEP_RAW)))) {
+		return 0;
+	}
+	stride[ndims - 1] = width;
+	for (i = ndims - 1; i > 0; i--) {
+		stride[i - 1] = stride[i] * dims[i];
+	}
+	return ndims;
+}
+
+/**
+ * @brief mapper print warpper
+ *
+ * @param  base      start address of the struct that owns the item.
+ * @param  jmitem    jmap item.
+ * @param  idx       array index.
+ */
+static void jmap_print_warpper(jmap_context_t *ctx, uint8_t *base,
+                               jmap_item_t *jmitem, size_t idx)
+{
+	void       *vptr    = base + jmitem->offset;
+	jxs_type    type    = jmitem->type;
+	size_t      size    = jmitem->size;
+	ptrdiff_t   offset  = 0;
+	const char *locator = jmap_locator(ctx);
+	if (vptr == NULL) {
+		jxs_log(JXS_LOG_ERROR, "%s: jmap struct addr is null.\n", locator);
+		return;
+	}
+	vptr   = (uint8_t *)vptr + size * idx;
+	offset = (ptrdiff_t)vptr - (ptrdiff_t)ctx->start_addr;
+	switch (type) {
+	case jxs_type_null:
+		/* nothing to do */
+		PRINT_JMITEM(jmitem, "NULL");
+		break;
+
+	case jxs_type_boolean:
+		if (TYPEOF(size, int)) {
+			PRINT_JMITEM(jmitem, "%d", *((int *)vptr));
+		} else if (TYPEOF(size, bool)) {
+			PRINT_JMITEM(jmitem, "%d", *((bool *)vptr));
+		}
+		break;
+
+	case jxs_type_double:
+		if (TYPEOF(size, double)) {
+			PRINT_JMITEM(jmitem, "%lf", *((double *)vptr));
+		} else if (TYPEOF(size, float)) {
+			PRINT_JMITEM(jmitem, "%f", *((float *)vptr));
+		}
+		break;
+
+	case jxs_type_int:
+		if (TYPEOF(size, int64_t)) {
+			PRINT_JMITEM(jmitem, "%" PRId64 "", *((int64_t *)vptr));
+		} else if (TYPEOF(size, int32_t)) {
+			PRINT_JMITEM(jmitem, "%" PRId32 "", *((int32_t *)vptr));
+		} else if (TYPEOF(size, int16_t)) {
+			PRINT_JMITEM(jmitem, "%" PRId16 "", *((int16_t *)vptr));
+		} else if (TYPEOF(size, int8_t)) {
+			PRINT_JMITEM(jmitem, "%" PRId8 "", *((int8_t *)vptr));
+		}
+		break;
+
+	case jxs_type_uint:
+		if (TYPEOF(size, uint64_t)) {
+			PRINT_JMITEM(jmitem, "%" PRIu64 "", *((uint64_t *)vptr));
+		} else if (TYPEOF(size, uint32_t)) {
+			PRINT_JMITEM(jmitem, "%" PRIu32 "", *((uint32_t *)vptr));
+		} else if (TYPEOF(size, uint16_t)) {
+			PRINT_JMITEM(jmitem, "%" PRIu16 "", *((uint16_t *)vptr));
+		} else if (TYPEOF(size, uint8_t)) {
+			PRINT_JMITEM(jmitem, "%" PRIu8 "", *((uint8_t *)vptr));
+		}
+		break;
+
+	case jxs_type_string:
+		PRINT_JMITEM(jmitem, "%s", *((char(*)[])vptr));
+		break;
+
+	case jxs_type_object: {
+		json_object *jso = NULL;
+		jso = *(json_object **)vptr;
+		if (jso) {
+			PRINT_JMITEM(jmitem, "%s", json_object_to_json_string(jso));
+		} else {
+			PRINT_JMITEM(jmitem, "NULL");
+		}
+		break;
+	}
+
+	case jxs_type_struct:
+		PRINT_JMITEM(jmitem, "[JMAP:%p][OFFSET:%8" FMT_PTRDIFF_T "]", jmitem->subjm, offset);
+		jmap_struct_print(ctx, jmitem->subjm, (uint8_t *)vptr);
+		break;
+
+	case jxs_type_array: {
+		jmap_item_t new_jmitem;
+		jmap_array_move_next_dimen(&new_jmitem, jmitem, idx);
+		PRINT_JMITEM(&new_jmitem, "[depth(%" FMT_SIZE_T "), type(%s), "
+		             "form(%" FMT_SIZE_T "x%" FMT_SIZE_T ")]",
+		             new_jmitem.arr.depth - new_jmitem.arr.cur_depth + 1,
+		             type_to_name(new_jmitem.type),
+		             new_jmitem.arr.length, new_jmitem.size);
+		jmap_array_print(ctx, base, &new_jmitem);
+		break;
+	}
+
+	default:
+		jxs_log(JXS_LOG_ERROR, "%s<error type>\n", jmitem->key);
+		break;
+	}
+}
+
+/**
+ * @brief array type print
+ *
+ * @param  base      start address of the struct that owns the array.
+ * @param  jmitem    jmap item.
+ */
+static void jmap_array_print(jmap_context_t *ctx, uint8_t *base, jmap_item_t *jmitem)
+{
+	size_t i     = 0;
+	size_t depth = ctx->path.depth;
+	for (i = 0; i < jmitem->arr.length; i++) {
+		jmap_path_enter(ctx, depth, NULL, i);
+		jmap_print_warpper(ctx, base, jmitem, i);
+	}
+	jmap_path_leave(ctx, depth);
+}
+
+/**
+ * @brief Clamp an integer into [min, max] of the member type, with a warning
+ * instead of letting the cast wrap it.
+ */
+static int64_t jmap_clamp_int(jmap_context_t *ctx, int64_t num, int64_t min, int64_t max)
+{
+	if ((num < min) || (num > max)) {
+		jxs_log(JXS_LOG_WARN, "%s: %" PRId64 " is out of range [%" PRId64 ", %" PRId64 "], clamped.\n",
+		        jmap_locator(ctx), num, min, max);
+		return (num < min) ? min : max;
+	}
+	return num;
+}
+
+static uint64_t jmap_clamp_uint(jmap_context_t *ctx, uint64_t num, bool neg, uint64_t max)
+{
+	if (neg) {
+		jxs_log(JXS_LOG_WARN, "%s: negative value for an unsigned member, clamped to 0.\n",
+		        jmap_locator(ctx));
+		return 0;
+	} else if (num > max) {
+		jxs_log(JXS_LOG_WARN, "%s: %" PRIu64 " is out of range [0, %" PRIu64 "], clamped.\n",
+		        jmap_locator(ctx), num, max);
+		return max;
+	}
+	return num;
+}
+
+/**
+ * @brief Store an integer into an int8/int16/int32/int64 member.
+ * @return 0 for success, -1 for error.
+ */
+static int jmap_store_int(jmap_context_t *ctx, void *vptr, size_t size, int64_t num)
+{
+	if (TYPEOF(size, int64_t)) {
+		*((int64_t *)vptr) = num;
+	} else if (TYPEOF(size, int32_t)) {
+		*((int32_t *)vptr) = (int32_t)jmap_clamp_int(ctx, num, INT32_MIN, INT32_MAX);
+	} else if (TYPEOF(size, int16_t)) {
+		*((int16_t *)vptr) = (int16_t)jmap_clamp_int(ctx, num, INT16_MIN, INT16_MAX);
+	} else if (TYPEOF(size, int8_t)) {
+		*((int8_t *)vptr) = (int8_t)jmap_clamp_int(ctx, num, INT8_MIN, INT8_MAX);
+	} else {
+		jxs_log(JXS_LOG_ERROR, "%s: required type '%s' <sizeof> does not match.\n",
+		        jmap_locator(ctx), type_to_name(jxs_type_int));
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Store an unsigned integer into an uint8/uint16/uint32/uint64 member,
+ * 'neg' is set if the json value was negative.
+ * @return 0 for success, -1 for error.
+ */
+static int jmap_store_uint(jmap_context_t *ctx, void *vptr, size_t size, uint64_t num, bool neg)
+{
+	if (TYPEOF(size, uint64_t)) {
+		*((uint64_t *)vptr) = jmap_clamp_uint(ctx, num, neg, UINT64_MAX);
+	} else if (TYPEOF(size, uint32_t)) {
+		*((uint32_t *)vptr) = (uint32_t)jmap_clamp_uint(ctx, num, neg, UINT32_MAX);
+	} else if (TYPEOF(size, uint16_t)) {
+		*((uint16_t *)vptr) = (uint16_t)jmap_clamp_uint(ctx, num, neg, UINT16_MAX);
+	} else if (TYPEOF(size, uint8_t)) {
+		*((uint8_t *)vptr) = (uint8_t)jmap_clamp_uint(ctx, num, neg, UINT8_MAX);
+	} else {
+		jxs_log(JXS_LOG_ERROR, "%s: required type '%s' <sizeof> does not match.\n",
+		        jmap_locator(ctx), type_to_name(jxs_type_uint));
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief struct type print
+ *
+ * @param  mapper    mapper object.
+ * @param  base      struct start address.
+ */
+static void jmap_struct_print(jmap_context_t *ctx, jxs_mapper *mapper, uint8_t *base)
+{
+	size_t       i      = 0;
+	size_t       depth  = ctx->path.depth;
+	jmap_head_t *jmhead = NULL;
+	jmap_list_t *jmlist = NULL;
+	if (mapper == NULL) {
+		jxs_log(JXS_LOG_ERROR, "mapper null.\n");
+		return;
+	}
+	jmhead = get_jmhead(mapper);
+	jmlist = get_jmlist(mapper);
+	for (i = 0; i < jmhead->idx; i++) {
+		jmap_item_t *jmitem = &jmlist[i];
+		jmap_path_enter(ctx, depth, jmitem->key, 0);
+		jmap_print_warpper(ctx, base, jmitem, 0);
+	}
+	jmap_path_leave(ctx, depth);
+}
+
+static item_action jmap_convert_handler(jmap_context_t *ctx, jmap_item_t *jmitem, void *vptr,
+                                        json_object **jso)
+{
+	jxs_type type     = jmitem->type;
+	size_t   size     = jmitem->size;
+	uint8_t  rule     = jmitem->rule;
+	bool     is_force = false;
+	if (rule == 0) {
+		jxs_log(JXS_LOG_ERROR, "rule flag set error.\n");
+		return RULE_ITEM_ERROR;
+	}
+	ctx->now.vptr = vptr;
+	if (ctx->convert.callback) {
+		ctx->convert.callback(ctx);
+		if (ctx->convert.rule != 0) {
+			/* if complex rule is set, overriding basic rules and force to check rules */
+			rule     = ctx->convert.rule;
+			is_force = true;
+			jxs_log(JXS_LOG_TRACE, "%s: set complex rule: 0x%08x.\n", jmap_locator(ctx), rule);
+		}
+		/* reset rule flag */
+		ctx->convert.rule = 0;
+	}
+	if (rule == JXS_RULE_KEEP_RAW) {
+		// jxs_log(JXS_LOG_TRACE, "%s: keep raw.\n", jmap_locator(ctx));
+		return RULE_ITEM_KEEP;
+	}
+	/* if complex rule not set, the rule action can only take effect when the data is empty */
+	if (!is_force) {
+		bool is_empty = false;
+		switch (type) {
+		case jxs_type_null:
+			/* nothing to do */
+			break;
+
+		case jxs_type_boolean: {
+			int tmpbool = 0;
+			if (TYPEOF(size, int)) {
+				tmpbool = *((int *)vptr);
+			} else if (TYPEOF(size, bool)) {
+				tmpbool = *((bool *)vptr);
+			}
+			if (tmpbool == false) {
+				is_empty = true;
+			}
+			break;
+		}
+
+		case jxs_type_double: {
+			double tmpdouble = 0;
+			if (TYPEOF(size, double)) {
+				tmpdouble = *((double *)vptr);
+			} else if (TYPEOF(size, float)) {
+				tmpdouble = *((float *)vptr);
+			}
+			if (tmpdouble == 0) {
+				is_empty = true;
+			}
+			break;
+		}
+
+		case jxs_type_int: {
+			int64_t tmpint = 0;
+			if (TYPEOF(size, int64_t)) {
+				tmpint = *((int64_t *)vptr);
+			} else if (TYPEOF(size, int32_t)) {
+				tmpint = *((int32_t *)vptr);
+			} else if (TYPEOF(size, int16_t)) {
+				tmpint = *((int16_t *)vptr);
+			} else if (TYPEOF(size, int8_t)) {
+				tmpint = *((int8_t *)vptr);
+			}
+			if (tmpint == 0) {
+				is_empty = true;
+			}
+			break;
+		}
+
+		case jxs_type_uint: {
+			uint64_t tmpuint = 0;
+			if (TYPEOF(size, uint64_t)) {
+				tmpuint = *((uint64_t *)vptr);
+			} else if (TYPEOF(size, uint32_t)) {
+				tmpuint = *((uint32_t *)vptr);
+			} else if (TYPEOF(size, uint16_t)) {
+				tmpuint = *((uint16_t *)vptr);
+			} else if (TYPEOF(size, uint8_t)) {
+				tmpuint = *((uint8_t *)vptr);
+			}
+			if (tmpuint == 0) {
+				is_empty = true;
+			}
+			break;
+		}
+
+		case jxs_type_string: {
+			char *tmpstr = *((char(*)[])vptr);
+			if ((tmpstr == NULL) || (tmpstr[0] == '\0')) {
+				is_empty = true;
+			}
+			break;
+		}
+
+		case jxs_type_object: {
+			json_object *tmpjso = NULL;
+			tmpjso = *((json_object **)vptr);
+			if (tmpjso == NULL) {
+				is_empty = true;
+			}
+			break;
+		}
+
+		case jxs_type_struct:
+		case jxs_type_array:
+		default:
+			break;
+		}
+		/* If the data is not empty, don't modify anything */
+		if (!is_empty) {
+			// jxs_log(JXS_LOG_TRACE, "%s: keep raw.\n", jmap_locator(ctx));
+			return RULE_ITEM_KEEP;
+		}
+	}
+	if (rule == JXS_RULE_DROP_SELF) {
+		// jxs_log(JXS_LOG_TRACE, "%s: delete it.\n", jmap_locator(ctx));
+		return RULE_ITEM_DELETE;
+	} else if (rule == JXS_RULE_SET_NULL) {
+		*jso = NULL;
+		// jxs_log(JXS_LOG_TRACE, "%s: set null.\n", jmap_locator(ctx));
+		return RULE_ITEM_SET;
+	}
+	// jxs_log(JXS_LOG_TRACE, "%s: keep raw.\n", jmap_locator(ctx));
+	return RULE_ITEM_KEEP;
+}
+
+static int jmap_to_json_warpper(jmap_context_t *ctx, uint8_t *base,
+                                jmap_item_t *jmitem, size_t idx,
+                                json_object **jso)
+{
+	int ret = 0;
+	json_object *item_jso = NULL;
+	void        *vptr     = base + jmitem->offset;
+	jxs_type     type     = jmitem->type;
+	size_t       size     = jmitem->size;
+	item_action  action   = 0;
+	char         numbuf[NUM_BUFSIZE];
+	if (vptr == NULL) {
+		jxs_log(JXS_LOG_ERROR, "%s: jmap struct addr is null.\n", jmap_locator(ctx));
+		return -1;
+	}
+	vptr   = (uint8_t *)vptr + size * idx;
+	action = jmap_convert_handler(ctx, jmitem, vptr, &item_jso);
+	if (action == RULE_ITEM_ERROR) {
+		jxs_log(JXS_LOG_WARN, "Rules handling error, skip rules.\n");
+	} else if (action == RULE_ITEM_DELETE) {
+		/* delete current item */
+		ret = 1;
+		goto ok;
+	} else if (action == RULE_ITEM_SET) {
+		/* set item_jso inside, so skip the following operations and return. */
+		ret = 0;
+		goto ok;
+	}
+	switch (type) {
+	case jxs_type_null:
+		item_jso = NULL;
+		break;
+
+	case jxs_type_boolean:
+		if (TYPEOF(size, int)) {
+			item_jso = json_object_new_boolean(*((int *)vptr));
+		} else if (TYPEOF(size, bool)) {
+			item_jso = json_object_new_boolean(*((bool *)vptr));
+		} else {
+			jxs_log(JXS_LOG_ERROR, "%s: required type '%s' <sizeof> does not match.\n",
+			        jmap_locator(ctx), type_to_name(type));
+			goto end;
+		}
+		break;
+
+	case jxs_type_double:
+		/* keep the shortest digits, json-c would print '%.17g' */
+		if (TYPEOF(size, double)) {
+			double tmpdbl = *((double *)vptr);
+			numbuf[num_format_double(numbuf, tmpdbl)] = '\0';
+			item_jso = json_object_new_double_s(tmpdbl, numbuf);
+		} else if (TYPEOF(size, float)) {
+			float tmpflt = *((float *)vptr);
+			numbuf[num_format_float(numbuf, tmpflt)] = '\0';
+			item_jso = json_object_new_double_s(tmpflt, numbuf);
+		} else {
+			jxs_log(JXS_LOG_ERROR, "%s: required type '%s' <sizeof> does not match.\n",
+			        jmap_locator(ctx), type_to_name(type));
+			goto end;
+		}
+		break;
+
+	case jxs_type_int:
+		if (TYPEOF(size, int64_t)) {
+			item_jso = json_object_new_int64(*((int64_t *)vptr));
+		} else if (TYPEOF(size, int32_t)) {
+			item_jso = json_object_new_int(*((int32_t *)vptr));
+		} else if (TYPEOF(size, int16_t)) {
+			item_jso = json_object_new_int(*((int16_t *)vptr));
+		} else if (TYPEOF(size, int8_t)) {
+			item_jso = json_object_new_int(*((int8_t *)vptr));
+		} else {
+			jxs_log(JXS_LOG_ERROR, "%s: required type '%s' <sizeof> does not match.\n",
+			        jmap_locator(ctx), type_to_name(type));
+			goto end;
+		}
+		break;
+
+	case jxs_type_uint:
+		if (TYPEOF(size, uint64_t)) {
+			item_jso = json_object_new_uint64(*((uint64_t *)vptr));
+		} else if (TYPEOF(size, uint32_t)) {
+			item_jso = json_object_new_int64(*((uint32_t *)vptr));
+		} else if (TYPEOF(size, uint16_t)) {
+			item_jso = json_object_new_int(*((uint16_t *)vptr));
+		} else if (TYPEOF(size, uint8_t)) {
+			item_jso = json_object_new_int(*((uint8_t *)vptr));
+		} else {
+			jxs_log(JXS_LOG_ERROR, "%s: required type '%s' <sizeof> does not match.\n",
+			        jmap_locator(ctx), type_to_name(type));
+			goto end;
+		}
+		break;
+
+	case jxs_type_string: {
+		char *tmpstr = *((char(*)[])vptr);
+		item_jso = json_object_new_string_len(tmpstr, (int)strnlen(tmpstr, size));
+		break;
+	}
+
+	case jxs_type_object:
+		item_jso = json_object_get(*((json_object **)vptr));
+		break;
+
+	case jxs_type_struct:
+		if (jmitem->subjm == NULL) {
+			jxs_log(JXS_LOG_ERROR, "%s: Please create a mapper for your nested struct..\n", jmap_locator(ctx));
+			goto end;
+		}
+		item_jso = json_object_new_object();
+		if (item_jso == NULL) {
+			jxs_log(JXS_LOG_ERROR, "%s: new json object error.\n", jmap_locator(ctx));
+			goto end;
+		}
+		if ((ret = jmap_to_json_object(ctx, jmitem->subjm, (uint8_t *)vptr, item_jso)) == -1) {
+			jxs_log(JXS_LOG_ERROR, "%s: struct to json error.\n", jmap_locator(ctx));
+			goto end;
+		}
+		break;
+
+	case jxs_type_array: {
+		jmap_item_t new_jmitem;
+		jmap_array_move_next_dimen(&new_jmitem, jmitem, idx);
+		item_jso = json_object_new_array();
+		if (item_jso == NULL) {
+			jxs_log(JXS_LOG_ERROR, "%s: new json array object error.\n", jmap_locator(ctx));
+			goto end;
+		}
+		if ((ret = jmap_to_json_array(ctx, base, &new_jmitem, item_jso)) == -1) {
+			jxs_log(JXS_LOG_ERROR, "%s: array to json error.\n", jmap_locator(ctx));
+			goto end;
+		}
+		break;
+	}
+
+	default:
+		jxs_log(JXS_LOG_ERROR, "%s: error mapper type.\n", jmap_locator(ctx));
+		goto end;
+	}
+ok:
+	*jso = item_jso;
+	return ret;
+end:
+	if (item_jso) {
+		jxs_log(JXS_LOG_ERROR, "%s: call json_object_put to free it.\n", jmap_locator(ctx));
+		json_object_put(item_jso);
+	}
+	return ret;
+}
+
+static int jmap_from_json_warpper(jmap_context_t *ctx, uint8_t *base,
+                                  jmap_item_t *jmitem, size_t idx,
+                                  json_object *jso)
+{
+	json_object *item_jso = jso;
+	void        *vptr     = base + jmitem->offset;
+	jxs_type     type     = jmitem->type;
+	size_t       size     = jmitem->size;
+	if (vptr == NULL) {
+		jxs_log(JXS_LOG_ERROR, "%s: jmap struct addr is null.\n", jmap_locator(ctx));
+		return -1;
+	}
+	vptr = (uint8_t *)vptr + size * idx;
+	switch (type) {
+	case jxs_type_null:
+		memset(vptr, 0, size);
+		break;
+
+	case jxs_type_boolean:
+		if (TYPEOF(size, int)) {
+			*((int *)vptr) = (int)json_object_get_boolean(item_jso);
+		} else if (TYPEOF(size, bool)) {
+			*((bool *)vptr) = (bool)json_object_get_boolean(item_jso);
+		} else {
+			jxs_log(JXS_LOG_ERROR, "%s: required type '%s' <sizeof> does not match.\n",
+			        jmap_locator(ctx), type_to_name(type));
+			return -1;
+		}
+		break;
+
+	case jxs_type_double:
+		if (TYPEOF(size, double)) {
+			*((double *)vptr) = json_object_get_double(item_jso);
+		} else if (TYPEOF(size, float)) {
+			*((float *)vptr) = (float)json_object_get_double(item_jso);
+		} else {
+			jxs_log(JXS_LOG_ERROR, "%s: required type '%s' <sizeof> does not match.\n",
+			        jmap_locator(ctx), type_to_name(type));
+			return -1;
+		}
+		break;
+
+	case jxs_type_int:
+		if (jmap_store_int(ctx, vptr, size, json_object_get_int64(item_jso)) != 0) {
+			return -1;
+		}
+		break;
+
+	case jxs_type_uint: {
+		bool neg = (json_object_get_int64(item_jso) < 0);
+		if (jmap_store_uint(ctx, vptr, size, neg ? 0 : json_object_get_uint64(item_jso), neg) != 0) {
+			return -1;
+		}
+		break;
+	}
+
+	case jxs_type_string: {
+		const char *tmpstr = NULL;
+		tmpstr = json_object_get_string(item_jso);
+		if (tmpstr == NULL) {
+			memset(vptr, 0, size);
+		} else if (str_copy_fit(*((char(*)[])vptr), size, tmpstr, strlen(tmpstr))) {
+			ctx->stats.truncated++;
+		}
+		break;
+	}
+
+	case jxs_type_object:
+		*((json_object **)vptr) = json_object_get(item_jso);
+		break;
+
+	case jxs_type_struct:
+		if (jmitem->subjm == NULL) {
+			jxs_log(JXS_LOG_ERROR, "%s: Please create a mapper for your nested struct..\n", jmap_locator(ctx));
+			return -1;
+		}
+		if (item_jso == NULL) {
+			memset(vptr, 0, size);
+		} else {
+			if (jmap_from_json_object(ctx, jmitem->subjm, (uint8_t *)vptr, item_jso) != 0) {
+				jxs_log(JXS_LOG_ERROR, "%s: struct from json error.\n", jmap_locator(ctx));
+				return -1;
+			}
+		}
+		break;
+
+	case jxs_type_array:
+		if (item_jso == NULL) {
+			memset(vptr, 0, size);
+		} else {
+			int         ret   = 0;
+			bool        merge = ctx->merge;
+			jmap_item_t new_jmitem;
+			/* an array in a merge patch replaces the whole array(RFC 7386) */
+			if (merge) {
+				memset(vptr, 0, size);
+				ctx->merge = false;
+			}
+			jmap_array_move_next_dimen(&new_jmitem, jmitem, idx);
+			ret        = jmap_from_json_array(ctx, base, &new_jmitem, item_jso);
+			ctx->merge = merge;
+			if (ret != 0) {
+				jxs_log(JXS_LOG_ERROR, "%s: array from json error.\n", jmap_locator(ctx));
+				return -1;
+			}
+		}
+		break;
+
+	default:
+		jxs_log(JXS_LOG_ERROR, "%s: error mapper type.\n", jmap_locator(ctx));
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Fill json_object based on array's jmap
+ *
+ * @param[in]  base    start address of the struct that owns the array.
+ * @param[in]  jmitem  jampitem of the array.
+ * @param[out] arrjso  json_object of array.
+ * @return 0 for success, -1 for error.
+ */
+static int jmap_to_json_array(jmap_context_t *ctx, uint8_t *base,
+                              jmap_item_t *jmitem, json_object *arrjso)
+{
+	int         ret       = 0;
+	size_t      i         = 0;
+	size_t      depth     = ctx->path.depth;
+	size_t      arr_len   = jmitem->arr.length;
+	if ((jmitem->size == 0) || (arr_len == 0)) {
+		jxs_log(JXS_LOG_ERROR, "%s: array 'size', 'len' cannot not be zero.\n", jmap_locator(ctx));
+		return -1;
+	}
+	/* If not json array type, return error */
+	if (json_object_get_type(arrjso) != json_type_array) {
+		jxs_log(JXS_LOG_ERROR, "%s: this json_object is not a 'json_type_array' object.\n", jmap_locator(ctx));
+		return -1;
+	}
+	for (i = 0; i < arr_len; i++) {
+		json_object *item_jso = NULL;
+		ctx->now.jmitem = jmitem;
+		ctx->now.idx    = i;
+		ctx->stats.elements++;
+		jmap_path_enter(ctx, depth, NULL, i);
+		ret = jmap_to_json_warpper(ctx, base, jmitem, i, &item_jso);
+		if (ret == -1) {
+			jmap_path_leave(ctx, depth);
+			jxs_log(JXS_LOG_ERROR, "%s: jmap to json error.\n", jmap_locator(ctx));
+			return -1;
+		} else if (ret == 0) {
+			json_object_array_add(arrjso, item_jso);
+		} else {
+			jxs_log(JXS_LOG_TRACE, "%s: delete current item.\n", jmap_locator(ctx));
+			ret = 0;
+		}
+	}
+	jmap_path_leave(ctx, depth);
+	return ret;
+}
+
+/**
+ * @brief Write the struct to the json_object according to the struct's mapper
+ *
+ * @param  mapper  [input]struct's mapper
+ * @param  base    [input]struct start address
+ * @param  jso   [output]json_object, Must be initialized
+ * @return 0 for success, -1 for error.
+ */
+static int jmap_to_json_object(jmap_context_t *ctx, jxs_mapper *mapper,
+                               uint8_t *base, json_object *jso)
+{
+	int          ret       = 0;
+	size_t       i         = 0;
+	size_t       depth     = ctx->path.depth;
+	jmap_head_t *jmhead    = get_jmhead(mapper);
+	jmap_list_t *jmlist    = get_jmlist(mapper);
+	if ((mapper == NULL) || (jso == NULL)) {
+		jxs_log(JXS_LOG_ERROR, "%s: mapper or json_object is null.\n", jmap_locator(ctx));
+		return -1;
+	}
+	if (json_object_get_type(jso) != json_type_object) {
+		jxs_log(JXS_LOG_ERROR, "%s: this json_object is not a 'json_type_object' object.\n", jmap_locator(ctx));
+		return -1;
+	}
+	for (i = 0; i < jmhead->idx; i++) {
+		json_object *item_jso = NULL;
+		jmap_item_t *jmitem   = &jmlist[i];
+		ctx->now.jmitem = jmitem;
+		ctx->now.idx    = 0;
+		ctx->stats.items++;
+		jmap_path_enter(ctx, depth, jmitem->key, 0);
+		ret = jmap_to_json_warpper(ctx, base, jmitem, 0, &item_jso);
+		if (ret == -1) {
+			jmap_path_leave(ctx, depth);
+			jxs_log(JXS_LOG_ERROR, "%s: jmap to json error.\n", jmap_locator(ctx));
+			return -1;
+		} else if (ret == 0) {
+			json_object_object_add(jso, jmitem->key, item_jso);
+		} else {
+			jxs_log(JXS_LOG_TRACE, "%s: delete current item.\n", jmap_locator(ctx));
+			ret = 0;
+		}
+	}
+	jmap_path_leave(ctx, depth);
+	return ret;
+}
+
+/**
+ * @brief Fill array's jmap based on json_object
+ *
+ * @param  base       [input]start address of the struct that owns the array.
+ * @param  jmitem     [output]Jmap of the base address of the array.
+ * @param  arr_jso  [input]json_object of array type.
+ * @return 0 for success, -1 for error.
+ */
+static int jmap_from_json_array(jmap_context_t *ctx, uint8_t *base,
+                                jmap_item_t *jmitem, json_object *arrjso)
+{
+	size_t      i         = 0;
+	size_t      depth     = ctx->path.depth;
+	size_t      arr_len   = jmitem->arr.length;
+	size_t      jarr_len  = 0;
+	if (arrjso == NULL) {
+		jxs_log(JXS_LOG_ERROR, "%s: array json_object is null.\n", jmap_locator(ctx));
+		return -1;
+	}
+	if ((jmitem->size == 0) || (arr_len == 0)) {
+		jxs_log(JXS_LOG_ERROR, "%s: array 'size', 'len' cannot not be zero.\n", jmap_locator(ctx));
+		return -1;
+	}
+	if (json_object_get_type(arrjso) != json_type_array) {
+		jxs_log(JXS_LOG_ERROR, "%s: this json_object is not a 'json_type_array' object.\n", jmap_locator(ctx));
+		return -1;
+	}
+	/* If the json array length exceeds the buf value, the excess is discarded */
+	jarr_len = json_object_array_length(arrjso);
+	if (jarr_len > arr_len) {
+		jxs_log(JXS_LOG_WARN, "%s: array length exceeds the buffer, throw it.\n", jmap_locator(ctx));
+	} else {
+		arr_len = jarr_len;
+	}
+	for (i = 0; i < arr_len; i++) {
+		ctx->now.jmitem = jmitem;
+		ctx->now.idx    = i;
+		ctx->stats.elements++;
+		jmap_path_enter(ctx, depth, NULL, i);
+		if (jmap_from_json_warpper(ctx, base, jmitem, i,
+		                           json_object_array_get_idx(arrjso, i)) != 0) {
+			jmap_path_leave(ctx, depth);
+			jxs_log(JXS_LOG_ERROR, "%s: jmap from json error.\n", jmap_locator(ctx));
+			return -1;
+		}
+	}
+	jmap_path_leave(ctx, depth);
+	return 0;
+}
+
+/**
+ * @brief Write the data in the json_object to the struct through jmap
+ *
+ * @param  jmap  struct's mapper
+ * @param  base  struct start address
+ * @param  jso   json_object, Must be initialized
+ * @return 0 for success, -1 for error.
+ */
+static int jmap_from_json_object(jmap_context_t *ctx, jxs_mapper *mapper,
+                                 uint8_t *base, json_object *jso)
+{
+	size_t       i         = 0;
+	bool         keep      = false;
+	size_t       depth     = ctx->path.depth;
+	jmap_head_t *jmhead    = get_jmhead(mapper);
+	jmap_list_t *jmlist    = get_jmlist(mapper);
+	if (mapper == NULL) {
+		jxs_log(JXS_LOG_ERROR, "%s: mapper cannot be null.\n", jmap_locator(ctx));
+		return -1;
+	}
+	if (jso == NULL) {
+		jxs_log(JXS_LOG_ERROR, "%s: json_object is null.\n", jmap_locator(ctx));
+		return -1;
+	}
+	/* a merge patch that is not an object replaces the whole struct */
+	keep = ctx->merge && json_object_is_type(jso, json_type_object);
+	for (i = 0; i < jmhead->idx; i++) {
+		jmap_item_t *jmitem   = &jmlist[i];
+		json_object *item_jso = NULL;
+		if (!json_object_object_get_ex(jso, jmitem->key, &item_jso) && keep) {
+			continue;
+		}
+		ctx->now.jmitem = jmitem;
+		ctx->now.idx    = 0;
+		ctx->stats.items++;
+		jmap_path_enter(ctx, depth, jmitem->key, 0);
+		if (jmap_from_json_warpper(ctx, base, jmitem, 0, item_jso) != 0) {
+			jmap_path_leave(ctx, depth);
+			jxs_log(JXS_LOG_ERROR, "%s: jmap from json error.\n", jmap_locator(ctx));
+			return -1;
+		}
+	}
+	jmap_path_leave(ctx, depth);
+	return 0;
+}
+
+/**
+ * @brief Write the indentation of a line, the same as json-c does.
+ */
+static void jmap_write_indent(jxs_wbuf *wbuf, int level, int flags)
+{
+	if (flags & JSON_C_TO_STRING_PRETTY) {
+		if (flags & JSON_C_TO_STRING_PRETTY_TAB) {
+			wbuf_fill(wbuf, '\t', (size_t)level);
+		} else {
+			wbuf_fill(wbuf, ' ', (size_t)level * 2);
+		}
+	}
+}
+
+/**
+ * @brief Write the characters of a json string without the quotes, they are
+ * escaped the same as json-c.
+ */
+static void jmap_write_escaped(jxs_wbuf *wbuf, const char *str, size_t len, int flags)
+{
+	static const char hex_chars[] = "0123456789abcdef";
+	size_t pos   = 0;
+	size_t run   = 0;
+	bool   slash = !(flags & JSON_C_TO_STRING_NOSLASHESCAPE);
+	while (pos < len) {
+		unsigned char c   = 0;
+		const char   *esc = NULL;
+		char          ubuf[6];
+		/* copy the plain run in one go, then escape the byte that ends it */
+		run = str_escape_span(str + pos, len - pos, slash);
+		wbuf_append(wbuf, str + pos, run);
+		pos += run;
+		if (pos >= len) {
+			break;
+		}
+		c = (unsigned char)str[pos++];
+		switch (c) {
+		case '\b': esc = "\\b"; break;
+		case '\n': esc = "\\n"; break;
+		case '\r': esc = "\\r"; break;
+		case '\t': esc = "\\t"; break;
+		case '\f': esc = "\\f"; break;
+		case '"':  esc = "\\\""; break;
+		case '\\': esc = "\\\\"; break;
+		case '/':  esc = "\\/"; break;
+		default:
+			memcpy(ubuf, "\\u00", 4);
+			ubuf[4] = hex_chars[c >> 4];
+			ubuf[5] = hex_chars[c & 0xf];
+			wbuf_append(wbuf, ubuf, sizeof(ubuf));
+			break;
+		}
+		if (esc) {
+			wbuf_append(wbuf, esc, 2);
+		}
+	}
+}
+
+/**
+ * @brief Write a quoted json string, characters are escaped the same as json-c.
+ */
+static void jmap_write_string(jxs_wbuf *wbuf, const char *str, size_t len, int flags)
+{
+	wbuf_putc(wbuf, '"');
+	jmap_write_escaped(wbuf, str, len, flags);
+	wbuf_putc(wbuf, '"');
+}
+
+static void jmap_write_int(jxs_wbuf *wbuf, int64_t value)
+{
+	char buf[NUM_BUFSIZE];
+	wbuf_append(wbuf, buf, num_format_i64(buf, value));
+}
+
+static void jmap_write_uint(jxs_wbuf *wbuf, uint64_t value)
+{
+	char buf[NUM_BUFSIZE];
+	wbuf_append(wbuf, buf, num_format_u64(buf, value));
+}
+
+/**
+ * @brief Write a double, or a float with 'single' set, with the shortest digits
+ * that read back to the same value.
+ */
+static void jmap_write_double(jxs_wbuf *wbuf, double value, bool single)
+{
+	char   buf[NUM_BUFSIZE];
+	size_t len = single ? num_format_float(buf, (float)value) : num_format_double(buf, value);
+	wbuf_append(wbuf, buf, len);
+}
+
+/**
+ * @brief Write a json_object member, json-c prints it at level 0, so every new
+ * line is shifted to the level of the member.
+ */
+static void jmap_write_jso(jxs_wbuf *wbuf, json_object *jso, int level, int flags)
+{
+	const char *str = NULL;
+	const char *nl  = NULL;
+	if (jso == NULL) {
+		wbuf_puts(wbuf, "null");
+		return;
+	}
+#if (JSON_C_VERSION_NUM >= 0xb00)
+	str = json_object_to_json_string_ext(jso, flags);
+#else
+	str = json_object_to_json_string(jso);
+#endif
+	if (str == NULL) {
+		wbuf_puts(wbuf, "null");
+		return;
+	}
+	while ((flags & JSON_C_TO_STRING_PRETTY) && ((nl = strchr(str, '\n')) != NULL)) {
+		wbuf_append(wbuf, str, (size_t)(nl - str) + 1);
+		jmap_write_indent(wbuf, level, flags);
+		str = nl + 1;
+	}
+	wbuf_append(wbuf, str, strlen(str));
+}
+
+/**
+ * @brief Write the separator, indentation and key(if any) in front of an
+ * object member or array element.
+ * @param  key           object member key, NULL for array element.
+ * @param  had_children  whether it is not the first member/element.
+ * @param  level         level of the member/element.
+ */
+static void jmap_write_prefix(jxs_wbuf *wbuf, const char *key, bool had_children,
+                              int level, int flags)
+{
+	if (had_children) {
+		wbuf_putc(wbuf, ',');
+		if (flags & JSON_C_TO_STRING_PRETTY) {
+			wbuf_putc(wbuf, '\n');
+		}
+	}
+	if ((flags & JSON_C_TO_STRING_SPACED) && !(flags & JSON_C_TO_STRING_PRETTY)) {
+		wbuf_putc(wbuf, ' ');
+	}
+	jmap_write_indent(wbuf, level, flags);
+	if (key) {
+		jmap_write_string(wbuf, key, strlen(key), flags);
+		if (flags & JSON_C_TO_STRING_SPACED) {
+			wbuf_puts(wbuf, ": ");
+		} else {
+			wbuf_putc(wbuf, ':');
+		}
+	}
+}
+
+/**
+ * @brief Write the closing bracket of an object or array.
+ */
+static void jmap_write_suffix(jxs_wbuf *wbuf, char bracket, bool had_children,
+                              int level, int flags)
+{
+	if (flags & JSON_C_TO_STRING_PRETTY) {
+		if (had_children) {
+			wbuf_putc(wbuf, '\n');
+		}
+		jmap_write_indent(wbuf, level, flags);
+	}
+	if ((flags & JSON_C_TO_STRING_SPACED) && !(flags & JSON_C_TO_STRING_PRETTY)) {
+		wbuf_putc(wbuf, ' ');
+	}
+	wbuf_putc(wbuf, bracket);
+}
+
+/**
+ * @brief Write a number(or boolean) member or array element, the leaf shared
+ * by @ref jmap_write_warpper() and @ref jmap_write_flat().
+ */
+static void jmap_write_number(jmap_context_t *ctx, jxs_wbuf *wbuf, const void *vptr,
+                              jxs_type type, size_t size)
+{
+	switch (type) {
+	case jxs_type_boolean: {
+		int tmpbool = 0;
+		if (TYPEOF(size, int)) {
+			tmpbool = *((const int *)vptr);
+		} else if (TYPEOF(size, bool)) {
+			tmpbool = *((const bool *)vptr);
+		} else {
+			jxs_log(JXS_LOG_ERROR, "%s: required type '%s' <sizeof> does not match.\n",
+			        jmap_locator(ctx), type_to_name(type));
+			wbuf_puts(wbuf, "null");
+			break;
+		}
+		if (tmpbool) {
+			wbuf_puts(wbuf, "true");
+		} else {
+			wbuf_puts(wbuf, "false");
+		}
+		break;
+	}
+
+	case jxs_type_double:
+		if (TYPEOF(size, double)) {
+			jmap_write_double(wbuf, *((const double *)vptr), false);
+		} else if (TYPEOF(size, float)) {
+			jmap_write_double(wbuf, *((const float *)vptr), true);
+		} else {
+			jxs_log(JXS_LOG_ERROR, "%s: required type '%s' <sizeof> does not match.\n",
+			        jmap_locator(ctx), type_to_name(type));
+			wbuf_puts(wbuf, "null");
+		}
+		break;
+
+	case jxs_type_int:
+		if (TYPEOF(size, int64_t)) {
+			jmap_write_int(wbuf, *((const int64_t *)vptr));
+		} else if (TYPEOF(size, int32_t)) {
+			jmap_write_int(wbuf, *((const int32_t *)vptr));
+		} else if (TYPEOF(size, int16_t)) {
+			jmap_write_int(wbuf, *((const int16_t *)vptr));
+		} else if (TYPEOF(size, int8_t)) {
+			jmap_write_int(wbuf, *((const int8_t *)vptr));
+		} else {
+			jxs_log(JXS_LOG_ERROR, "%s: required type '%s' <sizeof> does not match.\n",
+			        jmap_locator(ctx), type_to_name(type));
+			wbuf_puts(wbuf, "null");
+		}
+		break;
+
+	case jxs_type_uint:
+		if (TYPEOF(size, uint64_t)) {
+			jmap_write_uint(wbuf, *((const uint64_t *)vptr));
+		} else if (TYPEOF(size, uint32_t)) {
+			jmap_write_uint(wbuf, *((const uint32_t *)vptr));
+		} else if (TYPEOF(size, uint16_t)) {
+			jmap_write_uint(wbuf, *((const uint16_t *)vptr));
+		} else if (TYPEOF(size, uint8_t)) {
+			jmap_write_uint(wbuf, *((const uint8_t *)vptr));
+		} else {
+			jxs_log(JXS_LOG_ERROR, "%s: required type '%s' <sizeof> does not match.\n",
+			        jmap_locator(ctx), type_to_name(type));
+			wbuf_puts(wbuf, "null");
+		}
+		break;
+
+	default:
+		jxs_log(JXS_LOG_ERROR, "%s: error mapper type.\n", jmap_locator(ctx));
+		wbuf_puts(wbuf, "null");
+		break;
+	}
+}
+
+/**
+ * @brief Write a flat array(see @ref jmap_array_flat()) as json text, the
+ * same text as @ref jmap_write_array() writes.
+ * @param  ptr     first element.
+ * @param  dims    dimensions, from this one to the last.
+ * @param  stride  bytes of one element of every dimension.
+ * @param  level   level of the array.
+ */
+static void jmap_write_flat(jmap_context_t *ctx, const uint8_t *ptr, jxs_type type,
+                            const size_t *dims, const size_t *stride, size_t ndims,
+                            jxs_wbuf *wbuf, int level, int flags)
+{
+	size_t i = 0;
+	wbuf_putc(wbuf, '[');
+	if (flags & JSON_C_TO_STRING_PRETTY) {
+		wbuf_putc(wbuf, '\n');
+	}
+	ctx->stats.elements += dims[0];
+	for (i = 0; i < dims[0]; i++, ptr += stride[0]) {
+		jmap_write_prefix(wbuf, NULL, i != 0, level + 1, flags);
+		if (ndims > 1) {
+			jmap_write_flat(ctx, ptr, type, dims + 1, stride + 1, ndims - 1, wbuf, level + 1, flags);
+		} else {
+			jmap_write_number(ctx, wbuf, ptr, type, stride[0]);
+		}
+	}
+	jmap_write_suffix(wbuf, ']', true, level, flags);
+}
+
+/**
+ * @brief Write one struct member(or array element) as json text directly,
+ * the output is the same as @ref jmap_to_json_warpper() printed by json-c.
+ * @param  key     object member key, NULL for array element.
+ * @param  level   level of the member.
+ * @param  had_children whether it is not the first member/element.
+ * @return 0 for written, 1 for deleted by the rules, -1 for error.
+ */
+static int jmap_write_warpper(jmap_context_t *ctx, uint8_t *base, jmap_item_t *jmitem,
+                              size_t idx, jxs_wbuf *wbuf, const char *key,
+                              bool had_children, int level, int flags)
+{
+	json_object *item_jso = NULL;
+	void        *vptr     = base + jmitem->offset;
+	jxs_type     type     = jmitem->type;
+	size_t       size     = jmitem->size;
+	item_action  action   = 0;
+	vptr   = (uint8_t *)vptr + size * idx;
+	action = jmap_convert_handler(ctx, jmitem, vptr, &item_jso);
+	if (action == RULE_ITEM_ERROR) {
+		jxs_log(JXS_LOG_WARN, "Rules handling error, skip rules.\n");
+	} else if (action == RULE_ITEM_DELETE) {
+		/* delete current item */
+		return 1;
+	}
+	jmap_write_prefix(wbuf, key, had_children, level, flags);
+	if (action == RULE_ITEM_SET) {
+		/* rules only set null */
+		wbuf_puts(wbuf, "null");
+		return 0;
+	}
+	switch (type) {
+	case jxs_type_null:
+		wbuf_puts(wbuf, "null");
+		break;
+
+	case jxs_type_boolean:
+	case jxs_type_double:
+	case jxs_type_int:
+	case jxs_type_uint:
+		jmap_write_number(ctx, wbuf, vptr, type, size);
+		break;
+
+	case jxs_type_string: {
+		char *tmpstr = *((char(*)[])vptr);
+		/* a full member may have no terminator */
+		jmap_write_string(wbuf, tmpstr, strnlen(tmpstr, size), flags);
+		break;
+	}
+
+	case jxs_type_object:
+		jmap_write_jso(wbuf, *((json_object **)vptr), level, flags);
+		break;
+
+	case jxs_type_struct:
+		if (jmitem->subjm == NULL) {
+			jxs_log(JXS_LOG_ERROR, "%s: Please create a mapper for your nested struct..\n", jmap_locator(ctx));
+			wbuf_puts(wbuf, "null");
+			break;
+		}
+		if (jmap_write_object(ctx, jmitem->subjm, (uint8_t *)vptr, wbuf, level, flags) != 0) {
+			jxs_log(JXS_LOG_ERROR, "%s: struct to json error.\n", jmap_locator(ctx));
+			return -1;
+		}
+		break;
+
+	case jxs_type_array: {
+		jmap_item_t new_jmitem;
+		jmap_array_move_next_dimen(&new_jmitem, jmitem, idx);
+		if (jmap_write_array(ctx, base, &new_jmitem, wbuf, level, flags) != 0) {
+			jxs_log(JXS_LOG_ERROR, "%s: array to json error.\n", jmap_locator(ctx));
+			return -1;
+		}
+		break;
+	}
+
+	default:
+		jxs_log(JXS_LOG_ERROR, "%s: error mapper type.\n", jmap_locator(ctx));
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Write an array as json text according to array's jmap.
+ * @param  level   level of the array.
+ * @return 0 for success, -1 for error.
+ */
+static int jmap_write_array(jmap_context_t *ctx, uint8_t *base, jmap_item_t *jmitem,
+                            jxs_wbuf *wbuf, int level, int flags)
+{
+	int         ret          = 0;
+	size_t      i            = 0;
+	bool        had_children = false;
+	size_t      depth        = ctx->path.depth;
+	size_t      arr_len      = jmitem->arr.length;
+	size_t      ndims        = 0;
+	size_t      dims[JXS_ARRAY_DEPTH];
+	size_t      stride[JXS_ARRAY_DEPTH];
+	if ((jmitem->size == 0) || (arr_len == 0)) {
+		jxs_log(JXS_LOG_ERROR, "%s: array 'size', 'len' cannot not be zero.\n", jmap_locator(ctx));
+		return -1;
+	}
+	if ((ndims = jmap_array_flat(ctx, jmitem, true, dims, stride)) != 0) {
+		jmap_write_flat(ctx, base + jmitem->offset, jmitem->basetype, dims, stride, ndims,
+		                wbuf, level, flags);
+		return 0;
+	}
+	wbuf_putc(wbuf, '[');
+	if (flags & JSON_C_TO_STRING_PRETTY) {
+		wbuf_putc(wbuf, '\n');
+	}
+	for (i = 0; i < arr_len; i++) {
+		ctx->now.jmitem = jmitem;
+		ctx->now.idx    = i;
+		ctx->stats.elements++;
+		jmap_path_enter(ctx, depth, NULL, i);
+		ret = jmap_write_warpper(ctx, base, jmitem, i, wbuf, NULL, had_children, level + 1, flags);
+		if (ret == -1) {
+			jmap_path_leave(ctx, depth);
+			jxs_log(JXS_LOG_ERROR, "%s: jmap to json error.\n", jmap_locator(ctx));
+			return -1;
+		} else if (ret == 0) {
+			had_children = true;
+		} else {
+			jxs_log(JXS_LOG_TRACE, "%s: delete current item.\n", jmap_locator(ctx));
+		}
+	}
+	jmap_path_leave(ctx, depth);
+	jmap_write_suffix(wbuf, ']', had_children, level, flags);
+	return 0;
+}
+
+/**
+ * @brief Write the struct as json text according to the struct's mapper, without
+ * building any json_object.
+ * @param  mapper  struct's mapper
+ * @param  base    struct start address
+ * @param  level   level of the object.
+ * @return 0 for success, -1 for error.
+ */
+static int jmap_write_object(jmap_context_t *ctx, jxs_mapper *mapper, uint8_t *base,
+                             jxs_wbuf *wbuf, int level, int flags)
+{
+	int          ret          = 0;
+	size_t       i            = 0;
+	bool         had_children = false;
+	size_t       depth        = ctx->path.depth;
+	jmap_head_t *jmhead       = get_jmhead(mapper);
+	jmap_list_t *jmlist       = get_jmlist(mapper);
+	wbuf_putc(wbuf, '{');
+	if (flags & JSON_C_TO_STRING_PRETTY) {
+		wbuf_putc(wbuf, '\n');
+	}
+	for (i = 0; i < jmhead->idx; i++) {
+		jmap_item_t *jmitem = &jmlist[i];
+		ctx->now.jmitem = jmitem;
+		ctx->now.idx    = 0;
+		ctx->stats.items++;
+		jmap_path_enter(ctx, depth, jmitem->key, 0);
+		ret = jmap_write_warpper(ctx, base, jmitem, 0, wbuf, jmitem->key, had_children,
+		                         level + 1, flags);
+		if (ret == -1) {
+			jmap_path_leave(ctx, depth);
+			jxs_log(JXS_LOG_ERROR, "%s: jmap to json error.\n", jmap_locator(ctx));
+			return -1;
+		} else if (ret == 0) {
+			had_children = true;
+		} else {
+			jxs_log(JXS_LOG_TRACE, "%s: delete current item.\n", jmap_locator(ctx));
+		}
+	}
+	jmap_path_leave(ctx, depth);
+	jmap_write_suffix(wbuf, '}', had_children, level, flags);
+	return 0;
+}
+
+/**
+ * @brief Read a number(or boolean) member or array element, the leaf shared by
+ * @ref jmap_read_warpper() and @ref jmap_read_flat().
+ * @param  rd  json reader at the value, NULL if the value is absent or null.
+ * @return 0 for success, -1 for error.
+ */
+static int jmap_read_number(jmap_context_t *ctx, void *vptr, jxs_type type, size_t size,
+                            jxs_reader *rd)
+{
+	bool       neg = false;
+	uint64_t   num = 0;
+	jxs_rvalue val;
+	val.type = json_type_null;
+	if ((rd != NULL) && (rd_scalar(rd, &val) != 0)) {
+		return -1;
+	}
+	switch (type) {
+	case jxs_type_boolean:
+		if (TYPEOF(size, int)) {
+			*((int *)vptr) = (int)rval_get_boolean(&val);
+		} else if (TYPEOF(size, bool)) {
+			*((bool *)vptr) = rval_get_boolean(&val);
+		} else {
+			jxs_log(JXS_LOG_ERROR, "%s: required type '%s' <sizeof> does not match.\n",
+			        jmap_locator(ctx), type_to_name(type));
+			return -1;
+		}
+		break;
+
+	case jxs_type_double:
+		if (TYPEOF(size, double)) {
+			*((double *)vptr) = rval_get_double(&val);
+		} else if (TYPEOF(size, float)) {
+			*((float *)vptr) = rval_get_float(&val);
+		} else {
+			jxs_log(JXS_LOG_ERROR, "%s: required type '%s' <sizeof> does not match.\n",
+			        jmap_locator(ctx), type_to_name(type));
+			return -1;
+		}
+		break;
+
+	case jxs_type_int:
+		return jmap_store_int(ctx, vptr, size, rval_get_int64(&val));
+
+	case jxs_type_uint:
+		num = rval_get_uint64(&val, &neg);
+		return jmap_store_uint(ctx, vptr, size, num, neg);
+
+	default:
+		jxs_log(JXS_LOG_ERROR, "%s: error mapper type.\n", jmap_locator(ctx));
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Read a json array into a flat array(see @ref jmap_array_flat()), the
+ * same as @ref jmap_read_array() does: a nested value that is not an array is
+ * an error, a null one clears its elements, the elements beyond a dimension
+ * are skipped.
+ * @param  ptr     first element.
+ * @param  dims    dimensions, from this one to the last.
+ * @param  stride  bytes of one element of every dimension.
+ * @param  rd      json reader at the array.
+ * @return 0 for success, -1 for error.
+ */
+static int jmap_read_flat(jmap_context_t *ctx, uint8_t *ptr, jxs_type type,
+                          const size_t *dims, const size_t *stride, size_t ndims,
+                          jxs_reader *rd)
+{
+	int    ret   = 0;
+	size_t i     = 0;
+	size_t depth = ctx->path.depth;
+	if (!rd_accept(rd, '[')) {
+		rd_error(rd, "'[' expected");
+		return -1;
+	}
+	if (rd_accept(rd, ']')) {
+		return 0;
+	}
+	do {
+		/* json-c accepts a trailing comma */
+		if (rd_peek(rd) == ']') {
+			break;
+		}
+		if (i < dims[0]) {
+			uint8_t *vptr = ptr + i * stride[0];
+			ctx->stats.elements++;
+			jmap_path_enter(ctx, depth, NULL, i);
+			if (ndims == 1) {
+				ret = jmap_read_number(ctx, vptr, type, stride[0], rd_null(rd) ? NULL : rd);
+			} else if (rd_null(rd)) {
+				memset(vptr, 0, stride[0]);
+			} else if (rd_peek(rd) != '[') {
+				jxs_log(JXS_LOG_ERROR, "%s: this json value is not an array.\n", jmap_locator(ctx));
+				ret = -1;
+			} else {
+				ret = jmap_read_flat(ctx, vptr, type, dims + 1, stride + 1, ndims - 1, rd);
+			}
+			if (ret != 0) {
+				jmap_path_leave(ctx, depth);
+				jxs_log(JXS_LOG_ERROR, "%s: jmap from json error.\n", jmap_locator(ctx));
+				return -1;
+			}
+		} else {
+			/* If the json array length exceeds the buf value, the excess is discarded */
+			jmap_path_leave(ctx, depth);
+			if (i == dims[0]) {
+				jxs_log(JXS_LOG_WARN, "%s: array length exceeds the buffer, throw it.\n", jmap_locator(ctx));
+			}
+			if (rd_skip_value(rd) != 0) {
+				return -1;
+			}
+		}
+		i++;
+	} while (rd_accept(rd, ','));
+	jmap_path_leave(ctx, depth);
+	if (!rd_accept(rd, ']')) {
+		rd_error(rd, "']' expected");
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Release the json_object of an object member and clear it.
+ * @param  base    struct start address.
+ * @param  jmitem  jmap of the object member.
+ */
+static void jmap_object_release(uint8_t *base, const jmap_item_t *jmitem)
+{
+	json_object **objp = (json_object **)(void *)(base + jmitem->offset);
+	json_object_put(*objp);
+	*objp = NULL;
+}
+
+/**
+ * @brief Read one struct member(or array element) from the json text, the
+ * result is the same as @ref jmap_from_json_warpper() with the json_object.
+ * @param  rd  json reader at the value, NULL if the member is absent.
+ * @return 0 for success, -1 for error.
+ */
+static int jmap_read_warpper(jmap_context_t *ctx, uint8_t *base, jmap_item_t *jmitem,
+                             size_t idx, jxs_reader *rd)
+{
+	void    *vptr   = base + jmitem->offset;
+	jxs_type type   = jmitem->type;
+	size_t   size   = jmitem->size;
+	bool     isnull = (rd == NULL) || rd_null(rd);
+	vptr = (uint8_t *)vptr + size * idx;
+	switch (type) {
+	case jxs_type_null:
+		memset(vptr, 0, size);
+		if (!isnull && (rd_skip_value(rd) != 0)) {
+			return -1;
+		}
+		break;
+
+	case jxs_type_boolean:
+	case jxs_type_double:
+	case jxs_type_int:
+	case jxs_type_uint:
+		if (jmap_read_number(ctx, vptr, type, size, isnull ? NULL : rd) != 0) {
+			return -1;
+		}
+		break;
+
+	case jxs_type_string:
+		if (isnull) {
+			memset(vptr, 0, size);
+		} else if ((rd_peek(rd) == '"') || (rd_peek(rd) == '\'')) {
+			/* decode the string into the member directly */
+			if (rd_string(rd, *((char(*)[])vptr), size) != 0) {
+				return -1;
+			}
+			ctx->stats.truncated += rd->cut ? 1 : 0;
+		} else if (rd_value_to_string(rd, *((char(*)[])vptr), size) != 0) {
+			return -1;
+		} else {
+			ctx->stats.truncated += rd->cut ? 1 : 0;
+		}
+		break;
+
+	case jxs_type_object:
+		if (isnull) {
+			*((json_object **)vptr) = NULL;
+		} else if (rd_value_to_jso(rd, (json_object **)vptr) != 0) {
+			return -1;
+		}
+		break;
+
+	case jxs_type_struct:
+		if (jmitem->subjm == NULL) {
+			jxs_log(JXS_LOG_ERROR, "%s: Please create a mapper for your nested struct..\n", jmap_locator(ctx));
+			return -1;
+		}
+		if (isnull) {
+			memset(vptr, 0, size);
+		} else if (rd_peek(rd) == '{') {
+			if (jmap_read_object(ctx, jmitem->subjm, (uint8_t *)vptr, rd) != 0) {
+				jxs_log(JXS_LOG_ERROR, "%s: struct from json error.\n", jmap_locator(ctx));
+				return -1;
+			}
+		} else {
+			/* not an object, every member is cleared like json-c does */
+			if ((rd_skip_value(rd) != 0) ||
+			    (jmap_read_object(ctx, jmitem->subjm, (uint8_t *)vptr, NULL) != 0)) {
+				jxs_log(JXS_LOG_ERROR, "%s: struct from json error.\n", jmap_locator(ctx));
+				return -1;
+			}
+		}
+		break;
+
+	case jxs_type_array:
+		if (isnull) {
+			memset(vptr, 0, size);
+		} else {
+			int         ret   = 0;
+			bool        merge = ctx->merge;
+			jmap_item_t new_jmitem;
+			if (rd_peek(rd) != '[') {
+				jxs_log(JXS_LOG_ERROR, "%s: this json value is not an array.\n", jmap_locator(ctx));
+				return -1;
+			}
+			/* an array in a merge patch replaces the whole array(RFC 7386) */
+			if (merge) {
+				memset(vptr, 0, size);
+				ctx->merge = false;
+			}
+			jmap_array_move_next_dimen(&new_jmitem, jmitem, idx);
+			ret        = jmap_read_array(ctx, base, &new_jmitem, rd);
+			ctx->merge = merge;
+			if (ret != 0) {
+				jxs_log(JXS_LOG_ERROR, "%s: array from json error.\n", jmap_locator(ctx));
+				return -1;
+			}
+		}
+		break;
+
+	default:
+		jxs_log(JXS_LOG_ERROR, "%s: error mapper type.\n", jmap_locator(ctx));
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Read a json array into the struct according to array's jmap. The
+ * elements beyond the array length are skipped.
+ * @param  base    start address of the struct that owns the array.
+ * @param  jmitem  jmap of the array.
+ * @param  rd      json reader at the array.
+ * @return 0 for success, -1 for error.
+ */
+static int jmap_read_array(jmap_context_t *ctx, uint8_t *base,
+                           jmap_item_t *jmitem, jxs_reader *rd)
+{
+	size_t      i         = 0;
+	size_t      depth     = ctx->path.depth;
+	size_t      arr_len   = jmitem->arr.length;
+	size_t      ndims     = 0;
+	size_t      dims[JXS_ARRAY_DEPTH];
+	size_t      stride[JXS_ARRAY_DEPTH];
+	if ((jmitem->size == 0) || (arr_len == 0)) {
+		jxs_log(JXS_LOG_ERROR, "%s: array 'size', 'len' cannot not be zero.\n", jmap_locator(ctx));
+		return -1;
+	}
+	if ((ndims = jmap_array_flat(ctx, jmitem, false, dims, stride)) != 0) {
+		return jmap_read_flat(ctx, base + jmitem->offset, jmitem->basetype, dims, stride, ndims, rd);
+	}
+	if (!rd_accept(rd, '[')) {
+		rd_error(rd, "'[' expected");
+		return -1;
+	}
+	if (rd_accept(rd, ']')) {
+		return 0;
+	}
+	do {
+		/* json-c accepts a trailing comma */
+		if (rd_peek(rd) == ']') {
+			break;
+		}
+		if (i < arr_len) {
+			ctx->now.jmitem = jmitem;
+			ctx->now.idx    = i;
+			ctx->stats.elements++;
+			jmap_path_enter(ctx, depth, NULL, i);
+			if (jmap_read_warpper(ctx, base, jmitem, i, rd) != 0) {
+				jmap_path_leave(ctx, depth);
+				jxs_log(JXS_LOG_ERROR, "%s: jmap from json error.\n", jmap_locator(ctx));
+				return -1;
+			}
+		} else {
+			/* If the json array length exceeds the buf value, the excess is discarded */
+			jmap_path_leave(ctx, depth);
+			if (i == arr_len) {
+				jxs_log(JXS_LOG_WARN, "%s: array length exceeds the buffer, throw it.\n", jmap_locator(ctx));
+			}
+			if (rd_skip_value(rd) != 0) {
+				return -1;
+			}
+		}
+		i++;
+	} while (rd_accept(rd, ','));
+	jmap_path_leave(ctx, depth);
+	if (!rd_accept(rd, ']')) {
+		rd_error(rd, "']' expected");
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Read a json object into the struct through jmap. The members missing
+ * in the json object are cleared(kept for a merge patch), the keys without a
+ * mapper item are skipped.
+ * @param  mapper  struct's mapper
+ * @param  base    struct start address
+ * @param  rd      json reader at the object, NULL to clear every member.
+ * @return 0 for success, -1 for error.
+ */
+static int jmap_read_object(jmap_context_t *ctx, jxs_mapper *mapper,
+                            uint8_t *base, jxs_reader *rd)
+{
+	int          ret    = 0;
+	size_t       i      = 0;
+	uint64_t     seen_buf[8];
+	uint64_t    *seen   = seen_buf;
+	size_t       depth  = ctx->path.depth;
+	jmap_head_t *jmhead = get_jmhead(mapper);
+	jmap_list_t *jmlist = get_jmlist(mapper);
+	size_t       nwords = 0;
+	if (mapper == NULL) {
+		jxs_log(JXS_LOG_ERROR, "%s: mapper cannot be null.\n", jmap_locator(ctx));
+		return -1;
+	}
+	nwords = (jmhead->idx + 63) / 64;
+	/* bitmap of the members found in the json object */
+	if (nwords > JXS_NELEM(seen_buf)) {
+		seen = (uint64_t *)jxs_calloc(nwords, sizeof(uint64_t));
+		if (seen == NULL) {
+			jxs_log(JXS_LOG_ERROR, "%s: calloc seen table failed.\n", jmap_locator(ctx));
+			return -1;
+		}
+		ctx->stats.allocs++;
+	} else {
+		memset(seen_buf, 0, sizeof(seen_buf));
+	}
+	if ((rd != NULL) && !rd_accept(rd, '{')) {
+		rd_error(rd, "'{' expected");
+		ret = -1;
+		goto end;
+	}
+	if ((rd != NULL) && !rd_accept(rd, '}')) {
+		do {
+			const char  *key    = NULL;
+			const char  *value  = NULL;
+			size_t       klen   = 0;
+			jmap_item_t *jmitem = NULL;
+			/* json-c accepts a trailing comma */
+			if (rd_peek(rd) == '}') {
+				break;
+			}
+			if (rd_key(rd, &key, &klen) != 0) {
+				ret = -1;
+				goto end;
+			}
+			rd_skip_ws(rd);
+			value  = rd->cur;
+			jmitem = jmap_index_find(mapper, key, klen);
+			if ((jmitem == NULL) && (rd_skip_value(rd) != 0)) {
+				ret = -1;
+				goto end;
+			}
+			for (; jmitem != NULL; jmitem = jmitem->same ? &jmlist[jmitem->same - 1] : NULL) {
+				i = (size_t)(jmitem - jmlist);
+				/* more than one member mapped to the key, read the value again */
+				rd->cur         = value;
+				ctx->now.jmitem = jmitem;
+				ctx->now.idx    = 0;
+				ctx->stats.items++;
+				/* a repeated key replaces the json_object read for the first one */
+				if ((jmitem->type == jxs_type_object) && (seen[i / 64] & ((uint64_t)1 << (i % 64)))) {
+					jmap_object_release(base, jmitem);
+				}
+				jmap_path_enter(ctx, depth, jmitem->key, 0);
+				if (jmap_read_warpper(ctx, base, jmitem, 0, rd) != 0) {
+					jmap_path_leave(ctx, depth);
+					jxs_log(JXS_LOG_ERROR, "%s: jmap from json error.\n", jmap_locator(ctx));
+					ret = -1;
+					goto end;
+				}
+				seen[i / 64] |= (uint64_t)1 << (i % 64);
+			}
+		} while (rd_accept(rd, ','));
+		if (!rd_accept(rd, '}')) {
+			rd_error(rd, "'}' expected");
+			ret = -1;
+			goto end;
+		}
+	}
+	/* a merge patch keeps the absent members, unless it wasn't an object */
+	for (i = 0; (i < jmhead->idx) && !(ctx->merge && (rd != NULL)); i++) {
+		jmap_item_t *jmitem = &jmlist[i];
+		if (seen[i / 64] & ((uint64_t)1 << (i % 64))) {
+			continue;
+		}
+		ctx->now.jmitem = jmitem;
+		ctx->now.idx    = 0;
+		ctx->stats.items++;
+		jmap_path_enter(ctx, depth, jmitem->key, 0);
+		if (jmap_read_warpper(ctx, base, jmitem, 0, NULL) != 0) {
+			jmap_path_leave(ctx, depth);
+			jxs_log(JXS_LOG_ERROR, "%s: jmap from json error.\n", jmap_locator(ctx));
+			ret = -1;
+			goto end;
+		}
+	}
+end:
+	jmap_path_leave(ctx, depth);
+	if (seen != seen_buf) {
+		jxs_free(seen);
+	}
+	return ret;
+}
+
+/**
+ * @brief Take 'units' mappers from the arena. The current block is used until
+ * it is full, then a block twice as large(at least 'units') is added. What is
+ * left at the end of the full block is not used.
+ * @return mappers, not cleared. NULL for error.
+ */
+static jxs_mapper *jxs_arena_alloc(jmap_context_t *ctx, size_t units)
+{
+	jxs_arena_block *block = *ctx->buf.arena;
+	size_t           len   = block ? block->len * 2 : MAPPER_ARENA_LENGTH;
+	if ((block == NULL) || ((block->len - block->idx) < units)) {
+		len = (len < units) ? units : len;
+		if (len >= SIZE_MAX / sizeof(jxs_mapper)) {
+			return NULL;
+		}
+		/* the head takes the first unit, it keeps the mappers aligned */
+		block = (jxs_arena_block *)jxs_malloc((len + 1) * sizeof(jxs_mapper));
+		if (block == NULL) {
+			return NULL;
+		}
+		ctx->stats.allocs++;
+		block->next      = *ctx->buf.arena;
+		block->len       = len;
+		block->idx       = 0;
+		*ctx->buf.arena = block;
+	}
+	block->idx += units;
+	return (jxs_mapper *)(void *)block + 1 + (block->idx - units);
+}
+
+/**
+ * @brief Free every block of the arena, with all the mappers in it.
+ */
+static void jxs_arena_release(jxs_arena_block **arena)
+{
+	jxs_arena_block *block = *arena;
+	while (block) {
+		jxs_arena_block *next = block->next;
+		jxs_free(block);
+		block = next;
+	}
+	*arena = NULL;
+}
+
+jxs_mapper *jxs_map_basic_new(void *context, size_t num)
+{
+	jxs_mapper     *mapper  = NULL;
+	jmap_head_t    *jmhead  = NULL;
+	jmap_context_t *ctx     = (jmap_context_t *)context;
+	size_t          nslot   = 0;
+	size_t          nbucket = 0;
+	size_t          units   = 0;
+	if (num == 0) {
+		jxs_log(JXS_LOG_ERROR, "jmap item cannot be 0.\n");
+		return NULL;
+	}
+	if (context == NULL) {
+		jxs_log(JXS_LOG_ERROR, "context data cannot be 0.\n");
+		return NULL;
+	}
+	/* head, items, then the key index */
+	units          = num + 1 + jmap_index_units(num, &nslot, &nbucket);
+	ctx->buf.need += units;
+	/* Prefer to use local variables to store mapper to improve performance,
+	 * Avoid malloc and free memory frequently. buffer length defined by macro
+	 * MAPPER_BUFFER_LENGTH, a compiled schema has no buffer at all.
+	 * The rest comes from the arena of the schema, a few blocks for any number
+	 * of mappers, freed at once by jxs_schema_unload().
+	 * Neither is cleared by the caller, only the head is needed, every item is
+	 * cleared when it is added.
+	 */
+	if ((ctx->buf.len - ctx->buf.idx) < units) {
+		if ((ctx->buf.arena == NULL) || ((mapper = jxs_arena_alloc(ctx, units)) == NULL)) {
+			jxs_log(JXS_LOG_ERROR, "jmap new failed.\n");
+			return NULL;
+		}
+		jmhead = get_jmhead(mapper);
+		memset(jmhead, 0, sizeof(jxs_mapper));
+		jmhead->isbuf = false;
+	} else {
+		mapper        = &ctx->buf.arr[ctx->buf.idx];
+		ctx->buf.idx += units;
+		jmhead        = get_jmhead(mapper);
+		memset(jmhead, 0, sizeof(jxs_mapper));
+		jmhead->isbuf = true;
+	}
+	jmhead->limit   = num;
+	jmhead->nslot   = nslot;
+	jmhead->nbucket = nbucket;
+	jxs_log(JXS_LOG_INFO, "JMAP NEW[%p]%s\n", mapper, jmhead->isbuf ? "(BUFFER)" : "(ARENA)");
+	return mapper;
+}
+
+jxs_item *jxs_item_basic_add(jxs_mapper *mapper, jxs_type type, const char *key,
+                             ptrdiff_t offset, size_t mbsize, jxs_mapper *subjm, ...)
+{
+	size_t       i = 0;
+	va_list      ap;
+	jmap_head_t *jmhead = NULL;
+	jmap_list_t *jmlist = NULL;
+	jmap_item_t *jmitem = NULL;
+	if (mapper == NULL) {
+		jxs_log(JXS_LOG_ERROR, "mapper cannot be null.\n");
+		return NULL;
+	}
+	if (type == jxs_type_array) {
+		jxs_log(JXS_LOG_ERROR, "'Multi-Dimen Array' Usage error.\n");
+		return NULL;
+	} else if ((type == jxs_type_struct) && (subjm == NULL)) {
+		jxs_log(JXS_LOG_ERROR, "you must specify a mapper for the sub-struct.\n");
+		return NULL;
+	}
+	jmhead = get_jmhead(mapper);
+	jmlist = get_jmlist(mapper);
+	/* avoid overflow */
+	if (jmhead->idx >= jmhead->limit) {
+		jxs_log(JXS_LOG_ERROR, "add too many, drop it.\n");
+		return NULL;
+	}
+	jmitem = &jmlist[jmhead->idx];
+	memset(jmitem, 0, sizeof(jmap_item_t));
+	jmitem->key      = key;
+	jmitem->offset   = offset;
+	jmitem->size     = mbsize;
+	jmitem->subjm    = subjm;
+	jmitem->basetype = type;
+	va_start(ap, subjm);
+	for (i = 0; i < JXS_NELEM(jmitem->arr.deptab); i++) {
+		// TODO: does 'int' is engouth?
+		jmitem->arr.deptab[i] = (size_t)va_arg(ap, int);
+		/* Use 0 to mark the end of the variable argument list */
+		if (jmitem->arr.deptab[i] == 0) {
+			jmitem->arr.depth = i;
+			break;
+		}
+	}
+	va_end(ap);
+	/* If no 0 is received, the array exceeds a predefined maximum depth */
+	if (jmitem->arr.deptab[JXS_ARRAY_DEPTH] != 0) {
+		jxs_log(JXS_LOG_ERROR, "Exceeds the predefined maximum array depth[%d], "
+		        "you can modify the MACRO manually.\n", JXS_ARRAY_DEPTH);
+		return NULL;
+	}
+	/* If it is not an array, the type is equal to the basic type,
+	 * otherwise it is an array type */
+	jmitem->type = (jmitem->arr.depth == 0) ? jmitem->basetype : jxs_type_array;
+	jmitem->rule = JXS_RULE_KEEP_RAW;
+	/* Increase the jmapper reference count */
+	if (subjm) {
+		jmap_head_t *head = get_jmhead(subjm);
+		head->ref++;
+	}
+	/* increment the index */
+	jmhead->idx++;
+	return jmitem;
+}
+
+static int check_ref_count(jxs_mapper *mapper)
+{
+	jmap_head_t *head = get_jmhead(mapper);
+	if (head->ref != 0) {
+		jxs_log(JXS_LOG_ERROR, "The return value of the descriptor callback "
+		        "function is incorrect, it needs to be the top-level mapper, "
+		        "otherwise, a memory leak will occur.\n");
+		return -1;
+	}
+	/*set top-level mapper reference count is 1 */
+	head->ref = 1;
+	return 0;
+}
+
+/**
+ * @brief Monotonic clock of the statistics in nanoseconds. It is 0 while the
+ * statistics are off(or there is no such clock), a phase timed with
+ * @ref jxs_stats_since() costs nothing then.
+ */
+static uint64_t jxs_stats_clock(void)
+{
+#ifdef JXS_HAVE_POSIX
+	struct timespec ts;
+	if (jxs_atomic_load(&jxs_stats_on) && (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)) {
+		return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+	}
+#endif
+	return 0;
+}
+
+/* nanoseconds since 'start' from jxs_stats_clock(), 0 if it wasn't read */
+static uint64_t jxs_stats_since(uint64_t start)
+{
+	uint64_t now = start ? jxs_stats_clock() : 0;
+	return (now > start) ? now - start : 0;
+}
+
+/**
+ * @brief Add every counter of 'src' to 'dst'.
+ * @param shared  'dst' is read and written by other threads(the process-wide one).
+ */
+static void jxs_stats_merge(jxs_stats *dst, const jxs_stats *src, bool shared)
+{
+	uint64_t       *d = (uint64_t *)dst;
+	const uint64_t *v = (const uint64_t *)src;
+	size_t          i = 0;
+	for (i = 0; i < sizeof(jxs_stats) / sizeof(uint64_t); i++) {
+		if (v[i] == 0) {
+			continue;
+		}
+		if (shared) {
+			jxs_stats_add(&d[i], v[i]);
+		} else {
+			d[i] += v[i];
+		}
+	}
+}
+
+/**
+ * @brief End of a conversion call: count it, and add the counters of the
+ * call to the process-wide statistics.
+ * @param ret  result of the call.
+ * @return ret.
+ */
+static int jmap_stats_commit(jmap_context_t *ctx, int ret)
+{
+	if (jxs_atomic_load(&jxs_stats_on)) {
+		ctx->stats.calls  = 1;
+		ctx->stats.errors = (ret != 0) ? 1 : 0;
+		jxs_stats_merge(&jxs_stats_all, &ctx->stats, true);
+	}
+	return ret;
+}
+
+/**
+ * @brief Prepare the per-call context of a conversion with a loaded schema.
+ * The schema itself is never written during the conversion, the struct address
+ * is carried down the traversal instead. The locator buffers are left as they
+ * are, they are formatted on demand from the path stack.
+ * @param schema   loaded schema, NULL when the descriptor is about to run.
+ */
+static void jmap_context_init(jmap_context_t *ctx, const jxs_schema *schema,
+                              void *stptr, void *opaque)
+{
+	memset(&ctx->buf, 0, sizeof(ctx->buf));
+	memset(&ctx->now, 0, sizeof(ctx->now));
+	memset(&ctx->stats, 0, sizeof(ctx->stats));
+	ctx->start_addr       = stptr;
+	ctx->opaque           = opaque;
+	ctx->merge            = false;
+	ctx->path.depth       = 0;
+	ctx->path.built       = 0;
+	ctx->convert.rule     = 0;
+	ctx->convert.callback = schema ? schema->callback : NULL;
+}
+
+/**
+ * @brief Run the descriptor and keep the mapper tree it describes.
+ * @param schema   schema to fill.
+ * @param buffer   mapper buffer, NULL to take every mapper from the arena.
+ * @param buflen   number of mappers in buffer.
+ * @param func     struct descriptor.
+ * @param opaque   user opaque data, passed to the descriptor.
+ * @param need     if not NULL, returns the buffer length that would have held
+ *                 every mapper, even when the descriptor failed.
+ * @param stats    if not NULL, returns the statistics of the descriptor run.
+ * @return 0 for success, -1 for error.
+ */
+static int jxs_schema_load(jxs_schema *schema, jxs_mapper *buffer, size_t buflen,
+                           jxs_descriptor func, void *opaque, size_t *need, jxs_stats *stats)
+{
+	int            ret    = 0;
+	jxs_mapper    *mapper = NULL;
+	uint64_t       start  = jxs_stats_clock();
+	jmap_context_t ctx;
+	memset(schema, 0, sizeof(jxs_schema));
+	jmap_context_init(&ctx, NULL, NULL, opaque);
+	ctx.buf.arr   = buffer;
+	ctx.buf.len   = buflen;
+	ctx.buf.arena = &schema->arena;
+	if (func == NULL) {
+		jxs_log(JXS_LOG_ERROR, "constructor cannot be null.\n");
+		ret = -1;
+		goto end;
+	}
+	if ((mapper = func(&ctx)) == NULL) {
+		jxs_log(JXS_LOG_ERROR, "mapper cannot be null.\n");
+		jxs_arena_release(&schema->arena);
+		ret = -1;
+		goto end;
+	}
+	if (check_ref_count(mapper) != 0) {
+		jxs_log(JXS_LOG_ERROR, "Incorrect mapper returned.\n");
+		jxs_arena_release(&schema->arena);
+		ret = -1;
+		goto end;
+	}
+	jmap_index_build(mapper);
+	schema->mapper   = mapper;
+	schema->callback = ctx.convert.callback;
+end:
+	if (need) {
+		*need = ctx.buf.need;
+	}
+	/* not a conversion, only the time and the mappers from heap are counted */
+	if (jxs_atomic_load(&jxs_stats_on)) {
+		ctx.stats.descriptor_ns = jxs_stats_since(start);
+		jxs_stats_merge(&jxs_stats_all, &ctx.stats, true);
+	}
+	if (stats && jxs_atomic_load(&jxs_stats_on)) {
+		*stats = ctx.stats;
+	}
+	return ret;
+}
+
+static void jxs_schema_unload(jxs_schema *schema)
+{
+	jxs_log(JXS_LOG_INFO, "JMAP DELETE[%p]\n", schema->mapper);
+	jxs_arena_release(&schema->arena);
+	schema->mapper = NULL;
+}
+
+jxs_schema *jxs_schema_compile(jxs_descriptor func, void *opaque)
+{
+	jxs_schema *schema = NULL;
+	schema = (jxs_schema *)jxs_calloc(1, sizeof(jxs_schema));
+	if (schema == NULL) {
+		jxs_log(JXS_LOG_ERROR, "schema new failed.\n");
+		return NULL;
+	}
+	/* No buffer, every mapper is in the arena owned by the schema */
+	if (jxs_schema_load(schema, NULL, 0, func, opaque, NULL, NULL) != 0) {
+		jxs_log(JXS_LOG_ERROR, "schema compile failed.\n");
+		jxs_free(schema);
+		return NULL;
+	}
+	return schema;
+}
+
+void jxs_schema_free(jxs_schema *schema)
+{
+	if (schema) {
+		jxs_schema_unload(schema);
+		jxs_free(schema);
+	}
+}
+
+void jxs_print_struct_with_schema(const jxs_schema *schema, void *stptr, void *opaque)
+{
+	jmap_context_t ctx;
+	if ((schema == NULL) || (stptr == NULL)) {
+		jxs_log(JXS_LOG_ERROR, "schema or struct cannot be null.\n");
+		return;
+	}
+	jmap_context_init(&ctx, schema, stptr, opaque);
+	jmap_struct_print(&ctx, schema->mapper, (uint8_t *)stptr);
+}
+
+void jxs_print_struct(jxs_descriptor func, void *stptr, void *opaque)
+{
+	jxs_schema schema;
+	jxs_mapper buffer[MAPPER_BUFFER_LENGTH];
+	if ((func == NULL) || (stptr == NULL)) {
+		jxs_log(JXS_LOG_ERROR, "constructor or struct cannot be null.\n");
+		return;
+	}
+	if (jxs_schema_load(&schema, buffer, JXS_NELEM(buffer), func, opaque, NULL, NULL) != 0) {
+		return;
+	}
+	jxs_print_struct_with_schema(&schema, stptr, opaque);
+	jxs_schema_unload(&schema);
+}
+
+json_object *jxs_struct_to_json_object_with_schema(const jxs_schema *schema,
+                                                   void *stptr, void *opaque)
+{
+	json_object   *jso   = NULL;
+	uint64_t       start = jxs_stats_clock();
+	jmap_context_t ctx;
+	jmap_context_init(&ctx, schema, stptr, opaque);
+	if ((schema == NULL) || (stptr == NULL)) {
+		jxs_log(JXS_LOG_ERROR, "schema or struct cannot be null.\n");
+		jmap_stats_commit(&ctx, -1);
+		return NULL;
+	}
+	jso = json_object_new_object();
+	if (jso == NULL) {
+		jxs_log(JXS_LOG_ERROR, "json_object new failed.\n");
+		jmap_stats_commit(&ctx, -1);
+		return NULL;
+	}
+	if (jmap_to_json_object(&ctx, schema->mapper, (uint8_t *)stptr, jso) != 0) {
+		jxs_log(JXS_LOG_ERROR, "jmap to json [%p] error.\n", jso);
+		json_object_put(jso);
+		jso = NULL;
+	}
+	ctx.stats.convert_ns = jxs_stats_since(start);
+	jmap_stats_commit(&ctx, (jso != NULL) ? 0 : -1);
+	return jso;
+}
+
+json_object *jxs_struct_to_json_object(jxs_descriptor func,
+                                       void *stptr, void *opaque)
+{
+	json_object *jso = NULL;
+	jxs_schema   schema;
+	jxs_mapper   buffer[MAPPER_BUFFER_LENGTH];
+	if ((func == NULL) || (stptr == NULL)) {
+		jxs_log(JXS_LOG_ERROR, "constructor or struct cannot be null.\n");
+		return NULL;
+	}
+	if (jxs_schema_load(&schema, buffer, JXS_NELEM(buffer), func, opaque, NULL, NULL) != 0) {
+		return NULL;
+	}
+	jso = jxs_struct_to_json_object_with_schema(&schema, stptr, opaque);
+	jxs_schema_unload(&schema);
+	return jso;
+}
+
+int jxs_struct_from_json_object_with_schema(const jxs_schema *schema, void *stptr,
+                                            void *opaque, json_object *jso)
+{
+	int            ret   = 0;
+	uint64_t       start = jxs_stats_clock();
+	jmap_context_t ctx;
+	jmap_context_init(&ctx, schema, stptr, opaque);
+	if ((schema == NULL) || (stptr == NULL) || (jso == NULL)) {
+		jxs_log(JXS_LOG_ERROR, "schema, struct or jso cannot be null.\n");
+		return jmap_stats_commit(&ctx, -1);
+	}
+	if (jmap_from_json_object(&ctx, schema->mapper, (uint8_t *)stptr, jso) != 0) {
+		jxs_log(JXS_LOG_ERROR, "jmap from json [%p] error.\n", jso);
+		ret = -1;
+	}
+	ctx.stats.convert_ns = jxs_stats_since(start);
+	return jmap_stats_commit(&ctx, ret);
+}
+
+int jxs_struct_from_json_object(jxs_descriptor func,
+                                void *stptr, void *opaque, json_object *jso)
+{
+	int        ret = 0;
+	jxs_schema schema;
+	jxs_mapper buffer[MAPPER_BUFFER_LENGTH];
+	if ((func == NULL) || (stptr == NULL) || (jso == NULL)) {
+		jxs_log(JXS_LOG_ERROR, "constructor, struct or jso cannot be null.\n");
+		return -1;
+	}
+	if (jxs_schema_load(&schema, buffer, JXS_NELEM(buffer), func, opaque, NULL, NULL) != 0) {
+		return -1;
+	}
+	ret = jxs_struct_from_json_object_with_schema(&schema, stptr, opaque, jso);
+	jxs_schema_unload(&schema);
+	return ret;
+}
+
+/**
+ * @brief Write the whole struct as json text into the write buffer.
+ * @param ctx      conversion context storage, it is initialized here.
+ * @return 0 for success, -1 for error.
+ */
+static int jmap_struct_to_wbuf(jmap_context_t *ctx, const jxs_schema *schema,
+                               void *stptr, void *opaque, jxs_wbuf *wbuf, int flags)
+{
+	int      ret    = -1;
+	uint64_t start  = jxs_stats_clock();
+	size_t   mark   = wbuf->len;
+	size_t   allocs = wbuf->allocs;
+	jmap_context_init(ctx, schema, stptr, opaque);
+	if ((schema == NULL) || (stptr == NULL)) {
+		jxs_log(JXS_LOG_ERROR, "schema or struct cannot be null.\n");
+		return -1;
+	}
+	if (jmap_write_object(ctx, schema->mapper, (uint8_t *)stptr, wbuf, 0, flags) != 0) {
+		jxs_log(JXS_LOG_ERROR, "jmap to json text error.\n");
+		goto end;
+	}
+	wbuf_finish(wbuf);
+	if (wbuf->err) {
+		jxs_log(JXS_LOG_ERROR, "json text out of memory.\n");
+		goto end;
+	}
+	ctx->stats.bytes_out = wbuf->len - mark;
+	ret                  = 0;
+end:
+	ctx->stats.allocs  += wbuf->allocs - allocs;
+	ctx->stats.parse_ns = jxs_stats_since(start);
+	return ret;
+}
+
+const char *jxs_struct_to_json_string_ext_with_schema(const jxs_schema *schema, void *stptr,
+                                                      void *opaque, int flags)
+{
+	jxs_wbuf       wbuf;
+	jmap_context_t ctx;
+	memset(&wbuf, 0, sizeof(jxs_wbuf));
+	if (jmap_stats_commit(&ctx, jmap_struct_to_wbuf(&ctx, schema, stptr, opaque, &wbuf, flags)) != 0) {
+		jxs_log(JXS_LOG_ERROR, "struct to json string failed.\n");
+		wbuf_release(&wbuf);
+		return NULL;
+	}
+	/* the buffer is handed over to the caller, free it by jxs_free_json_string() */
+	return wbuf.data;
+}
+
+const char *jxs_struct_to_json_string_ext(jxs_descriptor func, void *stptr,
+                                          void *opaque, int flags)
+{
+	const char *copy = NULL;
+	jxs_schema  schema;
+	jxs_mapper  buffer[MAPPER_BUFFER_LENGTH];
+	if ((func == NULL) || (stptr == NULL)) {
+		jxs_log(JXS_LOG_ERROR, "constructor or struct cannot be null.\n");
+		return NULL;
+	}
+	if (jxs_schema_load(&schema, buffer, JXS_NELEM(buffer), func, opaque, NULL, NULL) != 0) {
+		return NULL;
+	}
+	copy = jxs_struct_to_json_string_ext_with_schema(&schema, stptr, opaque, flags);
+	jxs_schema_unload(&schema);
+	return copy;
+}
+
+const char *jxs_struct_to_json_string_with_schema(const jxs_schema *schema,
+                                                  void *stptr, void *opaque)
+{
+#ifdef JSON_C_TO_STRING_PLAIN
+	return jxs_struct_to_json_string_ext_with_schema(schema, stptr, opaque, JSON_C_TO_STRING_PLAIN);
+#else
+	return jxs_struct_to_json_string_ext_with_schema(schema, stptr, opaque, 0);
+#endif
+}
+
+const char *jxs_struct_to_json_string(jxs_descriptor func, void *stptr, void *opaque)
+{
+#ifdef JSON_C_TO_STRING_PLAIN
+	return jxs_struct_to_json_string_ext(func, stptr, opaque, JSON_C_TO_STRING_PLAIN);
+#else
+	return jxs_struct_to_json_string_ext(func, stptr, opaque, 0);
+#endif
+}
+
+void jxs_free_json_string(char *jstring)
+{
+	if (jstring) {
+		jxs_free(jstring);
+	}
+}
+
+/**
+ * @brief Parse the json text straight into the struct.
+ * @param ctx      conversion context storage, it is initialized here.
+ * @param merge    true to apply the text as a merge patch.
+ * @return 0 for success, -1 for error.
+ */
+static int jmap_struct_from_text(jmap_context_t *ctx, const jxs_schema *schema,
+                                 void *stptr, void *opaque, const char *text, size_t len,
+                                 bool merge)
+{
+	int        c     = 0;
+	int        ret   = -1;
+	uint64_t   start = jxs_stats_clock();
+	jxs_reader rd;
+	jmap_context_init(ctx, schema, stptr, opaque);
+	if ((schema == NULL) || (stptr == NULL)) {
+		jxs_log(JXS_LOG_ERROR, "schema or struct cannot be null.\n");
+		return -1;
+	}
+	rd_init(&rd, text, len);
+	ctx->merge = merge;
+	c = rd_peek(&rd);
+	if ((c < 0) || rd_null(&rd)) {
+		jxs_log(JXS_LOG_ERROR, "json text is empty or null.\n");
+		goto end;
+	}
+	if (c == '{') {
+		if (jmap_read_object(ctx, schema->mapper, (uint8_t *)stptr, &rd) != 0) {
+			jxs_log(JXS_LOG_ERROR, "jmap from json text error.\n");
+			goto end;
+		}
+	} else {
+		/* not an object, every member is cleared like json-c does */
+		if ((rd_skip_value(&rd) != 0) ||
+		    (jmap_read_object(ctx, schema->mapper, (uint8_t *)stptr, NULL) != 0)) {
+			jxs_log(JXS_LOG_ERROR, "jmap from json text error.\n");
+			goto end;
+		}
+	}
+	ret = 0;
+end:
+	ctx->stats.bytes_in = len;
+	ctx->stats.parse_ns = jxs_stats_since(start);
+	return ret;
+}
+
+int jxs_struct_from_json_string_with_schema(const jxs_schema *schema,
+                                            void *stptr, void *opaque,
+                                            const char *jstring)
+{
+	jmap_context_t ctx;
+	if (jstring == NULL) {
+		jxs_log(JXS_LOG_ERROR, "json string cannot be null.\n");
+		return -1;
+	}
+	if (jmap_stats_commit(&ctx, jmap_struct_from_text(&ctx, schema, stptr, opaque, jstring,
+	                                                  strlen(jstring), false)) != 0) {
+		jxs_log(JXS_LOG_ERROR, "json string parse error.\n");
+		return -1;
+	}
+	return 0;
+}
+
+int jxs_struct_from_json_string(jxs_descriptor func,
+                                void *stptr, void *opaque,
+                                const char *jstring)
+{
+	int        ret = 0;
+	jxs_schema schema;
+	jxs_mapper buffer[MAPPER_BUFFER_LENGTH];
+	if (jstring == NULL) {
+		jxs_log(JXS_LOG_ERROR, "json string cannot be null.\n");
+		return -1;
+	}
+	if (jxs_schema_load(&schema, buffer, JXS_NELEM(buffer), func, opaque, NULL, NULL) != 0) {
+		return -1;
+	}
+	ret = jxs_struct_from_json_string_with_schema(&schema, stptr, opaque, jstring);
+	jxs_schema_unload(&schema);
+	return ret;
+}
+
+int jxs_struct_patch_from_json_string(const jxs_schema *schema, void *stptr,
+                                      void *opaque, const char *jstring)
+{
+	jmap_context_t ctx;
+	if (jstring == NULL) {
+		jxs_log(JXS_LOG_ERROR, "json string cannot be null.\n");
+		return -1;
+	}
+	if (jmap_stats_commit(&ctx, jmap_struct_from_text(&ctx, schema, stptr, opaque, jstring,
+	                                                  strlen(jstring), true)) != 0) {
+		jxs_log(JXS_LOG_ERROR, "json merge patch parse error.\n");
+		return -1;
+	}
+	return 0;
+}
+
+int jxs_struct_patch_from_json_object(const jxs_schema *schema, void *stptr,
+                                      void *opaque, json_object *jso)
+{
+	int            ret   = 0;
+	uint64_t       start = jxs_stats_clock();
+	jmap_context_t ctx;
+	jmap_context_init(&ctx, schema, stptr, opaque);
+	if ((schema == NULL) || (stptr == NULL) || (jso == NULL)) {
+		jxs_log(JXS_LOG_ERROR, "schema, struct or jso cannot be null.\n");
+		return jmap_stats_commit(&ctx, -1);
+	}
+	ctx.merge = true;
+	if (jmap_from_json_object(&ctx, schema->mapper, (uint8_t *)stptr, jso) != 0) {
+		jxs_log(JXS_LOG_ERROR, "jmap merge patch [%p] error.\n", jso);
+		ret = -1;
+	}
+	ctx.stats.convert_ns = jxs_stats_since(start);
+	return jmap_stats_commit(&ctx, ret);
+}
+
+#ifdef JXS_HAVE_POSIX
+/**
+ * @brief Write all the data to the descriptor, in one write() unless the
+ * system splits it.
+ * @return 0 for success, -1 for error.
+ */
+static int jxs_fd_write(int fd, const char *data, size_t len)
+{
+	while (len > 0) {
+		ssize_t n = write(fd, data, len);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		data += n;
+		len  -= (size_t)n;
+	}
+	return 0;
+}
+
+/**
+ * @brief fsync() the directory of the file, so a rename in it is durable.
+ */
+static int jxs_dir_sync(const char *filename)
+{
+	int         ret   = 0;
+	int         fd    = -1;
+	char       *dir   = NULL;
+	const char *slash = strrchr(filename, '/');
+	if (slash == NULL) {
+		fd = open(".", O_RDONLY);
+	} else if (slash == filename) {
+		fd = open("/", O_RDONLY);
+	} else if ((dir = (char *)jxs_malloc((size_t)(slash - filename) + 1)) != NULL) {
+		memcpy(dir, filename, (size_t)(slash - filename));
+		dir[slash - filename] = '\0';
+		fd = open(dir, O_RDONLY);
+		jxs_free(dir);
+	}
+	if ((fd < 0) || (fsync(fd) != 0)) {
+		ret = -1;
+	}
+	if (fd >= 0) {
+		close(fd);
+	}
+	return ret;
+}
+
+/**
+ * @brief Replace the file with the data: it is written to a new file next to
+ * it, which is then renamed over it. A crash leaves either the old file or
+ * the new one, never a part of it. A symbolic link is followed, the file it
+ * points to is replaced. The new file keeps the mode of the old one, and its
+ * owner and group when the process is allowed to set them.
+ * @return 0 for success, -1 for error.
+ */
+static int jxs_file_replace(const char *filename, const char *data, size_t len, jxs_sync sync)
+{
+	int         ret     = -1;
+	int         fd      = -1;
+	int         i       = 0;
+	size_t      size    = 0;
+	char       *tmpname = NULL;
+	const char *path    = filename;
+	char        real[PATH_MAX];
+	struct stat st;
+	/* the target of a link, a file that doesn't exist yet is created as named */
+	if (realpath(filename, real) != NULL) {
+		path = real;
+	}
+	size    = strlen(path) + 32;
+	tmpname = (char *)jxs_malloc(size);
+	if (tmpname == NULL) {
+		jxs_log(JXS_LOG_ERROR, "malloc error.\n");
+		return -1;
+	}
+	for (i = 0; (i < 100) && (fd < 0); i++) {
+		snprintf(tmpname, size, "%s.%ld.%d.tmp", path, (long)getpid(), i);
+		fd = open(tmpname, O_WRONLY | O_CREAT | O_EXCL, 0666);
+		if ((fd < 0) && (errno != EEXIST)) {
+			break;
+		}
+	}
+	if (fd < 0) {
+		jxs_log(JXS_LOG_ERROR, "open file [%s] error.\n", tmpname);
+		goto end;
+	}
+	if (stat(path, &st) == 0) {
+		/* the owner first, fchown() clears the set-id bits of the mode */
+		if (((st.st_uid != geteuid()) || (st.st_gid != getegid())) &&
+		    (fchown(fd, st.st_uid, st.st_gid) != 0)) {
+			jxs_log(JXS_LOG_WARN, "keep the owner of file [%s] error.\n", filename);
+		}
+		if (fchmod(fd, st.st_mode & 07777) != 0) {
+			jxs_log(JXS_LOG_WARN, "keep the mode of file [%s] error.\n", filename);
+		}
+	}
+	if (jxs_fd_write(fd, data, len) != 0) {
+		jxs_log(JXS_LOG_ERROR, "write file [%s] error.\n", tmpname);
+		goto end;
+	}
+	if ((sync != JXS_SYNC_NONE) && (jxs_fdatasync(fd) != 0)) {
+		jxs_log(JXS_LOG_ERROR, "sync file [%s] error.\n", tmpname);
+		goto end;
+	}
+	if (close(fd) != 0) {
+		fd = -1;
+		jxs_log(JXS_LOG_ERROR, "write file [%s] error.\n", tmpname);
+		goto end;
+	}
+	fd = -1;
+	if (rename(tmpname, path) != 0) {
+		jxs_log(JXS_LOG_ERROR, "rename file [%s] to [%s] error.\n", tmpname, path);
+		goto end;
+	}
+	tmpname[0] = '\0';
+	if ((sync != JXS_SYNC_NONE) && (jxs_dir_sync(path) != 0)) {
+		jxs_log(JXS_LOG_ERROR, "sync the directory of file [%s] error.\n", filename);
+		goto end;
+	}
+	ret = 0;
+end:
+	if (fd >= 0) {
+		close(fd);
+	}
+	if (tmpname[0] != '\0') {
+		unlink(tmpname);
+	}
+	jxs_free(tmpname);
+	return ret;
+}
+#endif
+
+int jxs_struct_to_file_sync(const jxs_schema *schema, void *stptr, void *opaque,
+                            const char *filename, int flags, jxs_sync sync)
+{
+	int            ret   = 0;
+	uint64_t       start = 0;
+	jxs_wbuf       wbuf;
+	jmap_context_t ctx;
+#ifndef JXS_HAVE_POSIX
+	FILE          *fp  = NULL;
+	size_t         len = 0;
+#endif
+	memset(&wbuf, 0, sizeof(jxs_wbuf));
+	jmap_context_init(&ctx, schema, stptr, opaque);
+	if (filename == NULL) {
+		jxs_log(JXS_LOG_ERROR, "filename cannot be null.\n");
+		ret = -1;
+		goto end;
+	}
+	if (jmap_struct_to_wbuf(&ctx, schema, stptr, opaque, &wbuf, flags) != 0) {
+		jxs_log(JXS_LOG_ERROR, "struct to json text failed.\n");
+		ret = -1;
+		goto end;
+	}
+	start = jxs_stats_clock();
+#ifdef JXS_HAVE_POSIX
+	if (jxs_file_replace(filename, wbuf.data, wbuf.len, sync) != 0) {
+		jxs_log(JXS_LOG_ERROR, "json to file [%s] error.\n", filename);
+		ret = -1;
+		goto end;
+	}
+#else
+	/* no portable atomic replace, write the file in place */
+	(void)sync;
+	if ((fp = fopen(filename, "wb")) == NULL) {
+		jxs_log(JXS_LOG_ERROR, "open file [%s] error.\n", filename);
+		ret = -1;
+		goto end;
+	}
+	len = fwrite(wbuf.data, 1, wbuf.len, fp);
+	if ((fclose(fp) != 0) || (len != wbuf.len)) {
+		jxs_log(JXS_LOG_ERROR, "json to file [%s] error.\n", filename);
+		ret = -1;
+		goto end;
+	}
+#endif
+end:
+	ctx.stats.io_ns = jxs_stats_since(start);
+	wbuf_release(&wbuf);
+	return jmap_stats_commit(&ctx, ret);
+}
+
+int jxs_struct_to_file_ext_with_schema(const jxs_schema *schema,
+                                       void *stptr, void *opaque,
+                                       const char *filename, int flags)
+{
+	return jxs_struct_to_file_sync(schema, stptr, opaque, filename, flags, JXS_SYNC_NONE);
+}
+
+int jxs_struct_to_file_ext(jxs_descriptor func,
+                           void *stptr, void *opaque,
+                           const char *filename, int flags)
+{
+	int        ret = 0;
+	jxs_schema schema;
+	jxs_mapper buffer[MAPPER_BUFFER_LENGTH];
+	if (filename == NULL) {
+		jxs_log(JXS_LOG_ERROR, "filename cannot be null.\n");
+		return -1;
+	}
+	if (jxs_schema_load(&schema, buffer, JXS_NELEM(buffer), func, opaque, NULL, NULL) != 0) {
+		return -1;
+	}
+	ret = jxs_struct_to_file_ext_with_schema(&schema, stptr, opaque, filename, flags);
+	jxs_schema_unload(&schema);
+	return ret;
+}
+
+int jxs_struct_to_file_with_schema(const jxs_schema *schema,
+                                   void *stptr, void *opaque, const char *filename)
+{
+#ifdef JSON_C_TO_STRING_PLAIN
+	return jxs_struct_to_file_ext_with_schema(schema, stptr, opaque,
+	                                          filename, JSON_C_TO_STRING_PLAIN);
+#else
+	return jxs_struct_to_file_ext_with_schema(schema, stptr, opaque, filename, 0);
+#endif
+}
+
+int jxs_struct_to_file(jxs_descriptor func,
+                       void *stptr, void *opaque, const char *filename)
+{
+#ifdef JSON_C_TO_STRING_PLAIN
+	return jxs_struct_to_file_ext(func, stptr, opaque,
+	                              filename, JSON_C_TO_STRING_PLAIN);
+#else
+	return jxs_struct_to_file_ext(func, stptr, opaque, filename, 0);
+#endif
+}
+
+/**
+ * @brief Whether a struct member(or array element) holds the same value in
+ * both structs. One memcmp() settles most of them, whole sub-structs and
+ * arrays included. Only when the bytes differ are strings compared up to their
+ * terminator, json_objects by value, and sub-structs member by member(the
+ * padding and the bytes after a string terminator don't count).
+ */
+static bool jmap_diff_equal(jmap_item_t *jmitem, size_t idx,
+                            const uint8_t *oldbase, const uint8_t *newbase)
+{
+	size_t         i    = 0;
+	size_t         off  = (size_t)jmitem->offset + jmitem->size * idx;
+	const uint8_t *oldp = oldbase + off;
+	const uint8_t *newp = newbase + off;
+	if (memcmp(oldp, newp, jmitem->size) == 0) {
+		return true;
+	}
+	switch (jmitem->type) {
+	case jxs_type_null:
+		return true;
+
+	case jxs_type_string:
+		return strncmp((const char *)oldp, (const char *)newp, jmitem->size) == 0;
+
+	case jxs_type_object:
+		return json_object_equal(*((json_object *const *)oldp), *((json_object *const *)newp)) != 0;
+
+	case jxs_type_struct: {
+		jmap_head_t *jmhead = NULL;
+		jmap_list_t *jmlist = NULL;
+		if (jmitem->subjm == NULL) {
+			return false;
+		}
+		jmhead = get_jmhead(jmitem->subjm);
+		jmlist = get_jmlist(jmitem->subjm);
+		for (i = 0; i < jmhead->idx; i++) {
+			if (!jmap_diff_equal(&jmlist[i], 0, oldp, newp)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	case jxs_type_array: {
+		jmap_item_t new_jmitem;
+		jmap_array_move_next_dimen(&new_jmitem, jmitem, idx);
+		for (i = 0; i < new_jmitem.arr.length; i++) {
+			if (!jmap_diff_equal(&new_jmitem, i, oldbase, newbase)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	default:
+		return false;
+	}
+}
+
+/**
+ * @brief Write a merge patch object(RFC 7386) with the members that differ.
+ * Sub-structs are diffed member by member, any other member that differs is
+ * written whole(json has no way to patch a part of an array).
+ * @return 1 for a member written, 0 for none, -1 for error.
+ */
+static int jmap_diff_merge(jmap_context_t *ctx, jxs_mapper *mapper, const uint8_t *oldbase,
+                           uint8_t *newbase, jxs_wbuf *wbuf, int flags)
+{
+	int          ret          = 0;
+	size_t       i            = 0;
+	size_t       mark         = 0;
+	bool         had_children = false;
+	size_t       depth        = ctx->path.depth;
+	jmap_head_t *jmhead       = get_jmhead(mapper);
+	jmap_list_t *jmlist       = get_jmlist(mapper);
+	wbuf_putc(wbuf, '{');
+	for (i = 0; i < jmhead->idx; i++) {
+		jmap_item_t *jmitem = &jmlist[i];
+		if (jmap_diff_equal(jmitem, 0, oldbase, newbase)) {
+			continue;
+		}
+		ctx->now.jmitem = jmitem;
+		ctx->now.idx    = 0;
+		jmap_path_enter(ctx, depth, jmitem->key, 0);
+		mark = wbuf->len;
+		if ((jmitem->type == jxs_type_struct) && (jmitem->subjm != NULL)) {
+			jmap_write_prefix(wbuf, jmitem->key, had_children, 0, flags);
+			ret = jmap_diff_merge(ctx, jmitem->subjm, oldbase + jmitem->offset,
+			                      newbase + jmitem->offset, wbuf, flags);
+		} else {
+			/* written: 0 -> 1, deleted by the rules: 1 -> 0 */
+			ret = jmap_write_warpper(ctx, newbase, jmitem, 0, wbuf, jmitem->key,
+			                         had_children, 0, flags);
+			ret = (ret < 0) ? ret : !ret;
+		}
+		if (ret == -1) {
+			jmap_path_leave(ctx, depth);
+			jxs_log(JXS_LOG_ERROR, "%s: jmap diff error.\n", jmap_locator(ctx));
+			return -1;
+		} else if (ret == 1) {
+			had_children = true;
+		} else {
+			/* only the padding differs */
+			wbuf->len = mark;
+		}
+	}
+	jmap_path_leave(ctx, depth);
+	wbuf_putc(wbuf, '}');
+	return had_children ? 1 : 0;
+}
+
+/**
+ * @brief Write the locator of the current item as a json pointer(RFC 6901),
+ * "tb[1].icon" is "/tb/1/icon".
+ * @return 0 for success, -1 for error.
+ */
+static int jmap_diff_pointer(jmap_context_t *ctx, jxs_wbuf *wbuf)
+{
+	size_t i = 0;
+	if (ctx->path.depth > JXS_PATH_DEPTH) {
+		jxs_log(JXS_LOG_ERROR, "%s: too deep for a json pointer.\n", jmap_locator(ctx));
+		return -1;
+	}
+	wbuf_putc(wbuf, '"');
+	for (i = 0; i < ctx->path.depth; i++) {
+		const char *key = ctx->path.frame[i].key;
+		wbuf_putc(wbuf, '/');
+		if (key == NULL) {
+			char buf[NUM_BUFSIZE];
+			wbuf_append(wbuf, buf, num_format_u64(buf, ctx->path.frame[i].idx));
+			continue;
+		}
+		/* '~' is "~0" and '/' is "~1" in a pointer */
+		while (*key) {
+			size_t run = strcspn(key, "~/");
+			jmap_write_escaped(wbuf, key, run, JSON_C_TO_STRING_NOSLASHESCAPE);
+			key += run;
+			if (*key) {
+				wbuf_append(wbuf, (*key == '~') ? "~0" : "~1", 2);
+				key++;
+			}
+		}
+	}
+	wbuf_putc(wbuf, '"');
+	return 0;
+}
+
+/**
+ * @brief Write a json patch 'replace' operation(RFC 6902) for every value
+ * that differs below the struct member(or array element).
+ * @return 0 for success, -1 for error.
+ */
+static int jmap_diff_ops(jmap_context_t *ctx, jmap_item_t *jmitem, size_t idx,
+                         const uint8_t *oldbase, uint8_t *newbase, jxs_wbuf *wbuf,
+                         bool *had_children, int flags)
+{
+	size_t i     = 0;
+	size_t mark  = 0;
+	size_t depth = ctx->path.depth;
+	int    ret   = 0;
+	if (jmap_diff_equal(jmitem, idx, oldbase, newbase)) {
+		return 0;
+	}
+	ctx->now.jmitem = jmitem;
+	ctx->now.idx    = idx;
+	if ((jmitem->type == jxs_type_struct) && (jmitem->subjm != NULL)) {
+		size_t       off    = (size_t)jmitem->offset + jmitem->size * idx;
+		jmap_head_t *jmhead = get_jmhead(jmitem->subjm);
+		jmap_list_t *jmlist = get_jmlist(jmitem->subjm);
+		for (i = 0; (i < jmhead->idx) && (ret == 0); i++) {
+			jmap_path_enter(ctx, depth, jmlist[i].key, 0);
+			ret = jmap_diff_ops(ctx, &jmlist[i], 0, oldbase + off, newbase + off,
+			                    wbuf, had_children, flags);
+		}
+		jmap_path_leave(ctx, depth);
+		return ret;
+	} else if (jmitem->type == jxs_type_array) {
+		jmap_item_t new_jmitem;
+		jmap_array_move_next_dimen(&new_jmitem, jmitem, idx);
+		for (i = 0; (i < new_jmitem.arr.length) && (ret == 0); i++) {
+			jmap_path_enter(ctx, depth, NULL, i);
+			ret = jmap_diff_ops(ctx, &new_jmitem, i, oldbase, newbase, wbuf, had_children, flags);
+		}
+		jmap_path_leave(ctx, depth);
+		return ret;
+	}
+	mark = wbuf->len;
+	if (*had_children) {
+		wbuf_putc(wbuf, ',');
+	}
+	wbuf_puts(wbuf, "{\"op\":\"replace\",\"path\":");
+	if (jmap_diff_pointer(ctx, wbuf) != 0) {
+		return -1;
+	}
+	ret = jmap_write_warpper(ctx, newbase, jmitem, idx, wbuf, "value", true, 0, flags);
+	if (ret == -1) {
+		jxs_log(JXS_LOG_ERROR, "%s: jmap diff error.\n", jmap_locator(ctx));
+		return -1;
+	} else if (ret == 1) {
+		/* deleted by the rules */
+		wbuf->len = mark;
+		return 0;
+	}
+	wbuf_putc(wbuf, '}');
+	*had_children = true;
+	return 0;
+}
+
+const char *jxs_struct_diff_to_json(const jxs_schema *schema, const void *oldst, void *newst,
+                                    void *opaque, jxs_patch format, int flags)
+{
+	int            ret   = 0;
+	size_t         i     = 0;
+	uint64_t       start = jxs_stats_clock();
+	jxs_wbuf       wbuf;
+	jmap_context_t ctx;
+	memset(&wbuf, 0, sizeof(jxs_wbuf));
+	jmap_context_init(&ctx, schema, newst, opaque);
+	if ((schema == NULL) || (oldst == NULL) || (newst == NULL)) {
+		jxs_log(JXS_LOG_ERROR, "schema or struct cannot be null.\n");
+		jmap_stats_commit(&ctx, -1);
+		return NULL;
+	}
+	/* a patch is always written compact */
+	flags &= ~(JSON_C_TO_STRING_SPACED | JSON_C_TO_STRING_PRETTY | JSON_C_TO_STRING_PRETTY_TAB);
+	if (format == JXS_PATCH_MERGE) {
+		ret = jmap_diff_merge(&ctx, schema->mapper, (const uint8_t *)oldst, (uint8_t *)newst,
+		                      &wbuf, flags);
+	} else {
+		bool         had_children = false;
+		jmap_head_t *jmhead       = get_jmhead(schema->mapper);
+		jmap_list_t *jmlist       = get_jmlist(schema->mapper);
+		wbuf_putc(&wbuf, '[');
+		for (i = 0; (i < jmhead->idx) && (ret == 0); i++) {
+			jmap_path_enter(&ctx, 0, jmlist[i].key, 0);
+			ret = jmap_diff_ops(&ctx, &jmlist[i], 0, (const uint8_t *)oldst, (uint8_t *)newst,
+			                    &wbuf, &had_children, flags);
+		}
+		jmap_path_leave(&ctx, 0);
+		wbuf_putc(&wbuf, ']');
+	}
+	wbuf_finish(&wbuf);
+	ctx.stats.bytes_out = wbuf.len;
+	ctx.stats.allocs   += wbuf.allocs;
+	ctx.stats.parse_ns  = jxs_stats_since(start);
+	if (jmap_stats_commit(&ctx, ((ret < 0) || wbuf.err) ? -1 : 0) != 0) {
+		jxs_log(JXS_LOG_ERROR, "struct diff to json failed.\n");
+		wbuf_release(&wbuf);
+		return NULL;
+	}
+	/* the buffer is handed over to the caller, free it by jxs_free_json_string() */
+	return wbuf.data;
+}
+
+static inline bool cb_host_le(void)
+{
+	const uint16_t one = 1;
+	return *((const uint8_t *)&one) == 1;
+}
+
+/* head length of an item with the argument 'n' */
+static size_t cb_head_size(uint64_t n)
+{
+	if (n < 24) {
+		return 1;
+	} else if (n <= UINT8_MAX) {
+		return 2;
+	} else if (n <= UINT16_MAX) {
+		return 3;
+	} else if (n <= UINT32_MAX) {
+		return 5;
+	}
+	return 9;
+}
+
+/* store the head of an item, the argument big-endian in 'width - 1' bytes */
+static void cb_head_store(uint8_t *p, int major, uint64_t n, size_t width)
+{
+	size_t i = 0;
+	if (width == 1) {
+		p[0] = (uint8_t)((major << 5) | (int)n);
+		return;
+	}
+	/* 24, 25, 26, 27 for 1, 2, 4, 8 bytes */
+	p[0] = (uint8_t)((major << 5) | ((width == 2) ? 24 : ((width == 3) ? 25 : ((width == 5) ? 26 : 27))));
+	for (i = width - 1; i > 0; i--) {
+		p[i] = (uint8_t)n;
+		n  >>= 8;
+	}
+}
+
+static void cb_put_head(jxs_wbuf *wbuf, int major, uint64_t n)
+{
+	uint8_t head[9];
+	size_t  width = cb_head_size(n);
+	cb_head_store(head, major, n, width);
+	wbuf_append(wbuf, (const char *)head, width);
+}
+
+/**
+ * @brief Leave room for the head of an array or map that holds at most 'max'
+ * items, the real count is stored by @ref cb_head_patch() when the rules have
+ * dropped what they drop. The head keeps the width of 'max', which is still
+ * well-formed CBOR when less items were written.
+ * @return position of the head.
+ */
+static size_t cb_head_reserve(jxs_wbuf *wbuf, uint64_t max)
+{
+	size_t pos = wbuf->len;
+	wbuf_fill(wbuf, 0, cb_head_size(max));
+	return pos;
+}
+
+static void cb_head_patch(jxs_wbuf *wbuf, size_t pos, int major, uint64_t max, uint64_t n)
+{
+	if (!wbuf->err) {
+		cb_head_store((uint8_t *)wbuf->data + pos, major, n, cb_head_size(max));
+	}
+}
+
+static void cb_put_int(jxs_wbuf *wbuf, int64_t value)
+{
+	if (value < 0) {
+		/* -1 - value, without the overflow of INT64_MIN */
+		cb_put_head(wbuf, CBOR_NEGINT, ~(uint64_t)value);
+	} else {
+		cb_put_head(wbuf, CBOR_UINT, (uint64_t)value);
+	}
+}
+
+/**
+ * @brief Write a float as float32, a double as float32 too when it is exact,
+ * or else as float64.
+ */
+static void cb_put_double(jxs_wbuf *wbuf, double value, bool single)
+{
+	uint8_t buf[9];
+	if (single || !isfinite(value) ||
+	    ((fabs(value) <= FLT_MAX) && ((double)(float)value == value))) {
+		float    f    = (float)value;
+		uint32_t bits = 0;
+		memcpy(&bits, &f, sizeof(bits));
+		cb_head_store(buf, CBOR_SIMPLE, bits, 5);
+		wbuf_append(wbuf, (const char *)buf, 5);
+	} else {
+		uint64_t bits = 0;
+		memcpy(&bits, &value, sizeof(bits));
+		cb_head_store(buf, CBOR_SIMPLE, bits, 9);
+		wbuf_append(wbuf, (const char *)buf, 9);
+	}
+}
+
+static void cb_put_text(jxs_wbuf *wbuf, const char *str, size_t len)
+{
+	cb_put_head(wbuf, CBOR_TEXT, len);
+	wbuf_append(wbuf, str, len);
+}
+
+/* write a json_object member, NULL is null */
+static void cb_put_jso(jxs_wbuf *wbuf, json_object *jso)
+{
+	size_t i = 0;
+	switch (json_object_get_type(jso)) {
+	case json_type_boolean:
+		wbuf_putc(wbuf, json_object_get_boolean(jso) ? (char)0xf5 : (char)0xf4);
+		break;
+
+	case json_type_double:
+		cb_put_double(wbuf, json_object_get_double(jso), false);
+		break;
+
+	case json_type_int: {
+		int64_t num = json_object_get_int64(jso);
+		/* saturated, it may be a larger unsigned value */
+		if (num == INT64_MAX) {
+			cb_put_head(wbuf, CBOR_UINT, json_object_get_uint64(jso));
+		} else {
+			cb_put_int(wbuf, num);
+		}
+		break;
+	}
+
+	case json_type_string:
+		cb_put_text(wbuf, json_object_get_string(jso), (size_t)json_object_get_string_len(jso));
+		break;
+
+	case json_type_array:
+		cb_put_head(wbuf, CBOR_ARRAY, json_object_array_length(jso));
+		for (i = 0; i < json_object_array_length(jso); i++) {
+			cb_put_jso(wbuf, json_object_array_get_idx(jso, i));
+		}
+		break;
+
+	case json_type_object: {
+		struct json_object_iterator it  = json_object_iter_begin(jso);
+		struct json_object_iterator end = json_object_iter_end(jso);
+		cb_put_head(wbuf, CBOR_MAP, (uint64_t)json_object_object_length(jso));
+		for (; !json_object_iter_equal(&it, &end); json_object_iter_next(&it)) {
+			const char *key = json_object_iter_peek_name(&it);
+			cb_put_text(wbuf, key, strlen(key));
+			cb_put_jso(wbuf, json_object_iter_peek_value(&it));
+		}
+		break;
+	}
+
+	default:
+		wbuf_putc(wbuf, (char)0xf6);
+		break;
+	}
+}
+
+/**
+ * @brief RFC 8746 typed array tag for the elements of a member, in the host
+ * byte order so the elements are copied as they are.
+ * @return the tag, 0 if the elements have no typed array form.
+ */
+static uint64_t cb_typed_tag(jxs_type type, size_t width)
+{
+	/* 0b010_f_s_e_ll: float, signed, little-endian, log2 of the width */
+	uint64_t ll = (width == 1) ? 0 : ((width == 2) ? 1 : ((width == 4) ? 2 : 3));
+	uint64_t e  = ((width > 1) && cb_host_le()) ? 4 : 0;
+	if ((width != 1) && (width != 2) && (width != 4) && (width != 8)) {
+		return 0;
+	}
+	switch (type) {
+	case jxs_type_int:
+		return CBOR_TAG_TYPED_MIN | 8 | e | ll;
+	case jxs_type_uint:
+		return CBOR_TAG_TYPED_MIN | e | ll;
+	case jxs_type_double:
+		/* float16 is 0, float32 and float64 are 1 and 2 */
+		return (width < 4) ? 0 : (CBOR_TAG_TYPED_MIN | 16 | e | (ll - 1));
+	default:
+		return 0;
+	}
+}
+
+/**
+ * @brief Write a number array as one RFC 8746 typed array, the elements are
+ * copied in one go, inside a multi-dimensional array(tag 40) if it has more
+ * than one dimension. The rules are checked per element, so an array that
+ * has any is left to @ref jmap_cbor_write_array().
+ * @return 0 for written, 1 if the array has no typed form.
+ */
+static int jmap_cbor_write_typed(jmap_context_t *ctx, uint8_t *base, jmap_item_t *jmitem,
+                                 jxs_wbuf *wbuf)
+{
+	size_t   i     = 0;
+	size_t   width = 0;
+	size_t   dims[JXS_ARRAY_DEPTH];
+	size_t   ndims = jmap_array_dims(jmitem, dims, &width);
+	uint64_t tag   = cb_typed_tag(jmitem->basetype, width);
+	if ((tag == 0) || (ctx->convert.callback != NULL) || (jmitem->rule != JXS_RULE_KEEP_RAW)) {
+		return 1;
+	}
+	if (ndims > 1) {
+		cb_put_head(wbuf, CBOR_TAG, CBOR_TAG_MDARRAY);
+		cb_put_head(wbuf, CBOR_ARRAY, 2);
+		cb_put_head(wbuf, CBOR_ARRAY, ndims);
+		for (i = 0; i < ndims; i++) {
+			cb_put_head(wbuf, CBOR_UINT, dims[i]);
+		}
+	}
+	cb_put_head(wbuf, CBOR_TAG, tag);
+	cb_put_head(wbuf, CBOR_BYTES, jmitem->size * jmitem->arr.length);
+	wbuf_append(wbuf, (const char *)base + jmitem->offset, jmitem->size * jmitem->arr.length);
+	ctx->stats.elements += jmitem->size * jmitem->arr.length / width;
+	return 0;
+}
+
+/**
+ * @brief Write one struct member(or array element) as CBOR, integers in their
+ * shortest form, strings with their length.
+ * @return 0 for written, 1 for deleted by the rules, -1 for error.
+ */
+static int jmap_cbor_write_warpper(jmap_context_t *ctx, uint8_t *base, jmap_item_t *jmitem,
+                                   size_t idx, jxs_wbuf *wbuf)
+{
+	json_object *item_jso = NULL;
+	void        *vptr     = base + jmitem->offset;
+	jxs_type     type     = jmitem->type;
+	size_t       size     = jmitem->size;
+	item_action  action   = 0;
+	vptr   = (uint8_t *)vptr + size * idx;
+	action = jmap_convert_handler(ctx, jmitem, vptr, &item_jso);
+	if (action == RULE_ITEM_ERROR) {
+		jxs_log(JXS_LOG_WARN, "Rules handling error, skip rules.\n");
+	} else if (action == RULE_ITEM_DELETE) {
+		/* delete current item */
+		return 1;
+	} else if (action == RULE_ITEM_SET) {
+		/* rules only set null */
+		wbuf_putc(wbuf, (char)0xf6);
+		return 0;
+	}
+	switch (type) {
+	case jxs_type_boolean:
+		if (TYPEOF(size, int)) {
+			wbuf_putc(wbuf, *((int *)vptr) ? (char)0xf5 : (char)0xf4);
+		} else if (TYPEOF(size, bool)) {
+			wbuf_putc(wbuf, *((bool *)vptr) ? (char)0xf5 : (char)0xf4);
+		} else {
+			jxs_log(JXS_LOG_ERROR, "%s: required type '%s' <sizeof> does not match.\n",
+			        jmap_locator(ctx), type_to_name(type));
+			wbuf_putc(wbuf, (char)0xf6);
+		}
+		break;
+
+	case jxs_type_double:
+		if (TYPEOF(size, double)) {
+			cb_put_double(wbuf, *((double *)vptr), false);
+		} else if (TYPEOF(size, float)) {
+			cb_put_double(wbuf, *((float *)vptr), true);
+		} else {
+			jxs_log(JXS_LOG_ERROR, "%s: required type '%s' <sizeof> does not match.\n",
+			        jmap_locator(ctx), type_to_name(type));
+			wbuf_putc(wbuf, (char)0xf6);
+		}
+		break;
+
+	case jxs_type_int:
+		if (TYPEOF(size, int64_t)) {
+			cb_put_int(wbuf, *((int64_t *)vptr));
+		} else if (TYPEOF(size, int32_t)) {
+			cb_put_int(wbuf, *((int32_t *)vptr));
+		} else if (TYPEOF(size, int16_t)) {
+			cb_put_int(wbuf, *((int16_t *)vptr));
+		} else if (TYPEOF(size, int8_t)) {
+			cb_put_int(wbuf, *((int8_t *)vptr));
+		} else {
+			jxs_log(JXS_LOG_ERROR, "%s: required type '%s' <sizeof> does not match.\n",
+			        jmap_locator(ctx), type_to_name(type));
+			wbuf_putc(wbuf, (char)0xf6);
+		}
+		break;
+
+	case jxs_type_uint:
+		if (TYPEOF(size, uint64_t)) {
+			cb_put_head(wbuf, CBOR_UINT, *((uint64_t *)vptr));
+		} else if (TYPEOF(size, uint32_t)) {
+			cb_put_head(wbuf, CBOR_UINT, *((uint32_t *)vptr));
+		} else if (TYPEOF(size, uint16_t)) {
+			cb_put_head(wbuf, CBOR_UINT, *((uint16_t *)vptr));
+		} else if (TYPEOF(size, uint8_t)) {
+			cb_put_head(wbuf, CBOR_UINT, *((uint8_t *)vptr));
+		} else {
+			jxs_log(JXS_LOG_ERROR, "%s: required type '%s' <sizeof> does not match.\n",
+			        jmap_locator(ctx), type_to_name(type));
+			wbuf_putc(wbuf, (char)0xf6);
+		}
+		break;
+
+	case jxs_type_string: {
+		char *tmpstr = *((char(*)[])vptr);
+		/* a full member may have no terminator */
+		cb_put_text(wbuf, tmpstr, strnlen(tmpstr, size));
+		break;
+	}
+
+	case jxs_type_object:
+		cb_put_jso(wbuf, *((json_object **)vptr));
+		break;
+
+	case jxs_type_struct:
+		if (jmitem->subjm == NULL) {
+			jxs_log(JXS_LOG_ERROR, "%s: Please create a mapper for your nested struct..\n", jmap_locator(ctx));
+			wbuf_putc(wbuf, (char)0xf6);
+			break;
+		}
+		if (jmap_cbor_write_object(ctx, jmitem->subjm, (uint8_t *)vptr, wbuf) != 0) {
+			jxs_log(JXS_LOG_ERROR, "%s: struct to cbor error.\n", jmap_locator(ctx));
+			return -1;
+		}
+		break;
+
+	case jxs_type_array: {
+		jmap_item_t new_jmitem;
+		jmap_array_move_next_dimen(&new_jmitem, jmitem, idx);
+		if (jmap_cbor_write_array(ctx, base, &new_jmitem, wbuf) != 0) {
+			jxs_log(JXS_LOG_ERROR, "%s: array to cbor error.\n", jmap_locator(ctx));
+			return -1;
+		}
+		break;
+	}
+
+	case jxs_type_null:
+		wbuf_putc(wbuf, (char)0xf6);
+		break;
+
+	default:
+		jxs_log(JXS_LOG_ERROR, "%s: error mapper type.\n", jmap_locator(ctx));
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Write an array as CBOR according to array's jmap, a number array as
+ * a typed array.
+ * @return 0 for success, -1 for error.
+ */
+static int jmap_cbor_write_array(jmap_context_t *ctx, uint8_t *base, jmap_item_t *jmitem,
+                                 jxs_wbuf *wbuf)
+{
+	int    ret     = 0;
+	size_t i       = 0;
+	size_t count   = 0;
+	size_t head    = 0;
+	size_t depth   = ctx->path.depth;
+	size_t arr_len = jmitem->arr.length;
+	if ((jmitem->size == 0) || (arr_len == 0)) {
+		jxs_log(JXS_LOG_ERROR, "%s: array 'size', 'len' cannot not be zero.\n", jmap_locator(ctx));
+		return -1;
+	}
+	if (jmap_cbor_write_typed(ctx, base, jmitem, wbuf) == 0) {
+		return 0;
+	}
+	head = cb_head_reserve(wbuf, arr_len);
+	for (i = 0; i < arr_len; i++) {
+		ctx->now.jmitem = jmitem;
+		ctx->now.idx    = i;
+		ctx->stats.elements++;
+		jmap_path_enter(ctx, depth, NULL, i);
+		ret = jmap_cbor_write_warpper(ctx, base, jmitem, i, wbuf);
+		if (ret == -1) {
+			jmap_path_leave(ctx, depth);
+			jxs_log(JXS_LOG_ERROR, "%s: jmap to cbor error.\n", jmap_locator(ctx));
+			return -1;
+		} else if (ret == 0) {
+			count++;
+		} else {
+			jxs_log(JXS_LOG_TRACE, "%s: delete current item.\n", jmap_locator(ctx));
+		}
+	}
+	jmap_path_leave(ctx, depth);
+	cb_head_patch(wbuf, head, CBOR_ARRAY, arr_len, count);
+	return 0;
+}
+
+/**
+ * @brief Write the struct as a CBOR map according to the struct's mapper, the
+ * member keys are text strings.
+ * @return 0 for success, -1 for error.
+ */
+static int jmap_cbor_write_object(jmap_context_t *ctx, jxs_mapper *mapper, uint8_t *base,
+                                  jxs_wbuf *wbuf)
+{
+	int          ret    = 0;
+	size_t       i      = 0;
+	size_t       count  = 0;
+	size_t       head   = 0;
+	size_t       depth  = ctx->path.depth;
+	jmap_head_t *jmhead = get_jmhead(mapper);
+	jmap_list_t *jmlist = get_jmlist(mapper);
+	head = cb_head_reserve(wbuf, jmhead->idx);
+	for (i = 0; i < jmhead->idx; i++) {
+		jmap_item_t *jmitem = &jmlist[i];
+		size_t       mark   = wbuf->len;
+		ctx->now.jmitem = jmitem;
+		ctx->now.idx    = 0;
+		ctx->stats.items++;
+		jmap_path_enter(ctx, depth, jmitem->key, 0);
+		cb_put_text(wbuf, jmitem->key, jmitem->klen);
+		ret = jmap_cbor_write_warpper(ctx, base, jmitem, 0, wbuf);
+		if (ret == -1) {
+			jmap_path_leave(ctx, depth);
+			jxs_log(JXS_LOG_ERROR, "%s: jmap to cbor error.\n", jmap_locator(ctx));
+			return -1;
+		} else if (ret == 0) {
+			count++;
+		} else {
+			/* take the key back */
+			wbuf->len = mark;
+			jxs_log(JXS_LOG_TRACE, "%s: delete current item.\n", jmap_locator(ctx));
+		}
+	}
+	jmap_path_leave(ctx, depth);
+	cb_head_patch(wbuf, head, CBOR_MAP, jmhead->idx, count);
+	return 0;
+}
+
+static inline void cb_init(jxs_cbor *cb, const uint8_t *data, size_t len)
+{
+	cb->start = data;
+	cb->cur   = data;
+	cb->end   = data + len;
+	cb->depth = 0;
+	cb->err   = false;
+}
+
+static void cb_error(jxs_cbor *cb, const char *what)
+{
+	if (!cb->err) {
+		jxs_log(JXS_LOG_ERROR, "cbor parse error at offset %" FMT_SIZE_T ": %s.\n",
+		        (size_t)(cb->cur - cb->start), what);
+	}
+	cb->err = true;
+}
+
+/* the initial byte of the next item, -1 at the end */
+static inline int cb_peek(const jxs_cbor *cb)
+{
+	return (cb->cur < cb->end) ? *cb->cur : -1;
+}
+
+/* consume the 'break' of an indefinite length item */
+static inline bool cb_accept_break(jxs_cbor *cb)
+{
+	if (cb_peek(cb) == CBOR_BREAK) {
+		cb->cur++;
+		return true;
+	}
+	return false;
+}
+
+/**
+ * @brief Read the head of the next item.
+ * @param  major   major type output.
+ * @param  ai      additional information output, CBOR_INDEF for an indefinite
+ *                 length item.
+ * @param  n       argument output, the float bits for a float.
+ * @return 0 for success, -1 for error.
+ */
+static int cb_head(jxs_cbor *cb, int *major, int *ai, uint64_t *n)
+{
+	size_t width = 0;
+	if (cb->cur >= cb->end) {
+		cb_error(cb, "unexpected end of data");
+		return -1;
+	}
+	*major = *cb->cur >> 5;
+	*ai    = *cb->cur & 0x1f;
+	*n     = (uint64_t)*ai;
+	if (*ai < 24) {
+		cb->cur++;
+		return 0;
+	} else if (*ai == CBOR_INDEF) {
+		if ((*major < CBOR_BYTES) || (*major == CBOR_TAG)) {
+			cb_error(cb, "invalid indefinite length");
+			return -1;
+		}
+		cb->cur++;
+		return 0;
+	} else if (*ai > 27) {
+		cb_error(cb, "reserved additional information");
+		return -1;
+	}
+	width = (size_t)1 << (*ai - 24);
+	if ((size_t)(cb->end - cb->cur) <= width) {
+		cb_error(cb, "unexpected end of data");
+		return -1;
+	}
+	for (*n = 0, cb->cur++; width > 0; width--) {
+		*n = (*n << 8) | *cb->cur++;
+	}
+	return 0;
+}
+
+/**
+ * @brief Take 'n' bytes of the content of a byte or text string.
+ * @return start of the bytes, NULL for error.
+ */
+static const uint8_t *cb_take(jxs_cbor *cb, uint64_t n)
+{
+	const uint8_t *p = cb->cur;
+	if (n > (uint64_t)(cb->end - cb->cur)) {
+		cb_error(cb, "string longer than the data");
+		return NULL;
+	}
+	cb->cur += n;
+	return p;
+}
+
+/**
+ * @brief Skip the next item, with everything nested in it.
+ * @return 0 for success, -1 for error.
+ */
+static int cb_skip(jxs_cbor *cb)
+{
+	int      ret   = 0;
+	int      major = 0;
+	int      ai    = 0;
+	uint64_t n     = 0;
+	uint64_t i     = 0;
+	if (cb_head(cb, &major, &ai, &n) != 0) {
+		return -1;
+	}
+	if (++cb->depth > JXS_JSON_MAX_DEPTH) {
+		cb_error(cb, "too deeply nested");
+		return -1;
+	}
+	switch (major) {
+	case CBOR_BYTES:
+	case CBOR_TEXT:
+		if (ai != CBOR_INDEF) {
+			ret = (cb_take(cb, n) == NULL) ? -1 : 0;
+			break;
+		}
+		/* chunks of the same major type, up to the break */
+		while ((ret == 0) && !cb_accept_break(cb)) {
+			if ((cb_peek(cb) >> 5) != major) {
+				cb_error(cb, "invalid string chunk");
+				ret = -1;
+			} else {
+				ret = cb_skip(cb);
+			}
+		}
+		break;
+
+	case CBOR_ARRAY:
+	case CBOR_MAP:
+		if (ai == CBOR_INDEF) {
+			while ((ret == 0) && !cb_accept_break(cb)) {
+				ret = cb_skip(cb);
+			}
+			break;
+		}
+		/* a map has a key and a value per pair */
+		for (i = 0; (ret == 0) && (i < n); i++) {
+			ret = cb_skip(cb);
+			if ((ret == 0) && (major == CBOR_MAP)) {
+				ret = cb_skip(cb);
+			}
+		}
+		break;
+
+	case CBOR_TAG:
+		ret = cb_skip(cb);
+		break;
+
+	case CBOR_SIMPLE:
+		if (ai == CBOR_INDEF) {
+			cb_error(cb, "unexpected break");
+			ret = -1;
+		}
+		break;
+
+	default:
+		break;
+	}
+	cb->depth--;
+	return ret;
+}
+
+/* the next item is null or undefined, it is consumed */
+static bool cb_null(jxs_cbor *cb)
+{
+	int c = cb_peek(cb);
+	if ((c == 0xf6) || (c == 0xf7)) {
+		cb->cur++;
+		return true;
+	}
+	return false;
+}
+
+/* half precision float bits to double */
+static double cb_half_to_double(uint16_t half)
+{
+	int    exp  = (half >> 10) & 0x1f;
+	int    mant = half & 0x3ff;
+	double num  = 0;
+	if (exp == 0) {
+		num = ldexp(mant, -24);
+	} else if (exp != 31) {
+		num = ldexp(mant + 1024, exp - 25);
+	} else {
+		num = (mant == 0) ? INFINITY : NAN;
+	}
+	return (half & 0x8000) ? -num : num;
+}
+
+/**
+ * @brief Copy a text(or byte) string whose head has been read into 'dst',
+ * the chunks of an indefinite length string are joined. It is truncated on a
+ * UTF-8 character boundary to fit, and always terminated.
+ * @param  major  major type of the string.
+ * @return 0 for success, -1 for error.
+ */
+static int cb_string(jxs_cbor *cb, int major, int ai, uint64_t n, char *dst, size_t size)
+{
+	size_t len   = 0;
+	bool   chunk = (ai == CBOR_INDEF);
+	if (size == 0) {
+		return -1;
+	}
+	dst[0]  = '\0';
+	cb->cut = false;
+	do {
+		const uint8_t *p = NULL;
+		if (chunk) {
+			int cmajor = 0;
+			if (cb_accept_break(cb)) {
+				return 0;
+			}
+			if (cb_head(cb, &cmajor, &ai, &n) != 0) {
+				return -1;
+			}
+			/* every chunk is a definite string of the same type */
+			if ((cmajor != major) || (ai == CBOR_INDEF)) {
+				cb_error(cb, "invalid string chunk");
+				return -1;
+			}
+		}
+		if ((p = cb_take(cb, n)) == NULL) {
+			return -1;
+		}
+		if (len < (size - 1)) {
+			if (str_copy_fit(dst + len, size - len, (const char *)p, (size_t)n)) {
+				cb->cut = true;
+			}
+			/* once a chunk is cut, the rest is dropped */
+			len = (strlen(dst + len) < n) ? (size - 1) : (len + (size_t)n);
+		} else if (n > 0) {
+			cb->cut = true;
+		}
+	} while (chunk);
+	return 0;
+}
+
+/**
+ * @brief Read the next item as a scalar value. Tags are looked through, an
+ * array, map or byte string is skipped and gives no value, like json-c does
+ * for the containers.
+ * @return 0 for success, -1 for error.
+ */
+static int cb_scalar(jxs_cbor *cb, jxs_rvalue *val)
+{
+	int            major = 0;
+	int            ai    = 0;
+	uint64_t       n     = 0;
+	const uint8_t *item  = NULL;
+	val->type = json_type_null;
+	val->d    = 0;
+	do {
+		item = cb->cur;
+		if (cb_head(cb, &major, &ai, &n) != 0) {
+			return -1;
+		}
+	} while (major == CBOR_TAG);
+	switch (major) {
+	case CBOR_UINT:
+		val->type = json_type_int;
+		val->u    = n;
+		val->i    = (n > INT64_MAX) ? INT64_MAX : (int64_t)n;
+		val->d    = (double)n;
+		break;
+
+	case CBOR_NEGINT:
+		val->type = json_type_int;
+		val->u    = 0;
+		val->i    = (n > INT64_MAX) ? INT64_MIN : (-1 - (int64_t)n);
+		val->d    = -1.0 - (double)n;
+		break;
+
+	case CBOR_TEXT:
+		val->type = json_type_string;
+		return cb_string(cb, major, ai, n, val->sbuf, sizeof(val->sbuf));
+
+	case CBOR_BYTES:
+	case CBOR_ARRAY:
+	case CBOR_MAP:
+		/* back to the head, and skip the whole item */
+		cb->cur = item;
+		if (cb_skip(cb) != 0) {
+			return -1;
+		}
+		val->type = (major == CBOR_BYTES) ? json_type_null : json_type_object;
+		break;
+
+	default:
+		if ((ai == 20) || (ai == 21)) {
+			val->type = json_type_boolean;
+			val->b    = (ai == 21);
+			val->d    = val->b;
+		} else if (ai == 25) {
+			val->type = json_type_double;
+			val->d    = cb_half_to_double((uint16_t)n);
+		} else if (ai == 26) {
+			uint32_t bits = (uint32_t)n;
+			float    f    = 0;
+			memcpy(&f, &bits, sizeof(f));
+			val->type = json_type_double;
+			val->d    = f;
+		} else if (ai == 27) {
+			val->type = json_type_double;
+			memcpy(&val->d, &n, sizeof(val->d));
+		} else if (ai == CBOR_INDEF) {
+			cb_error(cb, "unexpected break");
+			return -1;
+		}
+		/* null, undefined and the unassigned simple values */
+		break;
+	}
+	return 0;
+}
+
+/**
+ * @brief Copy the next map key, it must be a text string.
+ * @return the key, free it by jxs_free(), NULL for error.
+ */
+static char *cb_key_dup(jxs_cbor *cb)
+{
+	int            major = 0;
+	int            ai    = 0;
+	uint64_t       n     = 0;
+	const uint8_t *p     = NULL;
+	char          *key   = NULL;
+	if ((cb_peek(cb) >> 5) != CBOR_TEXT) {
+		cb_error(cb, "map key is not a text string");
+		return NULL;
+	}
+	if (cb_head(cb, &major, &ai, &n) != 0) {
+		return NULL;
+	}
+	if (ai == CBOR_INDEF) {
+		/* joined into the key buffer, a longer key is truncated */
+		if (cb_string(cb, major, ai, n, cb->keybuf, sizeof(cb->keybuf)) != 0) {
+			return NULL;
+		}
+		p = (const uint8_t *)cb->keybuf;
+		n = strlen(cb->keybuf);
+	} else if ((p = cb_take(cb, n)) == NULL) {
+		return NULL;
+	}
+	if ((key = (char *)jxs_malloc((size_t)n + 1)) == NULL) {
+		cb_error(cb, "out of memory");
+		return NULL;
+	}
+	memcpy(key, p, (size_t)n);
+	key[n] = '\0';
+	return key;
+}
+
+/**
+ * @brief Build a json_object from the next item, for the members that keep
+ * json-c objects. Tags are dropped, byte strings have no json form and give
+ * null.
+ * @return 0 for success, -1 for error.
+ */
+static int cb_value_to_jso(jxs_cbor *cb, json_object **jso)
+{
+	int      major = 0;
+	int      ai    = 0;
+	uint64_t n     = 0;
+	uint64_t i     = 0;
+	*jso = NULL;
+	if (++cb->depth > JXS_JSON_MAX_DEPTH) {
+		cb_error(cb, "too deeply nested");
+		return -1;
+	}
+	switch (cb_peek(cb) >> 5) {
+	case CBOR_TEXT: {
+		const char *text = NULL;
+		if (cb_head(cb, &major, &ai, &n) != 0) {
+			break;
+		}
+		if (ai == CBOR_INDEF) {
+			/* joined into the key buffer, a longer string is truncated */
+			if (cb_string(cb, major, ai, n, cb->keybuf, sizeof(cb->keybuf)) == 0) {
+				*jso = json_object_new_string(cb->keybuf);
+			}
+		} else if ((text = (const char *)cb_take(cb, n)) != NULL) {
+			*jso = json_object_new_string_len(text, (int)n);
+		}
+		break;
+	}
+
+	case CBOR_ARRAY:
+		if (cb_head(cb, &major, &ai, &n) != 0) {
+			break;
+		}
+		*jso = json_object_new_array();
+		for (i = 0; (ai == CBOR_INDEF) ? !cb_accept_break(cb) : (i < n); i++) {
+			json_object *item_jso = NULL;
+			if (cb_value_to_jso(cb, &item_jso) != 0) {
+				break;
+			}
+			json_object_array_add(*jso, item_jso);
+		}
+		break;
+
+	case CBOR_MAP:
+		if (cb_head(cb, &major, &ai, &n) != 0) {
+			break;
+		}
+		*jso = json_object_new_object();
+		for (i = 0; (ai == CBOR_INDEF) ? !cb_accept_break(cb) : (i < n); i++) {
+			char        *key      = cb_key_dup(cb);
+			json_object *item_jso = NULL;
+			if ((key == NULL) || (cb_value_to_jso(cb, &item_jso) != 0)) {
+				jxs_free(key);
+				break;
+			}
+			json_object_object_add(*jso, key, item_jso);
+			jxs_free(key);
+		}
+		break;
+
+	case CBOR_TAG:
+		if (cb_head(cb, &major, &ai, &n) == 0) {
+			cb->depth--;
+			return cb_value_to_jso(cb, jso);
+		}
+		break;
+
+	default: {
+		jxs_rvalue val;
+		if (cb_scalar(cb, &val) != 0) {
+			break;
+		}
+		if (val.type == json_type_boolean) {
+			*jso = json_object_new_boolean(val.b);
+		} else if (val.type == json_type_double) {
+			*jso = json_object_new_double(val.d);
+		} else if ((val.type == json_type_int) && (val.u > INT64_MAX)) {
+			*jso = json_object_new_uint64(val.u);
+		} else if ((val.type == json_type_int) && (val.i == INT64_MIN) && (val.d < (double)INT64_MIN)) {
+			*jso = json_object_new_double(val.d);
+		} else if (val.type == json_type_int) {
+			*jso = json_object_new_int64(val.i);
+		}
+		break;
+	}
+	}
+	cb->depth--;
+	if (cb->err) {
+		json_object_put(*jso);
+		*jso = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Store a number(or any scalar) into an int/uint/double member, the
+ * same conversions as the json readers.
+ * @return 0 for success, -1 for error.
+ */
+static int jmap_cbor_store_number(jmap_context_t *ctx, void *vptr, jxs_type type, size_t size,
+                                  const jxs_rvalue *val)
+{
+	bool neg = false;
+	switch (type) {
+	case jxs_type_double:
+		if (TYPEOF(size, double)) {
+			*((double *)vptr) = rval_get_double(val);
+		} else if (TYPEOF(size, float)) {
+			/* an integer is rounded once */
+			if ((val->type == json_type_int) && (val->i < 0)) {
+				*((float *)vptr) = (float)val->i;
+			} else if (val->type == json_type_int) {
+				*((float *)vptr) = (float)val->u;
+			} else {
+				*((float *)vptr) = (float)rval_get_double(val);
+			}
+		} else {
+			jxs_log(JXS_LOG_ERROR, "%s: required type '%s' <sizeof> does not match.\n",
+			        jmap_locator(ctx), type_to_name(type));
+			return -1;
+		}
+		return 0;
+
+	case jxs_type_int:
+		return jmap_store_int(ctx, vptr, size, rval_get_int64(val));
+
+	case jxs_type_uint: {
+		uint64_t num = rval_get_uint64(val, &neg);
+		return jmap_store_uint(ctx, vptr, size, num, neg);
+	}
+
+	default:
+		jxs_log(JXS_LOG_ERROR, "%s: a number can't fill a '%s' member.\n",
+		        jmap_locator(ctx), type_to_name(type));
+		return -1;
+	}
+}
+
+/**
+ * @brief Load one element of a typed array.
+ * @param  tag  RFC 8746 typed array tag.
+ */
+static void cb_typed_load(const uint8_t *p, uint64_t tag, size_t width, jxs_rvalue *val)
+{
+	size_t   i    = 0;
+	uint64_t bits = 0;
+	bool     le   = (tag & 4) && (width > 1);
+	for (i = 0; i < width; i++) {
+		bits = (bits << 8) | p[le ? (width - 1 - i) : i];
+	}
+	if (tag & 16) {
+		val->type = json_type_double;
+		if (width == 2) {
+			val->d = cb_half_to_double((uint16_t)bits);
+		} else if (width == 4) {
+			uint32_t bits32 = (uint32_t)bits;
+			float    f      = 0;
+			memcpy(&f, &bits32, sizeof(f));
+			val->d = f;
+		} else {
+			memcpy(&val->d, &bits, sizeof(val->d));
+		}
+	} else if ((tag & 8) && (bits >> (width * 8 - 1))) {
+		/* negative, sign extend */
+		if (width < 8) {
+			bits |= UINT64_MAX << (width * 8);
+		}
+		val->type = json_type_int;
+		val->i    = (int64_t)bits;
+		val->u    = 0;
+	} else {
+		val->type = json_type_int;
+		val->u    = bits;
+		val->i    = (bits > INT64_MAX) ? INT64_MAX : (int64_t)bits;
+	}
+	if (val->type == json_type_int) {
+		val->d = (val->i < 0) ? (double)val->i : (double)val->u;
+	}
+}
+
+/**
+ * @brief Read an RFC 8746 typed array(in a tag 40 multi-dimensional array when
+ * it has more than one dimension) into a number array. When the element type,
+ * byte order and shape are the member's own, the elements are copied in one
+ * go, otherwise they are converted one by one, the elements out of the
+ * member's bounds are skipped.
+ * @param  tag  the tag already read.
+ * @return 0 for success, -1 for error.
+ */
+static int jmap_cbor_read_typed(jmap_context_t *ctx, uint8_t *base, jmap_item_t *jmitem,
+                                jxs_cbor *cb, uint64_t tag)
+{
+	int            major  = 0;
+	int            ai     = 0;
+	uint64_t       n      = 0;
+	size_t         i      = 0;
+	size_t         k      = 0;
+	size_t         ndims  = 0;
+	size_t         mwidth = 0;
+	size_t         width  = 0;
+	size_t         count  = 1;
+	size_t         dims[JXS_ARRAY_DEPTH];
+	size_t         mdims[JXS_ARRAY_DEPTH];
+	size_t         at[JXS_ARRAY_DEPTH];
+	size_t         mndims = jmap_array_dims(jmitem, mdims, &mwidth);
+	const uint8_t *data   = NULL;
+	bool           warned = false;
+	if (tag == CBOR_TAG_MDARRAY) {
+		if ((cb_head(cb, &major, &ai, &n) != 0) || (major != CBOR_ARRAY) || (n != 2) ||
+		    (cb_head(cb, &major, &ai, &n) != 0) || (major != CBOR_ARRAY) || (ai == CBOR_INDEF) ||
+		    (n == 0) || (n > JXS_ARRAY_DEPTH)) {
+			cb_error(cb, "invalid multi-dimensional array");
+			return -1;
+		}
+		for (ndims = (size_t)n, i = 0; i < ndims; i++) {
+			if ((cb_head(cb, &major, &ai, &n) != 0) || (major != CBOR_UINT) || (n > SIZE_MAX)) {
+				cb_error(cb, "invalid array dimension");
+				return -1;
+			}
+			if ((n != 0) && (count > (SIZE_MAX / n))) {
+				cb_error(cb, "array dimension too large");
+				return -1;
+			}
+			dims[i] = (size_t)n;
+			count  *= dims[i];
+		}
+		if ((cb_head(cb, &major, &ai, &tag) != 0) || (major != CBOR_TAG) ||
+		    (tag < CBOR_TAG_TYPED_MIN) || (tag > CBOR_TAG_TYPED_MAX)) {
+			cb_error(cb, "multi-dimensional array without a typed array");
+			return -1;
+		}
+	}
+	/* 0b010_f_s_e_ll */
+	width = (tag & 16) ? ((size_t)2 << (tag & 3)) : ((size_t)1 << (tag & 3));
+	if (width > 8) {
+		jxs_log(JXS_LOG_ERROR, "%s: float128 typed array is not supported.\n", jmap_locator(ctx));
+		return -1;
+	}
+	if ((cb_head(cb, &major, &ai, &n) != 0) || (major != CBOR_BYTES) || (ai == CBOR_INDEF) ||
+	    ((data = cb_take(cb, n)) == NULL) || ((n % width) != 0)) {
+		cb_error(cb, "invalid typed array");
+		return -1;
+	}
+	if (ndims == 0) {
+		ndims   = 1;
+		dims[0] = (size_t)(n / width);
+		count   = dims[0];
+	}
+	if ((ndims != mndims) || (count != (n / width))) {
+		jxs_log(JXS_LOG_ERROR, "%s: typed array shape does not match the member.\n", jmap_locator(ctx));
+		return -1;
+	}
+	ctx->stats.elements += count;
+	if ((cb_typed_tag(jmitem->basetype, mwidth) == tag) &&
+	    (memcmp(dims, mdims, ndims * sizeof(size_t)) == 0)) {
+		memcpy(base + jmitem->offset, data, (size_t)n);
+		return 0;
+	}
+	memset(at, 0, sizeof(at));
+	for (i = 0; i < count; i++, data += width) {
+		size_t     off = 0;
+		jxs_rvalue val;
+		/* row-major offset in the member, if the element is in its bounds */
+		for (k = 0; k < ndims; k++) {
+			if (at[k] >= mdims[k]) {
+				break;
+			}
+			off = off * mdims[k] + at[k];
+		}
+		if (k == ndims) {
+			cb_typed_load(data, tag, width, &val);
+			if (jmap_cbor_store_number(ctx, base + jmitem->offset + off * mwidth,
+			                           jmitem->basetype, mwidth, &val) != 0) {
+				return -1;
+			}
+		} else if (!warned) {
+			jxs_log(JXS_LOG_WARN, "%s: array length exceeds the buffer, throw it.\n", jmap_locator(ctx));
+			warned = true;
+		}
+		/* next index, the last dimension first */
+		for (k = ndims; (k > 0) && (++at[k - 1] == dims[k - 1]); k--) {
+			at[k - 1] = 0;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief Read one struct member(or array element) from CBOR, the values are
+ * converted the same as @ref jmap_read_warpper() does for json text.
+ * @param  cb  CBOR reader at the item, NULL if the member is absent.
+ * @return 0 for success, -1 for error.
+ */
+static int jmap_cbor_read_warpper(jmap_context_t *ctx, uint8_t *base, jmap_item_t *jmitem,
+                                  size_t idx, jxs_cbor *cb)
+{
+	jxs_rvalue val;
+	void      *vptr   = base + jmitem->offset;
+	jxs_type   type   = jmitem->type;
+	size_t     size   = jmitem->size;
+	bool       isnull = (cb == NULL) || cb_null(cb);
+	vptr     = (uint8_t *)vptr + size * idx;
+	val.type = json_type_null;
+	val.d    = 0;
+	switch (type) {
+	case jxs_type_null:
+		memset(vptr, 0, size);
+		if (!isnull && (cb_skip(cb) != 0)) {
+			return -1;
+		}
+		break;
+
+	case jxs_type_boolean:
+		if (!isnull && (cb_scalar(cb, &val) != 0)) {
+			return -1;
+		}
+		if (TYPEOF(size, int)) {
+			*((int *)vptr) = (int)rval_get_boolean(&val);
+		} else if (TYPEOF(size, bool)) {
+			*((bool *)vptr) = rval_get_boolean(&val);
+		} else {
+			jxs_log(JXS_LOG_ERROR, "%s: required type '%s' <sizeof> does not match.\n",
+			        jmap_locator(ctx), type_to_name(type));
+			return -1;
+		}
+		break;
+
+	case jxs_type_double:
+	case jxs_type_int:
+	case jxs_type_uint:
+		if (!isnull && (cb_scalar(cb, &val) != 0)) {
+			return -1;
+		}
+		if (jmap_cbor_store_number(ctx, vptr, type, size, &val) != 0) {
+			return -1;
+		}
+		break;
+
+	case jxs_type_string: {
+		json_object *jso = NULL;
+		if (isnull) {
+			memset(vptr, 0, size);
+		} else if ((cb_peek(cb) >> 5) == CBOR_TEXT) {
+			int      major = 0;
+			int      ai    = 0;
+			uint64_t n     = 0;
+			/* decode the string into the member directly */
+			if ((cb_head(cb, &major, &ai, &n) != 0) ||
+			    (cb_string(cb, major, ai, n, *((char(*)[])vptr), size) != 0)) {
+				return -1;
+			}
+			ctx->stats.truncated += cb->cut ? 1 : 0;
+		} else if (cb_value_to_jso(cb, &jso) != 0) {
+			return -1;
+		} else {
+			/* the text json-c gives by json_object_get_string() */
+			const char *str = jso ? json_object_get_string(jso) : "";
+			if (str_copy_fit(*((char(*)[])vptr), size, str, strlen(str))) {
+				ctx->stats.truncated++;
+			}
+			json_object_put(jso);
+		}
+		break;
+	}
+
+	case jxs_type_object:
+		if (isnull) {
+			*((json_object **)vptr) = NULL;
+		} else if (cb_value_to_jso(cb, (json_object **)vptr) != 0) {
+			return -1;
+		}
+		break;
+
+	case jxs_type_struct:
+		if (jmitem->subjm == NULL) {
+			jxs_log(JXS_LOG_ERROR, "%s: Please create a mapper for your nested struct..\n", jmap_locator(ctx));
+			return -1;
+		}
+		if (isnull) {
+			memset(vptr, 0, size);
+		} else if ((cb_peek(cb) >> 5) == CBOR_MAP) {
+			if (jmap_cbor_read_object(ctx, jmitem->subjm, (uint8_t *)vptr, cb) != 0) {
+				jxs_log(JXS_LOG_ERROR, "%s: struct from cbor error.\n", jmap_locator(ctx));
+				return -1;
+			}
+		} else {
+			/* not a map, every member is cleared like json-c does */
+			if ((cb_skip(cb) != 0) ||
+			    (jmap_cbor_read_object(ctx, jmitem->subjm, (uint8_t *)vptr, NULL) != 0)) {
+				jxs_log(JXS_LOG_ERROR, "%s: struct from cbor error.\n", jmap_locator(ctx));
+				return -1;
+			}
+		}
+		break;
+
+	case jxs_type_array:
+		if (isnull) {
+			memset(vptr, 0, size);
+		} else {
+			jmap_item_t new_jmitem;
+			jmap_array_move_next_dimen(&new_jmitem, jmitem, idx);
+			if (jmap_cbor_read_array(ctx, base, &new_jmitem, cb) != 0) {
+				jxs_log(JXS_LOG_ERROR, "%s: array from cbor error.\n", jmap_locator(ctx));
+				return -1;
+			}
+		}
+		break;
+
+	default:
+		jxs_log(JXS_LOG_ERROR, "%s: error mapper type.\n", jmap_locator(ctx));
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Read a CBOR array into the struct according to array's jmap. The
+ * elements beyond the array length are skipped.
+ * @return 0 for success, -1 for error.
+ */
+static int jmap_cbor_read_array(jmap_context_t *ctx, uint8_t *base, jmap_item_t *jmitem,
+                                jxs_cbor *cb)
+{
+	int      major   = 0;
+	int      ai      = 0;
+	uint64_t n       = 0;
+	size_t   i       = 0;
+	size_t   depth   = ctx->path.depth;
+	size_t   arr_len = jmitem->arr.length;
+	if ((jmitem->size == 0) || (arr_len == 0)) {
+		jxs_log(JXS_LOG_ERROR, "%s: array 'size', 'len' cannot not be zero.\n", jmap_locator(ctx));
+		return -1;
+	}
+	if (cb_head(cb, &major, &ai, &n) != 0) {
+		return -1;
+	}
+	while (major == CBOR_TAG) {
+		if ((n == CBOR_TAG_MDARRAY) || ((n >= CBOR_TAG_TYPED_MIN) && (n <= CBOR_TAG_TYPED_MAX))) {
+			return jmap_cbor_read_typed(ctx, base, jmitem, cb, n);
+		}
+		if (cb_head(cb, &major, &ai, &n) != 0) {
+			return -1;
+		}
+	}
+	if (major != CBOR_ARRAY) {
+		jxs_log(JXS_LOG_ERROR, "%s: this cbor item is not an array.\n", jmap_locator(ctx));
+		return -1;
+	}
+	for (i = 0; (ai == CBOR_INDEF) ? !cb_accept_break(cb) : (i < n); i++) {
+		if (i < arr_len) {
+			ctx->now.jmitem = jmitem;
+			ctx->now.idx    = i;
+			ctx->stats.elements++;
+			jmap_path_enter(ctx, depth, NULL, i);
+			if (jmap_cbor_read_warpper(ctx, base, jmitem, i, cb) != 0) {
+				jmap_path_leave(ctx, depth);
+				jxs_log(JXS_LOG_ERROR, "%s: jmap from cbor error.\n", jmap_locator(ctx));
+				return -1;
+			}
+		} else {
+			/* If the array length exceeds the buf value, the excess is discarded */
+			jmap_path_leave(ctx, depth);
+			if (i == arr_len) {
+				jxs_log(JXS_LOG_WARN, "%s: array length exceeds the buffer, throw it.\n", jmap_locator(ctx));
+			}
+			if (cb_skip(cb) != 0) {
+				return -1;
+			}
+		}
+	}
+	jmap_path_leave(ctx, depth);
+	return cb->err ? -1 : 0;
+}
+
+/**
+ * @brief Read a CBOR map into the struct through jmap. The members missing in
+ * the map are cleared(kept for a merge patch), the keys without a mapper item
+ * and the keys that are not text are skipped.
+ * @param  cb  CBOR reader at the map, NULL to clear every member.
+ * @return 0 for success, -1 for error.
+ */
+static int jmap_cbor_read_object(jmap_context_t *ctx, jxs_mapper *mapper,
+                                 uint8_t *base, jxs_cbor *cb)
+{
+	int          ret    = 0;
+	int          major  = 0;
+	int          ai     = CBOR_INDEF;
+	uint64_t     n      = 0;
+	uint64_t     pair   = 0;
+	size_t       i      = 0;
+	uint64_t     seen_buf[8];
+	uint64_t    *seen   = seen_buf;
+	size_t       depth  = ctx->path.depth;
+	jmap_head_t *jmhead = get_jmhead(mapper);
+	jmap_list_t *jmlist = get_jmlist(mapper);
+	size_t       nwords = (jmhead->idx + 63) / 64;
+	/* bitmap of the members found in the map */
+	if (nwords > JXS_NELEM(seen_buf)) {
+		seen = (uint64_t *)jxs_calloc(nwords, sizeof(uint64_t));
+		if (seen == NULL) {
+			jxs_log(JXS_LOG_ERROR, "%s: calloc seen table failed.\n", jmap_locator(ctx));
+			return -1;
+		}
+		ctx->stats.allocs++;
+	} else {
+		memset(seen_buf, 0, sizeof(seen_buf));
+	}
+	if ((cb != NULL) && ((cb_head(cb, &major, &ai, &n) != 0) || (major != CBOR_MAP))) {
+		cb_error(cb, "map expected");
+		ret = -1;
+		goto end;
+	}
+	for (pair = 0; (cb != NULL) && ((ai == CBOR_INDEF) ? !cb_accept_break(cb) : (pair < n)); pair++) {
+		const char    *key    = NULL;
+		size_t         klen   = 0;
+		const uint8_t *value  = NULL;
+		jmap_item_t   *jmitem = NULL;
+		int            kmajor = 0;
+		int            kai    = 0;
+		uint64_t       kn     = 0;
+		if ((cb_peek(cb) >> 5) != CBOR_TEXT) {
+			/* not a member key */
+			if ((cb_skip(cb) != 0) || (cb_skip(cb) != 0)) {
+				ret = -1;
+				goto end;
+			}
+			continue;
+		}
+		if (cb_head(cb, &kmajor, &kai, &kn) != 0) {
+			ret = -1;
+			goto end;
+		}
+		if (kai == CBOR_INDEF) {
+			if (cb_string(cb, kmajor, kai, kn, cb->keybuf, sizeof(cb->keybuf)) != 0) {
+				ret = -1;
+				goto end;
+			}
+			key  = cb->keybuf;
+			klen = strlen(key);
+		} else if ((key = (const char *)cb_take(cb, kn)) == NULL) {
+			ret = -1;
+			goto end;
+		} else {
+			klen = (size_t)kn;
+		}
+		value  = cb->cur;
+		jmitem = jmap_index_find(mapper, key, klen);
+		if ((jmitem == NULL) && (cb_skip(cb) != 0)) {
+			ret = -1;
+			goto end;
+		}
+		for (; jmitem != NULL; jmitem = jmitem->same ? &jmlist[jmitem->same - 1] : NULL) {
+			i = (size_t)(jmitem - jmlist);
+			/* more than one member mapped to the key, read the value again */
+			cb->cur         = value;
+			ctx->now.jmitem = jmitem;
+			ctx->now.idx    = 0;
+			ctx->stats.items++;
+			/* a repeated key replaces the json_object read for the first one */
+			if ((jmitem->type == jxs_type_object) && (seen[i / 64] & ((uint64_t)1 << (i % 64)))) {
+				jmap_object_release(base, jmitem);
+			}
+			jmap_path_enter(ctx, depth, jmitem->key, 0);
+			if (jmap_cbor_read_warpper(ctx, base, jmitem, 0, cb) != 0) {
+				jmap_path_leave(ctx, depth);
+				jxs_log(JXS_LOG_ERROR, "%s: jmap from cbor error.\n", jmap_locator(ctx));
+				ret = -1;
+				goto end;
+			}
+			seen[i / 64] |= (uint64_t)1 << (i % 64);
+		}
+	}
+	if ((cb != NULL) && cb->err) {
+		ret = -1;
+		goto end;
+	}
+	/* a merge patch keeps the absent members, unless it wasn't a map */
+	for (i = 0; (i < jmhead->idx) && !(ctx->merge && (cb != NULL)); i++) {
+		jmap_item_t *jmitem = &jmlist[i];
+		if (seen[i / 64] & ((uint64_t)1 << (i % 64))) {
+			continue;
+		}
+		ctx->now.jmitem = jmitem;
+		ctx->now.idx    = 0;
+		ctx->stats.items++;
+		jmap_path_enter(ctx, depth, jmitem->key, 0);
+		if (jmap_cbor_read_warpper(ctx, base, jmitem, 0, NULL) != 0) {
+			jmap_path_leave(ctx, depth);
+			jxs_log(JXS_LOG_ERROR, "%s: jmap from cbor error.\n", jmap_locator(ctx));
+			ret = -1;
+			goto end;
+		}
+	}
+end:
+	jmap_path_leave(ctx, depth);
+	if (seen != seen_buf) {
+		jxs_free(seen);
+	}
+	return ret;
+}
+
+uint8_t *jxs_struct_to_cbor(const jxs_schema *schema, void *stptr, void *opaque, size_t *len)
+{
+	int            ret   = 0;
+	uint64_t       start = jxs_stats_clock();
+	jxs_wbuf       wbuf;
+	jmap_context_t ctx;
+	memset(&wbuf, 0, sizeof(jxs_wbuf));
+	jmap_context_init(&ctx, schema, stptr, opaque);
+	if ((schema == NULL) || (stptr == NULL) || (len == NULL)) {
+		jxs_log(JXS_LOG_ERROR, "schema, struct or len cannot be null.\n");
+		jmap_stats_commit(&ctx, -1);
+		return NULL;
+	}
+	if ((jmap_cbor_write_object(&ctx, schema->mapper, (uint8_t *)stptr, &wbuf) != 0) || wbuf.err) {
+		ret = -1;
+	}
+	ctx.stats.bytes_out = wbuf.len;
+	ctx.stats.allocs   += wbuf.allocs;
+	ctx.stats.parse_ns  = jxs_stats_since(start);
+	if (jmap_stats_commit(&ctx, ret) != 0) {
+		jxs_log(JXS_LOG_ERROR, "struct to cbor failed.\n");
+		wbuf_release(&wbuf);
+		return NULL;
+	}
+	/* the buffer is handed over to the caller, free it by jxs_free_cbor() */
+	*len = wbuf.len;
+	return (uint8_t *)wbuf.data;
+}
+
+int jxs_struct_from_cbor(const jxs_schema *schema, void *stptr, void *opaque,
+                         const uint8_t *data, size_t len)
+{
+	int            c     = 0;
+	int            ret   = -1;
+	uint64_t       start = jxs_stats_clock();
+	jxs_cbor       cb;
+	jmap_context_t ctx;
+	jmap_context_init(&ctx, schema, stptr, opaque);
+	if ((schema == NULL) || (stptr == NULL) || (data == NULL)) {
+		jxs_log(JXS_LOG_ERROR, "schema, struct or data cannot be null.\n");
+		return jmap_stats_commit(&ctx, -1);
+	}
+	cb_init(&cb, data, len);
+	c = cb_peek(&cb);
+	if ((c < 0) || cb_null(&cb)) {
+		jxs_log(JXS_LOG_ERROR, "cbor data is empty or null.\n");
+		goto end;
+	}
+	if ((c >> 5) == CBOR_MAP) {
+		if (jmap_cbor_read_object(&ctx, schema->mapper, (uint8_t *)stptr, &cb) != 0) {
+			jxs_log(JXS_LOG_ERROR, "jmap from cbor error.\n");
+			goto end;
+		}
+	} else {
+		/* not a map, every member is cleared like json-c does */
+		if ((cb_skip(&cb) != 0) ||
+		    (jmap_cbor_read_object(&ctx, schema->mapper, (uint8_t *)stptr, NULL) != 0)) {
+			jxs_log(JXS_LOG_ERROR, "jmap from cbor error.\n");
+			goto end;
+		}
+	}
+	ret = 0;
+end:
+	ctx.stats.bytes_in = len;
+	ctx.stats.parse_ns = jxs_stats_since(start);
+	return jmap_stats_commit(&ctx, ret);
+}
+
+void jxs_free_cbor(uint8_t *data)
+{
+	jxs_free(data);
+}
+
+int jxs_struct_from_file_with_schema(const jxs_schema *schema,
+                                     void *stptr, void *opaque, const char *filename)
+{
+	int            ret   = 0;
+	FILE          *fp    = NULL;
+	void          *map   = NULL;
+	const char    *text  = NULL;
+	size_t         len   = 0;
+	uint64_t       start = jxs_stats_clock();
+	uint64_t       io    = 0;
+	jxs_wbuf       rbuf;
+	jmap_context_t ctx;
+#ifdef JXS_HAVE_POSIX
+	int            fd    = -1;
+#endif
+	memset(&rbuf, 0, sizeof(jxs_wbuf));
+	jmap_context_init(&ctx, schema, stptr, opaque);
+	if (filename == NULL) {
+		jxs_log(JXS_LOG_ERROR, "filename cannot be null.\n");
+		ret = -1;
+		goto end;
+	}
+#ifdef JXS_HAVE_POSIX
+	if ((fd = open(filename, O_RDONLY)) < 0) {
+		jxs_log(JXS_LOG_ERROR, "open file [%s] error.\n", filename);
+		ret = -1;
+		goto end;
+	}
+	if ((map = jxs_file_map(fd, &len)) != NULL) {
+		/* the mapping outlives the descriptor */
+		close(fd);
+		text = (const char *)map;
+	} else if ((fp = fdopen(fd, "rb")) == NULL) {
+		jxs_log(JXS_LOG_ERROR, "open file [%s] error.\n", filename);
+		close(fd);
+		ret = -1;
+		goto end;
+	}
+#else
+	if ((fp = fopen(filename, "rb")) == NULL) {
+		jxs_log(JXS_LOG_ERROR, "open file [%s] error.\n", filename);
+		ret = -1;
+		goto end;
+	}
+#endif
+	if (fp != NULL) {
+		ret = jxs_file_load(fp, filename, &rbuf);
+		fclose(fp);
+		if (ret != 0) {
+			jxs_log(JXS_LOG_ERROR, "json from file [%s] error.\n", filename);
+			goto end;
+		}
+		text = rbuf.data;
+		len  = rbuf.len;
+	}
+	io = jxs_stats_since(start);
+	if (jmap_struct_from_text(&ctx, schema, stptr, opaque, text, len, false) != 0) {
+		jxs_log(JXS_LOG_ERROR, "json from file [%s] error.\n", filename);
+		ret = -1;
+		goto end;
+	}
+end:
+#ifdef JXS_HAVE_POSIX
+	if (map != NULL) {
+		munmap(map, len);
+	}
+#endif
+	ctx.stats.io_ns   = io;
+	ctx.stats.allocs += rbuf.allocs;
+	wbuf_release(&rbuf);
+	return jmap_stats_commit(&ctx, ret);
+}
+
+int jxs_struct_from_file(jxs_descriptor func,
+                         void *stptr, void *opaque, const char *filename)
+{
+	int        ret = 0;
+	jxs_schema schema;
+	jxs_mapper buffer[MAPPER_BUFFER_LENGTH];
+	if (filename == NULL) {
+		jxs_log(JXS_LOG_ERROR, "filename cannot be null.\n");
+		return -1;
+	}
+	if (jxs_schema_load(&schema, buffer, JXS_NELEM(buffer), func, opaque, NULL, NULL) != 0) {
+		return -1;
+	}
+	ret = jxs_struct_from_file_with_schema(&schema, stptr, opaque, filename);
+	jxs_schema_unload(&schema);
+	return ret;
+}
+
+/**
+ * @brief Parse one ndjson line into the struct and hand it to the callback.
+ */
+static void jxs_ndjson_line(jxs_ndjson *nd, const char *line, size_t len)
+{
+	size_t i = 0;
+	while ((i < len) && ((line[i] == ' ') || (line[i] == '\t') || (line[i] == '\r'))) {
+		i++;
+	}
+	if (i == len) {
+		return;
+	}
+	if (jmap_stats_commit(&nd->ctx, jmap_struct_from_text(&nd->ctx, nd->schema, nd->stptr,
+	                                                      nd->opaque, line, len, false)) != 0) {
+		jxs_log(JXS_LOG_WARN, "ndjson line %" FMT_SIZE_T " skipped.\n", nd->lineno);
+		return;
+	}
+	if (nd->callback(nd->stptr, nd->lineno, nd->userdata) != 0) {
+		nd->stop = true;
+	}
+}
+
+/**
+ * @brief Parse the complete lines of the text.
+ * @param last     the text ends at the end of file, the last line needs no '\n'.
+ * @return bytes consumed, an incomplete line at the end is left.
+ */
+static size_t jxs_ndjson_lines(jxs_ndjson *nd, const char *text, size_t len, bool last)
+{
+	const char *p   = text;
+	const char *end = text + len;
+	const char *nl  = NULL;
+	while ((p < end) && !nd->stop) {
+		nl = (const char *)memchr(p, '\n', (size_t)(end - p));
+		if (nl == NULL) {
+			if (!last) {
+				break;
+			}
+			nl = end;
+		}
+		nd->lineno++;
+		jxs_ndjson_line(nd, p, (size_t)(nl - p));
+		p = (nl < end) ? (nl + 1) : end;
+	}
+	return (size_t)(p - text);
+}
+
+/**
+ * @brief Read the ndjson through stdio, for the streams that can't be mapped.
+ * The buffer only grows to the longest line.
+ */
+static int jxs_ndjson_stdio(jxs_ndjson *nd, FILE *fp)
+{
+	int      ret  = 0;
+	bool     last = false;
+	size_t   n    = 0;
+	size_t   used = 0;
+	jxs_wbuf rbuf;
+	memset(&rbuf, 0, sizeof(jxs_wbuf));
+	while (!last && !nd->stop) {
+		if (wbuf_reserve(&rbuf, RBUF_CHUNK_SIZE) != 0) {
+			ret = -1;
+			break;
+		}
+		n         = fread(rbuf.data + rbuf.len, 1, RBUF_CHUNK_SIZE, fp);
+		rbuf.len += n;
+		if (n < RBUF_CHUNK_SIZE) {
+			if (ferror(fp)) {
+				jxs_log(JXS_LOG_ERROR, "ndjson read error.\n");
+				ret = -1;
+				break;
+			}
+			last = true;
+		}
+		used = jxs_ndjson_lines(nd, rbuf.data, rbuf.len, last);
+		memmove(rbuf.data, rbuf.data + used, rbuf.len - used);
+		rbuf.len -= used;
+	}
+	wbuf_release(&rbuf);
+	return ret;
+}
+
+#ifdef JXS_HAVE_POSIX
+/**
+ * @brief Walk a regular file through a sliding mapping window. Only the window
+ * is mapped, a line crossing its end starts the next window.
+ */
+static int jxs_ndjson_mmap(jxs_ndjson *nd, int fd, off_t fsize)
+{
+	bool   last   = false;
+	off_t  off    = 0;
+	off_t  moff   = 0;
+	size_t mlen   = 0;
+	size_t used   = 0;
+	size_t window = NDJSON_WINDOW_SIZE;
+	off_t  pagesz = (off_t)sysconf(_SC_PAGESIZE);
+	void  *base   = NULL;
+	while ((off < fsize) && !nd->stop) {
+		moff = off - (off % pagesz);
+		last = ((fsize - moff) <= (off_t)window);
+		mlen = last ? (size_t)(fsize - moff) : window;
+		base = mmap(NULL, mlen, PROT_READ, MAP_PRIVATE, fd, moff);
+		if (base == MAP_FAILED) {
+			jxs_log(JXS_LOG_ERROR, "ndjson mmap %" FMT_SIZE_T " bytes failed.\n", mlen);
+			return -1;
+		}
+		madvise(base, mlen, MADV_SEQUENTIAL);
+		used = jxs_ndjson_lines(nd, (const char *)base + (off - moff),
+		                        mlen - (size_t)(off - moff), last);
+		munmap(base, mlen);
+		if ((used == 0) && !last && !nd->stop) {
+			/* the line doesn't fit the window */
+			if (window > (SIZE_MAX / 2)) {
+				jxs_log(JXS_LOG_ERROR, "ndjson line %" FMT_SIZE_T " is too long.\n",
+				        nd->lineno + 1);
+				return -1;
+			}
+			window *= 2;
+		}
+		off += (off_t)used;
+	}
+	return 0;
+}
+#endif
+
+int jxs_ndjson_foreach(const jxs_schema *schema, const char *filename,
+                       void *stptr, void *opaque,
+                       jxs_record_callback callback, void *userdata)
+{
+	int         ret = 0;
+	FILE       *fp  = NULL;
+	jxs_ndjson  nd;
+#ifdef JXS_HAVE_POSIX
+	int         fd  = -1;
+	struct stat st;
+#endif
+	if ((schema == NULL) || (filename == NULL) || (stptr == NULL) || (callback == NULL)) {
+		jxs_log(JXS_LOG_ERROR, "schema, filename, struct or callback cannot be null.\n");
+		return -1;
+	}
+	nd.schema   = schema;
+	nd.stptr    = stptr;
+	nd.opaque   = opaque;
+	nd.callback = callback;
+	nd.userdata = userdata;
+	nd.lineno   = 0;
+	nd.stop     = false;
+#ifdef JXS_HAVE_POSIX
+	if ((fd = open(filename, O_RDONLY)) < 0) {
+		jxs_log(JXS_LOG_ERROR, "open file [%s] error.\n", filename);
+		return -1;
+	}
+	if ((fstat(fd, &st) == 0) && S_ISREG(st.st_mode)) {
+		ret = jxs_ndjson_mmap(&nd, fd, st.st_size);
+		close(fd);
+	} else if ((fp = fdopen(fd, "rb")) != NULL) {
+		/* a pipe or a device, read it as a stream */
+		ret = jxs_ndjson_stdio(&nd, fp);
+		fclose(fp);
+	} else {
+		jxs_log(JXS_LOG_ERROR, "open file [%s] error.\n", filename);
+		close(fd);
+		return -1;
+	}
+#else
+	if ((fp = fopen(filename, "rb")) == NULL) {
+		jxs_log(JXS_LOG_ERROR, "open file [%s] error.\n", filename);
+		return -1;
+	}
+	ret = jxs_ndjson_stdio(&nd, fp);
+	fclose(fp);
+#endif
+	if (ret != 0) {
+		jxs_log(JXS_LOG_ERROR, "ndjson from file [%s] error.\n", filename);
+	}
+	return ret;
+}
+
+#ifdef JXS_HAVE_POSIX
+jxs_writer *jxs_writer_new(int fd, size_t bufsize, jxs_sync sync)
+{
+	jxs_writer *writer = NULL;
+	if (fd < 0) {
+		jxs_log(JXS_LOG_ERROR, "invalid file descriptor.\n");
+		return NULL;
+	}
+	writer = (jxs_writer *)jxs_calloc(1, sizeof(jxs_writer));
+	if (writer == NULL) {
+		jxs_log(JXS_LOG_ERROR, "writer new failed.\n");
+		return NULL;
+	}
+	writer->fd      = fd;
+	writer->bufsize = bufsize ? bufsize : WRITER_DEFAULT_SIZE;
+	writer->sync    = sync;
+	/* room for a few records more than the threshold, before any growth */
+	if (wbuf_reserve(&writer->wbuf, writer->bufsize + WBUF_DEFAULT_SIZE) != 0) {
+		jxs_log(JXS_LOG_ERROR, "writer buffer new failed.\n");
+		jxs_free(writer);
+		return NULL;
+	}
+	return writer;
+}
+
+int jxs_writer_append(jxs_writer *writer, const jxs_schema *schema,
+                      void *stptr, void *opaque, int flags)
+{
+	size_t start = 0;
+	if (writer == NULL) {
+		jxs_log(JXS_LOG_ERROR, "writer cannot be null.\n");
+		return -1;
+	}
+	start = writer->wbuf.len;
+	flags &= ~(JSON_C_TO_STRING_PRETTY | JSON_C_TO_STRING_PRETTY_TAB);
+	if (jmap_stats_commit(&writer->ctx, jmap_struct_to_wbuf(&writer->ctx, schema, stptr, opaque,
+	                                                        &writer->wbuf, flags)) != 0) {
+		jxs_log(JXS_LOG_ERROR, "writer append failed.\n");
+		/* drop the partial record, the buffer is still usable */
+		writer->wbuf.len = start;
+		writer->wbuf.err = false;
+		return -1;
+	}
+	wbuf_putc(&writer->wbuf, '\n');
+	if (writer->wbuf.err) {
+		jxs_log(JXS_LOG_ERROR, "writer append out of memory.\n");
+		writer->wbuf.len = start;
+		writer->wbuf.err = false;
+		return -1;
+	}
+	/* the record is buffered now, a write error is left to the next flush */
+	if ((writer->wbuf.len >= writer->bufsize) && (jxs_writer_flush(writer) != 0)) {
+		jxs_log(JXS_LOG_WARN, "writer keeps %" FMT_SIZE_T " bytes buffered.\n", writer->wbuf.len);
+	}
+	return 0;
+}
+
+int jxs_writer_flush(jxs_writer *writer)
+{
+	ssize_t  n     = 0;
+	size_t   done  = 0;
+	uint64_t start = jxs_stats_clock();
+	if (writer == NULL) {
+		jxs_log(JXS_LOG_ERROR, "writer cannot be null.\n");
+		return -1;
+	}
+	while (done < writer->wbuf.len) {
+		n = write(writer->fd, writer->wbuf.data + done, writer->wbuf.len - done);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			jxs_log(JXS_LOG_ERROR, "writer write error: %s.\n", strerror(errno));
+			break;
+		}
+		done += (size_t)n;
+	}
+	if (jxs_atomic_load(&jxs_stats_on)) {
+		/* the records are committed by append, only the write time is left */
+		jxs_stats_add(&jxs_stats_all.io_ns, jxs_stats_since(start));
+	}
+	/* keep what is not written, for the next flush */
+	memmove(writer->wbuf.data, writer->wbuf.data + done, writer->wbuf.len - done);
+	writer->wbuf.len -= done;
+	if (writer->wbuf.len != 0) {
+		return -1;
+	}
+	if ((writer->sync == JXS_SYNC_FLUSH) && (done != 0) && (jxs_fdatasync(writer->fd) != 0)) {
+		jxs_log(JXS_LOG_ERROR, "writer sync error: %s.\n", strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+int jxs_writer_free(jxs_writer *writer)
+{
 	int ret = 0;
-	json_object *item_jso = NULL;
-	void        *vptr     = (uint8_t *)jmhead->start_addr + jmitem->offset;
-	jxs_type     type     = jmitem->type;
-	size_t       size     = jmitem->size;
-	item_action  action   = 0;
-	if (vptr == NULL) {
-		jxs_log(JXS_LOG_ERROR, "%s: jmap struct addr is null.\n", locator);
+	if (writer == NULL) {
+		return 0;
+	}
+	if (jxs_writer_flush(writer) != 0) {
+		jxs_log(JXS_LOG_ERROR, "writer lost %" FMT_SIZE_T " bytes.\n", writer->wbuf.len);
+		ret = -1;
+	}
+	if ((writer->sync == JXS_SYNC_CLOSE) && (jxs_fdatasync(writer->fd) != 0)) {
+		jxs_log(JXS_LOG_ERROR, "writer sync error: %s.\n", strerror(errno));
+		ret = -1;
+	}
+	wbuf_release(&writer->wbuf);
+	jxs_free(writer);
+	return ret;
+}
+#else
+jxs_writer *jxs_writer_new(int fd, size_t bufsize, jxs_sync sync)
+{
+	(void)fd;
+	(void)bufsize;
+	(void)sync;
+	jxs_log(JXS_LOG_ERROR, "writer is not supported on this platform.\n");
+	return NULL;
+}
+
+int jxs_writer_append(jxs_writer *writer, const jxs_schema *schema,
+                      void *stptr, void *opaque, int flags)
+{
+	(void)writer;
+	(void)schema;
+	(void)stptr;
+	(void)opaque;
+	(void)flags;
+	return -1;
+}
+
+int jxs_writer_flush(jxs_writer *writer)
+{
+	(void)writer;
+	return -1;
+}
+
+int jxs_writer_free(jxs_writer *writer)
+{
+	(void)writer;
+	return 0;
+}
+#endif
+
+jxs_context *jxs_context_new(void)
+{
+	jxs_context *jctx = NULL;
+	jctx = (jxs_context *)jxs_calloc(1, sizeof(jxs_context));
+	if (jctx == NULL) {
+		jxs_log(JXS_LOG_ERROR, "context new failed.\n");
+		return NULL;
+	}
+	jctx->arr = (jxs_mapper *)jxs_malloc(MAPPER_BUFFER_LENGTH * sizeof(jxs_mapper));
+	if (jctx->arr == NULL) {
+		jxs_log(JXS_LOG_ERROR, "context mapper storage new failed.\n");
+		jxs_free(jctx);
+		return NULL;
+	}
+	jctx->len = MAPPER_BUFFER_LENGTH;
+	return jctx;
+}
+
+void jxs_context_reset(jxs_context *jctx)
+{
+	jxs_mapper *arr = NULL;
+	if (jctx == NULL) {
+		return;
+	}
+	if (jctx->loaded) {
+		jxs_schema_unload(&jctx->schema);
+		jctx->loaded = false;
+	}
+	/* The last descriptor overflowed the storage and got part of its mappers
+	 * from heap, grow the storage to that high-water mark now that it's unused.
+	 */
+	if (jctx->need > jctx->len) {
+		arr = (jxs_mapper *)jxs_malloc(jctx->need * sizeof(jxs_mapper));
+		if (arr == NULL) {
+			jxs_log(JXS_LOG_WARN, "context mapper storage grow to %" FMT_SIZE_T
+			        " failed, keep %" FMT_SIZE_T ".\n", jctx->need, jctx->len);
+		} else {
+			jxs_free(jctx->arr);
+			jctx->arr = arr;
+			jctx->len = jctx->need;
+		}
+	}
+	jctx->out.len = 0;
+	jctx->out.err = false;
+}
+
+void jxs_context_free(jxs_context *jctx)
+{
+	if (jctx) {
+		if (jctx->loaded) {
+			jxs_schema_unload(&jctx->schema);
+		}
+		wbuf_release(&jctx->out);
+		jxs_free(jctx->arr);
+		jxs_free(jctx);
+	}
+}
+
+/**
+ * @brief Count a conversion made with the context, into the process-wide
+ * statistics and into the last and total ones of the context.
+ * @return ret.
+ */
+static int jxs_context_commit(jxs_context *jctx, int ret)
+{
+	jmap_stats_commit(&jctx->mctx, ret);
+	if (jxs_atomic_load(&jxs_stats_on)) {
+		jctx->last = jctx->mctx.stats;
+		jxs_stats_merge(&jctx->total, &jctx->last, false);
+	}
+	return ret;
+}
+
+const jxs_schema *jxs_context_schema(jxs_context *jctx, jxs_descriptor func, void *opaque)
+{
+	int ret = 0;
+	if (jctx == NULL) {
+		jxs_log(JXS_LOG_ERROR, "context cannot be null.\n");
+		return NULL;
+	}
+	jxs_context_reset(jctx);
+	ret = jxs_schema_load(&jctx->schema, jctx->arr, jctx->len, func, opaque, &jctx->need, &jctx->last);
+	if (jxs_atomic_load(&jxs_stats_on)) {
+		jxs_stats_merge(&jctx->total, &jctx->last, false);
+	}
+	if (ret != 0) {
+		return NULL;
+	}
+	jctx->loaded = true;
+	return &jctx->schema;
+}
+
+const char *jxs_context_to_json_string_ext(jxs_context *jctx, const jxs_schema *schema,
+                                           void *stptr, void *opaque, int flags)
+{
+	if (jctx == NULL) {
+		jxs_log(JXS_LOG_ERROR, "context cannot be null.\n");
+		return NULL;
+	}
+	/* keep the capacity of the last output */
+	jctx->out.len = 0;
+	jctx->out.err = false;
+	if (jxs_context_commit(jctx, jmap_struct_to_wbuf(&jctx->mctx, schema, stptr, opaque,
+	                                                 &jctx->out, flags)) != 0) {
+		jxs_log(JXS_LOG_ERROR, "struct to json string failed.\n");
+		return NULL;
+	}
+	return jctx->out.data;
+}
+
+const char *jxs_context_to_json_string(jxs_context *jctx, const jxs_schema *schema,
+                                       void *stptr, void *opaque)
+{
+#ifdef JSON_C_TO_STRING_PLAIN
+	return jxs_context_to_json_string_ext(jctx, schema, stptr, opaque, JSON_C_TO_STRING_PLAIN);
+#else
+	return jxs_context_to_json_string_ext(jctx, schema, stptr, opaque, 0);
+#endif
+}
+
+int jxs_context_from_json_string(jxs_context *jctx, const jxs_schema *schema,
+                                 void *stptr, void *opaque, const char *jstring)
+{
+	if ((jctx == NULL) || (jstring == NULL)) {
+		jxs_log(JXS_LOG_ERROR, "context or json string cannot be null.\n");
 		return -1;
 	}
-	vptr   = (uint8_t *)vptr + size * idx;
-	action = jmap_convert_handler(ctx, jmitem, vptr, &item_jso, locator);
-	if (action == RULE_ITEM_ERROR) {
-		jxs_log(JXS_LOG_WARN, "Rules handling error, skip rules.\n");
-	} else if (action == RULE_ITEM_DELETE) {
-		/* delete current item */
-		ret = 1;
-		goto ok;
-	} else if (action == RULE_ITEM_SET) {
-		/* set item_jso inside, so skip the following operations and return. */
-		ret = 0;
-		goto ok;
+	if (jxs_context_commit(jctx, jmap_struct_from_text(&jctx->mctx, schema, stptr, opaque,
+	                                                   jstring, strlen(jstring), false)) != 0) {
+		jxs_log(JXS_LOG_ERROR, "json string parse error.\n");
+		return -1;
+	}
+	return 0;
+}
+
+void jxs_stats_enable(int enable)
+{
+	jxs_atomic_store(&jxs_stats_on, (enable != 0));
+}
+void jxs_stats_get(jxs_stats *stats)
+{
+	uint64_t *d = (uint64_t *)stats;
+	uint64_t *v = (uint64_t *)&jxs_stats_all;
+	size_t    i = 0;
+	if (stats == NULL) {
+		return;
+	}
+	for (i = 0; i < sizeof(jxs_stats) / sizeof(uint64_t); i++) {
+		d[i] = jxs_atomic_load(&v[i]);
+	}
+}
+void jxs_stats_reset(void)
+{
+	uint64_t *v = (uint64_t *)&jxs_stats_all;
+	size_t    i = 0;
+	for (i = 0; i < sizeof(jxs_stats) / sizeof(uint64_t); i++) {
+		jxs_atomic_store(&v[i], 0);
+	}
+}
+void jxs_context_stats(jxs_context *jctx, jxs_stats *last, jxs_stats *total)
+{
+	if (jctx == NULL) {
+		jxs_log(JXS_LOG_ERROR, "context cannot be null.\n");
+		return;
+	}
+	if (last) {
+		*last = jctx->last;
+	}
+	if (total) {
+		*total = jctx->total;
+	}
+}
+const char *jxs_stats_to_json_string(const jxs_stats *stats)
+{
+	/* in the order of the members of jxs_stats */
+	static const char *const names[] = {
+		"calls", "errors", "items", "elements", "truncated", "bytes_out", "bytes_in",
+		"allocs", "descriptor_ns", "convert_ns", "parse_ns", "io_ns",
+	};
+	size_t          i = 0;
+	const uint64_t *v = NULL;
+	jxs_stats       snap;
+	jxs_wbuf        wbuf;
+	if (stats == NULL) {
+		jxs_stats_get(&snap);
+		stats = &snap;
+	}
+	v = (const uint64_t *)stats;
+	memset(&wbuf, 0, sizeof(jxs_wbuf));
+	wbuf_putc(&wbuf, '{');
+	for (i = 0; i < JXS_NELEM(names); i++) {
+		if (i != 0) {
+			wbuf_putc(&wbuf, ',');
+		}
+		wbuf_putc(&wbuf, '"');
+		wbuf_append(&wbuf, names[i], strlen(names[i]));
+		wbuf_append(&wbuf, "\":", 2);
+		jmap_write_uint(&wbuf, v[i]);
+	}
+	wbuf_putc(&wbuf, '}');
+	wbuf_finish(&wbuf);
+	if (wbuf.err) {
+		jxs_log(JXS_LOG_ERROR, "statistics to json out of memory.\n");
+		wbuf_release(&wbuf);
+		return NULL;
+	}
+	/* the buffer is handed over to the caller, free it by jxs_free_json_string() */
+	return wbuf.data;
+}
+
+int jxs_gen_write_begin(jxs_context *jctx, const void *stptr)
+{
+	if (jctx == NULL) {
+		jxs_log(JXS_LOG_ERROR, "context cannot be null.\n");
+		return -1;
+	}
+	jmap_context_init(&jctx->mctx, NULL, NULL, NULL);
+	/* keep the capacity of the last output */
+	jctx->out.len = 0;
+	jctx->out.err = false;
+	jctx->start   = jxs_stats_clock();
+	jctx->allocs  = jctx->out.allocs;
+	if (stptr == NULL) {
+		jxs_log(JXS_LOG_ERROR, "struct cannot be null.\n");
+		return jxs_context_commit(jctx, -1);
+	}
+	return 0;
+}
+
+const char *jxs_gen_write_end(jxs_context *jctx)
+{
+	int ret = 0;
+	wbuf_finish(&jctx->out);
+	if (jctx->out.err) {
+		jxs_log(JXS_LOG_ERROR, "json text out of memory.\n");
+		ret = -1;
+	}
+	jctx->mctx.stats.bytes_out = jctx->out.len;
+	jctx->mctx.stats.allocs   += jctx->out.allocs - jctx->allocs;
+	jctx->mctx.stats.parse_ns  = jxs_stats_since(jctx->start);
+	if (jxs_context_commit(jctx, ret) != 0) {
+		jxs_log(JXS_LOG_ERROR, "struct to json string failed.\n");
+		return NULL;
+	}
+	return jctx->out.data;
+}
+
+void jxs_gen_raw(jxs_context *jctx, const char *text, size_t len)
+{
+	wbuf_append(&jctx->out, text, len);
+}
+
+void jxs_gen_bool(jxs_context *jctx, int value)
+{
+	if (value) {
+		wbuf_puts(&jctx->out, "true");
+	} else {
+		wbuf_puts(&jctx->out, "false");
+	}
+}
+
+void jxs_gen_int(jxs_context *jctx, int64_t value)
+{
+	jmap_write_int(&jctx->out, value);
+}
+
+void jxs_gen_uint(jxs_context *jctx, uint64_t value)
+{
+	jmap_write_uint(&jctx->out, value);
+}
+
+void jxs_gen_double(jxs_context *jctx, double value)
+{
+	jmap_write_double(&jctx->out, value, false);
+}
+
+void jxs_gen_float(jxs_context *jctx, float value)
+{
+	jmap_write_double(&jctx->out, value, true);
+}
+
+void jxs_gen_string(jxs_context *jctx, const char *str, size_t size, int flags)
+{
+	/* a full member may have no terminator */
+	jmap_write_string(&jctx->out, str, strnlen(str, size), flags);
+}
+
+void jxs_gen_jso(jxs_context *jctx, json_object *jso, int level, int flags)
+{
+	jmap_write_jso(&jctx->out, jso, level, flags);
+}
+
+/**
+ * @return 1 if the json text is an object('{' is consumed), 2 if it is another
+ * value(skipped), -1 for error.
+ */
+int jxs_gen_read_begin(jxs_context *jctx, void *stptr, const char *jstring)
+{
+	int c = 0;
+	if (jctx == NULL) {
+		jxs_log(JXS_LOG_ERROR, "context cannot be null.\n");
+		return -1;
+	}
+	jmap_context_init(&jctx->mctx, NULL, stptr, NULL);
+	jctx->start = jxs_stats_clock();
+	if ((stptr == NULL) || (jstring == NULL)) {
+		jxs_log(JXS_LOG_ERROR, "struct or json string cannot be null.\n");
+		return -1;
+	}
+	rd_init(&jctx->in, jstring, strlen(jstring));
+	jctx->mctx.stats.bytes_in = (uint64_t)(jctx->in.end - jctx->in.start);
+	c = rd_peek(&jctx->in);
+	if ((c < 0) || rd_null(&jctx->in)) {
+		jxs_log(JXS_LOG_ERROR, "json text is empty or null.\n");
+		return -1;
+	}
+	return jxs_gen_object(jctx);
+}
+
+int jxs_gen_read_end(jxs_context *jctx, int ret)
+{
+	if (jctx == NULL) {
+		return -1;
+	}
+	jctx->mctx.stats.parse_ns = jxs_stats_since(jctx->start);
+	if (jxs_context_commit(jctx, (ret < 0) ? -1 : 0) != 0) {
+		jxs_log(JXS_LOG_ERROR, "json string parse error.\n");
+		return -1;
+	}
+	return 0;
+}
+
+int jxs_gen_peek(jxs_context *jctx)
+{
+	return rd_peek(&jctx->in);
+}
+
+int jxs_gen_accept(jxs_context *jctx, char c)
+{
+	return rd_accept(&jctx->in, c);
+}
+
+int jxs_gen_expect(jxs_context *jctx, char c)
+{
+	char what[] = "'?' expected";
+	if (rd_accept(&jctx->in, c)) {
+		return 0;
 	}
-	switch (type) {
-	case jxs_type_null:
-		item_jso = NULL;
-		break;
+	what[1] = c;
+	rd_error(&jctx->in, what);
+	return -1;
+}
 
-	case jxs_type_boolean:
-		if (TYPEOF(size, int)) {
-			item_jso = json_object_new_boolean(*((int *)vptr));
-		} else if (TYPEOF(size, bool)) {
-			item_jso = json_object_new_boolean(*((bool *)vptr));
-		} else {
-			jxs_log(JXS_LOG_ERROR, "%s: required type '%s' <sizeof> does not match.\n",
-			        locator, type_to_name(type));
-			goto end;
-		}
-		break;
+int jxs_gen_null(jxs_context *jctx)
+{
+	return rd_null(&jctx->in);
+}
 
-	case jxs_type_double:
-		if (TYPEOF(size, double)) {
-			item_jso = json_object_new_double(*((double *)vptr));
-		} else if (TYPEOF(size, float)) {
-			item_jso = json_object_new_double(*((float *)vptr));
-		} else {
-			jxs_log(JXS_LOG_ERROR, "%s: required type '%s' <sizeof> does not match.\n",
-			        locator, type_to_name(type));
-			goto end;
-		}
-		break;
+int jxs_gen_skip(jxs_context *jctx)
+{
+	return rd_skip_value(&jctx->in);
+}
 
-	case jxs_type_int:
-		if (TYPEOF(size, int64_t)) {
-			item_jso = json_object_new_int64(*((int64_t *)vptr));
-		} else if (TYPEOF(size, int32_t)) {
-			item_jso = json_object_new_int(*((int32_t *)vptr));
-		} else if (TYPEOF(size, int16_t)) {
-			item_jso = json_object_new_int(*((int16_t *)vptr));
-		} else if (TYPEOF(size, int8_t)) {
-			item_jso = json_object_new_int(*((int8_t *)vptr));
-		} else {
-			jxs_log(JXS_LOG_ERROR, "%s: required type '%s' <sizeof> does not match.\n",
-			        locator, type_to_name(type));
-			goto end;
-		}
-		break;
+int jxs_gen_key(jxs_context *jctx, const char **key, size_t *len)
+{
+	return rd_key(&jctx->in, key, len);
+}
 
-	case jxs_type_string: {
-		char *tmpstr = *((char(*)[])vptr);
-		item_jso = json_object_new_string(tmpstr);
-		break;
+/**
+ * @return 1 for an object('{' is consumed), 0 for null, 2 for another
+ * value(skipped), -1 for error.
+ */
+int jxs_gen_object(jxs_context *jctx)
+{
+	if (rd_null(&jctx->in)) {
+		return 0;
 	}
+	if (rd_accept(&jctx->in, '{')) {
+		return 1;
+	}
+	return (rd_skip_value(&jctx->in) != 0) ? -1 : 2;
+}
 
-	case jxs_type_object:
-		item_jso = json_object_get(*((json_object **)vptr));
-		break;
+/**
+ * @return 1 for an array('[' is consumed), 0 for null, -1 for another value
+ * or error.
+ */
+int jxs_gen_array(jxs_context *jctx)
+{
+	if (rd_null(&jctx->in)) {
+		return 0;
+	}
+	if (!rd_accept(&jctx->in, '[')) {
+		jxs_log(JXS_LOG_ERROR, "this json value is not an array.\n");
+		return -1;
+	}
+	return 1;
+}
 
-	case jxs_type_struct:
-		if (jmitem->subjm == NULL) {
-			jxs_log(JXS_LOG_ERROR, "%s: Please create a mapper for your nested struct..\n", locator);
-			goto end;
+/**
+ * @brief Move to the element 'idx' of the array, the elements beyond 'len'
+ * are skipped.
+ * @return 1 if the element is there, 0 at the end of the array(']' is
+ * consumed), -1 for error.
+ */
+int jxs_gen_element(jxs_context *jctx, size_t idx, size_t len)
+{
+	jxs_reader *rd = &jctx->in;
+	for (;;) {
+		if (idx == 0) {
+			if (rd_accept(rd, ']')) {
+				return 0;
+			}
+		} else if (!rd_accept(rd, ',')) {
+			break;
 		}
-		item_jso = json_object_new_object();
-		if (item_jso == NULL) {
-			jxs_log(JXS_LOG_ERROR, "%s: new json object error.\n", locator);
-			goto end;
+		/* json-c accepts a trailing comma */
+		if (rd_peek(rd) == ']') {
+			break;
 		}
-		jmap_head_t *sub_jmhead = get_jmhead(jmitem->subjm);
-		sub_jmhead->start_addr = (uint8_t *)jmhead->start_addr + jmitem->offset;
-		jmap_struct_move_forward(jmitem->subjm, size, idx);
-		if ((ret = jmap_to_json_object(ctx, jmitem->subjm, item_jso)) == -1) {
-			jxs_log(JXS_LOG_ERROR, "%s: struct to json error.\n", locator);
-			goto end;
+		if (idx < len) {
+			jctx->mctx.stats.elements++;
+			return 1;
 		}
-		jmap_struct_move_backward(jmitem->subjm, size, idx);
-		break;
-
-	case jxs_type_array: {
-		jmap_item_t new_jmitem;
-		jmap_array_move_next_dimen(&new_jmitem, jmitem, idx);
-		item_jso = json_object_new_array();
-		if (item_jso == NULL) {
-			jxs_log(JXS_LOG_ERROR, "%s: new json array object error.\n", locator);
-			goto end;
+		/* If the json array length exceeds the buf value, the excess is discarded */
+		if (idx == len) {
+			jxs_log(JXS_LOG_WARN, "array length exceeds the buffer, throw it.\n");
 		}
-		if ((ret = jmap_to_json_array(ctx, jmhead, &new_jmitem, item_jso)) == -1) {
-			jxs_log(JXS_LOG_ERROR, "%s: array to json error.\n", locator);
-			goto end;
+		if (rd_skip_value(rd) != 0) {
+			return -1;
 		}
-		break;
-	}
-
-	default:
-		jxs_log(JXS_LOG_ERROR, "%s: error mapper type.\n", locator);
-		goto end;
+		idx++;
 	}
-ok:
-	*jso = item_jso;
-	return ret;
-end:
-	if (item_jso) {
-		jxs_log(JXS_LOG_ERROR, "%s: call json_object_put to free it.\n", locator);
-		json_object_put(item_jso);
+	if (!rd_accept(rd, ']')) {
+		rd_error(rd, "']' expected");
+		return -1;
 	}
-	return ret;
+	return 0;
 }
 
-static int jmap_from_json_warpper(jmap_context_t *ctx, jmap_head_t *jmhead,
-                                  jmap_item_t *jmitem, size_t idx,
-                                  json_object *jso, const char *locator)
+/* read a scalar value, null is read as absent */
+static int jxs_gen_scalar(jxs_context *jctx, jxs_rvalue *val)
 {
-	json_object *item_jso = jso;
-	void        *vptr     = (uint8_t *)jmhead->start_addr + jmitem->offset;
-	jxs_type     type     = jmitem->type;
-	size_t       size     = jmitem->size;
-	if (vptr == NULL) {
-		jxs_log(JXS_LOG_ERROR, "%s: jmap struct addr is null.\n", locator);
+	val->type = json_type_null;
+	if (!rd_null(&jctx->in) && (rd_scalar(&jctx->in, val) != 0)) {
 		return -1;
 	}
-	vptr = (uint8_t *)vptr + size * idx;
-	switch (type) {
-	case jxs_type_null:
-		memset(vptr, 0, size);
-		break;
+	return 0;
+}
 
-	case jxs_type_boolean:
-		if (TYPEOF(size, int)) {
-			*((int *)vptr) = (int)json_object_get_boolean(item_jso);
-		} else if (TYPEOF(size, bool)) {
-			*((bool *)vptr) = (bool)json_object_get_boolean(item_jso);
-		} else {
-			jxs_log(JXS_LOG_ERROR, "%s: required type '%s' <sizeof> does not match.\n",
-			        locator, type_to_name(type));
-			return -1;
-		}
-		break;
+int jxs_gen_read_bool(jxs_context *jctx, int *value)
+{
+	jxs_rvalue val;
+	if (jxs_gen_scalar(jctx, &val) != 0) {
+		return -1;
+	}
+	*value = rval_get_boolean(&val);
+	return 0;
+}
 
-	case jxs_type_double:
-		if (TYPEOF(size, double)) {
-			*((double *)vptr) = json_object_get_double(item_jso);
-		} else if (TYPEOF(size, float)) {
-			*((float *)vptr) = (float)json_object_get_double(item_jso);
-		} else {
-			jxs_log(JXS_LOG_ERROR, "%s: required type '%s' <sizeof> does not match.\n",
-			        locator, type_to_name(type));
-			return -1;
-		}
-		break;
+int jxs_gen_read_int(jxs_context *jctx, int64_t *value, int64_t min, int64_t max)
+{
+	jxs_rvalue val;
+	if (jxs_gen_scalar(jctx, &val) != 0) {
+		return -1;
+	}
+	*value = jmap_clamp_int(&jctx->mctx, rval_get_int64(&val), min, max);
+	return 0;
+}
 
-	case jxs_type_int:
-		if (TYPEOF(size, int64_t)) {
-			*((int64_t *)vptr) = (int64_t)json_object_get_int64(item_jso);
-		} else if (TYPEOF(size, int32_t)) {
-			*((int32_t *)vptr) = (int32_t)json_object_get_int(item_jso);
-		} else if (TYPEOF(size, int16_t)) {
-			*((int16_t *)vptr) = (int16_t)json_object_get_int(item_jso);
-		} else if (TYPEOF(size, int8_t)) {
-			*((int8_t *)vptr) = (int8_t)json_object_get_int(item_jso);
-		} else {
-			jxs_log(JXS_LOG_ERROR, "%s: required type '%s' <sizeof> does not match.\n",
-			        locator, type_to_name(type));
-			return -1;
-		}
-		break;
+int jxs_gen_read_uint(jxs_context *jctx, uint64_t *value, uint64_t max)
+{
+	bool       neg = false;
+	uint64_t   num = 0;
+	jxs_rvalue val;
+	if (jxs_gen_scalar(jctx, &val) != 0) {
+		return -1;
+	}
+	num    = rval_get_uint64(&val, &neg);
+	*value = jmap_clamp_uint(&jctx->mctx, num, neg, max);
+	return 0;
+}
 
-	case jxs_type_string: {
-		const char *tmpstr = NULL;
-		tmpstr = json_object_get_string(item_jso);
-		if (tmpstr == NULL) {
-			memset(vptr, 0, size);
-		} else {
-			snprintf(*((char(*)[])vptr), size, "%s", tmpstr);
-		}
-		break;
+int jxs_gen_read_double(jxs_context *jctx, double *value)
+{
+	jxs_rvalue val;
+	if (jxs_gen_scalar(jctx, &val) != 0) {
+		return -1;
 	}
+	*value = rval_get_double(&val);
+	return 0;
+}
 
-	case jxs_type_object:
-		*((json_object **)vptr) = json_object_get(item_jso);
-		break;
+int jxs_gen_read_float(jxs_context *jctx, float *value)
+{
+	jxs_rvalue val;
+	if (jxs_gen_scalar(jctx, &val) != 0) {
+		return -1;
+	}
+	*value = rval_get_float(&val);
+	return 0;
+}
 
-	case jxs_type_struct:
-		if (jmitem->subjm == NULL) {
-			jxs_log(JXS_LOG_ERROR, "%s: Please create a mapper for your nested struct..\n", locator);
+int jxs_gen_read_string(jxs_context *jctx, char *dst, size_t size)
+{
+	jxs_reader *rd = &jctx->in;
+	int         c  = 0;
+	if (rd_null(rd)) {
+		memset(dst, 0, size);
+		return 0;
+	}
+	c = rd_peek(rd);
+	if ((c == '"') || (c == '\'')) {
+		/* decode the string into the member directly */
+		if (rd_string(rd, dst, size) != 0) {
 			return -1;
 		}
-		if (item_jso == NULL) {
-			memset(vptr, 0, size);
-		} else {
-			jmap_head_t *sub_jmhead = get_jmhead(jmitem->subjm);
-			sub_jmhead->start_addr = (uint8_t *)jmhead->start_addr + jmitem->offset;
-			jmap_struct_move_forward(jmitem->subjm, size, idx);
-			if (jmap_from_json_object(ctx, jmitem->subjm, item_jso) != 0) {
-				jxs_log(JXS_LOG_ERROR, "%s: struct from json error.\n", locator);
-				return -1;
-			}
-			jmap_struct_move_backward(jmitem->subjm, size, idx);
-		}
-		break;
-
-	case jxs_type_array:
-		if (item_jso == NULL) {
-			memset(vptr, 0, size);
-		} else {
-			jmap_item_t new_jmitem;
-			jmap_array_move_next_dimen(&new_jmitem, jmitem, idx);
-			if (jmap_from_json_array(ctx, jmhead, &new_jmitem, item_jso) != 0) {
-				jxs_log(JXS_LOG_ERROR, "%s: array from json error.\n", locator);
-				return -1;
-			}
-		}
-		break;
-
-	default:
-		jxs_log(JXS_LOG_ERROR, "%s: error mapper type.\n", locator);
+	} else if (rd_value_to_string(rd, dst, size) != 0) {
 		return -1;
 	}
+	jctx->mctx.stats.truncated += rd->cut ? 1 : 0;
 	return 0;
 }
 
-/**
- * @brief Fill json_object based on array's jmap
- *
- * @param[in]  jmitem  jampitem of the array.
- * @param[out] arrjso  json_object of array.
- * @return 0 for success, -1 for error.
- */
-static int jmap_to_json_array(jmap_context_t *ctx, jmap_head_t *jmhead,
-                              jmap_item_t *jmitem, json_object *arrjso)
+int jxs_gen_read_jso(jxs_context *jctx, json_object **jso)
 {
-	int         ret       = 0;
-	size_t      i         = 0;
-	const char *locator   = ctx->now.locator;
-	const char *fzlocator = ctx->now.fzlocator;
-	size_t      arr_len   = jmitem->arr.length;
-	if ((jmitem->size == 0) || (arr_len == 0)) {
-		jxs_log(JXS_LOG_ERROR, "%s: array 'size', 'len' cannot not be zero.\n", locator);
-		return -1;
+	if (rd_null(&jctx->in)) {
+		*jso = NULL;
+		return 0;
 	}
-	/* If not json array type, return error */
-	if (json_object_get_type(arrjso) != json_type_array) {
-		jxs_log(JXS_LOG_ERROR, "%s: this json_object is not a 'json_type_array' object.\n", locator);
-		return -1;
+	return rd_value_to_jso(&jctx->in, jso);
+}
+
+/* append formatted text to the generated source */
+static void cg_vprintf(jxs_wbuf *wbuf, const char *fmt, va_list ap)
+{
+	int     len = 0;
+	va_list cp;
+	va_copy(cp, ap);
+	len = vsnprintf(NULL, 0, fmt, cp);
+	va_end(cp);
+	if (len < 0) {
+		wbuf->err = true;
+		return;
 	}
-	for (i = 0; i < arr_len; i++) {
-		json_object *item_jso = NULL;
-		ctx->now.jmitem = jmitem;
-		ctx->now.jmhead = jmhead;
-		ctx->now.idx    = i;
-		SET_NEW_LOCATOR(ctx->now.locator, locator, jmitem->key, 1, i);
-		SET_NEW_FUZZY_LOCATOR(ctx->now.fzlocator, fzlocator, jmitem->key, 1);
-		ret = jmap_to_json_warpper(ctx, jmhead, jmitem, i, &item_jso, ctx->now.locator);
-		if (ret == -1) {
-			jxs_log(JXS_LOG_ERROR, "%s: jmap to json error.\n", locator);
-			return -1;
-		} else if (ret == 0) {
-			json_object_array_add(arrjso, item_jso);
-		} else {
-			jxs_log(JXS_LOG_TRACE, "delete '%s[%" FMT_SIZE_T "]' item.\n", locator, i);
-			ret = 0;
+	if (wbuf_reserve(wbuf, (size_t)len) == 0) {
+		vsnprintf(wbuf->data + wbuf->len, (size_t)len + 1, fmt, ap);
+		wbuf->len += (size_t)len;
+	}
+}
+
+static void cg_printf(jxs_wbuf *wbuf, const char *fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	cg_vprintf(wbuf, fmt, ap);
+	va_end(ap);
+}
+
+/* append an indented line to the generated source */
+static void cg_line(jxs_cg *cg, const char *fmt, ...)
+{
+	va_list ap;
+	wbuf_fill(&cg->src, '\t', (size_t)cg->indent);
+	va_start(ap, fmt);
+	cg_vprintf(&cg->src, fmt, ap);
+	va_end(ap);
+	wbuf_putc(&cg->src, '\n');
+}
+
+/* append the bytes as the inside of a C string literal */
+static void cg_cstring(jxs_wbuf *wbuf, const char *str, size_t len)
+{
+	size_t i = 0;
+	for (i = 0; i < len; i++) {
+		unsigned char c = (unsigned char)str[i];
+		switch (c) {
+		case '"':  wbuf_puts(wbuf, "\\\""); break;
+		case '\\': wbuf_puts(wbuf, "\\\\"); break;
+		case '\n': wbuf_puts(wbuf, "\\n"); break;
+		case '\t': wbuf_puts(wbuf, "\\t"); break;
+		/* no trigraphs */
+		case '?':  wbuf_puts(wbuf, "\\?"); break;
+		default:
+			if ((c < 0x20) || (c >= 0x7f)) {
+				char oct[4] = { '\\', (char)('0' + (c >> 6)), (char)('0' + ((c >> 3) & 7)),
+				                (char)('0' + (c & 7)) };
+				wbuf_append(wbuf, oct, sizeof(oct));
+			} else {
+				wbuf_putc(wbuf, (char)c);
+			}
+			break;
+		}
+	}
+}
+
+/* emit the json text 'str' as one jxs_gen_raw() call */
+static void cg_raw(jxs_cg *cg, const char *str, size_t len)
+{
+	wbuf_fill(&cg->src, '\t', (size_t)cg->indent);
+	wbuf_puts(&cg->src, "jxs_gen_raw(jctx, \"");
+	cg_cstring(&cg->src, str, len);
+	cg_printf(&cg->src, "\", %" FMT_SIZE_T ");\n", len);
+}
+
+/* emit the json text written so far, the next value is not a constant */
+static void cg_flush(jxs_cg *cg)
+{
+	if (cg->lit.len != 0) {
+		cg_raw(cg, cg->lit.data, cg->lit.len);
+		cg->lit.len = 0;
+	}
+}
+
+/* function of the mapper at the level(-1 for the reader), SIZE_MAX if none */
+static size_t cg_func_find(jxs_cg *cg, jxs_mapper *mapper, int level)
+{
+	size_t i = 0;
+	for (i = 0; i < cg->nfunc; i++) {
+		if ((cg->func[i].mapper == mapper) && (cg->func[i].level == level)) {
+			return i;
 		}
 	}
-	return ret;
+	return SIZE_MAX;
 }
 
 /**
- * @brief Write the struct to the json_object according to the struct's mapper
- *
- * @param  mapper  [input]struct's mapper
- * @param  jso   [output]json_object, Must be initialized
- * @return 0 for success, -1 for error.
+ * @brief Dimensions and element width of an item, the item itself is one
+ * element of no dimension.
+ * @return number of dimensions, -1 if the size doesn't match them.
  */
-static int jmap_to_json_object(jmap_context_t *ctx, jxs_mapper *mapper, json_object *jso)
+static int cg_item_dims(jmap_item_t *jmitem, size_t dims[JXS_ARRAY_DEPTH], size_t *width)
 {
-	int          ret       = 0;
-	size_t       i         = 0;
-	const char  *locator   = ctx->now.locator;
-	const char  *fzlocator = ctx->now.fzlocator;
-	jmap_head_t *jmhead    = get_jmhead(mapper);
-	jmap_list_t *jmlist    = get_jmlist(mapper);
-	if ((mapper == NULL) || (jso == NULL)) {
-		jxs_log(JXS_LOG_ERROR, "%s: mapper or json_object is null.\n", locator);
-		return -1;
+	size_t i     = 0;
+	size_t count = 1;
+	for (i = 0; i < jmitem->arr.depth; i++) {
+		dims[i] = jmitem->arr.deptab[i];
+		count  *= dims[i];
 	}
-	if (json_object_get_type(jso) != json_type_object) {
-		jxs_log(JXS_LOG_ERROR, "%s: this json_object is not a 'json_type_object' object.\n", locator);
+	if ((count == 0) || (jmitem->size % count != 0) || ((i > 0) && (jmitem->size == 0))) {
 		return -1;
 	}
-	for (i = 0; i < jmhead->idx; i++) {
-		json_object *item_jso = NULL;
-		jmap_item_t *jmitem   = &jmlist[i];
-		ctx->now.jmitem = jmitem;
-		ctx->now.jmhead = jmhead;
-		ctx->now.idx    = 0;
-		SET_NEW_LOCATOR(ctx->now.locator, locator, jmitem->key, 0, 0);
-		SET_NEW_FUZZY_LOCATOR(ctx->now.fzlocator, fzlocator, jmitem->key, 0);
-		ret = jmap_to_json_warpper(ctx, jmhead, jmitem, 0, &item_jso, ctx->now.locator);
-		if (ret == -1) {
-			jxs_log(JXS_LOG_ERROR, "%s: jmap to json error.\n", locator);
-			return -1;
-		} else if (ret == 0) {
-			json_object_object_add(jso, jmitem->key, item_jso);
-		} else {
-			jxs_log(JXS_LOG_TRACE, "%s: delete current item.\n", locator);
-			ret = 0;
-		}
-	}
-	return ret;
+	*width = jmitem->size / count;
+	return (int)jmitem->arr.depth;
 }
 
 /**
- * @brief Fill array's jmap based on json_object
- *
- * @param  jmitem     [output]Jmap of the base address of the array.
- * @param  arr_jso  [input]json_object of array type.
- * @return 0 for success, -1 for error.
+ * @brief Check that the generated code can convert the item the same as the
+ * mapper does.
+ * @return 0 for supported, -1 otherwise.
  */
-static int jmap_from_json_array(jmap_context_t *ctx, jmap_head_t *jmhead,
-                                jmap_item_t *jmitem, json_object *arrjso)
+static int cg_item_check(jxs_mapper *mapper, size_t idx)
 {
-	size_t      i         = 0;
-	const char *locator   = ctx->now.locator;
-	const char *fzlocator = ctx->now.fzlocator;
-	size_t      arr_len   = jmitem->arr.length;
-	size_t      jarr_len  = 0;
-	if (arrjso == NULL) {
-		jxs_log(JXS_LOG_ERROR, "%s: array json_object is null.\n", locator);
+	size_t       i      = 0;
+	size_t       width  = 0;
+	size_t       dims[JXS_ARRAY_DEPTH];
+	bool         known  = false;
+	jmap_item_t *jmitem = &get_jmlist(mapper)[idx];
+	if (jmitem->key == NULL) {
+		jxs_log(JXS_LOG_ERROR, "item key cannot be null.\n");
 		return -1;
 	}
-	if ((jmitem->size == 0) || (arr_len == 0)) {
-		jxs_log(JXS_LOG_ERROR, "%s: array 'size', 'len' cannot not be zero.\n", locator);
+	if (jmitem->rule != JXS_RULE_KEEP_RAW) {
+		jxs_log(JXS_LOG_ERROR, "%s: rules are not supported by the code generator.\n", jmitem->key);
 		return -1;
 	}
-	if (json_object_get_type(arrjso) != json_type_array) {
-		jxs_log(JXS_LOG_ERROR, "%s: this json_object is not a 'json_type_array' object.\n", locator);
+	for (i = 0; i < idx; i++) {
+		if (strcmp(get_jmlist(mapper)[i].key, jmitem->key) == 0) {
+			jxs_log(JXS_LOG_ERROR, "%s: members sharing a key are not supported by the "
+			        "code generator.\n", jmitem->key);
+			return -1;
+		}
+	}
+	if (cg_item_dims(jmitem, dims, &width) < 0) {
+		jxs_log(JXS_LOG_ERROR, "%s: array 'size', 'len' do not match.\n", jmitem->key);
 		return -1;
 	}
-	/* If the json array length exceeds the buf value, the excess is discarded */
-	jarr_len = json_object_array_length(arrjso);
-	if (jarr_len > arr_len) {
-		jxs_log(JXS_LOG_WARN, "%s: array length exceeds the buffer, throw it.\n", locator);
+	switch (jmitem->basetype) {
+	case jxs_type_boolean:
+		known = TYPEOF(width, int) || TYPEOF(width, bool);
+		break;
+	case jxs_type_double:
+		known = TYPEOF(width, double) || TYPEOF(width, float);
+		break;
+	case jxs_type_int:
+	case jxs_type_uint:
+		known = (width == 1) || (width == 2) || (width == 4) || (width == 8);
+		break;
+	case jxs_type_struct:
+		known = (jmitem->subjm != NULL);
+		break;
+	case jxs_type_null:
+	case jxs_type_string:
+	case jxs_type_object:
+		known = true;
+		break;
+	default:
+		break;
 	}
-	arr_len = jarr_len;
-	for (i = 0; i < arr_len; i++) {
-		ctx->now.jmitem = jmitem;
-		ctx->now.jmhead = jmhead;
-		ctx->now.idx    = i;
-		SET_NEW_LOCATOR(ctx->now.locator, locator, jmitem->key, 1, i);
-		SET_NEW_FUZZY_LOCATOR(ctx->now.fzlocator, fzlocator, jmitem->key, 1);
-		if (jmap_from_json_warpper(ctx, jmhead, jmitem, i,
-		                           json_object_array_get_idx(arrjso, i),
-		                           ctx->now.locator) != 0) {
-			jxs_log(JXS_LOG_ERROR, "%s: jmap from json error.\n", locator);
-			return -1;
-		}
+	if (!known) {
+		jxs_log(JXS_LOG_ERROR, "%s: required type '%s' <sizeof> does not match.\n",
+		        jmitem->key, type_to_name(jmitem->basetype));
+		return -1;
 	}
 	return 0;
 }
 
 /**
- * @brief Write the data in the json_object to the struct through jmap
- *
- * @param  jmap  struct's mapper
- * @param  jso   json_object, Must be initialized
+ * @brief Add the function of the mapper at the level(-1 for the reader) after
+ * the ones of its sub-structs, so they are defined before they are called.
  * @return 0 for success, -1 for error.
  */
-static int jmap_from_json_object(jmap_context_t *ctx, jxs_mapper *mapper, json_object *jso)
+static int cg_func_add(jxs_cg *cg, jxs_mapper *mapper, int level)
 {
-	size_t       i         = 0;
-	const char  *locator   = ctx->now.locator;
-	const char  *fzlocator = ctx->now.fzlocator;
-	jmap_head_t *jmhead    = get_jmhead(mapper);
-	jmap_list_t *jmlist    = get_jmlist(mapper);
-	if (mapper == NULL) {
-		jxs_log(JXS_LOG_ERROR, "%s: mapper cannot be null.\n", locator);
-		return -1;
-	}
-	if (jso == NULL) {
-		jxs_log(JXS_LOG_ERROR, "%s: json_object is null.\n", locator);
-		return -1;
+	size_t       i      = 0;
+	jmap_head_t *jmhead = get_jmhead(mapper);
+	jmap_list_t *jmlist = get_jmlist(mapper);
+	if (cg_func_find(cg, mapper, level) != SIZE_MAX) {
+		return 0;
 	}
 	for (i = 0; i < jmhead->idx; i++) {
 		jmap_item_t *jmitem = &jmlist[i];
-		ctx->now.jmitem = jmitem;
-		ctx->now.jmhead = jmhead;
-		ctx->now.idx    = 0;
-		SET_NEW_LOCATOR(ctx->now.locator, locator, jmitem->key, 0, 0);
-		SET_NEW_FUZZY_LOCATOR(ctx->now.fzlocator, fzlocator, jmitem->key, 0);
-		if (jmap_from_json_warpper(ctx, jmhead, jmitem, 0,
-		                           json_object_object_get(jso, jmitem->key),
-		                           ctx->now.locator) != 0) {
-			jxs_log(JXS_LOG_ERROR, "%s: jmap from json error.\n", locator);
+		int          sub    = level;
+		if (cg_item_check(mapper, i) != 0) {
+			return -1;
+		}
+		if (jmitem->basetype != jxs_type_struct) {
+			continue;
+		}
+		/* only the pretty output depends on the level */
+		if ((level >= 0) && (cg->flags & JSON_C_TO_STRING_PRETTY)) {
+			sub = level + 1 + (int)jmitem->arr.depth;
+		}
+		if (cg_func_add(cg, jmitem->subjm, sub) != 0) {
 			return -1;
 		}
 	}
+	if (cg->nfunc == cg->cap) {
+		size_t       cap  = cg->cap ? cg->cap * 2 : 8;
+		jxs_cg_func *func = (jxs_cg_func *)jxs_realloc(cg->func, cap * sizeof(jxs_cg_func));
+		if (func == NULL) {
+			jxs_log(JXS_LOG_ERROR, "code generator out of memory.\n");
+			return -1;
+		}
+		cg->func = func;
+		cg->cap  = cap;
+	}
+	cg->func[cg->nfunc].mapper = mapper;
+	cg->func[cg->nfunc].level  = level;
+	cg->nfunc++;
 	return 0;
 }
 
+static void cg_write_value(jxs_cg *cg, jmap_item_t *jmitem, size_t width, const size_t *dims,
+                           int ndims, const char *var, size_t off, int level);
+
 /**
- * @brief delete the mapper, You should call it only for the top-arr_depth mapper.
- * delete both top mapper and child mapper will cause a double free. Please
- * ensure you are calling it for the top-arr_depth mapper.
- *     1. call @ref json_object_put() to decrement the reference count of the
- *        json_object items.
- *     2. free all the mapper new by @ref jxs_map_basic_new().
- *     3. decrement the reference count of the mapper's json_object.
- * @param  mapper  [input]struct's mapper
- * @see jxs_map_basic_new()
+ * @brief Emit the writer of an array at 'var + off', the same text as
+ * @ref jmap_write_array() writes. Small arrays are unrolled.
+ * @param  dims   dimensions, from this one to the last.
+ * @param  level  level of the array.
  */
-static void jxs_map_basic_delete(jxs_mapper *mapper)
+static void cg_write_array(jxs_cg *cg, jmap_item_t *jmitem, size_t width, const size_t *dims,
+                           int ndims, const char *var, size_t off, int level)
 {
-	size_t i = 0;
-	if (mapper) {
-		jmap_head_t *jmhead = get_jmhead(mapper);
-		jmap_list_t *jmlist = get_jmlist(mapper);
-		/* Last reference */
-		if (jmhead->ref == 1) {
-			for (i = 0; i < jmhead->idx; i++) {
-				jmap_item_t *jmitem = &jmlist[i];
-				if ((jmitem->type == jxs_type_struct) || (jmitem->basetype == jxs_type_struct)) {
-					jxs_map_basic_delete(jmitem->subjm);
-				}
-			}
-			jxs_log(JXS_LOG_INFO, "JMAP DELETE[%p]%s\n", mapper, jmhead->isbuf ? "(BUFFER)" : "");
-			if (jmhead->isbuf == false) {
-				free(mapper);
-			}
-		} else {
-			/* Decrease the reference count value */
-			jmhead->ref--;
+	int    i      = 0;
+	size_t n      = 0;
+	size_t stride = width;
+	char   elem[512];
+	for (i = 1; i < ndims; i++) {
+		stride *= dims[i];
+	}
+	wbuf_putc(&cg->lit, '[');
+	if (cg->flags & JSON_C_TO_STRING_PRETTY) {
+		wbuf_putc(&cg->lit, '\n');
+	}
+	if (dims[0] * (stride / width) <= JXS_CODEGEN_UNROLL) {
+		for (n = 0; n < dims[0]; n++) {
+			jmap_write_prefix(&cg->lit, NULL, n != 0, level + 1, cg->flags);
+			cg_write_value(cg, jmitem, width, dims + 1, ndims - 1, var, off + n * stride, level + 1);
 		}
+	} else {
+		jxs_wbuf sep;
+		memset(&sep, 0, sizeof(jxs_wbuf));
+		cg_flush(cg);
+		cg_line(cg, "for (size_t i%d = 0; i%d < %" FMT_SIZE_T "; i%d++) {",
+		        cg->loop, cg->loop, dims[0], cg->loop);
+		cg->indent++;
+		/* the separator of the elements after the first one */
+		jmap_write_prefix(&sep, NULL, true, level + 1, cg->flags);
+		jmap_write_prefix(&cg->lit, NULL, false, level + 1, cg->flags);
+		cg_line(cg, "if (i%d != 0) {", cg->loop);
+		cg->indent++;
+		cg_raw(cg, sep.data, sep.len);
+		cg->indent--;
+		if (cg->lit.len != 0) {
+			cg_line(cg, "} else {");
+			cg->indent++;
+			cg_flush(cg);
+			cg->indent--;
+		}
+		cg_line(cg, "}");
+		cg->src.err |= sep.err;
+		wbuf_release(&sep);
+		snprintf(elem, sizeof(elem), "%s + i%d * %" FMT_SIZE_T, var, cg->loop, stride);
+		cg->loop++;
+		cg_write_value(cg, jmitem, width, dims + 1, ndims - 1, elem, off, level + 1);
+		cg->loop--;
+		cg_flush(cg);
+		cg->indent--;
+		cg_line(cg, "}");
 	}
+	jmap_write_suffix(&cg->lit, ']', true, level, cg->flags);
 }
 
-jxs_mapper *jxs_map_basic_new(void *context, size_t num)
+/**
+ * @brief Emit the writer of a member(or array element) at 'var + off', the
+ * same text as @ref jmap_write_warpper() writes.
+ * @param  width  element width.
+ * @param  dims   dimensions of the value, ndims is 0 for an element.
+ * @param  level  level of the member.
+ */
+static void cg_write_value(jxs_cg *cg, jmap_item_t *jmitem, size_t width, const size_t *dims,
+                           int ndims, const char *var, size_t off, int level)
 {
-	jxs_mapper     *mapper = NULL;
-	jmap_head_t    *jmhead = NULL;
-	jmap_context_t *ctx    = (jmap_context_t *)context;
-	if (num == 0) {
-		jxs_log(JXS_LOG_ERROR, "jmap item cannot be 0.\n");
-		return NULL;
+	char ptr[512];
+	if (ndims > 0) {
+		cg_write_array(cg, jmitem, width, dims, ndims, var, off, level);
+		return;
 	}
-	if (context == NULL) {
-		jxs_log(JXS_LOG_ERROR, "context data cannot be 0.\n");
-		return NULL;
+	if (jmitem->basetype == jxs_type_null) {
+		wbuf_puts(&cg->lit, "null");
+		return;
 	}
-	if ((MAPPER_BUFFER_LENGTH - ctx->buf.idx) < (num + 1)) {
-		mapper = (jxs_mapper *)calloc(num + 1, sizeof(jxs_mapper));
-		if (mapper == NULL) {
-			jxs_log(JXS_LOG_ERROR, "jmap new failed.\n");
-			return NULL;
+	cg_flush(cg);
+	snprintf(ptr, sizeof(ptr), "%s + %" FMT_SIZE_T, var, off);
+	switch (jmitem->basetype) {
+	case jxs_type_boolean:
+		cg_line(cg, "jxs_gen_bool(jctx, *(const %s *)(const void *)(%s));",
+		        TYPEOF(width, int) ? "int" : "bool", ptr);
+		break;
+
+	case jxs_type_double:
+		if (TYPEOF(width, double)) {
+			cg_line(cg, "jxs_gen_double(jctx, *(const double *)(const void *)(%s));", ptr);
+		} else {
+			cg_line(cg, "jxs_gen_float(jctx, *(const float *)(const void *)(%s));", ptr);
 		}
-		jmhead        = get_jmhead(mapper);
-		jmhead->isbuf = false;
-	} else {
-		/* Prefer to use local variables to store mapper to improve performance,
-		 * Avoid malloc and free memory frequently. buffer length defined by macro
-		 * MAPPER_BUFFER_LENGTH.
-		 */
-		mapper        = &ctx->buf.arr[ctx->buf.idx];
-		ctx->buf.idx += (num + 1);
-		jmhead        = get_jmhead(mapper);
-		jmhead->isbuf = true;
+		break;
+
+	case jxs_type_int:
+		cg_line(cg, "jxs_gen_int(jctx, *(const int%d_t *)(const void *)(%s));", (int)width * 8, ptr);
+		break;
+
+	case jxs_type_uint:
+		cg_line(cg, "jxs_gen_uint(jctx, *(const uint%d_t *)(const void *)(%s));", (int)width * 8, ptr);
+		break;
+
+	case jxs_type_string:
+		cg_line(cg, "jxs_gen_string(jctx, (const char *)(%s), %" FMT_SIZE_T ", %d);",
+		        ptr, width, cg->flags);
+		break;
+
+	case jxs_type_object:
+		cg_line(cg, "jxs_gen_jso(jctx, *(json_object *const *)(const void *)(%s), %d, %d);",
+		        ptr, level, cg->flags);
+		break;
+
+	case jxs_type_struct: {
+		int sub = (cg->flags & JSON_C_TO_STRING_PRETTY) ? level : 0;
+		cg_line(cg, "%s_write_%" FMT_SIZE_T "(jctx, %s);", cg->name,
+		        cg_func_find(cg, jmitem->subjm, sub), ptr);
+		break;
+	}
+
+	default:
+		break;
 	}
-	jmhead->limit      = num;
-	jmhead->start_addr = ctx->start_addr;
-	jxs_log(JXS_LOG_INFO, "JMAP NEW[%p]%s\n", mapper, jmhead->isbuf ? "(BUFFER)" : "");
-	return mapper;
 }
 
-jxs_item *jxs_item_basic_add(jxs_mapper *mapper, jxs_type type, const char *key,
-                             ptrdiff_t offset, size_t mbsize, jxs_mapper *subjm, ...)
+/**
+ * @brief Emit the writer of the struct, the same text as
+ * @ref jmap_write_object() writes.
+ */
+static void cg_write_func(jxs_cg *cg, size_t idx)
 {
-	size_t       i = 0;
-	va_list      ap;
-	jmap_head_t *jmhead = NULL;
-	jmap_list_t *jmlist = NULL;
-	jmap_item_t *jmitem = NULL;
-	if (mapper == NULL) {
-		jxs_log(JXS_LOG_ERROR, "mapper cannot be null.\n");
-		return NULL;
+	size_t       i      = 0;
+	size_t       width  = 0;
+	size_t       dims[JXS_ARRAY_DEPTH];
+	int          level  = cg->func[idx].level;
+	jmap_head_t *jmhead = get_jmhead(cg->func[idx].mapper);
+	jmap_list_t *jmlist = get_jmlist(cg->func[idx].mapper);
+	cg_line(cg, "static void %s_write_%" FMT_SIZE_T "(jxs_context *jctx, const uint8_t *base)",
+	        cg->name, idx);
+	cg_line(cg, "{");
+	cg->indent++;
+	if (jmhead->idx == 0) {
+		cg_line(cg, "(void)base;");
 	}
-	if (type == jxs_type_array) {
-		jxs_log(JXS_LOG_ERROR, "'Multi-Dimen Array' Usage error.\n");
-		return NULL;
-	} else if ((type == jxs_type_struct) && (subjm == NULL)) {
-		jxs_log(JXS_LOG_ERROR, "you must specify a mapper for the sub-struct.\n");
-		return NULL;
+	wbuf_putc(&cg->lit, '{');
+	if (cg->flags & JSON_C_TO_STRING_PRETTY) {
+		wbuf_putc(&cg->lit, '\n');
 	}
-	jmhead = get_jmhead(mapper);
-	jmlist = get_jmlist(mapper);
-	/* avoid overflow */
-	if (jmhead->idx >= jmhead->limit) {
-		jxs_log(JXS_LOG_ERROR, "add too many, drop it.\n");
-		return NULL;
+	for (i = 0; i < jmhead->idx; i++) {
+		jmap_item_t *jmitem = &jmlist[i];
+		int          ndims  = cg_item_dims(jmitem, dims, &width);
+		jmap_write_prefix(&cg->lit, jmitem->key, i != 0, level + 1, cg->flags);
+		cg_write_value(cg, jmitem, width, dims, ndims, "base", (size_t)jmitem->offset, level + 1);
 	}
-	jmitem = &jmlist[jmhead->idx];
-	memset(jmitem, 0, sizeof(jmap_item_t));
-	jmitem->key      = key;
-	jmitem->offset   = offset;
-	jmitem->size     = mbsize;
-	jmitem->subjm    = subjm;
-	jmitem->basetype = type;
-	va_start(ap, subjm);
-	for (i = 0; i < JXS_NELEM(jmitem->arr.deptab); i++) {
-		// TODO: does 'int' is engouth?
-		jmitem->arr.deptab[i] = (size_t)va_arg(ap, int);
-		/* Use 0 to mark the end of the variable argument list */
-		if (jmitem->arr.deptab[i] == 0) {
-			jmitem->arr.depth = i;
-			break;
-		}
+	jmap_write_suffix(&cg->lit, '}', jmhead->idx != 0, level, cg->flags);
+	cg_flush(cg);
+	cg->indent--;
+	cg_line(cg, "}");
+	cg_line(cg, "");
+}
+
+/* emit 'if (call != 0) { return -1; }' */
+static void cg_check(jxs_cg *cg, const char *fmt, const char *ptr, size_t arg)
+{
+	wbuf_fill(&cg->src, '\t', (size_t)cg->indent);
+	wbuf_puts(&cg->src, "if (");
+	cg_printf(&cg->src, fmt, ptr, arg);
+	wbuf_puts(&cg->src, " != 0) {\n");
+	cg->indent++;
+	cg_line(cg, "return -1;");
+	cg->indent--;
+	cg_line(cg, "}");
+}
+
+/* emit the read of a narrow number through a temporary */
+static void cg_read_narrow(jxs_cg *cg, const char *tmp, const char *call, const char *type,
+                           const char *ptr)
+{
+	cg_line(cg, "{");
+	cg->indent++;
+	cg_line(cg, "%s value = 0;", tmp);
+	cg_line(cg, "if (%s != 0) {", call);
+	cg->indent++;
+	cg_line(cg, "return -1;");
+	cg->indent--;
+	cg_line(cg, "}");
+	cg_line(cg, "*(%s *)(void *)(%s) = (%s)value;", type, ptr, type);
+	cg->indent--;
+	cg_line(cg, "}");
+}
+
+static void cg_read_value(jxs_cg *cg, jmap_item_t *jmitem, size_t width, const size_t *dims,
+                          int ndims, const char *var, size_t off);
+
+/**
+ * @brief Emit the reader of an array at 'var + off', the same as
+ * @ref jmap_read_array() reads.
+ * @param  dims   dimensions, from this one to the last.
+ */
+static void cg_read_array(jxs_cg *cg, jmap_item_t *jmitem, size_t width, const size_t *dims,
+                          int ndims, const char *var, size_t off)
+{
+	int    i      = 0;
+	int    loop   = cg->loop;
+	size_t stride = width;
+	char   elem[512];
+	for (i = 1; i < ndims; i++) {
+		stride *= dims[i];
 	}
-	va_end(ap);
-	/* If no 0 is received, the array exceeds a predefined maximum depth */
-	if (jmitem->arr.deptab[JXS_ARRAY_DEPTH] != 0) {
-		jxs_log(JXS_LOG_ERROR, "Exceeds the predefined maximum array depth[%d], "
-		        "you can modify the MACRO manually.\n", JXS_ARRAY_DEPTH);
-		return NULL;
+	cg_line(cg, "switch (jxs_gen_array(jctx)) {");
+	cg_line(cg, "case 0:");
+	cg->indent++;
+	cg_line(cg, "memset(%s + %" FMT_SIZE_T ", 0, %" FMT_SIZE_T ");", var, off, stride * dims[0]);
+	cg_line(cg, "break;");
+	cg->indent--;
+	cg_line(cg, "case 1:");
+	cg->indent++;
+	cg_line(cg, "for (size_t i%d = 0;; i%d++) {", loop, loop);
+	cg->indent++;
+	cg_line(cg, "int more%d = jxs_gen_element(jctx, i%d, %" FMT_SIZE_T ");", loop, loop, dims[0]);
+	cg_line(cg, "if (more%d < 0) {", loop);
+	cg_line(cg, "\treturn -1;");
+	cg_line(cg, "} else if (more%d == 0) {", loop);
+	cg_line(cg, "\tbreak;");
+	cg_line(cg, "}");
+	snprintf(elem, sizeof(elem), "%s + i%d * %" FMT_SIZE_T, var, loop, stride);
+	cg->loop++;
+	cg_read_value(cg, jmitem, width, dims + 1, ndims - 1, elem, off);
+	cg->loop--;
+	cg->indent--;
+	cg_line(cg, "}");
+	cg_line(cg, "break;");
+	cg->indent--;
+	cg_line(cg, "default:");
+	cg_line(cg, "\treturn -1;");
+	cg_line(cg, "}");
+}
+
+/**
+ * @brief Emit the reader of a member(or array element) at 'var + off', the
+ * same as @ref jmap_read_warpper() reads.
+ * @param  width  element width.
+ * @param  dims   dimensions of the value, ndims is 0 for an element.
+ */
+static void cg_read_value(jxs_cg *cg, jmap_item_t *jmitem, size_t width, const size_t *dims,
+                          int ndims, const char *var, size_t off)
+{
+	char ptr[512];
+	char call[640];
+	if (ndims > 0) {
+		cg_read_array(cg, jmitem, width, dims, ndims, var, off);
+		return;
 	}
-	/* If it is not an array, the type is equal to the basic type,
-	 * otherwise it is an array type */
-	jmitem->type = (jmitem->arr.depth == 0) ? jmitem->basetype : jxs_type_array;
-	jmitem->rule = JXS_RULE_KEEP_RAW;
-	/* Increase the jmapper reference count */
-	if (subjm) {
-		jmap_head_t *head = get_jmhead(subjm);
-		head->ref++;
+	snprintf(ptr, sizeof(ptr), "%s + %" FMT_SIZE_T, var, off);
+	switch (jmitem->basetype) {
+	case jxs_type_null:
+		cg_line(cg, "if (!jxs_gen_null(jctx) && (jxs_gen_skip(jctx) != 0)) {");
+		cg_line(cg, "\treturn -1;");
+		cg_line(cg, "}");
+		cg_line(cg, "memset(%s, 0, %" FMT_SIZE_T ");", ptr, width);
+		break;
+
+	case jxs_type_boolean:
+		cg_read_narrow(cg, "int", "jxs_gen_read_bool(jctx, &value)",
+		               TYPEOF(width, int) ? "int" : "bool", ptr);
+		break;
+
+	case jxs_type_double:
+		if (TYPEOF(width, double)) {
+			cg_check(cg, "jxs_gen_read_double(jctx, (double *)(void *)(%s))", ptr, 0);
+		} else {
+			cg_check(cg, "jxs_gen_read_float(jctx, (float *)(void *)(%s))", ptr, 0);
+		}
+		break;
+
+	case jxs_type_int:
+		if (width == 8) {
+			cg_check(cg, "jxs_gen_read_int(jctx, (int64_t *)(void *)(%s), INT64_MIN, INT64_MAX)", ptr, 0);
+		} else {
+			char type[16];
+			snprintf(type, sizeof(type), "int%d_t", (int)width * 8);
+			snprintf(call, sizeof(call), "jxs_gen_read_int(jctx, &value, INT%d_MIN, INT%d_MAX)",
+			         (int)width * 8, (int)width * 8);
+			cg_read_narrow(cg, "int64_t", call, type, ptr);
+		}
+		break;
+
+	case jxs_type_uint:
+		if (width == 8) {
+			cg_check(cg, "jxs_gen_read_uint(jctx, (uint64_t *)(void *)(%s), UINT64_MAX)", ptr, 0);
+		} else {
+			char type[16];
+			snprintf(type, sizeof(type), "uint%d_t", (int)width * 8);
+			snprintf(call, sizeof(call), "jxs_gen_read_uint(jctx, &value, UINT%d_MAX)", (int)width * 8);
+			cg_read_narrow(cg, "uint64_t", call, type, ptr);
+		}
+		break;
+
+	case jxs_type_string:
+		cg_check(cg, "jxs_gen_read_string(jctx, (char *)(%s), %" FMT_SIZE_T ")", ptr, width);
+		break;
+
+	case jxs_type_object:
+		cg_check(cg, "jxs_gen_read_jso(jctx, (json_object **)(void *)(%s))", ptr, 0);
+		break;
+
+	case jxs_type_struct: {
+		size_t sub = cg_func_find(cg, jmitem->subjm, -1);
+		cg_line(cg, "switch (jxs_gen_object(jctx)) {");
+		cg_line(cg, "case 0:");
+		cg_line(cg, "\tmemset(%s, 0, %" FMT_SIZE_T ");", ptr, width);
+		cg_line(cg, "\tbreak;");
+		cg_line(cg, "case 1:");
+		cg->indent++;
+		snprintf(call, sizeof(call), "%s_read_%" FMT_SIZE_T "(jctx, %%s)", cg->name, sub);
+		cg_check(cg, call, ptr, 0);
+		cg_line(cg, "break;");
+		cg->indent--;
+		cg_line(cg, "case 2:");
+		cg_line(cg, "\t%s_clear_%" FMT_SIZE_T "(%s);", cg->name, sub, ptr);
+		cg_line(cg, "\tbreak;");
+		cg_line(cg, "default:");
+		cg_line(cg, "\treturn -1;");
+		cg_line(cg, "}");
+		break;
 	}
-	/* increment the index */
-	jmhead->idx++;
-	return jmitem;
-}
 
-static int check_ref_count(jxs_mapper *mapper)
-{
-	jmap_head_t *head = get_jmhead(mapper);
-	if (head->ref != 0) {
-		jxs_log(JXS_LOG_ERROR, "The return value of the descriptor callback "
-		        "function is incorrect, it needs to be the top-level mapper, "
-		        "otherwise, a memory leak will occur.\n");
-		return -1;
+	default:
+		break;
 	}
-	/*set top-level mapper reference count is 1 */
-	head->ref = 1;
-	return 0;
 }
 
-void jxs_print_struct(jxs_descriptor func, void *stptr, void *opaque)
+/**
+ * @brief Emit the reader of the struct, the same as @ref jmap_read_object()
+ * reads after the '{', and the clear of its members for a value that is not
+ * an object.
+ */
+static void cg_read_func(jxs_cg *cg, size_t idx)
 {
-	jxs_mapper    *mapper = NULL;
-	jxs_mapper     buffer[MAPPER_BUFFER_LENGTH] = { { .jmhead = { 0 } } };
-	jmap_context_t ctx;
-	memset(&ctx, 0, sizeof(jmap_context_t));
-	ctx.buf.arr = buffer;
-	if ((func == NULL) || (stptr == NULL)) {
-		jxs_log(JXS_LOG_ERROR, "constructor or struct cannot be null.\n");
-		return;
-	}
-	ctx.start_addr = stptr;
-	ctx.opaque     = opaque;
-	if ((mapper = func(&ctx)) == NULL) {
-		jxs_log(JXS_LOG_ERROR, "mapper cannot be null.\n");
-		return;
+	size_t       i      = 0;
+	size_t       j      = 0;
+	size_t       width  = 0;
+	size_t       dims[JXS_ARRAY_DEPTH];
+	jmap_head_t *jmhead = get_jmhead(cg->func[idx].mapper);
+	jmap_list_t *jmlist = get_jmlist(cg->func[idx].mapper);
+	cg_line(cg, "static void %s_clear_%" FMT_SIZE_T "(uint8_t *base)", cg->name, idx);
+	cg_line(cg, "{");
+	cg->indent++;
+	if (jmhead->idx == 0) {
+		cg_line(cg, "(void)base;");
 	}
-	if (check_ref_count(mapper) != 0) {
-		jxs_log(JXS_LOG_ERROR, "Incorrect mapper returned.\n");
-		goto end;
+	for (i = 0; i < jmhead->idx; i++) {
+		cg_line(cg, "memset(base + %" FMT_SIZE_T ", 0, %" FMT_SIZE_T ");",
+		        (size_t)jmlist[i].offset, jmlist[i].size);
 	}
-	jmap_struct_print(&ctx, mapper, NULL);
-end:
-	jxs_map_basic_delete(mapper);
-}
+	cg->indent--;
+	cg_line(cg, "}");
+	cg_line(cg, "");
 
-json_object *jxs_struct_to_json_object(jxs_descriptor func,
-                                       void *stptr, void *opaque)
-{
-	int ret = 0;
-	json_object   *jso    = NULL;
-	jxs_mapper    *mapper = NULL;
-	jxs_mapper     buffer[MAPPER_BUFFER_LENGTH] = { { .jmhead = { 0 } } };
-	jmap_context_t ctx;
-	memset(&ctx, 0, sizeof(jmap_context_t));
-	ctx.buf.arr = buffer;
-	if ((func == NULL) || (stptr == NULL)) {
-		jxs_log(JXS_LOG_ERROR, "constructor or struct cannot be null.\n");
-		ret = -1;
-		goto end;
-	}
-	jso = json_object_new_object();
-	if (jso == NULL) {
-		jxs_log(JXS_LOG_ERROR, "json_object new failed.\n");
-		ret = -1;
-		goto end;
+	cg_line(cg, "static int %s_read_%" FMT_SIZE_T "(jxs_context *jctx, uint8_t *base)", cg->name, idx);
+	cg_line(cg, "{");
+	cg->indent++;
+	cg_line(cg, "const char *key  = NULL;");
+	cg_line(cg, "size_t      klen = 0;");
+	if (jmhead->idx == 0) {
+		cg_line(cg, "(void)base;");
+	} else {
+		cg_line(cg, "uint8_t     seen[%" FMT_SIZE_T "];", jmhead->idx);
+		cg_line(cg, "memset(seen, 0, sizeof(seen));");
 	}
-	ctx.start_addr = stptr;
-	ctx.opaque     = opaque;
-	if ((mapper = func(&ctx)) == NULL) {
-		jxs_log(JXS_LOG_ERROR, "mapper cannot be null.\n");
-		ret = -1;
-		goto end;
+	cg_line(cg, "if (!jxs_gen_accept(jctx, '}')) {");
+	cg->indent++;
+	cg_line(cg, "do {");
+	cg->indent++;
+	cg_line(cg, "/* json-c accepts a trailing comma */");
+	cg_line(cg, "if (jxs_gen_peek(jctx) == '}') {");
+	cg_line(cg, "\tbreak;");
+	cg_line(cg, "}");
+	cg_line(cg, "if (jxs_gen_key(jctx, &key, &klen) != 0) {");
+	cg_line(cg, "\treturn -1;");
+	cg_line(cg, "}");
+	if (jmhead->idx != 0) {
+		cg_line(cg, "switch (klen) {");
+		for (i = 0; i < jmhead->idx; i++) {
+			size_t klen  = strlen(jmlist[i].key);
+			bool   first = true;
+			/* one case per key length, with every key of that length */
+			for (j = 0; (j < i) && first; j++) {
+				first = (strlen(jmlist[j].key) != klen);
+			}
+			if (!first) {
+				continue;
+			}
+			cg_line(cg, "case %" FMT_SIZE_T ":", klen);
+			cg->indent++;
+			for (j = i; j < jmhead->idx; j++) {
+				jmap_item_t *jmitem = &jmlist[j];
+				int          ndims  = 0;
+				if (strlen(jmitem->key) != klen) {
+					continue;
+				}
+				ndims = cg_item_dims(jmitem, dims, &width);
+				wbuf_fill(&cg->src, '\t', (size_t)cg->indent);
+				wbuf_puts(&cg->src, "if (memcmp(key, \"");
+				cg_cstring(&cg->src, jmitem->key, klen);
+				cg_printf(&cg->src, "\", %" FMT_SIZE_T ") == 0) {\n", klen);
+				cg->indent++;
+				cg_read_value(cg, jmitem, width, dims, ndims, "base", (size_t)jmitem->offset);
+				cg_line(cg, "seen[%" FMT_SIZE_T "] = 1;", j);
+				cg_line(cg, "continue;");
+				cg->indent--;
+				cg_line(cg, "}");
+			}
+			cg_line(cg, "break;");
+			cg->indent--;
+		}
+		cg_line(cg, "default:");
+		cg_line(cg, "\tbreak;");
+		cg_line(cg, "}");
+	} else {
+		cg_line(cg, "(void)key;");
 	}
-	if (check_ref_count(mapper) != 0) {
-		jxs_log(JXS_LOG_ERROR, "Incorrect mapper returned.\n");
-		ret = -1;
-		goto end;
+	cg_line(cg, "if (jxs_gen_skip(jctx) != 0) {");
+	cg_line(cg, "\treturn -1;");
+	cg_line(cg, "}");
+	cg->indent--;
+	cg_line(cg, "} while (jxs_gen_accept(jctx, ','));");
+	cg_line(cg, "if (jxs_gen_expect(jctx, '}') != 0) {");
+	cg_line(cg, "\treturn -1;");
+	cg_line(cg, "}");
+	cg->indent--;
+	cg_line(cg, "}");
+	/* the members missing in the json object are cleared */
+	for (i = 0; i < jmhead->idx; i++) {
+		cg_line(cg, "if (seen[%" FMT_SIZE_T "] == 0) {", i);
+		cg_line(cg, "\tmemset(base + %" FMT_SIZE_T ", 0, %" FMT_SIZE_T ");",
+		        (size_t)jmlist[i].offset, jmlist[i].size);
+		cg_line(cg, "}");
 	}
-	if (jmap_to_json_object(&ctx, mapper, jso) != 0) {
-		jxs_log(JXS_LOG_ERROR, "jmap to json [%p] error.\n", jso);
-		ret = -1;
-		goto end;
+	cg_line(cg, "return 0;");
+	cg->indent--;
+	cg_line(cg, "}");
+	cg_line(cg, "");
+}
+
+/* check that the prefix can start C identifiers */
+static bool cg_is_ident(const char *name)
+{
+	const char *p = name;
+	if ((name == NULL) || (*name == '\0') || ((*name >= '0') && (*name <= '9'))) {
+		return false;
 	}
-end:
-	jxs_map_basic_delete(mapper);
-	if ((ret != 0) && jso) {
-		json_object_put(jso);
-		jso = NULL;
+	for (; *p; p++) {
+		if (!(((*p >= 'a') && (*p <= 'z')) || ((*p >= 'A') && (*p <= 'Z')) ||
+		      ((*p >= '0') && (*p <= '9')) || (*p == '_'))) {
+			return false;
+		}
 	}
-	return jso;
+	return true;
 }
 
-int jxs_struct_from_json_object(jxs_descriptor func,
-                                void *stptr, void *opaque, json_object *jso)
+int jxs_schema_codegen(const jxs_schema *schema, const char *name, int flags,
+                       const char *filename)
 {
-	int            ret    = 0;
-	jxs_mapper    *mapper = NULL;
-	jxs_mapper     buffer[MAPPER_BUFFER_LENGTH] = { { .jmhead = { 0 } } };
-	jmap_context_t ctx;
-	memset(&ctx, 0, sizeof(jmap_context_t));
-	ctx.buf.arr = buffer;
-	if ((func == NULL) || (stptr == NULL) || (jso == NULL)) {
-		jxs_log(JXS_LOG_ERROR, "constructor, struct or jso cannot be null.\n");
-		ret = -1;
+	int    ret    = -1;
+	size_t i      = 0;
+	size_t writer = 0;
+	size_t reader = 0;
+	size_t len    = 0;
+	FILE  *fp     = NULL;
+	jxs_cg cg;
+	memset(&cg, 0, sizeof(jxs_cg));
+	if ((schema == NULL) || (schema->mapper == NULL) || (filename == NULL)) {
+		jxs_log(JXS_LOG_ERROR, "schema or filename cannot be null.\n");
+		return -1;
+	}
+	if (!cg_is_ident(name)) {
+		jxs_log(JXS_LOG_ERROR, "function prefix [%s] is not a C identifier.\n", name ? name : "");
+		return -1;
+	}
+	if (schema->callback != NULL) {
+		jxs_log(JXS_LOG_ERROR, "the convert callback is not supported by the code generator.\n");
+		return -1;
+	}
+	cg.name  = name;
+	cg.flags = flags;
+	if ((cg_func_add(&cg, schema->mapper, 0) != 0) || (cg_func_add(&cg, schema->mapper, -1) != 0)) {
 		goto end;
 	}
-	ctx.start_addr = stptr;
-	ctx.opaque     = opaque;
-	if ((mapper = func(&ctx)) == NULL) {
-		jxs_log(JXS_LOG_ERROR, "mapper cannot be null.\n");
-		ret = -1;
+	writer = cg_func_find(&cg, schema->mapper, 0);
+	reader = cg_func_find(&cg, schema->mapper, -1);
+	cg_line(&cg, "/*");
+	cg_line(&cg, " * Generated by jxs_schema_codegen(), do not edit.");
+	cg_line(&cg, " * json text converters of '%s', the writer formats with the json-c flags 0x%x.",
+	        name, (unsigned)flags);
+	cg_line(&cg, " */");
+	cg_line(&cg, "#include <stdbool.h>");
+	cg_line(&cg, "#include <stdint.h>");
+	cg_line(&cg, "#include <string.h>");
+	cg_line(&cg, "#include \"jsonXstruct.h\"");
+	cg_line(&cg, "");
+	cg_line(&cg, "const char *%s_to_json_string(jxs_context *jctx, const void *stptr);", name);
+	cg_line(&cg, "int %s_from_json_string(jxs_context *jctx, void *stptr, const char *jstring);", name);
+	cg_line(&cg, "");
+	for (i = 0; i < cg.nfunc; i++) {
+		if (cg.func[i].level >= 0) {
+			cg_write_func(&cg, i);
+		} else {
+			cg_read_func(&cg, i);
+		}
+	}
+	cg_line(&cg, "const char *%s_to_json_string(jxs_context *jctx, const void *stptr)", name);
+	cg_line(&cg, "{");
+	cg_line(&cg, "\tif (jxs_gen_write_begin(jctx, stptr) != 0) {");
+	cg_line(&cg, "\t\treturn NULL;");
+	cg_line(&cg, "\t}");
+	cg_line(&cg, "\t%s_write_%" FMT_SIZE_T "(jctx, (const uint8_t *)stptr);", name, writer);
+	cg_line(&cg, "\treturn jxs_gen_write_end(jctx);");
+	cg_line(&cg, "}");
+	cg_line(&cg, "");
+	cg_line(&cg, "int %s_from_json_string(jxs_context *jctx, void *stptr, const char *jstring)", name);
+	cg_line(&cg, "{");
+	cg_line(&cg, "\tint ret = jxs_gen_read_begin(jctx, stptr, jstring);");
+	cg_line(&cg, "\tif (ret == 1) {");
+	cg_line(&cg, "\t\tret = %s_read_%" FMT_SIZE_T "(jctx, (uint8_t *)stptr);", name, reader);
+	cg_line(&cg, "\t} else if (ret == 2) {");
+	cg_line(&cg, "\t\t/* not an object, every member is cleared like json-c does */");
+	cg_line(&cg, "\t\t%s_clear_%" FMT_SIZE_T "((uint8_t *)stptr);", name, reader);
+	cg_line(&cg, "\t\tret = 0;");
+	cg_line(&cg, "\t}");
+	cg_line(&cg, "\treturn jxs_gen_read_end(jctx, ret);");
+	cg_line(&cg, "}");
+	if (cg.src.err || cg.lit.err) {
+		jxs_log(JXS_LOG_ERROR, "code generator out of memory.\n");
 		goto end;
 	}
-	if (check_ref_count(mapper) != 0) {
-		jxs_log(JXS_LOG_ERROR, "Incorrect mapper returned.\n");
-		ret = -1;
+	if ((fp = fopen(filename, "wb")) == NULL) {
+		jxs_log(JXS_LOG_ERROR, "open file [%s] error.\n", filename);
 		goto end;
 	}
-	if (jmap_from_json_object(&ctx, mapper, jso) != 0) {
-		jxs_log(JXS_LOG_ERROR, "jmap from json [%p] error.\n", jso);
-		ret = -1;
+	len = fwrite(cg.src.data, 1, cg.src.len, fp);
+	if ((fclose(fp) != 0) || (len != cg.src.len)) {
+		jxs_log(JXS_LOG_ERROR, "write file [%s] error.\n", filename);
 		goto end;
 	}
+	ret = 0;
 end:
-	jxs_map_basic_delete(mapper);
+	wbuf_release(&cg.src);
+	wbuf_release(&cg.lit);
+	jxs_free(cg.func);
 	return ret;
 }
 
-const char *jxs_struct_to_json_string_ext(jxs_descriptor func, void *stptr,
-                                          void *opaque, int flags)
-{
-	const char  *jstring = NULL;
-	const char  *copy    = NULL;
-	json_object *jso     = NULL;
-	jso = jxs_struct_to_json_object(func, stptr, opaque);
-	if (jso == NULL) {
-		jxs_log(JXS_LOG_ERROR, "struct to json_object failed.\n");
-		jstring = NULL;
-		goto end;
-	}
-#if (JSON_C_VERSION_NUM >= 0xb00)
-	jstring = json_object_to_json_string_ext(jso, flags);
+#ifdef JXS_HAVE_THREADS
+#define jxs_atomic_fetch_add(ptr, val)    __atomic_fetch_add(ptr, val, __ATOMIC_RELAXED)
 #else
-	(void)flags;
-	jstring = json_object_to_json_string(jso);
+static inline size_t jxs_atomic_fetch_add(size_t *ptr, size_t val)
+{
+	size_t old = *ptr;
+	*ptr += val;
+	return old;
+}
 #endif
-	if (jstring == NULL) {
-		jxs_log(JXS_LOG_ERROR, "json object to string error.\n");
-		goto end;
-	} else {
-		copy = strdup(jstring);
+
+/**
+ * @brief Convert one record of the batch with the worker state.
+ * @return 0 for success, -1 for error.
+ */
+static int jxs_batch_record(jxs_batch_job *job, jxs_batch_worker *worker, size_t i)
+{
+	char *copy  = NULL;
+	void *stptr = job->structs + i * job->stsize;
+	if (job->out) {
+		/* the scratch buffer keeps its capacity, only the result is allocated */
+		worker->wbuf.len = 0;
+		worker->wbuf.err = false;
+		if (jmap_struct_to_wbuf(&worker->ctx, job->schema, stptr, job->opaque,
+		                        &worker->wbuf, job->flags) != 0) {
+			jxs_log(JXS_LOG_ERROR, "batch record [%" FMT_SIZE_T "] to json failed.\n", i);
+			return jmap_stats_commit(&worker->ctx, -1);
+		}
+		if ((copy = (char *)jxs_malloc(worker->wbuf.len + 1)) == NULL) {
+			jxs_log(JXS_LOG_ERROR, "batch record [%" FMT_SIZE_T "] out of memory.\n", i);
+			return jmap_stats_commit(&worker->ctx, -1);
+		}
+		worker->ctx.stats.allocs++;
+		jmap_stats_commit(&worker->ctx, 0);
+		memcpy(copy, worker->wbuf.data, worker->wbuf.len + 1);
+		job->out[i] = copy;
+		return 0;
 	}
-end:
-	if (jso) {
-		json_object_put(jso);
+	if (job->in[i] == NULL) {
+		jxs_log(JXS_LOG_ERROR, "batch record [%" FMT_SIZE_T "] json string is null.\n", i);
+		return -1;
 	}
-	return copy;
+	if (jmap_stats_commit(&worker->ctx,
+	                      jmap_struct_from_text(&worker->ctx, job->schema, stptr, job->opaque,
+	                                            job->in[i], strlen(job->in[i]), false)) != 0) {
+		jxs_log(JXS_LOG_ERROR, "batch record [%" FMT_SIZE_T "] from json failed.\n", i);
+		return -1;
+	}
+	return 0;
 }
 
-const char *jxs_struct_to_json_string(jxs_descriptor func, void *stptr, void *opaque)
+/**
+ * @brief Take chunks of records until the batch is exhausted.
+ */
+static void jxs_batch_run(jxs_batch_job *job, jxs_batch_worker *worker)
 {
-#ifdef JSON_C_TO_STRING_PLAIN
-	return jxs_struct_to_json_string_ext(func, stptr, opaque, JSON_C_TO_STRING_PLAIN);
-#else
-	return jxs_struct_to_json_string_ext(func, stptr, opaque, 0);
-#endif
+	size_t i      = 0;
+	size_t end    = 0;
+	size_t failed = 0;
+	for (;;) {
+		i = jxs_atomic_fetch_add(&job->next, job->chunk);
+		if (i >= job->n) {
+			break;
+		}
+		end = ((job->n - i) < job->chunk) ? job->n : (i + job->chunk);
+		for (; i < end; i++) {
+			if (jxs_batch_record(job, worker, i) != 0) {
+				failed++;
+			}
+		}
+	}
+	if (failed) {
+		jxs_atomic_fetch_add(&job->failed, failed);
+	}
 }
 
-void jxs_free_json_string(char *jstring)
+#ifdef JXS_HAVE_THREADS
+static void *jxs_pool_thread(void *arg)
 {
-	if (jstring) {
-		free(jstring);
+	jxs_batch_worker *worker = (jxs_batch_worker *)arg;
+	jxs_pool         *pool   = worker->pool;
+	jxs_batch_job    *job    = NULL;
+	uint64_t          seq    = 0;
+	pthread_mutex_lock(&pool->lock);
+	for (;;) {
+		while (!pool->stop && (pool->seq == seq)) {
+			pthread_cond_wait(&pool->wake, &pool->lock);
+		}
+		if (pool->stop) {
+			break;
+		}
+		seq = pool->seq;
+		job = pool->job;
+		pthread_mutex_unlock(&pool->lock);
+		jxs_batch_run(job, worker);
+		pthread_mutex_lock(&pool->lock);
+		if (--pool->busy == 0) {
+			pthread_cond_signal(&pool->done);
+		}
 	}
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
 }
+#endif
 
-int jxs_struct_from_json_string(jxs_descriptor func,
-                                void *stptr, void *opaque,
-                                const char *jstring)
+/**
+ * @brief Run the batch on the pool, or on the caller thread without a pool.
+ * @return 0 when every record is converted, -1 otherwise.
+ */
+static int jxs_batch_exec(jxs_pool *pool, jxs_batch_job *job)
 {
-	int ret = 0;
-	json_object *jso = NULL;
-	if (jstring == NULL) {
-		jxs_log(JXS_LOG_ERROR, "json string cannot be null.\n");
-		ret = -1;
-		goto end;
-	}
-	jso = json_tokener_parse(jstring);
-	if (jso == NULL) {
-		jxs_log(JXS_LOG_ERROR, "json string parse error.\n");
-		ret = -1;
-		goto end;
+	size_t           nthreads = pool ? (pool->nworkers + 1) : 1;
+	jxs_batch_worker local;
+	/* several chunks per thread, so a slow record doesn't hold the others */
+	job->chunk = job->n / (nthreads * 8);
+	if (job->chunk == 0) {
+		job->chunk = 1;
 	}
-	if (jxs_struct_from_json_object(func, stptr, opaque, jso) != 0) {
-		jxs_log(JXS_LOG_ERROR, "jmap from json [%p] error.\n", jso);
-		ret = -1;
-		goto end;
+	if (pool == NULL) {
+		memset(&local.wbuf, 0, sizeof(jxs_wbuf));
+		local.pool = NULL;
+		jxs_batch_run(job, &local);
+		wbuf_release(&local.wbuf);
+		return job->failed ? -1 : 0;
 	}
-end:
-	if (jso) {
-		json_object_put(jso);
+#ifdef JXS_HAVE_THREADS
+	pthread_mutex_lock(&pool->batch);
+	if ((pool->nworkers == 0) || (job->n <= job->chunk)) {
+		jxs_batch_run(job, &pool->workers[0]);
+	} else {
+		pthread_mutex_lock(&pool->lock);
+		pool->job  = job;
+		pool->busy = pool->nworkers;
+		pool->seq++;
+		pthread_cond_broadcast(&pool->wake);
+		pthread_mutex_unlock(&pool->lock);
+		jxs_batch_run(job, &pool->workers[0]);
+		pthread_mutex_lock(&pool->lock);
+		while (pool->busy != 0) {
+			pthread_cond_wait(&pool->done, &pool->lock);
+		}
+		pool->job = NULL;
+		pthread_mutex_unlock(&pool->lock);
 	}
-	return ret;
+	pthread_mutex_unlock(&pool->batch);
+#else
+	jxs_batch_run(job, &pool->workers[0]);
+#endif
+	return job->failed ? -1 : 0;
 }
 
-int jxs_struct_to_file_ext(jxs_descriptor func,
-                           void *stptr, void *opaque,
-                           const char *filename, int flags)
+jxs_pool *jxs_pool_new(int nthreads)
 {
-	int ret = 0;
-	json_object *jso = NULL;
-	if (filename == NULL) {
-		jxs_log(JXS_LOG_ERROR, "filename cannot be null.\n");
-		ret = -1;
-		goto end;
+	size_t    i    = 0;
+	jxs_pool *pool = NULL;
+	if (nthreads <= 0) {
+#ifdef JXS_HAVE_THREADS
+		long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = (ncpu > 0) ? (int)ncpu : 1;
+#else
+		nthreads = 1;
+#endif
 	}
-	jso = jxs_struct_to_json_object(func, stptr, opaque);
-	if (jso == NULL) {
-		jxs_log(JXS_LOG_ERROR, "struct to json_object failed.\n");
-		ret = -1;
-		goto end;
+	pool = (jxs_pool *)jxs_calloc(1, sizeof(jxs_pool));
+	if (pool == NULL) {
+		jxs_log(JXS_LOG_ERROR, "pool new failed.\n");
+		return NULL;
 	}
-#if (JSON_C_VERSION_NUM >= 0xc00)
-	ret = json_object_to_file_ext(filename, jso, flags);
-#elif (JSON_C_VERSION_NUM >= 0xb00)
-	ret = json_object_to_file_ext((char *)filename, jso, flags);
-#else
-	(void)flags;
-	ret = json_object_to_file((char *)filename, jso);
+#ifdef JXS_HAVE_THREADS
+	pool->nworkers = (size_t)nthreads - 1;
 #endif
-	if (ret != 0) {
-		jxs_log(JXS_LOG_ERROR, "json to file [%s] error.\n", filename);
-		ret = -1;
-		goto end;
+	pool->workers = (jxs_batch_worker *)jxs_calloc(pool->nworkers + 1, sizeof(jxs_batch_worker));
+	if (pool->workers == NULL) {
+		jxs_log(JXS_LOG_ERROR, "pool workers new failed.\n");
+		jxs_free(pool);
+		return NULL;
 	}
-end:
-	if (jso) {
-		json_object_put(jso);
+	for (i = 0; i <= pool->nworkers; i++) {
+		pool->workers[i].pool = pool;
 	}
-	return ret;
+#ifdef JXS_HAVE_THREADS
+	pool->threads = (pthread_t *)jxs_calloc(pool->nworkers + 1, sizeof(pthread_t));
+	if (pool->threads == NULL) {
+		jxs_log(JXS_LOG_ERROR, "pool threads new failed.\n");
+		jxs_free(pool->workers);
+		jxs_free(pool);
+		return NULL;
+	}
+	pthread_mutex_init(&pool->batch, NULL);
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->wake, NULL);
+	pthread_cond_init(&pool->done, NULL);
+	for (i = 0; i < pool->nworkers; i++) {
+		if (pthread_create(&pool->threads[i], NULL, jxs_pool_thread, &pool->workers[i + 1]) != 0) {
+			jxs_log(JXS_LOG_WARN, "pool thread create failed, run with %" FMT_SIZE_T
+			        " workers.\n", i);
+			pool->nworkers = i;
+			break;
+		}
+	}
+#endif
+	return pool;
 }
 
-int jxs_struct_to_file(jxs_descriptor func,
-                       void *stptr, void *opaque, const char *filename)
+void jxs_pool_free(jxs_pool *pool)
 {
-#ifdef JSON_C_TO_STRING_PLAIN
-	return jxs_struct_to_file_ext(func, stptr, opaque,
-	                              filename, JSON_C_TO_STRING_PLAIN);
-#else
-	return jxs_struct_to_file_ext(func, stptr, opaque, filename, 0);
+	size_t i = 0;
+	if (pool == NULL) {
+		return;
+	}
+#ifdef JXS_HAVE_THREADS
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = true;
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+	for (i = 0; i < pool->nworkers; i++) {
+		pthread_join(pool->threads[i], NULL);
+	}
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->wake);
+	pthread_mutex_destroy(&pool->lock);
+	pthread_mutex_destroy(&pool->batch);
+	jxs_free(pool->threads);
 #endif
+	for (i = 0; i <= pool->nworkers; i++) {
+		wbuf_release(&pool->workers[i].wbuf);
+	}
+	jxs_free(pool->workers);
+	jxs_free(pool);
 }
 
-int jxs_struct_from_file(jxs_descriptor func,
-                         void *stptr, void *opaque, const char *filename)
+int jxs_batch_to_json(jxs_pool *pool, const jxs_schema *schema,
+                      void *structs, size_t stsize, size_t n,
+                      void *opaque, int flags, char **jstrings)
 {
-	int ret = 0;
-	json_object *jso = NULL;
-	if (filename == NULL) {
-		jxs_log(JXS_LOG_ERROR, "filename cannot be null.\n");
-		ret = -1;
-		goto end;
-	}
-	jso = json_object_from_file(filename);
-	if (jso == NULL) {
-		jxs_log(JXS_LOG_ERROR, "json from file [%s] error.\n", filename);
-		ret = -1;
-		goto end;
-	}
-	if (jxs_struct_from_json_object(func, stptr, opaque, jso) != 0) {
-		jxs_log(JXS_LOG_ERROR, "jmap from json [%p] error.\n", jso);
-		ret = -1;
-		goto end;
+	jxs_batch_job job;
+	if ((schema == NULL) || (structs == NULL) || (jstrings == NULL) || (stsize == 0)) {
+		jxs_log(JXS_LOG_ERROR, "schema, structs or json strings cannot be null.\n");
+		return -1;
 	}
-end:
-	if (jso) {
-		json_object_put(jso);
+	memset(&job, 0, sizeof(jxs_batch_job));
+	memset(jstrings, 0, n * sizeof(char *));
+	job.schema  = schema;
+	job.structs = (uint8_t *)structs;
+	job.stsize  = stsize;
+	job.n       = n;
+	job.opaque  = opaque;
+	job.flags   = flags;
+	job.out     = jstrings;
+	return jxs_batch_exec(pool, &job);
+}
+
+int jxs_batch_from_json(jxs_pool *pool, const jxs_schema *schema,
+                        void *structs, size_t stsize, size_t n,
+                        void *opaque, const char *const *jstrings)
+{
+	jxs_batch_job job;
+	if ((schema == NULL) || (structs == NULL) || (jstrings == NULL) || (stsize == 0)) {
+		jxs_log(JXS_LOG_ERROR, "schema, structs or json strings cannot be null.\n");
+		return -1;
 	}
-	return ret;
+	memset(&job, 0, sizeof(jxs_batch_job));
+	job.schema  = schema;
+	job.structs = (uint8_t *)structs;
+	job.stsize  = stsize;
+	job.n       = n;
+	job.opaque  = opaque;
+	job.in      = jstrings;
+	return jxs_batch_exec(pool, &job);
 }
 
 void jxs_item_set_rule(jxs_item *item, jxs_rule rule)
@@ -1294,7 +8378,7 @@ const char *jxs_cvt_get_locator(void *context)
 		jxs_log(JXS_LOG_ERROR, "jmap context cannot be null.\n");
 		return NULL;
 	}
-	return ctx->now.locator;
+	return jmap_locator(ctx);
 }
 
 const char *jxs_cvt_get_fuzzy_locator(void *context)
@@ -1304,7 +8388,7 @@ const char *jxs_cvt_get_fuzzy_locator(void *context)
 		jxs_log(JXS_LOG_ERROR, "jmap context cannot be null.\n");
 		return NULL;
 	}
-	return ctx->now.fzlocator;
+	return jmap_fzlocator(ctx);
 }
 
 void *jxs_cvt_get_item_each(void *context)
@@ -1324,7 +8408,7 @@ void *jxs_cvt_get_item_fuzzy(void *context, const char *fuzzy_locator)
 		jxs_log(JXS_LOG_ERROR, "jmap context or fuzzy locator cannot be null.\n");
 		return NULL;
 	}
-	if (strcmp(ctx->now.fzlocator, fuzzy_locator) == 0) {
+	if (jmap_path_match(ctx, fuzzy_locator, true)) {
 		return ctx->now.vptr;
 	}
 	return NULL;
@@ -1337,7 +8421,7 @@ void *jxs_cvt_get_item(void *context, const char *locator)
 		jxs_log(JXS_LOG_ERROR, "jmap context or locator cannot be null.\n");
 		return NULL;
 	}
-	if (strcmp(ctx->now.locator, locator) == 0) {
+	if (jmap_path_match(ctx, locator, false)) {
 		return ctx->now.vptr;
 	}
 	return NULL;
@@ -1365,12 +8449,12 @@ void *jxs_get_userdata(void *context)
 
 void jxs_set_loglevel(int level)
 {
-	jxs_log_level = level;
+	jxs_atomic_store(&jxs_log_level, level);
 }
 
 int jxs_get_loglevel(void)
 {
-	return jxs_log_level;
+	return jxs_atomic_load(&jxs_log_level);
 }
 
 void jxs_set_log_callback(void (*callback)(int, const char *, va_list))
@@ -1378,3 +8462,20 @@ void jxs_set_log_callback(void (*callback)(int, const char *, va_list))
 	jxs_log_callback = callback;
 }
 
+int jxs_set_allocator(const jxs_allocator *allocator)
+{
+	if (allocator == NULL) {
+		jxs_heap.alloc    = jxs_libc_alloc;
+		jxs_heap.resize   = jxs_libc_resize;
+		jxs_heap.release  = jxs_libc_release;
+		jxs_heap.userdata = NULL;
+		return 0;
+	}
+	if ((allocator->alloc == NULL) || (allocator->resize == NULL) || (allocator->release == NULL)) {
+		jxs_log(JXS_LOG_ERROR, "allocator functions cannot be null.\n");
+		return -1;
+	}
+	jxs_heap = *allocator;
+	return 0;
+}
+
@@ -57,7 +57,6 @@ typedef enum jxs_type {
 	jxs_type_boolean, /**< boolean type, can be 'bool/int' */
 	jxs_type_double,  /**< double type, can be 'float/double' */
 	jxs_type_int,     /**< Integer type, can be 'int8/int16/int32/int64' */
-	// TODO: jxs_type_uint type is not currently supported
 	jxs_type_uint,    /**< Unsigned integer type, can be 'uint8/uint16/uint32/uint64' */
 	jxs_type_string,  /**< string type, should be 'char [x]' */
 	jxs_type_struct,  /**< struct type */
@@ -79,6 +78,73 @@ typedef union jxs_mapper    jxs_mapper;
  */
 typedef jxs_mapper * (*jxs_descriptor)(void *context);
 
+/* compiled struct schema, the mapper tree built once by a jxs_descriptor. */
+typedef struct jxs_schema   jxs_schema;
+
+/**
+ * @brief record callback of @ref jxs_ndjson_foreach().
+ * @param stptr     struct filled with the record.
+ * @param lineno    line number of the record, starts from 1.
+ * @param userdata  callback userdata.
+ * @return 0 to continue, or anything else to stop.
+ */
+typedef int (*jxs_record_callback)(void *stptr, size_t lineno, void *userdata);
+
+/* reusable conversion context, keeps its storage across conversions. */
+typedef struct jxs_context  jxs_context;
+
+/* worker pool for the batch conversions. */
+typedef struct jxs_pool     jxs_pool;
+
+/* buffered ndjson writer. */
+typedef struct jxs_writer   jxs_writer;
+
+/* when @ref jxs_writer(or @ref jxs_struct_to_file_sync()) flushes the data to the disk. */
+typedef enum jxs_sync {
+	JXS_SYNC_NONE = 0,  /**< never, leave it to the system */
+	JXS_SYNC_FLUSH,     /**< after every flush of the buffer */
+	JXS_SYNC_CLOSE,     /**< once, when the writer is freed */
+} jxs_sync;
+
+/* format of @ref jxs_struct_diff_to_json(). */
+typedef enum jxs_patch {
+	JXS_PATCH_MERGE = 0, /**< RFC 7386 merge patch, an object with the changed members */
+	JXS_PATCH_JSON,      /**< RFC 6902 json patch, a 'replace' operation per changed value */
+} jxs_patch;
+
+/**
+ * conversion statistics, see @ref jxs_stats_enable(). A call of the json text
+ * and CBOR functions converts while it prints or parses, its time is all in
+ * 'parse_ns'; 'convert_ns' is the time spent on json_object conversions.
+ */
+typedef struct jxs_stats {
+	uint64_t calls;          /**< conversions, one per record of ndjson, writer and batch */
+	uint64_t errors;         /**< conversions that failed */
+	uint64_t items;          /**< struct members visited */
+	uint64_t elements;       /**< array elements visited */
+	uint64_t truncated;      /**< strings cut to fit their member */
+	uint64_t bytes_out;      /**< json text or CBOR produced */
+	uint64_t bytes_in;       /**< json text or CBOR consumed */
+	uint64_t allocs;         /**< heap allocations of the library(not of json-c) */
+	uint64_t descriptor_ns;  /**< wall time of running descriptors */
+	uint64_t convert_ns;     /**< wall time of struct <-> json_object */
+	uint64_t parse_ns;       /**< wall time of printing and parsing json text or CBOR */
+	uint64_t io_ns;          /**< wall time of reading and writing files */
+} jxs_stats;
+
+/**
+ * heap allocator of the library, see @ref jxs_set_allocator(). Every block the
+ * library allocates, the strings and buffers it hands to the caller included,
+ * comes from 'alloc' or 'resize' and goes back through 'release'. json-c keeps
+ * its own allocator.
+ */
+typedef struct jxs_allocator {
+	void *(*alloc)(void *userdata, size_t size);             /**< like malloc() */
+	void *(*resize)(void *userdata, void *ptr, size_t size); /**< like realloc(), ptr may be NULL */
+	void  (*release)(void *userdata, void *ptr);             /**< like free(), ptr is never NULL */
+	void   *userdata;                                        /**< passed to every function */
+} jxs_allocator;
+
 /**
  * @brief set jsonXstruct library loglevel. It will take effect globally. Call it
  * before you use all the features.
@@ -89,6 +155,15 @@ JSONXSTRUCT_API void jxs_set_loglevel(int level);
 JSONXSTRUCT_API int jxs_get_loglevel(void);
 JSONXSTRUCT_API void jxs_set_log_callback(void (*callback)(int, const char *, va_list));
 
+/**
+ * @brief replace the heap allocator of the library, malloc() by default. It
+ * takes effect globally, set it before you use all the features: a block must
+ * go back to the allocator it came from.
+ * @param allocator  allocator, copied. NULL to restore malloc().
+ * @return 0 for success, -1 if a function of the allocator is missing.
+ */
+JSONXSTRUCT_API int jxs_set_allocator(const jxs_allocator *allocator);
+
 /**
  * @brief get opaque userdata.
  * @param  context   jsonXstruct context.
@@ -117,9 +192,10 @@ JSONXSTRUCT_API void jxs_cvt_set_item_rule(void *context, jxs_rule rule);
 
 /**
  * @brief New a mapper for your struct. If you add item more than 'num', it
- * will be discarded. It will use local stack buffer first. malloc() will be used
- * only if there is no buffer left. This can avoid malloc and free memory frequently
- * and improve the performance of jsonXstruct.
+ * will be discarded. It will use local stack buffer first. An arena of the
+ * schema will be used only if there is no buffer left, it allocates blocks of
+ * growing size and is freed at once with the schema. This can avoid malloc and
+ * free memory frequently and improve the performance of jsonXstruct.
  * You don't need to delete mapper manually, jsonXstruct will handle it internally.
  * @param context  jsonXstruct context.
  * @param num      number of mapper item, Usually equal to the number of struct
@@ -156,9 +232,10 @@ JSONXSTRUCT_API jxs_item *jxs_item_basic_add(jxs_mapper *mapper, jxs_type type,
 
 /**
  * @brief New a mapper for your anonymous struct. If you add item more than 'num', it
- * will be discarded. It will use local stack buffer first. malloc() will be used
- * only if there is no buffer left. This can avoid malloc and free memory frequently
- * and improve the performance of jsonXstruct.
+ * will be discarded. It will use local stack buffer first. An arena of the
+ * schema will be used only if there is no buffer left, it allocates blocks of
+ * growing size and is freed at once with the schema. This can avoid malloc and
+ * free memory frequently and improve the performance of jsonXstruct.
  * You don't need to delete mapper manually, jsonXstruct will handle it internally.
  * @param ctx      jsonXstruct context.
  * @param mapper   mapper output.
@@ -176,8 +253,8 @@ JSONXSTRUCT_API jxs_item *jxs_item_basic_add(jxs_mapper *mapper, jxs_type type,
  * @param stptr   struct start address
  * @param stmb    struct member name (Must be exactly the same as json key name).
  * @param type    can be 'boolean'(bool/int), 'double'(double/float),
- *                'int'(int8/int16/int32/int64), 'string'(char [x]),
- *                'object'(json_object), 'struct'(c struct).
+ *                'int'(int8/int16/int32/int64), 'uint'(uint8/uint16/uint32/uint64),
+ *                'string'(char [x]), 'object'(json_object), 'struct'(c struct).
  *                It must be the datatype recommended in brackets, otherwise, an
  *                error will occur.
  * @param subjm   sub-struct's Mapper, if type=struct, a initialized mapper is
@@ -199,9 +276,10 @@ JSONXSTRUCT_API jxs_item *jxs_item_basic_add(jxs_mapper *mapper, jxs_type type,
 
 /**
  * @brief New a mapper for your struct. If you add item more than 'num', it
- * will be discarded. It will use local stack buffer first. malloc() will be used
- * only if there is no buffer left. This can avoid malloc and free memory frequently
- * and improve the performance of jsonXstruct.
+ * will be discarded. It will use local stack buffer first. An arena of the
+ * schema will be used only if there is no buffer left, it allocates blocks of
+ * growing size and is freed at once with the schema. This can avoid malloc and
+ * free memory frequently and improve the performance of jsonXstruct.
  * You don't need to delete mapper manually, jsonXstruct will handle it internally.
  * @param ctx      jsonXstruct context.
  * @param sttype   struct prototype.
@@ -219,8 +297,8 @@ JSONXSTRUCT_API jxs_item *jxs_item_basic_add(jxs_mapper *mapper, jxs_type type,
  * @param mapper  mapper, must have been initialized with @ref jxs_map_basic_new().
  * @param stmb    struct member name (Must be exactly the same as json key name).
  * @param type    can be 'boolean'(bool/int), 'double'(double/float),
- *                'int'(int8/int16/int32/int64), 'string'(char [x]),
- *                'object'(json_object), 'struct'(c struct).
+ *                'int'(int8/int16/int32/int64), 'uint'(uint8/uint16/uint32/uint64),
+ *                'string'(char [x]), 'object'(json_object), 'struct'(c struct).
  *                It must be the datatype recommended in brackets, otherwise, an
  *                error will occur.
  * @param subjm   sub-struct's Mapper, if type=struct, a initialized mapper is
@@ -264,6 +342,23 @@ JSONXSTRUCT_API void jxs_item_set_rule(jxs_item *item, jxs_rule rule);
  */
 JSONXSTRUCT_API void jxs_item_set_constkey(jxs_item *item, const char *key);
 
+/**
+ * @brief compile a struct descriptor into a reusable schema. The descriptor is
+ * called only once here, the mapper tree it builds is kept on the heap and owned
+ * by the schema, so the '*_with_schema' conversion functions don't need to run
+ * the descriptor and build mappers again on every call.
+ * @param func    struct descriptor, see @ref jxs_struct_to_json_object().
+ * @param opaque  user opaque data, @ref jxs_get_userdata() returns it inside
+ *                the descriptor. The conversion functions take their own opaque.
+ * @return schema instance if success, or NULL is returned. it need free by
+ * yourself, call @ref jxs_schema_free() to free it.
+ * @note A schema is never modified by the conversion functions, so one schema
+ * can be shared by conversions running in several threads at the same time, as
+ * long as the convert callback(if any) is thread-safe too.
+ */
+JSONXSTRUCT_API jxs_schema *jxs_schema_compile(jxs_descriptor func, void *opaque);
+JSONXSTRUCT_API void jxs_schema_free(jxs_schema *schema);
+
 /**
  * @brief convert struct to json_object, you must implement the jxs_descriptor
  * callback function to describe your struct construction. It will new json_object
@@ -277,9 +372,14 @@ JSONXSTRUCT_API void jxs_item_set_constkey(jxs_item *item, const char *key);
  * @param opaque  user opaque data, use @ref jxs_get_userdata() to get it.
  * @return json_object instance if success, or NULL is returned. it need free by
  * yourself, such as calling @ref json_object_put().
+ * @note Every conversion function has a '*_with_schema' variant, it takes a
+ * schema from @ref jxs_schema_compile() instead of the descriptor, and does
+ * the same thing without running the descriptor again.
  */
 JSONXSTRUCT_API json_object *jxs_struct_to_json_object(jxs_descriptor func,
                                                        void *stptr, void *opaque);
+JSONXSTRUCT_API json_object *jxs_struct_to_json_object_with_schema(const jxs_schema *schema,
+                                                                   void *stptr, void *opaque);
 
 /**
  * @brief parse struct from json_object, you must implement the jxs_descriptor
@@ -297,10 +397,13 @@ JSONXSTRUCT_API json_object *jxs_struct_to_json_object(jxs_descriptor func,
  */
 JSONXSTRUCT_API int jxs_struct_from_json_object(jxs_descriptor func, void *stptr,
                                                 void *opaque, json_object *jso);
+JSONXSTRUCT_API int jxs_struct_from_json_object_with_schema(const jxs_schema *schema, void *stptr,
+                                                            void *opaque, json_object *jso);
 
 /**
  * @brief write struct to file as json format, you must implement the jxs_descriptor
- * callback function to describe your struct construction.
+ * callback function to describe your struct construction. Like
+ * @ref jxs_struct_to_json_string_ext(), no json_object is built.
  * @param func     struct descriptor, it will be called before the conversion
  *                 starts. it must be implemented and cannot be null, otherwise,
  *                 an error will occur. you must use @ref jxs_map_basic_new() and
@@ -312,15 +415,39 @@ JSONXSTRUCT_API int jxs_struct_from_json_object(jxs_descriptor func, void *stptr
  * @param flags    formatting options, see JSON_C_TO_STRING_PRETTY and other
  *                 constants.
  * @return 0 for success, -1 for error.
+ * @note The file is replaced atomically without a disk sync, see
+ * @ref jxs_struct_to_file_sync().
  */
 JSONXSTRUCT_API int jxs_struct_to_file_ext(jxs_descriptor func, void *stptr,
                                            void *opaque, const char *filename, int flags);
 JSONXSTRUCT_API int jxs_struct_to_file(jxs_descriptor func, void *stptr,
                                        void *opaque, const char *filename);
+JSONXSTRUCT_API int jxs_struct_to_file_ext_with_schema(const jxs_schema *schema, void *stptr,
+                                                       void *opaque, const char *filename,
+                                                       int flags);
+JSONXSTRUCT_API int jxs_struct_to_file_with_schema(const jxs_schema *schema, void *stptr,
+                                                   void *opaque, const char *filename);
+
+/**
+ * @brief Same as @ref jxs_struct_to_file_ext_with_schema(), with the disk sync
+ * chosen by the caller. The json text is written to a new file next to
+ * 'filename' in one write, then renamed over it, so a crash leaves the old
+ * file or the new one and never a part of it(on POSIX systems, elsewhere the
+ * file is written in place). If 'filename' is a symbolic link, the file it
+ * points to is replaced and the link is kept. The new file keeps the mode of
+ * the old one, and its owner and group when the process may set them(else it
+ * is owned by the process, like a new file).
+ * @param sync     JXS_SYNC_NONE leaves it to the system, any other value syncs
+ *                 the data before the rename and the directory after it.
+ * @return 0 for success, -1 for error.
+ */
+JSONXSTRUCT_API int jxs_struct_to_file_sync(const jxs_schema *schema, void *stptr, void *opaque,
+                                            const char *filename, int flags, jxs_sync sync);
 
 /**
  * @brief parse struct from json format file, you must implement the jxs_descriptor
- * callback function to describe your struct construction.
+ * callback function to describe your struct construction. Like
+ * @ref jxs_struct_from_json_string(), no json_object is built.
  * @param func     struct descriptor, it will be called before the conversion
  *                 starts. it must be implemented and cannot be null, otherwise,
  *                 an error will occur. you must use @ref jxs_map_basic_new() and
@@ -334,11 +461,75 @@ JSONXSTRUCT_API int jxs_struct_to_file(jxs_descriptor func, void *stptr,
 JSONXSTRUCT_API int jxs_struct_from_file(jxs_descriptor func,
                                          void *stptr, void *opaque,
                                          const char *filename);
+JSONXSTRUCT_API int jxs_struct_from_file_with_schema(const jxs_schema *schema,
+                                                     void *stptr, void *opaque,
+                                                     const char *filename);
+
+/**
+ * @brief parse a newline-delimited json(ndjson) file, one struct per line. Every
+ * line is parsed straight into the same struct like
+ * @ref jxs_struct_from_json_string_with_schema() does, then the callback is
+ * called. The file is mapped into memory a window at a time, so the memory used
+ * doesn't depend on the file size. Empty lines are ignored, a line that fails to
+ * parse is skipped with a warning and no callback.
+ * @param schema   compiled schema of one line, see @ref jxs_schema_compile().
+ * @param filename ndjson file path.
+ * @param stptr    struct pointer, filled again by every line.
+ * @param opaque   user opaque data, use @ref jxs_get_userdata() to get it.
+ * @param callback called with the struct after every parsed line, return 0 to
+ *                 continue, or anything else to stop.
+ * @param userdata callback userdata.
+ * @return 0 for success(also when stopped by the callback), -1 if the file
+ * can't be read.
+ */
+JSONXSTRUCT_API int jxs_ndjson_foreach(const jxs_schema *schema, const char *filename,
+                                       void *stptr, void *opaque,
+                                       jxs_record_callback callback, void *userdata);
+
+/**
+ * @brief new a buffered writer, it appends structs to the file descriptor as
+ * newline-delimited json(ndjson), one record per line. The records are written
+ * straight into one reusable buffer, which is written out when it's full.
+ * @param fd       output file descriptor, it's not closed by the writer.
+ * @param bufsize  buffer size, 0 for the default(64KB).
+ * @param sync     fsync policy, see @ref jxs_sync.
+ * @return writer instance if success, or NULL is returned. call
+ * @ref jxs_writer_free() to flush and free it.
+ * @note A writer is not thread-safe. Only available where POSIX io is.
+ */
+JSONXSTRUCT_API jxs_writer *jxs_writer_new(int fd, size_t bufsize, jxs_sync sync);
+/**
+ * @brief append a struct as one json line. The buffer is written out once it
+ * holds 'bufsize' bytes, a write error keeps the records buffered and is
+ * returned by the next @ref jxs_writer_flush() or @ref jxs_writer_free().
+ * @param writer   buffered writer.
+ * @param schema   compiled schema, see @ref jxs_schema_compile().
+ * @param stptr    struct pointer, Require initialized.
+ * @param opaque   user opaque data, use @ref jxs_get_userdata() to get it.
+ * @param flags    formatting options, JSON_C_TO_STRING_PRETTY and
+ *                 JSON_C_TO_STRING_PRETTY_TAB are ignored to keep one line.
+ * @return 0 when the record is buffered, -1 if it can't be converted, nothing
+ * of the record is buffered then.
+ */
+JSONXSTRUCT_API int jxs_writer_append(jxs_writer *writer, const jxs_schema *schema,
+                                      void *stptr, void *opaque, int flags);
+/**
+ * @brief write out the buffered records(and fsync them with JXS_SYNC_FLUSH).
+ * @return 0 for success, -1 for error, the unwritten records stay buffered.
+ */
+JSONXSTRUCT_API int jxs_writer_flush(jxs_writer *writer);
+/**
+ * @brief flush the buffered records(and fsync them with JXS_SYNC_FLUSH or
+ * JXS_SYNC_CLOSE), then free the writer.
+ * @return 0 for success, -1 if some records could not be written.
+ */
+JSONXSTRUCT_API int jxs_writer_free(jxs_writer *writer);
 
 /**
  * @brief convert struct to json string, you must implement the jxs_descriptor
  * callback function to describe your struct construction. It will new json string
- * internally.
+ * internally. The json text is written straight from the struct without building
+ * any json_object, the output is the same as json-c prints with these flags.
  * @param func    struct descriptor, it will be called before the conversion
  *                starts. it must be implemented and cannot be null, otherwise,
  *                an error will occur. you must use @ref jxs_map_basic_new() and
@@ -355,11 +546,39 @@ JSONXSTRUCT_API const char *jxs_struct_to_json_string(jxs_descriptor func,
                                                       void *stptr, void *opaque);
 JSONXSTRUCT_API const char *jxs_struct_to_json_string_ext(jxs_descriptor func, void *stptr,
                                                           void *opaque, int flags);
+JSONXSTRUCT_API const char *jxs_struct_to_json_string_with_schema(const jxs_schema *schema,
+                                                                  void *stptr, void *opaque);
+JSONXSTRUCT_API const char *jxs_struct_to_json_string_ext_with_schema(const jxs_schema *schema,
+                                                                      void *stptr, void *opaque,
+                                                                      int flags);
 JSONXSTRUCT_API void jxs_free_json_string(char *jstring);
 
+/**
+ * @brief Write what changed from 'oldst' to 'newst' as a json patch, so only
+ * the changed members have to be sent. Equal sub-structs and arrays are
+ * skipped with one memcmp(), strings are compared up to their terminator and
+ * json_object members by value.
+ * @param schema  compiled schema of both structs.
+ * @param oldst   the struct as it was(the snapshot).
+ * @param newst   the struct as it is now, the values are taken from it.
+ * @param opaque  user opaque data, use @ref jxs_get_userdata() to get it.
+ * @param format  JXS_PATCH_MERGE, the changed members as an object('{}' if
+ *                nothing changed), an array that changed is sent whole.
+ *                JXS_PATCH_JSON, a 'replace' operation for every changed value,
+ *                the paths are the locators as json pointers("/tb/1/icon").
+ * @param flags   formatting options, the patch is always compact.
+ * @return patch string, free it by @ref jxs_free_json_string(), NULL for error.
+ */
+JSONXSTRUCT_API const char *jxs_struct_diff_to_json(const jxs_schema *schema, const void *oldst,
+                                                    void *newst, void *opaque,
+                                                    jxs_patch format, int flags);
+
 /**
  * @brief parse struct from json string, you must implement the jxs_descriptor
- * callback function to describe your struct construction.
+ * callback function to describe your struct construction. The json text is
+ * parsed straight into the struct members, the values without a mapper item are
+ * skipped. The result is the same as @ref jxs_struct_from_json_object(), except
+ * that a syntax error may be found after some members have been written.
  * @param func    struct descriptor, it will be called before the conversion
  *                starts. it must be implemented and cannot be null, otherwise,
  *                an error will occur. you must use @ref jxs_map_basic_new() and
@@ -372,6 +591,254 @@ JSONXSTRUCT_API void jxs_free_json_string(char *jstring);
  */
 JSONXSTRUCT_API int jxs_struct_from_json_string(jxs_descriptor func, void *stptr,
                                                 void *opaque, const char *jstring);
+JSONXSTRUCT_API int jxs_struct_from_json_string_with_schema(const jxs_schema *schema, void *stptr,
+                                                            void *opaque, const char *jstring);
+
+/**
+ * @brief Apply an RFC 7386 merge patch to the struct in place. Only the members
+ * present in the patch are written, every other byte of the struct is left as
+ * it is, so the cost follows the size of the patch rather than of the struct.
+ * A member set to null is cleared, a sub-struct is merged member by member.
+ * An array is replaced whole: the elements past the patch's length and the
+ * members an element doesn't name are cleared. A patch that is not an object
+ * clears the whole struct.
+ * @param schema  compiled schema of the struct.
+ * @param stptr   struct pointer, Require initialized.
+ * @param opaque  user opaque data, use @ref jxs_get_userdata() to get it.
+ * @param jstring merge patch, e.g. made by @ref jxs_struct_diff_to_json().
+ * @return 0 for success, -1 for error.
+ */
+JSONXSTRUCT_API int jxs_struct_patch_from_json_string(const jxs_schema *schema, void *stptr,
+                                                      void *opaque, const char *jstring);
+JSONXSTRUCT_API int jxs_struct_patch_from_json_object(const jxs_schema *schema, void *stptr,
+                                                      void *opaque, json_object *jso);
+
+/**
+ * @brief Encode the struct as CBOR(RFC 8949), for the traffic that needs no
+ * human-readable json. A struct is a map keyed by the member names, integers
+ * take their shortest form, strings are length-prefixed, and an int/uint/
+ * float/double array is one RFC 8746 typed array(inside a tag 40 array for
+ * more dimensions) holding the elements as they are in memory. The encoding
+ * doesn't go through json-c, only the json_object members do.
+ * @param schema  compiled schema of the struct.
+ * @param stptr   struct pointer, Require initialized.
+ * @param opaque  user opaque data, use @ref jxs_get_userdata() to get it.
+ * @param len     encoded length output.
+ * @return CBOR data, free it by @ref jxs_free_cbor(), NULL for error.
+ */
+JSONXSTRUCT_API uint8_t *jxs_struct_to_cbor(const jxs_schema *schema, void *stptr,
+                                            void *opaque, size_t *len);
+/**
+ * @brief Decode CBOR into the struct, the values are converted the same as
+ * from json, the absent members are cleared. A typed array in the member's
+ * own element type and shape is copied in one go.
+ * @param data    CBOR data, e.g. made by @ref jxs_struct_to_cbor().
+ * @param len     data length.
+ * @return 0 for success, -1 for error.
+ */
+JSONXSTRUCT_API int jxs_struct_from_cbor(const jxs_schema *schema, void *stptr, void *opaque,
+                                         const uint8_t *data, size_t len);
+JSONXSTRUCT_API void jxs_free_cbor(uint8_t *data);
+
+/**
+ * @brief new a reusable conversion context. It owns the mapper storage for the
+ * descriptor, the conversion state with the locator buffers, and the json text
+ * output buffer, they are all kept across calls. After the first few calls a
+ * loop of conversions on the same context neither allocates nor clears large
+ * buffers. The mapper storage starts at the size of the stack buffer used by the
+ * descriptor based functions, and grows to the largest descriptor seen so far.
+ * @return context instance if success, or NULL is returned. call
+ * @ref jxs_context_free() to free it.
+ * @note A context is not thread-safe, use one context per thread.
+ */
+JSONXSTRUCT_API jxs_context *jxs_context_new(void);
+/**
+ * @brief drop the schema and output held by the context, keep the storage.
+ * @param jctx    conversion context.
+ */
+JSONXSTRUCT_API void jxs_context_reset(jxs_context *jctx);
+JSONXSTRUCT_API void jxs_context_free(jxs_context *jctx);
+
+/**
+ * @brief run the descriptor and load the schema into the context storage, like
+ * @ref jxs_schema_compile() but without any allocation once the storage is big
+ * enough. The context is reset first.
+ * @param jctx    conversion context.
+ * @param func    struct descriptor, see @ref jxs_struct_to_json_object().
+ * @param opaque  user opaque data, @ref jxs_get_userdata() returns it inside
+ *                the descriptor.
+ * @return schema owned by the context, valid until the next
+ * @ref jxs_context_schema(), @ref jxs_context_reset() or @ref jxs_context_free()
+ * call. NULL for error.
+ */
+JSONXSTRUCT_API const jxs_schema *jxs_context_schema(jxs_context *jctx,
+                                                     jxs_descriptor func, void *opaque);
+
+/**
+ * @brief convert struct to json string inside the context output buffer, see
+ * @ref jxs_struct_to_json_string_ext_with_schema().
+ * @param jctx    conversion context.
+ * @param schema  the schema of @ref jxs_context_schema(), or a compiled schema.
+ * @param stptr   struct pointer, Require initialized.
+ * @param opaque  user opaque data, use @ref jxs_get_userdata() to get it.
+ * @return json string owned by the context, valid until the next call on the
+ * context, don't free it. NULL for error.
+ */
+JSONXSTRUCT_API const char *jxs_context_to_json_string(jxs_context *jctx,
+                                                       const jxs_schema *schema,
+                                                       void *stptr, void *opaque);
+/**
+ * @brief Same as @ref jxs_context_to_json_string(), with formatting options.
+ * @param flags   formatting options, see JSON_C_TO_STRING_PRETTY and other
+ *                constants.
+ * @return json string owned by the context, NULL for error.
+ */
+JSONXSTRUCT_API const char *jxs_context_to_json_string_ext(jxs_context *jctx,
+                                                           const jxs_schema *schema,
+                                                           void *stptr, void *opaque,
+                                                           int flags);
+/**
+ * @brief parse struct from json string with the context, see
+ * @ref jxs_struct_from_json_string_with_schema().
+ * @return 0 for success, -1 for error.
+ */
+JSONXSTRUCT_API int jxs_context_from_json_string(jxs_context *jctx, const jxs_schema *schema,
+                                                 void *stptr, void *opaque,
+                                                 const char *jstring);
+
+/**
+ * @brief turn the conversion statistics on or off, they are off by default.
+ * While they are on, every conversion adds its counters to the process-wide
+ * statistics, and a context keeps the counters of its last call and its total.
+ * Off, nothing is counted and no clock is read.
+ * @param enable  non-zero to turn them on.
+ */
+JSONXSTRUCT_API void jxs_stats_enable(int enable);
+/**
+ * @brief read the process-wide statistics, without a lock. Every counter is
+ * read atomically, but conversions running at the same time may be counted
+ * in some of them only.
+ * @param stats   output.
+ */
+JSONXSTRUCT_API void jxs_stats_get(jxs_stats *stats);
+/**
+ * @brief clear the process-wide statistics, the ones of contexts are kept.
+ */
+JSONXSTRUCT_API void jxs_stats_reset(void);
+/**
+ * @brief read the statistics of the conversions made with the context, the
+ * descriptor run by @ref jxs_context_schema() included.
+ * @param jctx    conversion context.
+ * @param last    if not NULL, the counters of the last call.
+ * @param total   if not NULL, the counters of every call since the context
+ *                was created.
+ */
+JSONXSTRUCT_API void jxs_context_stats(jxs_context *jctx, jxs_stats *last, jxs_stats *total);
+/**
+ * @brief format statistics as a json object, one member per counter.
+ * @param stats   statistics, NULL for a snapshot of the process-wide ones.
+ * @return json string, free it by @ref jxs_free_json_string(), NULL for error.
+ */
+JSONXSTRUCT_API const char *jxs_stats_to_json_string(const jxs_stats *stats);
+
+/**
+ * @brief new a worker pool for @ref jxs_batch_to_json() and
+ * @ref jxs_batch_from_json(). The threads are started here and wait for
+ * batches, every thread keeps its own conversion context across batches.
+ * @param nthreads  threads working on a batch, the calling thread included,
+ *                  0 for the number of online CPUs. Without pthreads the pool
+ *                  has no thread and a batch runs on the calling thread.
+ * @return pool instance if success, or NULL is returned. call
+ * @ref jxs_pool_free() to free it.
+ * @note A pool runs one batch at a time, concurrent batches wait for each other.
+ */
+JSONXSTRUCT_API jxs_pool *jxs_pool_new(int nthreads);
+JSONXSTRUCT_API void jxs_pool_free(jxs_pool *pool);
+
+/**
+ * @brief convert an array of independent structs to json strings, the records
+ * are spread across the threads of the pool.
+ * @param pool     worker pool, NULL to convert on the calling thread only.
+ * @param schema   compiled schema of one struct, see @ref jxs_schema_compile().
+ * @param structs  first struct of the array.
+ * @param stsize   struct size, the distance between two structs.
+ * @param n        number of structs.
+ * @param opaque   user opaque data, the same for every record.
+ * @param flags    formatting options, see JSON_C_TO_STRING_PRETTY and other
+ *                 constants.
+ * @param jstrings array of n json strings, jstrings[i] is the json of the i-th
+ *                 struct, or NULL if it failed. free every one of them by
+ *                 @ref jxs_free_json_string().
+ * @return 0 if every record is converted, -1 otherwise.
+ * @note The convert callback of the schema(if any) runs on several threads at
+ * the same time, it must be thread-safe.
+ */
+JSONXSTRUCT_API int jxs_batch_to_json(jxs_pool *pool, const jxs_schema *schema,
+                                      void *structs, size_t stsize, size_t n,
+                                      void *opaque, int flags, char **jstrings);
+/**
+ * @brief parse an array of json strings into an array of independent structs,
+ * the i-th json string is parsed into the i-th struct. see
+ * @ref jxs_batch_to_json() for the parameters.
+ * @return 0 if every record is parsed, -1 otherwise.
+ */
+JSONXSTRUCT_API int jxs_batch_from_json(jxs_pool *pool, const jxs_schema *schema,
+                                        void *structs, size_t stsize, size_t n,
+                                        void *opaque, const char *const *jstrings);
+
+/**
+ * @brief write a C file of json text converters specialized for the schema:
+ * member offsets are constants, keys are pre-escaped literals and small
+ * arrays are unrolled, no mapper is walked at run time. The file defines
+ *
+ *     const char *<name>_to_json_string(jxs_context *jctx, const void *stptr);
+ *     int <name>_from_json_string(jxs_context *jctx, void *stptr, const char *jstring);
+ *
+ * which give the same results as @ref jxs_context_to_json_string_ext() with
+ * 'flags' and @ref jxs_context_from_json_string(). They only need this header
+ * and the library, not the struct definitions. The statistics count the calls,
+ * elements and bytes, not the items.
+ * @param schema   compiled schema, see @ref jxs_schema_compile(). The convert
+ *                 callback, item rules other than the default and members
+ *                 sharing a key are not supported.
+ * @param name     prefix of the generated functions, a C identifier.
+ * @param flags    formatting options of the generated writer, see
+ *                 JSON_C_TO_STRING_PRETTY and other constants.
+ * @param filename output file.
+ * @return 0 for success, -1 for error.
+ */
+JSONXSTRUCT_API int jxs_schema_codegen(const jxs_schema *schema, const char *name,
+                                       int flags, const char *filename);
+
+/* runtime of the converters written by jxs_schema_codegen(), not for direct use */
+JSONXSTRUCT_API int jxs_gen_write_begin(jxs_context *jctx, const void *stptr);
+JSONXSTRUCT_API const char *jxs_gen_write_end(jxs_context *jctx);
+JSONXSTRUCT_API void jxs_gen_raw(jxs_context *jctx, const char *text, size_t len);
+JSONXSTRUCT_API void jxs_gen_bool(jxs_context *jctx, int value);
+JSONXSTRUCT_API void jxs_gen_int(jxs_context *jctx, int64_t value);
+JSONXSTRUCT_API void jxs_gen_uint(jxs_context *jctx, uint64_t value);
+JSONXSTRUCT_API void jxs_gen_double(jxs_context *jctx, double value);
+JSONXSTRUCT_API void jxs_gen_float(jxs_context *jctx, float value);
+JSONXSTRUCT_API void jxs_gen_string(jxs_context *jctx, const char *str, size_t size, int flags);
+JSONXSTRUCT_API void jxs_gen_jso(jxs_context *jctx, json_object *jso, int level, int flags);
+JSONXSTRUCT_API int jxs_gen_read_begin(jxs_context *jctx, void *stptr, const char *jstring);
+JSONXSTRUCT_API int jxs_gen_read_end(jxs_context *jctx, int ret);
+JSONXSTRUCT_API int jxs_gen_peek(jxs_context *jctx);
+JSONXSTRUCT_API int jxs_gen_accept(jxs_context *jctx, char c);
+JSONXSTRUCT_API int jxs_gen_expect(jxs_context *jctx, char c);
+JSONXSTRUCT_API int jxs_gen_null(jxs_context *jctx);
+JSONXSTRUCT_API int jxs_gen_skip(jxs_context *jctx);
+JSONXSTRUCT_API int jxs_gen_key(jxs_context *jctx, const char **key, size_t *len);
+JSONXSTRUCT_API int jxs_gen_object(jxs_context *jctx);
+JSONXSTRUCT_API int jxs_gen_array(jxs_context *jctx);
+JSONXSTRUCT_API int jxs_gen_element(jxs_context *jctx, size_t idx, size_t len);
+JSONXSTRUCT_API int jxs_gen_read_bool(jxs_context *jctx, int *value);
+JSONXSTRUCT_API int jxs_gen_read_int(jxs_context *jctx, int64_t *value, int64_t min, int64_t max);
+JSONXSTRUCT_API int jxs_gen_read_uint(jxs_context *jctx, uint64_t *value, uint64_t max);
+JSONXSTRUCT_API int jxs_gen_read_double(jxs_context *jctx, double *value);
+JSONXSTRUCT_API int jxs_gen_read_float(jxs_context *jctx, float *value);
+JSONXSTRUCT_API int jxs_gen_read_string(jxs_context *jctx, char *dst, size_t size);
+JSONXSTRUCT_API int jxs_gen_read_jso(jxs_context *jctx, json_object **jso);
 
 /**
  * @brief print struct data by mapper as 'INFO' level. It won't be affected by
@@ -385,6 +852,8 @@ JSONXSTRUCT_API int jxs_struct_from_json_string(jxs_descriptor func, void *stptr
  * @param opaque  user opaque data, use @ref jxs_get_userdata() to get it.
  */
 JSONXSTRUCT_API void jxs_print_struct(jxs_descriptor func, void *stptr, void *opaque);
+JSONXSTRUCT_API void jxs_print_struct_with_schema(const jxs_schema *schema, void *stptr,
+                                                  void *opaque);
 
 /* Ends C function definitions when using C++ */
 #ifdef __cplusplus
@@ -0,0 +1,635 @@
+/**
+ * @file jsonXstruct.hpp
+ * @brief C++17 front end of jsonXstruct, header only. A struct is described by
+ * a constexpr table of member pointers instead of a descriptor callback: the
+ * type, width and array dimensions of every member are deduced at compile time,
+ * a wrong member type is a compile error instead of a size mismatch at run time.
+ *
+ *     struct thumbs { char icon[1024]; char url1[1024]; };
+ *     struct basic  { int vari; bool varb; int matrix[2][2][3]; thumbs tb[2]; };
+ *
+ *     JXS_MAPPING(thumbs, JXS_ITEM(icon), JXS_ITEM(url1));
+ *     JXS_MAPPING(basic, JXS_ITEM(vari), JXS_ITEM(varb), JXS_ITEM(matrix), JXS_ITEM(tb));
+ *
+ *     const char *text = jxs::to_json_string(jctx, bst);
+ *     jxs::from_json_string(jctx, bst, text);
+ *
+ * The json text converters are instantiated for every struct on top of the
+ * runtime of @ref jxs_schema_codegen(), and give the same results as the
+ * mapper interpreter. jxs::descriptor<T> is a plain @ref jxs_descriptor of the
+ * same struct for every C function(schema, files, CBOR, batch...), and a
+ * struct described by a C descriptor can be used in a table, see jxs::mapping.
+ *
+ * @note The members are 'bool', integers and enums, 'float/double', 'char [x]'
+ * strings, 'json_object *', described structs, and arrays of them.
+ */
+#ifndef JSONXSTRUCT_HPP
+#define JSONXSTRUCT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "jsonXstruct.h"
+
+namespace jxs {
+
+/**
+ * @brief Description of the struct T, specialize it for every struct with
+ * @ref JXS_MAPPING(), or by hand with one of:
+ *
+ *     static constexpr auto items = jxs::items(jxs::make_item("key", &T::member), ...);
+ *     static constexpr jxs_descriptor descriptor = my_c_descriptor;
+ *
+ * A struct with a C descriptor is converted by the mapper interpreter, so is
+ * every struct that contains it.
+ */
+template <class T>
+struct mapping {};
+
+/* mapper item of a C++ struct: json key and member pointer */
+template <class T, class M>
+struct item {
+	using struct_type = T;
+	using member_type = M;
+	const char *key;
+	M T::*ptr;
+};
+
+/**
+ * @brief Make a mapper item.
+ * @param key  json key, must be in constant memory, such as, input "mykey".
+ * @param ptr  member pointer, such as, &basic::vari.
+ */
+template <class T, class M>
+constexpr item<T, M> make_item(const char *key, M T::*ptr)
+{
+	return item<T, M>{key, ptr};
+}
+
+/* table of the mapper items of a struct, in the order of the json output */
+template <class... I>
+constexpr std::tuple<I...> items(const I &...it)
+{
+	return std::tuple<I...>(it...);
+}
+
+namespace detail {
+
+/* array depth limit of the library, JXS_ARRAY_DEPTH */
+constexpr std::size_t max_dims = 8;
+
+template <class T>
+struct dependent_false : std::false_type {};
+
+template <class T, class = void>
+struct has_items : std::false_type {};
+template <class T>
+struct has_items<T, std::void_t<decltype(mapping<T>::items)>> : std::true_type {};
+
+template <class T, class = void>
+struct has_descriptor : std::false_type {};
+template <class T>
+struct has_descriptor<T, std::void_t<decltype(mapping<T>::descriptor)>> : std::true_type {};
+
+template <class T>
+constexpr bool is_described_v = has_items<T>::value || has_descriptor<T>::value;
+
+/* 'char [x]' is a string, the last dimension of a char array is not an array */
+template <class M>
+constexpr bool is_string_v = std::is_same_v<std::remove_all_extents_t<M>, char> &&
+                             (std::rank_v<M> >= 1);
+
+template <class M>
+constexpr std::size_t dims_v = std::rank_v<M> - (is_string_v<M> ? 1 : 0);
+
+/* jmap type of a member */
+template <class M>
+constexpr jxs_type type_of()
+{
+	using E = std::remove_all_extents_t<M>;
+	if constexpr (is_string_v<M>) {
+		return jxs_type_string;
+	} else if constexpr (std::is_same_v<E, bool>) {
+		return jxs_type_boolean;
+	} else if constexpr (std::is_enum_v<E>) {
+		return std::is_signed_v<std::underlying_type_t<E>> ? jxs_type_int : jxs_type_uint;
+	} else if constexpr (std::is_same_v<E, float> || std::is_same_v<E, double>) {
+		return jxs_type_double;
+	} else if constexpr (std::is_integral_v<E> && (sizeof(E) <= sizeof(int64_t))) {
+		return std::is_signed_v<E> ? jxs_type_int : jxs_type_uint;
+	} else if constexpr (std::is_same_v<E, json_object *>) {
+		return jxs_type_object;
+	} else if constexpr (is_described_v<E>) {
+		return jxs_type_struct;
+	} else {
+		static_assert(dependent_false<E>::value, "jsonXstruct: unsupported member type, "
+		              "or the struct has no jxs::mapping");
+		return jxs_type_null;
+	}
+}
+
+template <class T>
+using items_t = std::remove_const_t<decltype(mapping<T>::items)>;
+
+template <class T>
+constexpr std::size_t items_num()
+{
+	return std::tuple_size_v<items_t<T>>;
+}
+
+constexpr bool key_equal(const char *a, const char *b)
+{
+	while ((*a != '\0') && (*a == *b)) {
+		a++;
+		b++;
+	}
+	return *a == *b;
+}
+
+/* every key is set and unique, the reader matches at most one item per key */
+template <class T, std::size_t... I>
+constexpr bool keys_unique(std::index_sequence<I...>)
+{
+	const char *keys[sizeof...(I) + 1] = {std::get<I>(mapping<T>::items).key..., NULL};
+	for (std::size_t i = 0; i < sizeof...(I); i++) {
+		if (keys[i] == NULL) {
+			return false;
+		}
+		for (std::size_t j = 0; j < i; j++) {
+			if (key_equal(keys[i], keys[j])) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+template <class T>
+constexpr bool is_static();
+
+/* whether the struct and all its sub-structs are described by items */
+template <class M>
+constexpr bool member_static()
+{
+	using E = std::remove_all_extents_t<M>;
+	static_assert(dims_v<M> <= max_dims, "jsonXstruct: too many array dimensions");
+	if constexpr (type_of<M>() == jxs_type_struct) {
+		return is_static<E>();
+	} else {
+		return true;
+	}
+}
+
+template <class T, std::size_t... I>
+constexpr bool items_static(std::index_sequence<I...>)
+{
+	static_assert((std::is_same_v<typename std::tuple_element_t<I, items_t<T>>::struct_type, T> && ...),
+	              "jsonXstruct: the item is not a member of this struct");
+	static_assert(keys_unique<T>(std::index_sequence<I...>()),
+	              "jsonXstruct: item keys must be set and unique");
+	return (member_static<typename std::tuple_element_t<I, items_t<T>>::member_type>() && ...);
+}
+
+template <class T>
+constexpr bool is_static()
+{
+	static_assert(std::is_standard_layout_v<T> && std::is_trivially_copyable_v<T>,
+	              "jsonXstruct: the struct must be a C compatible struct");
+	if constexpr (has_items<T>::value) {
+		return items_static<T>(std::make_index_sequence<items_num<T>()>());
+	} else {
+		return false;
+	}
+}
+
+/* offset of the member, the same as offsetof() */
+template <class T, class M>
+std::ptrdiff_t offset_of(M T::*ptr)
+{
+	union storage {
+		T             st;
+		unsigned char raw[sizeof(T)];
+		storage() : raw() {}
+	} u;
+	return reinterpret_cast<const unsigned char *>(&(u.st.*ptr)) - u.raw;
+}
+
+/* the mappers built by one descriptor call, a struct used twice shares one */
+struct mapper_cache {
+	const void *tag[32];
+	jxs_mapper *mapper[32];
+	std::size_t num;
+};
+
+template <class T>
+struct type_tag {
+	static constexpr char id = 0;
+};
+
+template <class T>
+jxs_mapper *build(void *context, mapper_cache &cache);
+
+template <class M, std::size_t... D>
+jxs_item *add_item(jxs_mapper *mapper, const char *key, std::ptrdiff_t offset,
+                   jxs_mapper *subjm, std::index_sequence<D...>)
+{
+	return jxs_item_basic_add(mapper, type_of<M>(), key, offset, sizeof(M), subjm,
+	                          static_cast<int>(std::extent_v<M, D>)..., 0);
+}
+
+template <class T, class M>
+int add_item(void *context, jxs_mapper *mapper, const item<T, M> &it, mapper_cache &cache)
+{
+	jxs_mapper *subjm = NULL;
+	if constexpr (type_of<M>() == jxs_type_struct) {
+		subjm = build<std::remove_all_extents_t<M>>(context, cache);
+		if (subjm == NULL) {
+			return -1;
+		}
+	}
+	if (add_item<M>(mapper, it.key, offset_of(it.ptr), subjm,
+	                std::make_index_sequence<dims_v<M>>()) == NULL) {
+		return -1;
+	}
+	return 0;
+}
+
+template <class T>
+jxs_mapper *build(void *context, mapper_cache &cache)
+{
+	if constexpr (has_descriptor<T>::value) {
+		return mapping<T>::descriptor(context);
+	} else {
+		std::size_t i      = 0;
+		int         ret    = 0;
+		jxs_mapper *mapper = NULL;
+		(void)is_static<T>();
+		for (i = 0; i < cache.num; i++) {
+			if (cache.tag[i] == &type_tag<T>::id) {
+				return cache.mapper[i];
+			}
+		}
+		mapper = jxs_map_basic_new(context, items_num<T>());
+		if (mapper == NULL) {
+			return NULL;
+		}
+		std::apply([&](const auto &...it) {
+			((ret = (ret == 0) ? add_item(context, mapper, it, cache) : ret), ...);
+		}, mapping<T>::items);
+		if (ret != 0) {
+			return NULL;
+		}
+		if (cache.num < sizeof(cache.tag) / sizeof(cache.tag[0])) {
+			cache.tag[cache.num]    = &type_tag<T>::id;
+			cache.mapper[cache.num] = mapper;
+			cache.num++;
+		}
+		return mapper;
+	}
+}
+
+/* json text writer of the struct, the same text as jmap_write_object() writes */
+template <int Flags>
+struct writer {
+	static constexpr bool pretty = (Flags & JSON_C_TO_STRING_PRETTY) != 0;
+	static constexpr bool spaced = ((Flags & JSON_C_TO_STRING_SPACED) != 0) && !pretty;
+
+	static void raw(jxs_context *jctx, const char *text)
+	{
+		jxs_gen_raw(jctx, text, std::char_traits<char>::length(text));
+	}
+
+	static void indent(jxs_context *jctx, int level)
+	{
+		static const char tabs[]   = "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
+		static const char spaces[] = "                                ";
+		if constexpr (pretty) {
+			const char *pad = (Flags & JSON_C_TO_STRING_PRETTY_TAB) ? tabs : spaces;
+			std::size_t len = static_cast<std::size_t>(level) * ((Flags & JSON_C_TO_STRING_PRETTY_TAB) ? 1 : 2);
+			while (len > 0) {
+				std::size_t n = (len < sizeof(tabs) - 1) ? len : sizeof(tabs) - 1;
+				jxs_gen_raw(jctx, pad, n);
+				len -= n;
+			}
+		} else {
+			(void)jctx;
+			(void)level;
+		}
+	}
+
+	static void prefix(jxs_context *jctx, const char *key, bool had_children, int level)
+	{
+		if (had_children) {
+			raw(jctx, pretty ? ",\n" : ",");
+		}
+		if constexpr (spaced) {
+			raw(jctx, " ");
+		}
+		indent(jctx, level);
+		if (key != NULL) {
+			jxs_gen_string(jctx, key, std::char_traits<char>::length(key), Flags);
+			raw(jctx, (Flags & JSON_C_TO_STRING_SPACED) ? ": " : ":");
+		}
+	}
+
+	static void suffix(jxs_context *jctx, const char *bracket, bool had_children, int level)
+	{
+		if constexpr (pretty) {
+			if (had_children) {
+				raw(jctx, "\n");
+			}
+			indent(jctx, level);
+		}
+		if constexpr (spaced) {
+			raw(jctx, " ");
+		}
+		raw(jctx, bracket);
+	}
+
+	template <class M>
+	static void value(jxs_context *jctx, const M &v, int level)
+	{
+		if constexpr (is_string_v<M> && (std::rank_v<M> == 1)) {
+			jxs_gen_string(jctx, v, sizeof(M), Flags);
+		} else if constexpr (std::is_array_v<M>) {
+			raw(jctx, pretty ? "[\n" : "[");
+			for (std::size_t i = 0; i < std::extent_v<M>; i++) {
+				prefix(jctx, NULL, i != 0, level + 1);
+				value(jctx, v[i], level + 1);
+			}
+			suffix(jctx, "]", true, level);
+		} else if constexpr (std::is_same_v<M, bool>) {
+			jxs_gen_bool(jctx, v ? 1 : 0);
+		} else if constexpr (std::is_enum_v<M>) {
+			value(jctx, static_cast<std::underlying_type_t<M>>(v), level);
+		} else if constexpr (std::is_same_v<M, float>) {
+			jxs_gen_float(jctx, v);
+		} else if constexpr (std::is_same_v<M, double>) {
+			jxs_gen_double(jctx, v);
+		} else if constexpr (std::is_integral_v<M> && std::is_signed_v<M>) {
+			jxs_gen_int(jctx, static_cast<int64_t>(v));
+		} else if constexpr (std::is_integral_v<M>) {
+			jxs_gen_uint(jctx, static_cast<uint64_t>(v));
+		} else if constexpr (std::is_same_v<M, json_object *>) {
+			jxs_gen_jso(jctx, v, level, Flags);
+		} else {
+			object(jctx, v, level);
+		}
+	}
+
+	template <class T>
+	static void object(jxs_context *jctx, const T &st, int level)
+	{
+		std::size_t n = 0;
+		raw(jctx, pretty ? "{\n" : "{");
+		std::apply([&](const auto &...it) {
+			((prefix(jctx, it.key, n++ != 0, level + 1), value(jctx, st.*(it.ptr), level + 1)), ...);
+		}, mapping<T>::items);
+		suffix(jctx, "}", n != 0, level);
+	}
+};
+
+/* json text reader of the struct, the same as jmap_read_object() reads */
+struct reader {
+	/* a value that is not an object clears every member */
+	template <class T>
+	static void clear(T &st)
+	{
+		std::apply([&](const auto &...it) {
+			(std::memset(&(st.*(it.ptr)), 0, sizeof(st.*(it.ptr))), ...);
+		}, mapping<T>::items);
+	}
+
+	template <class M>
+	static int value(jxs_context *jctx, M &v)
+	{
+		if constexpr (is_string_v<M> && (std::rank_v<M> == 1)) {
+			return jxs_gen_read_string(jctx, v, sizeof(M));
+		} else if constexpr (std::is_array_v<M>) {
+			switch (jxs_gen_array(jctx)) {
+			case 0:
+				std::memset(&v, 0, sizeof(M));
+				return 0;
+			case 1:
+				for (std::size_t i = 0;; i++) {
+					int more = jxs_gen_element(jctx, i, std::extent_v<M>);
+					if (more <= 0) {
+						return more;
+					}
+					if (value(jctx, v[i]) != 0) {
+						return -1;
+					}
+				}
+			default:
+				return -1;
+			}
+		} else if constexpr (std::is_same_v<M, bool>) {
+			int num = 0;
+			if (jxs_gen_read_bool(jctx, &num) != 0) {
+				return -1;
+			}
+			v = (num != 0);
+			return 0;
+		} else if constexpr (std::is_enum_v<M>) {
+			std::underlying_type_t<M> num = 0;
+			if (value(jctx, num) != 0) {
+				return -1;
+			}
+			v = static_cast<M>(num);
+			return 0;
+		} else if constexpr (std::is_same_v<M, float>) {
+			return jxs_gen_read_float(jctx, &v);
+		} else if constexpr (std::is_same_v<M, double>) {
+			return jxs_gen_read_double(jctx, &v);
+		} else if constexpr (std::is_integral_v<M> && std::is_signed_v<M>) {
+			int64_t num = 0;
+			if (jxs_gen_read_int(jctx, &num, std::numeric_limits<M>::min(),
+			                     std::numeric_limits<M>::max()) != 0) {
+				return -1;
+			}
+			v = static_cast<M>(num);
+			return 0;
+		} else if constexpr (std::is_integral_v<M>) {
+			uint64_t num = 0;
+			if (jxs_gen_read_uint(jctx, &num, std::numeric_limits<M>::max()) != 0) {
+				return -1;
+			}
+			v = static_cast<M>(num);
+			return 0;
+		} else if constexpr (std::is_same_v<M, json_object *>) {
+			return jxs_gen_read_jso(jctx, &v);
+		} else {
+			switch (jxs_gen_object(jctx)) {
+			case 0:
+				std::memset(&v, 0, sizeof(M));
+				return 0;
+			case 1:
+				return object(jctx, v);
+			case 2:
+				clear(v);
+				return 0;
+			default:
+				return -1;
+			}
+		}
+	}
+
+	/* read the member of the key, 1 if read, 0 for an unknown key, -1 for error */
+	template <class T, std::size_t... I>
+	static int member(jxs_context *jctx, T &st, const char *key, std::size_t klen,
+	                  bool *seen, std::index_sequence<I...>)
+	{
+		int found = 0;
+		(void)((match<I>(jctx, st, key, klen, seen, found)) || ...);
+		return found;
+	}
+
+	template <std::size_t I, class T>
+	static bool match(jxs_context *jctx, T &st, const char *key, std::size_t klen,
+	                  bool *seen, int &found)
+	{
+		const auto &it = std::get<I>(mapping<T>::items);
+		if ((std::char_traits<char>::length(it.key) != klen) ||
+		    (std::memcmp(key, it.key, klen) != 0)) {
+			return false;
+		}
+		found   = (value(jctx, st.*(it.ptr)) != 0) ? -1 : 1;
+		seen[I] = true;
+		return true;
+	}
+
+	/* read the members after the '{' */
+	template <class T>
+	static int object(jxs_context *jctx, T &st)
+	{
+		constexpr std::size_t num  = items_num<T>();
+		const char           *key  = NULL;
+		std::size_t           klen = 0;
+		bool                  seen[num + 1] = {};
+		if (!jxs_gen_accept(jctx, '}')) {
+			do {
+				int found = 0;
+				/* json-c accepts a trailing comma */
+				if (jxs_gen_peek(jctx) == '}') {
+					break;
+				}
+				if (jxs_gen_key(jctx, &key, &klen) != 0) {
+					return -1;
+				}
+				found = member(jctx, st, key, klen, seen, std::make_index_sequence<num>());
+				if ((found < 0) || ((found == 0) && (jxs_gen_skip(jctx) != 0))) {
+					return -1;
+				}
+			} while (jxs_gen_accept(jctx, ','));
+			if (jxs_gen_expect(jctx, '}') != 0) {
+				return -1;
+			}
+		}
+		/* the members missing in the json object are cleared */
+		std::apply([&](const auto &...it) {
+			std::size_t i = 0;
+			((seen[i++] ? (void)0 : (void)std::memset(&(st.*(it.ptr)), 0, sizeof(st.*(it.ptr)))), ...);
+		}, mapping<T>::items);
+		return 0;
+	}
+};
+
+} // namespace detail
+
+/**
+ * @brief struct descriptor of T built from its table, it can be passed to
+ * every C function that takes a @ref jxs_descriptor.
+ */
+template <class T>
+jxs_mapper *descriptor(void *context)
+{
+	detail::mapper_cache cache = {};
+	return detail::build<T>(context, cache);
+}
+
+/**
+ * @brief compiled schema of T, compiled once on the first call and freed at
+ * exit. Pass it to the '*_with_schema' and context functions.
+ * @return schema, or NULL if the descriptor failed.
+ */
+template <class T>
+const jxs_schema *schema()
+{
+	static const std::unique_ptr<jxs_schema, void (*)(jxs_schema *)> compiled(
+		jxs_schema_compile(descriptor<T>, NULL), jxs_schema_free);
+	return compiled.get();
+}
+
+/**
+ * @brief convert struct to json string inside the context output buffer, see
+ * @ref jxs_context_to_json_string_ext().
+ * @tparam Flags  formatting options, see JSON_C_TO_STRING_PRETTY and other
+ *                constants.
+ * @param jctx    conversion context.
+ * @param st      struct.
+ * @return json string owned by the context, valid until the next call on the
+ * context, don't free it. NULL for error.
+ */
+template <int Flags = 0, class T>
+const char *to_json_string(jxs_context *jctx, const T &st)
+{
+	if constexpr (detail::is_static<T>()) {
+		if (jxs_gen_write_begin(jctx, &st) != 0) {
+			return NULL;
+		}
+		detail::writer<Flags>::object(jctx, st, 0);
+		return jxs_gen_write_end(jctx);
+	} else {
+		return jxs_context_to_json_string_ext(jctx, schema<T>(), const_cast<T *>(&st), NULL, Flags);
+	}
+}
+
+/**
+ * @brief parse struct from json string with the context, see
+ * @ref jxs_context_from_json_string().
+ * @return 0 for success, -1 for error.
+ */
+template <class T>
+int from_json_string(jxs_context *jctx, T &st, const char *jstring)
+{
+	if constexpr (detail::is_static<T>()) {
+		int ret = jxs_gen_read_begin(jctx, &st, jstring);
+		if (ret == 1) {
+			ret = detail::reader::object(jctx, st);
+		} else if (ret == 2) {
+			/* not an object, every member is cleared like json-c does */
+			detail::reader::clear(st);
+			ret = 0;
+		}
+		return jxs_gen_read_end(jctx, ret);
+	} else {
+		return jxs_context_from_json_string(jctx, schema<T>(), &st, NULL, jstring);
+	}
+}
+
+} // namespace jxs
+
+/**
+ * @brief Describe a struct, at namespace scope outside of any namespace.
+ * @param sttype  struct type.
+ * @param ...     mapper items, made by @ref JXS_ITEM() or jxs::make_item().
+ */
+#define JXS_MAPPING(sttype, ...)                                  \
+	template <> struct jxs::mapping<sttype> {                     \
+		using type = sttype;                                      \
+		static constexpr auto items = jxs::items(__VA_ARGS__);    \
+	}
+/**
+ * @brief Mapper item of a member inside @ref JXS_MAPPING(), the member name is
+ * the json key.
+ * @param stmb  struct member name.
+ */
+#define JXS_ITEM(stmb)    jxs::make_item(# stmb, &type::stmb)
+
+#endif /* JSONXSTRUCT_HPP */
@@ -18,6 +18,63 @@
 #include <sys/types.h>
 #include "jsonXstruct.h"
 
+/* The batch worker pool needs pthreads and the gcc atomic builtins,
+ * without them a batch runs on the caller thread */
+#if !defined(_WIN32) && defined(__GNUC__) && !defined(JXS_NO_THREADS)
+#define JXS_HAVE_THREADS 1
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+/* POSIX file io: mmap() for reading, write() and fsync() for writing */
+#if defined(__unix__) || defined(__APPLE__)
+#define JXS_HAVE_POSIX 1
+#include <time.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifndef PATH_MAX
+#define PATH_MAX             4096
+#endif
+/* macOS has no fdatasync() */
+#if defined(__APPLE__)
+#define jxs_fdatasync(fd)    fsync(fd)
+#else
+#define jxs_fdatasync(fd)    fdatasync(fd)
+#endif
+#endif
+
+/* Vector string scanning, the widest the compiler targets, SWAR otherwise */
+#if defined(__GNUC__) && defined(__AVX2__)
+#define JXS_SIMD_AVX2 1
+#define JXS_SIMD_SSE2 1
+#include <immintrin.h>
+#elif defined(__GNUC__) && defined(__SSE2__)
+#define JXS_SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+
+/* Process-wide statistics counters and the runtime log level, relaxed atomics
+ * where there are threads */
+#ifdef JXS_HAVE_THREADS
+#define jxs_stats_add(ptr, val)      __atomic_fetch_add(ptr, val, __ATOMIC_RELAXED)
+#define jxs_atomic_load(ptr)         __atomic_load_n(ptr, __ATOMIC_RELAXED)
+#define jxs_atomic_store(ptr, val)   __atomic_store_n(ptr, val, __ATOMIC_RELAXED)
+#else
+#define jxs_stats_add(ptr, val)      (*(ptr) += (val))
+#define jxs_atomic_load(ptr)         (*(ptr))
+#define jxs_atomic_store(ptr, val)   (*(ptr) = (val))
+#endif
+
+/* Log statements above this level are compiled out, whatever the runtime level
+ * is: 0 quiet, 1 fatal, 2 error, 3 warn, 4 info, 5 debug, 6 trace. Build with
+ * e.g. -DJXS_COMPILE_LOG_LEVEL=2 to keep only the fatal and error messages */
+#ifndef JXS_COMPILE_LOG_LEVEL
+#define JXS_COMPILE_LOG_LEVEL    6
+#endif
+
 /* Set up for C function definitions, even when using C++ */
 #ifdef __cplusplus
 extern "C" {
@@ -44,8 +101,12 @@ extern "C" {
 
 #define jxs_log(level, format, ...)                                                \
 	do {                                                                           \
-		if (level <= jxs_log_level) {                                              \
-			if (jxs_log_level >= JXS_LOG_DEBUG) {                                  \
+		if ((level) > JXS_COMPILE_LOG_LEVEL) {                                     \
+			break;                                                                 \
+		}                                                                          \
+		int log_level_ = jxs_atomic_load(&jxs_log_level);                          \
+		if ((level) <= log_level_) {                                               \
+			if (log_level_ >= JXS_LOG_DEBUG) {                                     \
 				print_log(level, "[" JXS_TAG ".%s][%s %d]: " format,               \
 				          get_log_tag(level), __func__, __LINE__, ## __VA_ARGS__); \
 			}                                                                      \
@@ -56,26 +117,26 @@ extern "C" {
 		}                                                                          \
 	} while (0)
 
-#define PRINT_JMITEM(item, format, ...)                        \
-	do {                                                       \
-		if (jxs_log_level >= JXS_LOG_DEBUG) {                  \
-			print_log(JXS_LOG_INFO,                            \
-			          "[" JXS_TAG ".struct][%s %d]: "          \
-			          " [JMAP:%p][OFFSET:%8" FMT_PTRDIFF_T "]" \
-			          "(%7s)%s=<" format ">\n",                \
-			          __func__, __LINE__,                      \
-			          item, offset,                            \
-			          type_to_name((item)->type),              \
-			          locator, ## __VA_ARGS__);                \
-		}                                                      \
-		else {                                                 \
-			print_log(JXS_LOG_INFO,                            \
-			          "[" JXS_TAG ".struct]: "                 \
-			          " (%7s)%s=<" format ">\n",               \
-			          type_to_name((item)->type),              \
-			          locator, ## __VA_ARGS__);                \
-		}                                                      \
-	}                                                          \
+#define PRINT_JMITEM(item, format, ...)                         \
+	do {                                                        \
+		if (jxs_atomic_load(&jxs_log_level) >= JXS_LOG_DEBUG) { \
+			print_log(JXS_LOG_INFO,                             \
+			          "[" JXS_TAG ".struct][%s %d]: "           \
+			          " [JMAP:%p][OFFSET:%8" FMT_PTRDIFF_T "]"  \
+			          "(%7s)%s=<" format ">\n",                 \
+			          __func__, __LINE__,                       \
+			          item, offset,                             \
+			          type_to_name((item)->type),               \
+			          locator, ## __VA_ARGS__);                 \
+		}                                                       \
+		else {                                                  \
+			print_log(JXS_LOG_INFO,                             \
+			          "[" JXS_TAG ".struct]: "                  \
+			          " (%7s)%s=<" format ">\n",                \
+			          type_to_name((item)->type),               \
+			          locator, ## __VA_ARGS__);                 \
+		}                                                       \
+	}                                                           \
 	while (0)
 
 typedef struct _jmap_head   jmap_head_t;
@@ -90,40 +151,198 @@ typedef struct _jmap_item   jmap_list_t;
 /* 'key' string max length */
 #define JXS_KEY_MAXLEN          1024
 
+/**
+ * The maximum depth of the locator(struct members and array dimensions),
+ * the deeper levels are left out of the locator.
+ */
+#define JXS_PATH_DEPTH          64
+
+/* ndjson writer default buffer size */
+#define WRITER_DEFAULT_SIZE     (64 * 1024)
+
+/* json text write buffer default size */
+#define WBUF_DEFAULT_SIZE       1024
+
+/* nesting limit of the json values skipped by the reader */
+#define JXS_JSON_MAX_DEPTH      64
+
+/* arrays of up to this many elements are written without a loop by the
+ * converters emitted by jxs_schema_codegen() */
+#define JXS_CODEGEN_UNROLL      8
+
+/* CBOR major types, RFC 8949 */
+#define CBOR_UINT               0
+#define CBOR_NEGINT             1
+#define CBOR_BYTES              2
+#define CBOR_TEXT               3
+#define CBOR_ARRAY              4
+#define CBOR_MAP                5
+#define CBOR_TAG                6
+#define CBOR_SIMPLE             7
+/* additional information of an indefinite length item, and of the 'break' */
+#define CBOR_INDEF              31
+#define CBOR_BREAK              0xff
+/* RFC 8746 multi-dimensional array(row-major), and the typed array tags */
+#define CBOR_TAG_MDARRAY        40
+#define CBOR_TAG_TYPED_MIN      64
+#define CBOR_TAG_TYPED_MAX      87
+
+/* json number text max length */
+#define JXS_NUMBER_MAXLEN       128
+
+/* file read chunk size */
+#define RBUF_CHUNK_SIZE         (64 * 1024)
+
+/* json-c formatting flags, keep them usable with an old json-c */
+#ifndef JSON_C_TO_STRING_SPACED
+#define JSON_C_TO_STRING_SPACED           (1 << 0)
+#endif
+#ifndef JSON_C_TO_STRING_PRETTY
+#define JSON_C_TO_STRING_PRETTY           (1 << 1)
+#endif
+#ifndef JSON_C_TO_STRING_NOZERO
+#define JSON_C_TO_STRING_NOZERO           (1 << 2)
+#endif
+#ifndef JSON_C_TO_STRING_PRETTY_TAB
+#define JSON_C_TO_STRING_PRETTY_TAB       (1 << 3)
+#endif
+#ifndef JSON_C_TO_STRING_NOSLASHESCAPE
+#define JSON_C_TO_STRING_NOSLASHESCAPE    (1 << 4)
+#endif
+
+/* ndjson file mapping window, a longer line doubles it */
+#define NDJSON_WINDOW_SIZE      (64 * 1024 * 1024)
+
+/**
+ * The key index of a mapper is stored behind its items, as uint16_t arrays:
+ * disp[nbucket] bucket displacements, head[nbucket] bucket lists while
+ * building, slot[nslot] item index + 1. Mappers with more items are scanned.
+ */
+#define JXS_INDEX_MAX_ITEMS     UINT16_MAX
+/* displacements tried for a bucket before the index is given up */
+#define JXS_INDEX_MAX_DISP      UINT16_MAX
+
 /* mapper buffer length.
  * Limit stack size and avoid defining too large local variable */
 #define MAPPER_BUFFER_LENGTH    (10000 / sizeof(jmap_item_t))
+/* mappers of the first arena block, every next block doubles */
+#define MAPPER_ARENA_LENGTH     MAPPER_BUFFER_LENGTH
+
+/**
+ * Arena block of mappers, the head takes the first mapper unit and the
+ * mappers follow it.
+ */
+typedef struct jxs_arena_block {
+	struct jxs_arena_block *next;  /**< previous block */
+	size_t                  len;   /**< mapper units after the head */
+	size_t                  idx;   /**< mapper units in use */
+} jxs_arena_block;
+
+/**
+ * One level of the locator, an object member or an array element.
+ */
+typedef struct jmap_frame {
+	const char *key;     /**< member key, NULL for array element */
+	size_t      idx;     /**< array element index */
+	size_t      end;     /**< locator length after this level */
+	size_t      fzend;   /**< fuzzy locator length after this level */
+} jmap_frame;
 
 typedef struct jmap_context_t {
 	void *start_addr;   /**< struct's start addr */
 	void *opaque;       /**< struct's start addr */
+	bool  merge;        /**< merge patch, the members absent from the json are kept */
+	jxs_stats stats;    /**< counters of the current call */
 	struct {
 		jxs_mapper *arr;
 		size_t      idx;
+		size_t      len;
+		size_t      need;   /**< mappers the descriptor asked for, buffered or not */
+		jxs_arena_block **arena; /**< arena of the schema, for the mappers out of the buffer */
 	}     buf;       /**< stack buffer */
 	struct {
-		jmap_head_t *jmhead;
 		jmap_item_t *jmitem;
 		size_t       idx;
-		const char  *locator;
-		const char  *fzlocator;
 		void        *vptr;
 	}     now;        /**< current context */
+	struct {
+		jmap_frame frame[JXS_PATH_DEPTH];
+		size_t     depth;                     /**< levels in use */
+		size_t     built;                     /**< levels already formatted */
+		char       locator[JXS_KEY_MAXLEN];
+		char       fzlocator[JXS_KEY_MAXLEN];
+	}     path;       /**< current locator, formatted only when needed */
 	struct {
 		uint8_t rule; /**< Rule condition */
 		void (*callback)(void *);
 	}     convert;
 } jmap_context_t;
 
+/**
+ * Growable buffer for json text output.
+ */
+typedef struct jxs_wbuf {
+	char  *data;   /**< buffer, always '\0' terminated after wbuf_finish() */
+	size_t len;    /**< used length */
+	size_t cap;    /**< allocated length */
+	bool   err;    /**< out of memory happened, the content is incomplete */
+	size_t allocs; /**< times the buffer was allocated or moved */
+} jxs_wbuf;
+
+/**
+ * Json text reader, a cursor over the input that is never copied.
+ */
+typedef struct jxs_reader {
+	const char *start;                  /**< start of the input, for error offsets */
+	const char *cur;                    /**< current position */
+	const char *end;                    /**< end of the input */
+	int         depth;                  /**< nesting of the skipped value */
+	bool        err;                    /**< syntax error happened */
+	bool        cut;                    /**< the last string read was truncated */
+	char        keybuf[JXS_KEY_MAXLEN]; /**< decoded key with escapes */
+} jxs_reader;
+
+/**
+ * CBOR reader, a cursor over the encoded data that is never copied.
+ */
+typedef struct jxs_cbor {
+	const uint8_t *start;                  /**< start of the data, for error offsets */
+	const uint8_t *cur;                    /**< current position */
+	const uint8_t *end;                    /**< end of the data */
+	int            depth;                  /**< nesting of the skipped item */
+	bool           err;                    /**< malformed data */
+	bool           cut;                    /**< the last string read was truncated */
+	char           keybuf[JXS_KEY_MAXLEN]; /**< key joined from chunks */
+} jxs_cbor;
+
+/**
+ * Scalar json value read by the reader.
+ */
+typedef struct jxs_rvalue {
+	json_type   type;                    /**< value type, object/array are skipped */
+	bool        b;                       /**< boolean value */
+	int64_t     i;                       /**< integer value, saturated */
+	uint64_t    u;                       /**< integer value when not negative, saturated */
+	double      d;                       /**< number value */
+	uint64_t    sig;                     /**< first 19 significant digits */
+	int         exp10;                   /**< number value is sig * 10^exp10 */
+	bool        exact;                   /**< no non-zero digit was dropped from sig */
+	const char *raw;                     /**< number text */
+	size_t      rawlen;                  /**< number text length */
+	char        sbuf[JXS_NUMBER_MAXLEN]; /**< string value, truncated */
+} jxs_rvalue;
+
 /**
  * 'Json x Struct' Mapping Table
  */
 struct _jmap_head {
-	bool   isbuf;          /**< mapper is in the local buffer */
+	bool   isbuf;          /**< mapper is in the local buffer, not in the arena */
+	bool   indexed;        /**< key index is built */
 	size_t limit;          /**< jmap item limit */
 	size_t idx;            /**< jmap item counter */
 	size_t ref;            /**< jmapper reference count */
-	void  *start_addr;     /**< current struct's address */
+	size_t nslot;          /**< key index slots, 0 to look keys up by scanning */
+	size_t nbucket;        /**< key index buckets */
 };
 
 struct _jmap_item {
@@ -140,6 +359,10 @@ struct _jmap_item {
 		size_t cur_depth;
 	}           arr;                        /**< Array's attribute */
 	uint8_t     rule;
+	size_t      klen;                       /**< key length */
+	uint64_t    khash;                      /**< key hash, see jmap_key_hash() */
+	size_t      same;                       /**< next item with the same key(idx + 1) */
+	size_t      link;                       /**< next item in the index bucket(idx + 1) */
 };
 
 union jxs_mapper {
@@ -147,6 +370,127 @@ union jxs_mapper {
 	jmap_list_t jmlist;
 };
 
+/**
+ * Compiled struct description, the result of running a descriptor once.
+ */
+struct jxs_schema {
+	jxs_mapper      *mapper;     /**< top-level mapper */
+	void (*callback)(void *);    /**< convert callback set by the descriptor */
+	jxs_arena_block *arena;      /**< mappers that didn't fit the buffer, freed at once */
+};
+
+/**
+ * Reusable conversion context, all storage is kept across calls.
+ */
+struct jxs_context {
+	jxs_mapper    *arr;      /**< mapper storage */
+	size_t         len;      /**< mapper storage length */
+	size_t         need;     /**< mapper storage the last descriptor needed */
+	bool           loaded;   /**< 'schema' is loaded in the mapper storage */
+	jxs_schema     schema;   /**< schema described by jxs_context_schema() */
+	jxs_wbuf       out;      /**< json text output */
+	jmap_context_t mctx;     /**< conversion context, with the locator scratch */
+	jxs_stats      last;     /**< statistics of the last call */
+	jxs_stats      total;    /**< statistics of every call */
+	jxs_reader     in;       /**< json text input of the generated converters */
+	uint64_t       start;    /**< start time of a generated converter call */
+	size_t         allocs;   /**< output allocations before a generated converter call */
+};
+
+/**
+ * State of an ndjson walk, shared by the mmap and the stdio readers.
+ */
+typedef struct jxs_ndjson {
+	const jxs_schema   *schema;     /**< schema of one line */
+	void               *stptr;      /**< struct filled by every line */
+	void               *opaque;     /**< user opaque data */
+	jxs_record_callback callback;   /**< called for every parsed line */
+	void               *userdata;   /**< callback userdata */
+	size_t              lineno;     /**< lines consumed */
+	bool                stop;       /**< the callback asked to stop */
+	jmap_context_t      ctx;        /**< conversion context, reused by every line */
+} jxs_ndjson;
+
+/**
+ * Buffered ndjson writer.
+ */
+struct jxs_writer {
+	int            fd;        /**< output file descriptor, not owned */
+	size_t         bufsize;   /**< flush when the buffer holds this much */
+	jxs_sync       sync;      /**< fsync policy */
+	jxs_wbuf       wbuf;      /**< pending records */
+	jmap_context_t ctx;       /**< conversion context, reused by every record */
+};
+
+/**
+ * Per-thread state of a batch, kept across the records it converts.
+ */
+typedef struct jxs_batch_worker {
+	jmap_context_t ctx;       /**< conversion context, with the locator scratch */
+	jxs_wbuf       wbuf;      /**< json text scratch, copied out per record */
+	jxs_pool      *pool;      /**< owner pool */
+} jxs_batch_worker;
+
+/**
+ * One batch conversion, the records are handed out in chunks by 'next'.
+ */
+typedef struct jxs_batch_job {
+	const jxs_schema   *schema;   /**< shared, read-only schema */
+	uint8_t            *structs;  /**< first struct */
+	size_t              stsize;   /**< distance between two structs */
+	size_t              n;        /**< number of structs */
+	size_t              chunk;    /**< records taken at a time */
+	void               *opaque;   /**< user opaque data */
+	int                 flags;    /**< json-c formatting flags */
+	char              **out;      /**< to json: per record json string */
+	const char *const  *in;       /**< from json: per record json string */
+	size_t              next;     /**< next record to convert, atomic */
+	size_t              failed;   /**< failed records, atomic */
+} jxs_batch_job;
+
+/**
+ * Batch worker pool, the caller thread works on a batch too.
+ */
+struct jxs_pool {
+	size_t            nworkers;   /**< worker threads */
+	jxs_batch_worker *workers;    /**< worker state, [0] is the caller's */
+#ifdef JXS_HAVE_THREADS
+	pthread_t        *threads;    /**< worker threads */
+	pthread_mutex_t   batch;      /**< one batch at a time */
+	pthread_mutex_t   lock;       /**< protects the fields below */
+	pthread_cond_t    wake;       /**< a job is posted or the pool stops */
+	pthread_cond_t    done;       /**< the last busy worker left the job */
+	jxs_batch_job    *job;        /**< posted job */
+	uint64_t          seq;        /**< job sequence number */
+	size_t            busy;       /**< workers still on the job */
+	bool              stop;       /**< workers must exit */
+#endif
+};
+
+/**
+ * Converter function emitted by jxs_schema_codegen(), one per mapper and
+ * level(pretty output indents a reused mapper differently).
+ */
+typedef struct jxs_cg_func {
+	jxs_mapper *mapper;   /**< struct mapper */
+	int         level;    /**< level of the object, -1 for the reader */
+} jxs_cg_func;
+
+/**
+ * State of jxs_schema_codegen().
+ */
+typedef struct jxs_cg {
+	const char  *name;    /**< prefix of the emitted functions */
+	int          flags;   /**< json-c formatting flags of the writer */
+	jxs_wbuf     src;     /**< emitted C source */
+	jxs_wbuf     lit;     /**< json text not emitted yet, one jxs_gen_raw() call */
+	jxs_cg_func *func;    /**< functions to emit, children first */
+	size_t       nfunc;   /**< functions in use */
+	size_t       cap;     /**< functions allocated */
+	int          indent;  /**< tabs in front of an emitted line */
+	int          loop;    /**< nesting of the emitted loops */
+} jxs_cg;
+
 typedef enum item_action {
 	RULE_ITEM_ERROR = -1, /**< rule handling error */
 	RULE_ITEM_KEEP,       /**< keep raw data */
@@ -154,37 +498,6 @@ typedef enum item_action {
 	RULE_ITEM_SET         /**< set own data */
 } item_action;
 
-#define SET_NEW_LOCATOR(new_locator, locator, key, isarray, idx)         \
-	char _new_locator[JXS_KEY_MAXLEN] = { 0 };                           \
-	do {                                                                 \
-		if (isarray) {                                                   \
-			snprintf(_new_locator, sizeof(_new_locator),                 \
-			         "%s[%" FMT_SIZE_T "]",                              \
-			         (locator ? locator : key), (size_t)idx);            \
-		}                                                                \
-		else {                                                           \
-			snprintf(_new_locator, sizeof(_new_locator), "%s%s%s",       \
-			         (locator ? locator : ""),                           \
-			         ((locator && locator[0] != '\0') ? "." : ""), key); \
-		}                                                                \
-		new_locator = _new_locator;                                      \
-	} while (0)
-
-#define SET_NEW_FUZZY_LOCATOR(new_fzlocator, fzlocator, key, isarray)      \
-	char _new_fzlocator[JXS_KEY_MAXLEN] = { 0 };                           \
-	do {                                                                   \
-		if (isarray) {                                                     \
-			snprintf(_new_fzlocator, sizeof(_new_fzlocator),               \
-			         "%s[x]", (fzlocator ? fzlocator : key));              \
-		}                                                                  \
-		else {                                                             \
-			snprintf(_new_fzlocator, sizeof(_new_fzlocator), "%s%s%s",     \
-			         (fzlocator ? fzlocator : ""),                         \
-			         ((fzlocator && locator[0] != '\0') ? "." : ""), key); \
-		}                                                                  \
-		new_fzlocator = _new_fzlocator;                                    \
-	} while (0)
-
 /* Determine the type based on the data size */
 #define TYPEOF(size, type)    (size == sizeof(type))
 
@@ -192,12 +505,20 @@ typedef enum item_action {
 static void jxs_log_default_callback(int level, const char *fmt, va_list vl);
 static jmap_list_t *get_jmlist(jxs_mapper *mapper);
 static jmap_head_t *get_jmhead(jxs_mapper *mapper);
-static int jmap_to_json_array(jmap_context_t *ctx, jmap_head_t *jmhead, jmap_item_t *jmitem, json_object *arrjso);
-static int jmap_to_json_object(jmap_context_t *ctx, jxs_mapper *mapper, json_object *jso);
-static int jmap_from_json_array(jmap_context_t *ctx, jmap_head_t *jmhead, jmap_item_t *jmitem, json_object *arrjso);
-static int jmap_from_json_object(jmap_context_t *ctx, jxs_mapper *mapper, json_object *jso);
-static void jmap_array_print(jmap_context_t *ctx, jmap_head_t *jmhead, jmap_item_t *jmitem, const char *locator);
-static void jmap_struct_print(jmap_context_t *ctx, jxs_mapper *mapper, const char *locator);
+static int jmap_to_json_array(jmap_context_t *ctx, uint8_t *base, jmap_item_t *jmitem, json_object *arrjso);
+static int jmap_to_json_object(jmap_context_t *ctx, jxs_mapper *mapper, uint8_t *base, json_object *jso);
+static int jmap_from_json_array(jmap_context_t *ctx, uint8_t *base, jmap_item_t *jmitem, json_object *arrjso);
+static int jmap_from_json_object(jmap_context_t *ctx, jxs_mapper *mapper, uint8_t *base, json_object *jso);
+static void jmap_array_print(jmap_context_t *ctx, uint8_t *base, jmap_item_t *jmitem);
+static void jmap_struct_print(jmap_context_t *ctx, jxs_mapper *mapper, uint8_t *base);
+static int jmap_write_array(jmap_context_t *ctx, uint8_t *base, jmap_item_t *jmitem, jxs_wbuf *wbuf, int level, int flags);
+static int jmap_write_object(jmap_context_t *ctx, jxs_mapper *mapper, uint8_t *base, jxs_wbuf *wbuf, int level, int flags);
+static int jmap_read_array(jmap_context_t *ctx, uint8_t *base, jmap_item_t *jmitem, jxs_reader *rd);
+static int jmap_read_object(jmap_context_t *ctx, jxs_mapper *mapper, uint8_t *base, jxs_reader *rd);
+static int jmap_cbor_write_array(jmap_context_t *ctx, uint8_t *base, jmap_item_t *jmitem, jxs_wbuf *wbuf);
+static int jmap_cbor_write_object(jmap_context_t *ctx, jxs_mapper *mapper, uint8_t *base, jxs_wbuf *wbuf);
+static int jmap_cbor_read_array(jmap_context_t *ctx, uint8_t *base, jmap_item_t *jmitem, jxs_cbor *cb);
+static int jmap_cbor_read_object(jmap_context_t *ctx, jxs_mapper *mapper, uint8_t *base, jxs_cbor *cb);
 
 /* Ends C function definitions when using C++ */
 #ifdef __cplusplus